@@ -190,6 +190,14 @@
      jsonWriter.maxDepth = jsonParser.maxDepth = d;
 }
 
+- (BOOL)decimalNumbers {
+    return jsonParser.decimalNumbers;
+}
+
+- (void)setDecimalNumbers:(BOOL)x {
+    jsonParser.decimalNumbers = x;
+}
+
 
 #pragma mark Properties - writing
 
@@ -37,6 +37,19 @@
  */
 @protocol SBJsonParser
 
+/**
+ @brief Whether numbers are returned as NSDecimalNumber instances.
+ 
+ The default is NO. Integers that fit in 64 bits are then returned as NSNumber instances holding a
+ long long (or an unsigned long long above LLONG_MAX), other numbers as NSNumber instances holding
+ the nearest double. Integers too long for 64 bits and numbers out of the range of a double are
+ still returned as NSDecimalNumber instances.
+ 
+ Set this to YES if you need every number exactly as written, for example for decimal fractions
+ like prices.
+ */
+@property BOOL decimalNumbers;
+
 /**
  @brief Return the object represented by the given string.
  
@@ -50,6 +63,52 @@
 @end
 
 
+@class SBJsonParser;
+
+/**
+ @brief Events of a JSON document, in the order they appear in it.
+ 
+ Set an object implementing this protocol as the delegate of an SBJsonParser to handle documents
+ too large to hold in memory. The parser then builds no arrays or dictionaries, memory use depends
+ on how deeply the document is nested rather than on its size. The events are sent as the bytes
+ arrive, so with -parseBytes:length: the delegate sees the start of a document before its end has
+ been loaded.
+ 
+ Events already sent are not taken back if the document turns out to be invalid later on; the
+ parse methods return nil and the error trace tells what went wrong.
+ */
+@protocol SBJsonStreamParserDelegate
+
+/// Called for '{'. Keys and values follow, then -parserDidEndObject:
+- (void)parserDidStartObject:(SBJsonParser *)parser;
+
+/// Called for each key in an object, before its value
+- (void)parser:(SBJsonParser *)parser foundKey:(NSString *)key;
+
+/// Called for '}'
+- (void)parserDidEndObject:(SBJsonParser *)parser;
+
+/// Called for '['. Values follow, then -parserDidEndArray:
+- (void)parserDidStartArray:(SBJsonParser *)parser;
+
+/// Called for ']'
+- (void)parserDidEndArray:(SBJsonParser *)parser;
+
+/// Called for a string value. Keep or copy it, it is released after the call
+- (void)parser:(SBJsonParser *)parser foundString:(NSString *)string;
+
+/// Called for a number, same types as returned by SBJsonParser
+- (void)parser:(SBJsonParser *)parser foundNumber:(NSNumber *)number;
+
+/// Called for true and false
+- (void)parser:(SBJsonParser *)parser foundBoolean:(BOOL)x;
+
+/// Called for null
+- (void)parserFoundNull:(SBJsonParser *)parser;
+
+@end
+
+
 /**
  @brief The JSON parser class.
  
@@ -58,25 +117,115 @@
  @li Null -> NSNull
  @li String -> NSMutableString
  @li Array -> NSMutableArray
- @li Object -> NSMutableDictionary
+ @li Object -> NSMutableDictionary (with immutable NSString keys)
  @li Boolean -> NSNumber (initialised with -initWithBool:)
- @li Number -> NSDecimalNumber
+ @li Number -> NSNumber (long long, unsigned long long or double), or NSDecimalNumber
  
  Since Objective-C doesn't have a dedicated class for boolean values, these turns into NSNumber
  instances. These are initialised with the -initWithBool: method, and 
  round-trip back to JSON properly. (They won't silently suddenly become 0 or 1; they'll be
  represented as 'true' and 'false' again.)
  
- JSON numbers turn into NSDecimalNumber instances,
- as we can thus avoid any loss of precision. (JSON allows ridiculously large numbers.)
+ JSON integers turn into NSNumber instances holding a 64-bit integer and other numbers into
+ NSNumber instances holding a double, which is much cheaper than parsing NSDecimalNumber instances.
+ Numbers that don't fit either, and all numbers if decimalNumbers is set, turn into
+ NSDecimalNumber instances, as we can thus avoid any loss of precision. (JSON allows ridiculously
+ large numbers.)
  
  */
 @interface SBJsonParser : SBJsonBase <SBJsonParser> {
     
 @private
-    const char *c;
+    // State of an incremental parse, kept between chunks
+    int streamState;
+    int tokenState;
+    int numberState;
+    const char *literal;
+    NSUInteger literalIndex;
+    unichar hexValue;
+    int hexDigits;
+    unichar highSurrogate;
+    NSMutableData *tokenBuffer;
+    struct SBJsonFrame *frames;
+    NSUInteger frameCount, frameCapacity;
+    id result;
+    BOOL rootIsContainer;
+    
+    BOOL decimalNumbers;
+    id <SBJsonStreamParserDelegate> delegate;
+    
+    // Object keys seen so far, kept between documents
+    struct SBJsonKeyEntry *keyTable;
+    NSUInteger keyCount;
 }
 
+/**
+ @brief Receives the document as events instead of objects.
+ 
+ The default is nil. While a delegate is set, the parse methods send it the document as it is
+ parsed and return the delegate itself instead of an object if the document was valid, nil if it
+ wasn't. The delegate is not retained, and must not be changed in the middle of a document.
+ 
+ @see SBJsonStreamParserDelegate
+ */
+@property (assign) id <SBJsonStreamParserDelegate> delegate;
+
+/**
+ @brief Return the object represented by the given UTF-8 bytes.
+ 
+ Same as -objectWithString:, without creating a string first. Exactly length bytes are read,
+ the bytes don't need to be NUL terminated.
+ 
+ @param bytes UTF-8 encoded JSON
+ @param length the number of bytes to parse
+ */
+- (id)objectWithBytes:(const char *)bytes length:(NSUInteger)length;
+
+/**
+ @brief Return the object represented by the given UTF-8 data.
+ 
+ @see -objectWithBytes:length:
+ */
+- (id)objectWithData:(NSData *)data;
+
+/**
+ @brief Parse the next chunk of a JSON document.
+ 
+ Call this as data arrives, for example from -connection:didReceiveData:, and call -finishParsing
+ once the whole document has been passed in. Chunks can be split anywhere, also in the middle of
+ a string, an escape sequence or a multi-byte UTF-8 character.
+ 
+ Returns NO as soon as the input can no longer be valid JSON. Later chunks are ignored and
+ -finishParsing returns nil.
+ 
+ @param bytes UTF-8 encoded JSON
+ @param length the number of bytes to parse
+ */
+- (BOOL)parseBytes:(const char *)bytes length:(NSUInteger)length;
+
+/**
+ @brief Parse the next chunk of a JSON document.
+ 
+ @see -parseBytes:length:
+ */
+- (BOOL)parseData:(NSData *)data;
+
+/**
+ @brief Return the object represented by the chunks parsed since the last call.
+ 
+ Like -objectWithString: this returns nil on error, or if the document is not a dictionary or an
+ array. The parser is ready for the next document afterwards.
+ */
+- (id)finishParsing;
+
+/**
+ @brief Drop a document that was only partly parsed.
+ 
+ The parser is ready for the next document afterwards. Object keys seen so far are kept, so a
+ parser that is reused for many documents of the same kind creates each key only once.
+ */
+- (void)resetStream;
+
 @end
 
 // don't use - exists for backwards compatibility with 2.1.x only. Will be removed in 2.3.
@@ -28,43 +28,286 @@
  */
 
 #import "SBJsonParser.h"
+#import "SBJsonScan.h"
+#include <xlocale.h>
+#include <errno.h>
 
 @interface SBJsonParser ()
 
-- (BOOL)scanValue:(NSObject **)o;
+- (id)objectWithString:(NSString *)repr allowFragment:(BOOL)allowFragment;
 
-- (BOOL)scanRestOfArray:(NSMutableArray **)o;
-- (BOOL)scanRestOfDictionary:(NSMutableDictionary **)o;
-- (BOOL)scanRestOfNull:(NSNull **)o;
-- (BOOL)scanRestOfFalse:(NSNumber **)o;
-- (BOOL)scanRestOfTrue:(NSNumber **)o;
-- (BOOL)scanRestOfString:(NSMutableString **)o;
+- (void)foundHexQuad;
+- (void)appendCodePoint:(UTF32Char)ch;
+- (void)resetKeyTable;
 
-// Cannot manage without looking at the first digit
-- (BOOL)scanNumber:(NSNumber **)o;
+- (void)finishToken;
+- (void)finishStructure;
+- (id)finishParsingAllowingFragment:(BOOL)allowFragment;
 
-- (BOOL)scanHexQuad:(unichar *)x;
-- (BOOL)scanUnicodeChar:(unichar *)x;
-
-- (BOOL)scanIsAtEnd;
+- (void)failWithCode:(NSUInteger)code description:(NSString *)str;
+- (void)failFrameWithCode:(NSUInteger)code description:(NSString *)str;
+- (void)failHexQuad;
+- (void)failLowSurrogate;
+- (void)unwindFrames:(NSUInteger)count;
 
 @end
 
-#define skipWhitespace(c) while (isspace(*c)) c++
-#define skipDigits(c) while (isdigit(*c)) c++
+/*
+ The parser runs on plain C functions over the parser's instance variables, so the bytes of a
+ document cost no message sends. Only errors, escapes and the start and end of a document go
+ through methods.
+ */
+static const unsigned char *streamStructure(SBJsonParser *parser, const unsigned char *p, const unsigned char *end);
+static const unsigned char *startValue(SBJsonParser *parser, const unsigned char *p);
+static const unsigned char *streamString(SBJsonParser *parser, const unsigned char *p, const unsigned char *end);
+static const unsigned char *streamNumber(SBJsonParser *parser, const unsigned char *p, const unsigned char *end);
+static const unsigned char *streamLiteral(SBJsonParser *parser, const unsigned char *p, const unsigned char *end);
+static void foundValue(SBJsonParser *parser, id o);
+static void foundString(SBJsonParser *parser, const void *bytes, NSUInteger len);
+static void foundNumber(SBJsonParser *parser, const void *bytes, NSUInteger len);
+static NSString *keyWithBytes(SBJsonParser *parser, const void *bytes, NSUInteger len);
+static void pushFrame(SBJsonParser *parser, id container, int state);
+static void popFrame(SBJsonParser *parser);
+
+enum {
+    SBStreamIdle,
+    SBStreamParsing,
+    SBStreamFailed
+};
+
+enum {
+    SBTokenNone,
+    SBTokenString,
+    SBTokenStringAfterEscape,
+    SBTokenEscape,
+    SBTokenHexQuad,
+    SBTokenLowBackslash,
+    SBTokenLowU,
+    SBTokenNumber,
+    SBTokenLiteral
+};
+
+enum {
+    SBNumberStart,
+    SBNumberMinus,
+    SBNumberZero,
+    SBNumberInt,
+    SBNumberPoint,
+    SBNumberFraction,
+    SBNumberE,
+    SBNumberExponentSign,
+    SBNumberExponent
+};
+
+// What a byte means between tokens. Looked up in byteClass, so the switches on it become jump tables
+enum {
+    SBByteOther,
+    SBByteWhitespace,
+    SBByteObjectOpen,
+    SBByteObjectClose,
+    SBByteArrayOpen,
+    SBByteArrayClose,
+    SBByteComma,
+    SBByteColon,
+    SBByteQuote,
+    SBByteTrue,
+    SBByteFalse,
+    SBByteNull,
+    SBByteNumber,
+    SBBytePlus
+};
+
+/*
+ What an open container expects next. Array states must come first, see foundValue().
+ The Space states are the Start states once whitespace has followed the bracket. The recursive
+ scanner looked for the end of input before it skipped that whitespace, so it reported a different
+ error for "[ " than for "[".
+ */
+enum {
+    SBFrameArrayStart,
+    SBFrameArraySpace,
+    SBFrameArrayValue,
+    SBFrameArrayComma,
+    SBFrameObjectStart,
+    SBFrameObjectSpace,
+    SBFrameObjectKey,
+    SBFrameObjectColon,
+    SBFrameObjectValue,
+    SBFrameObjectComma
+};
+
+// One open array or object. Takes the place of a stack frame in a recursive parser.
+typedef struct SBJsonFrame {
+    id container;
+    NSString *key;
+    int state;
+} SBJsonFrame;
+
+/*
+ Object keys repeat thousands of times in large responses, so every parser keeps the keys it has
+ seen in an open addressing table and hands out the same immutable string again. The table is
+ kept between documents. It starts out with common Facebook field names, and is cleared back to
+ those once it is full, so documents with a lot of one-off keys can't fill it for good.
+ */
+#define SBKeyTableSize 512              // slots, a power of two
+#define SBKeyTableLimit 384             // keys kept before the table is cleared
+#define SBKeyMaxLength 32               // longer keys are not kept
+
+typedef struct SBJsonKeyEntry {
+    NSString *string;                   // nil for an empty slot
+    NSUInteger hash;
+    NSUInteger length;
+    char bytes[SBKeyMaxLength];
+} SBJsonKeyEntry;
+
+static NSString * const knownKeys[] = {
+    @"error_code", @"error_msg", @"request_args", @"key", @"value",
+    @"uid", @"name", @"first_name", @"last_name", @"sex", @"birthday", @"locale", @"username",
+    @"pic", @"pic_small", @"pic_big", @"pic_square", @"profile_url", @"status", @"message", @"time",
+    @"status_id", @"online_presence", @"is_app_user", @"has_added_app", @"timezone",
+    @"hometown_location", @"current_location", @"city", @"state", @"country", @"zip",
+    @"pid", @"aid", @"owner", @"src", @"src_big", @"src_small", @"src_height", @"src_width",
+    @"src_big_height", @"src_big_width", @"src_small_height", @"src_small_width",
+    @"link", @"caption", @"created", @"modified", @"object_id", @"cover_pid", @"size",
+    @"description", @"location", @"type", @"visible", @"can_upload", @"edit_link", @"modified_major",
+    @"eid", @"gid", @"post_id", @"actor_id", @"target_id", @"source_id", @"created_time",
+    @"updated_time", @"comments", @"likes", @"count", @"href", @"text", @"id", @"fromid", @"xid",
+    @"vid", @"title", @"thumbnail_link", @"embed_html", @"format", @"width", @"height",
+    @"video_id", @"upload_session_id", @"upload_phase", @"start_offset", @"end_offset"
+};
+
+// FNV-1a
+static inline NSUInteger keyHash(const unsigned char *bytes, NSUInteger len) {
+    uint32_t hash = 2166136261U;
+    while (len--) {
+        hash ^= *bytes++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+// Takes over the reference to string. There has to be a free slot.
+static void insertKey(SBJsonKeyEntry *table, NSString *string, const void *bytes, NSUInteger len, NSUInteger hash) {
+    NSUInteger i = hash & (SBKeyTableSize - 1);
+    while (table[i].string)
+        i = (i + 1) & (SBKeyTableSize - 1);
+    table[i].string = string;
+    table[i].hash = hash;
+    table[i].length = len;
+    memcpy(table[i].bytes, bytes, len);
+}
+
+static inline int hexDigitValue(unsigned char uc) {
+    return (uc >= '0' && uc <= '9')
+    ? uc - '0' : (uc >= 'a' && uc <= 'f')
+    ? (uc - 'a' + 10) : (uc >= 'A' && uc <= 'F')
+    ? (uc - 'A' + 10) : -1;
+}
+
+
+/*
+ Integers that fit in 64 bits are accumulated directly into a long long, or an unsigned long long
+ above LLONG_MAX, and Foundation keeps the small ones in tagged pointers. Fractions and exponents
+ go through strtod, which rounds correctly. Longer integers, numbers out of the range of a double
+ and all numbers in decimalNumbers mode become NSDecimalNumber as before.
+ The bytes have been checked to be a valid JSON number already.
+ */
+static NSNumber *numberWithBytes(const char *bytes, NSUInteger len, BOOL decimalNumbers) {
+    if (!decimalNumbers) {
+        const char *p = bytes, *end = bytes + len;
+        BOOL negative = *p == '-';
+        if (negative)
+            p++;
+        
+        unsigned long long magnitude = 0;
+        BOOL overflow = NO;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            unsigned digit = *p - '0';
+            if (overflow || magnitude > (ULLONG_MAX - digit) / 10)
+                overflow = YES;
+            else
+                magnitude = magnitude * 10 + digit;
+        }
+        
+        if (p == end && !overflow) {
+            if (!negative)
+                return magnitude <= LLONG_MAX ? [NSNumber numberWithLongLong:magnitude] : [NSNumber numberWithUnsignedLongLong:magnitude];
+            if (magnitude <= (unsigned long long)LLONG_MAX + 1)
+                return [NSNumber numberWithLongLong:(long long)(0 - magnitude)];
+            
+        } else if (p < end) {
+            // strtod needs a terminated copy, the number is followed by the rest of the document
+            char stackBuffer[64];
+            char *buffer = len < sizeof(stackBuffer) ? stackBuffer : malloc(len + 1);
+            if (buffer) {
+                memcpy(buffer, bytes, len);
+                buffer[len] = 0;
+                errno = 0;
+                double d = strtod_l(buffer, NULL, NULL);   // the C locale, whatever the app set
+                BOOL outOfRange = errno == ERANGE;         // overflow, or underflow to 0 as with 1e-400
+                if (buffer != stackBuffer)
+                    free(buffer);
+                if (isfinite(d) && !outOfRange)
+                    return [NSNumber numberWithDouble:d];
+            }
+        }
+    }
+    
+    id str = [[NSString alloc] initWithBytes:bytes length:len encoding:NSASCIIStringEncoding];
+    NSNumber *o = str ? [NSDecimalNumber decimalNumberWithString:str] : nil;
+    [str release];
+    return o;
+}
 
 
 @implementation SBJsonParser
 
-static char ctrl[0x22];
+@synthesize decimalNumbers;
+@synthesize delegate;
+
+static unsigned char byteClass[256];
 
 + (void)initialize
 {
-    ctrl[0] = '\"';
-    ctrl[1] = '\\';
-    for (int i = 1; i < 0x20; i++)
-        ctrl[i+1] = i;
-    ctrl[0x21] = 0;    
+    // Whitespace is the same characters as isspace() in the C locale
+    for (int i = '\t'; i <= '\r'; i++)
+        byteClass[i] = SBByteWhitespace;
+    byteClass[' '] = SBByteWhitespace;
+    byteClass['{'] = SBByteObjectOpen;
+    byteClass['}'] = SBByteObjectClose;
+    byteClass['['] = SBByteArrayOpen;
+    byteClass[']'] = SBByteArrayClose;
+    byteClass[','] = SBByteComma;
+    byteClass[':'] = SBByteColon;
+    byteClass['"'] = SBByteQuote;
+    byteClass['t'] = SBByteTrue;
+    byteClass['f'] = SBByteFalse;
+    byteClass['n'] = SBByteNull;
+    byteClass['-'] = SBByteNumber;
+    for (int i = '0'; i <= '9'; i++)
+        byteClass[i] = SBByteNumber;
+    byteClass['+'] = SBBytePlus;
+
+    SBJsonScanInitialize();
+}
+
+- (id)init {
+    self = [super init];
+    if (self)
+        tokenBuffer = [[NSMutableData alloc] initWithCapacity:256];
+    return self;
+}
+
+- (void)dealloc {
+    [self resetStream];
+    free(frames);
+    if (keyTable) {
+        for (NSUInteger i = 0; i < SBKeyTableSize; i++)
+            [keyTable[i].string release];
+        free(keyTable);
+    }
+    [tokenBuffer release];
+    [super dealloc];
 }
 
 /**
@@ -72,404 +315,767 @@ static char ctrl[0x22];
  It should be removed in the next major version.
  */
 - (id)fragmentWithString:(id)repr {
-    [self clearErrorTrace];
-    
+    return [self objectWithString:repr allowFragment:YES];
+}
+
+- (id)objectWithString:(NSString *)repr {
+    return [self objectWithString:repr allowFragment:NO];
+}
+
+- (id)objectWithString:(NSString *)repr allowFragment:(BOOL)allowFragment {
     if (!repr) {
+        [self clearErrorTrace];
         [self addErrorWithCode:EINPUT description:@"Input was 'nil'"];
         return nil;
     }
-    
-    depth = 0;
-    c = [repr UTF8String];
-    
-    id o;
-    if (![self scanValue:&o]) {
-        return nil;
-    }
-    
-    // We found some valid JSON. But did it also contain something else?
-    if (![self scanIsAtEnd]) {
-        [self addErrorWithCode:ETRAILGARBAGE description:@"Garbage after JSON"];
+
+    // As before, the document ends at the first NUL
+    const char *bytes = [repr UTF8String];
+    [self resetStream];
+    [self parseBytes:bytes length:strlen(bytes)];
+    return [self finishParsingAllowingFragment:allowFragment];
+}
+
+- (id)objectWithBytes:(const char *)bytes length:(NSUInteger)length {
+    [self resetStream];
+    [self parseBytes:bytes length:length];
+    return [self finishParsing];
+}
+
+- (id)objectWithData:(NSData *)data {
+    if (!data) {
+        [self clearErrorTrace];
+        [self addErrorWithCode:EINPUT description:@"Input was 'nil'"];
         return nil;
     }
-        
-    NSAssert1(o, @"Should have a valid object from %@", repr);
-    return o;    
+    return [self objectWithBytes:[data bytes] length:[data length]];
 }
 
-- (id)objectWithString:(NSString *)repr {
+- (BOOL)parseData:(NSData *)data {
+    return [self parseBytes:[data bytes] length:[data length]];
+}
 
-    id o = [self fragmentWithString:repr];
-    if (!o)
-        return nil;
+- (BOOL)parseBytes:(const char *)bytes length:(NSUInteger)length {
+    if (streamState == SBStreamIdle) {
+        [self clearErrorTrace];
+        streamState = SBStreamParsing;
+    }
     
-    // Check that the object we've found is a valid JSON container.
-    if (![o isKindOfClass:[NSDictionary class]] && ![o isKindOfClass:[NSArray class]]) {
-        [self addErrorWithCode:EFRAGMENT description:@"Valid fragment, but not JSON"];
-        return nil;
+    const unsigned char *p = (const unsigned char *)bytes;
+    const unsigned char *end = p + length;
+    while (p < end && streamState == SBStreamParsing) {
+        switch (tokenState) {
+            case SBTokenNone:
+                p = streamStructure(self, p, end);
+                break;
+            case SBTokenNumber:
+                p = streamNumber(self, p, end);
+                break;
+            case SBTokenLiteral:
+                p = streamLiteral(self, p, end);
+                break;
+            default:
+                p = streamString(self, p, end);
+                break;
+        }
     }
+    return streamState == SBStreamParsing;
+}
 
-    return o;
+- (id)finishParsing {
+    return [self finishParsingAllowingFragment:NO];
 }
 
 /*
- In contrast to the public methods, it is an error to omit the error parameter here.
+ The parser is a state machine over an explicit stack of open containers, so it can stop at the end
+ of any chunk and pick up again with the next one, and deep documents don't use up the thread's
+ stack. It reports the errors the recursive scanner it replaced did, including the messages each
+ enclosing container adds on the way out.
  */
-- (BOOL)scanValue:(NSObject **)o
-{
-    skipWhitespace(c);
-    
-    switch (*c++) {
-        case '{':
-            return [self scanRestOfDictionary:(NSMutableDictionary **)o];
-            break;
-        case '[':
-            return [self scanRestOfArray:(NSMutableArray **)o];
-            break;
-        case '"':
-            return [self scanRestOfString:(NSMutableString **)o];
-            break;
-        case 'f':
-            return [self scanRestOfFalse:(NSNumber **)o];
+static const unsigned char *streamStructure(SBJsonParser *parser, const unsigned char *p, const unsigned char *end) {
+    while (p < end) {
+        int cls = byteClass[*p];
+        if (cls == SBByteWhitespace) {
+            if (parser->frameCount) {
+                SBJsonFrame *top = &parser->frames[parser->frameCount - 1];
+                if (top->state == SBFrameArrayStart)
+                    top->state = SBFrameArraySpace;
+                else if (top->state == SBFrameObjectStart)
+                    top->state = SBFrameObjectSpace;
+            }
+            p = SBJsonSkipWhitespace(p + 1, end);
+            continue;
+        }
+
+        if (!parser->frameCount) {
+            if (parser->result) {
+                [parser failWithCode:ETRAILGARBAGE description:@"Garbage after JSON"];
+                return end;
+            }
+            return startValue(parser, p);
+        }
+
+        SBJsonFrame *top = &parser->frames[parser->frameCount - 1];
+        switch (top->state) {
+            case SBFrameArrayComma:
+                if (cls == SBByteComma) {
+                    top->state = SBFrameArrayValue;
+                    p++;
+                    continue;
+                }
+                // Like in the recursive scanner, a missing comma is not an error
+            case SBFrameArrayStart:
+            case SBFrameArraySpace:
+                if (cls == SBByteArrayClose) {
+                    popFrame(parser);
+                    p++;
+                    continue;
+                }
+                break;
+
+            case SBFrameArrayValue:
+                if (cls == SBByteArrayClose) {
+                    [parser failFrameWithCode:ETRAILCOMMA description:@"Trailing comma disallowed in array"];
+                    return end;
+                }
+                break;
+
+            case SBFrameObjectComma:
+                if (cls == SBByteComma) {
+                    top->state = SBFrameObjectKey;
+                    p++;
+                    continue;
+                }
+            case SBFrameObjectStart:
+            case SBFrameObjectSpace:
+                if (cls == SBByteObjectClose) {
+                    popFrame(parser);
+                    p++;
+                    continue;
+                }
+            case SBFrameObjectKey:
+                if (cls == SBByteObjectClose) {
+                    [parser failFrameWithCode:ETRAILCOMMA description:@"Trailing comma disallowed in object"];
+                    return end;
+                }
+                if (cls != SBByteQuote) {
+                    [parser failFrameWithCode:EPARSE description:@"Object key string expected"];
+                    return end;
+                }
+                break;
+
+            case SBFrameObjectColon:
+                if (cls != SBByteColon) {
+                    [parser failFrameWithCode:EPARSE description:@"Expected ':' separating key and value"];
+                    return end;
+                }
+                top->state = SBFrameObjectValue;
+                p++;
+                continue;
+
+            case SBFrameObjectValue:
+                break;
+        }
+        return startValue(parser, p);
+    }
+    return p;
+}
+
+static const unsigned char *startValue(SBJsonParser *parser, const unsigned char *p) {
+    switch (byteClass[*p]) {
+        case SBByteObjectOpen:
+        case SBByteArrayOpen:
+            if (parser->maxDepth && parser->frameCount + 1 > parser->maxDepth) {
+                [parser failWithCode:EDEPTH description:@"Nested too deep"];
+                return p;
+            }
+            if (!parser->frameCount)
+                parser->rootIsContainer = YES;
+            if (parser->delegate) {
+                // Nothing is built for the delegate, the frame only tracks where the parser is
+                if (*p == '{') {
+                    pushFrame(parser, nil, SBFrameObjectStart);
+                    [parser->delegate parserDidStartObject:parser];
+                } else {
+                    pushFrame(parser, nil, SBFrameArrayStart);
+                    [parser->delegate parserDidStartArray:parser];
+                }
+            } else if (*p == '{')
+                pushFrame(parser, [[NSMutableDictionary alloc] initWithCapacity:7], SBFrameObjectStart);
+            else
+                pushFrame(parser, [[NSMutableArray alloc] initWithCapacity:8], SBFrameArrayStart);
             break;
-        case 't':
-            return [self scanRestOfTrue:(NSNumber **)o];
+        case SBByteQuote:
+            parser->tokenState = SBTokenString;
+            parser->highSurrogate = 0;
             break;
-        case 'n':
-            return [self scanRestOfNull:(NSNull **)o];
+        case SBByteTrue:
+            parser->literal = "true";
+            parser->literalIndex = 1;
+            parser->tokenState = SBTokenLiteral;
             break;
-        case '-':
-        case '0'...'9':
-            c--; // cannot verify number correctly without the first character
-            return [self scanNumber:(NSNumber **)o];
+        case SBByteFalse:
+            parser->literal = "false";
+            parser->literalIndex = 1;
+            parser->tokenState = SBTokenLiteral;
             break;
-        case '+':
-            [self addErrorWithCode:EPARSENUM description: @"Leading + disallowed in number"];
-            return NO;
+        case SBByteNull:
+            parser->literal = "null";
+            parser->literalIndex = 1;
+            parser->tokenState = SBTokenLiteral;
             break;
-        case 0x0:
-            [self addErrorWithCode:EEOF description:@"Unexpected end of string"];
-            return NO;
+        case SBByteNumber:
+            // The number scanner checks the first character too
+            parser->tokenState = SBTokenNumber;
+            parser->numberState = SBNumberStart;
+            return p;
+        case SBBytePlus:
+            [parser failWithCode:EPARSENUM description:@"Leading + disallowed in number"];
             break;
         default:
-            [self addErrorWithCode:EPARSE description: @"Unrecognised leading character"];
-            return NO;
+            [parser failWithCode:EPARSE description:@"Unrecognised leading character"];
             break;
     }
-    
-    NSAssert(0, @"Should never get here");
-    return NO;
+    return p + 1;
 }
 
-- (BOOL)scanRestOfTrue:(NSNumber **)o
-{
-    if (!strncmp(c, "rue", 3)) {
-        c += 3;
-        *o = [NSNumber numberWithBool:YES];
-        return YES;
+static const unsigned char *streamString(SBJsonParser *parser, const unsigned char *p, const unsigned char *end) {
+    // Bytes between escapes are copied in one go, and not at all if the whole string is in this chunk
+    const unsigned char *run = p;
+    
+    while (p < end) {
+        unsigned char ch;
+        const unsigned char *scanned;
+        switch (parser->tokenState) {
+            case SBTokenString:
+            case SBTokenStringAfterEscape:
+                scanned = p;
+                p = SBJsonScanString(p, end);
+                if (p != scanned)
+                    parser->tokenState = SBTokenString;
+                if (p == end)
+                    break;
+                
+                ch = *p;
+                if (ch == '"') {
+                    if ([parser->tokenBuffer length]) {
+                        [parser->tokenBuffer appendBytes:run length:p - run];
+                        foundString(parser, [parser->tokenBuffer bytes], [parser->tokenBuffer length]);
+                    } else {
+                        foundString(parser, run, p - run);
+                    }
+                    return p + 1;
+                }
+                if (ch != '\\') {
+                    [parser failWithCode:ECTRL description:[NSString stringWithFormat:@"Unescaped control character '0x%x'", ch]];
+                    return end;
+                }
+                [parser->tokenBuffer appendBytes:run length:p - run];
+                parser->tokenState = SBTokenEscape;
+                p++;
+                break;
+                
+            case SBTokenEscape:
+                ch = *p++;
+                switch (ch) {
+                    case '\\':
+                    case '/':
+                    case '"':
+                        break;
+                        
+                    case 'b':   ch = '\b';  break;
+                    case 'n':   ch = '\n';  break;
+                    case 'r':   ch = '\r';  break;
+                    case 't':   ch = '\t';  break;
+                    case 'f':   ch = '\f';  break;
+                        
+                    case 'u':
+                        parser->tokenState = SBTokenHexQuad;
+                        parser->hexValue = 0;
+                        parser->hexDigits = 0;
+                        continue;
+                    default:
+                        // The recursive scanner read a signed char, bytes above 0x7f were printed sign extended
+                        [parser failWithCode:EESCAPE description:[NSString stringWithFormat:@"Illegal escape sequence '0x%x'", (unichar)(char)ch]];
+                        return end;
+                }
+                [parser->tokenBuffer appendBytes:&ch length:1];
+                parser->tokenState = SBTokenStringAfterEscape;
+                run = p;
+                break;
+                
+            case SBTokenHexQuad: {
+                int d = hexDigitValue(*p++);
+                if (d == -1) {
+                    [parser failHexQuad];
+                    return end;
+                }
+                parser->hexValue = parser->hexValue * 16 + d;
+                if (++parser->hexDigits == 4) {
+                    [parser foundHexQuad];
+                    if (parser->streamState == SBStreamFailed)
+                        return end;
+                    run = p;
+                }
+                break;
+            }
+                
+            case SBTokenLowBackslash:
+                if (*p++ != '\\') {
+                    [parser failLowSurrogate];
+                    return end;
+                }
+                parser->tokenState = SBTokenLowU;
+                break;
+                
+            case SBTokenLowU:
+                if (*p++ != 'u') {
+                    [parser failLowSurrogate];
+                    return end;
+                }
+                parser->tokenState = SBTokenHexQuad;
+                parser->hexValue = 0;
+                parser->hexDigits = 0;
+                break;
+        }
     }
-    [self addErrorWithCode:EPARSE description:@"Expected 'true'"];
-    return NO;
+    
+    // The string goes on in the next chunk
+    if (parser->tokenState == SBTokenString || parser->tokenState == SBTokenStringAfterEscape)
+        [parser->tokenBuffer appendBytes:run length:p - run];
+    return p;
 }
 
-- (BOOL)scanRestOfFalse:(NSNumber **)o
-{
-    if (!strncmp(c, "alse", 4)) {
-        c += 4;
-        *o = [NSNumber numberWithBool:NO];
-        return YES;
+- (void)foundHexQuad {
+    if (highSurrogate) {
+        unichar lo = hexValue;
+        if (lo < 0xdc00 || lo >= 0xdfff) {
+            [self addErrorWithCode:EUNICODE description:@"Invalid low surrogate char"];
+            [self failWithCode:EUNICODE description:@"Broken unicode character"];
+            return;
+        }
+        [self appendCodePoint:(highSurrogate - 0xd800) * 0x400 + (lo - 0xdc00) + 0x10000];
+        highSurrogate = 0;
+        
+    } else if (hexValue >= 0xd800 && hexValue < 0xdc00) {
+        // High surrogate, expect a low one next
+        highSurrogate = hexValue;
+        tokenState = SBTokenLowBackslash;
+        return;
+        
+    } else if (hexValue >= 0xdc00 && hexValue < 0xe000) {
+        [self addErrorWithCode:EUNICODE description:@"Invalid high character in surrogate pair"];
+        [self failWithCode:EUNICODE description:@"Broken unicode character"];
+        return;
+        
+    } else {
+        [self appendCodePoint:hexValue];
     }
-    [self addErrorWithCode:EPARSE description: @"Expected 'false'"];
-    return NO;
+    tokenState = SBTokenStringAfterEscape;
 }
 
-- (BOOL)scanRestOfNull:(NSNull **)o {
-    if (!strncmp(c, "ull", 3)) {
-        c += 3;
-        *o = [NSNull null];
-        return YES;
+- (void)appendCodePoint:(UTF32Char)ch {
+    unsigned char utf8[4];
+    NSUInteger len;
+    if (ch < 0x80) {
+        utf8[0] = ch;
+        len = 1;
+    } else if (ch < 0x800) {
+        utf8[0] = 0xc0 | (ch >> 6);
+        utf8[1] = 0x80 | (ch & 0x3f);
+        len = 2;
+    } else if (ch < 0x10000) {
+        utf8[0] = 0xe0 | (ch >> 12);
+        utf8[1] = 0x80 | ((ch >> 6) & 0x3f);
+        utf8[2] = 0x80 | (ch & 0x3f);
+        len = 3;
+    } else {
+        utf8[0] = 0xf0 | (ch >> 18);
+        utf8[1] = 0x80 | ((ch >> 12) & 0x3f);
+        utf8[2] = 0x80 | ((ch >> 6) & 0x3f);
+        utf8[3] = 0x80 | (ch & 0x3f);
+        len = 4;
     }
-    [self addErrorWithCode:EPARSE description: @"Expected 'null'"];
-    return NO;
+    [tokenBuffer appendBytes:utf8 length:len];
 }
 
-- (BOOL)scanRestOfArray:(NSMutableArray **)o {
-    if (maxDepth && ++depth > maxDepth) {
-        [self addErrorWithCode:EDEPTH description: @"Nested too deep"];
-        return NO;
-    }
-    
-    *o = [NSMutableArray arrayWithCapacity:8];
+static const unsigned char *streamNumber(SBJsonParser *parser, const unsigned char *p, const unsigned char *end) {
+    // The logic to test for validity of the number formatting is relicensed
+    // from JSON::XS with permission from its author Marc Lehmann.
+    // (Available at the CPAN: http://search.cpan.org/dist/JSON-XS/ .)
+    // It is applied one character at a time, so a number can end in the next chunk.
+    const unsigned char *start = p;
     
-    for (; *c ;) {
-        id v;
+    for (; p < end; p++) {
+        unsigned char ch = *p;
+        BOOL digit = (ch >= '0' && ch <= '9');
         
-        skipWhitespace(c);
-        if (*c == ']' && c++) {
-            depth--;
-            return YES;
-        }
-        
-        if (![self scanValue:&v]) {
-            [self addErrorWithCode:EPARSE description:@"Expected value while parsing array"];
-            return NO;
+        switch (parser->numberState) {
+            case SBNumberStart:
+                parser->numberState = ch == '-' ? SBNumberMinus : ch == '0' ? SBNumberZero : SBNumberInt;
+                break;
+                
+            case SBNumberMinus:
+                if (!digit) {
+                    [parser failWithCode:EPARSENUM description:@"No digits after initial minus"];
+                    return end;
+                }
+                parser->numberState = ch == '0' ? SBNumberZero : SBNumberInt;
+                break;
+                
+            case SBNumberZero:
+                if (digit) {
+                    [parser failWithCode:EPARSENUM description:@"Leading 0 disallowed in number"];
+                    return end;
+                }
+            case SBNumberInt:
+            case SBNumberFraction:
+                if (digit) {
+                    // Leave p on the last digit, the loop steps past it
+                    p = SBJsonSkipDigits(p + 1, end) - 1;
+                    break;
+                }
+                if (ch == '.' && parser->numberState != SBNumberFraction)
+                    parser->numberState = SBNumberPoint;
+                else if (ch == 'e' || ch == 'E')
+                    parser->numberState = SBNumberE;
+                else
+                    goto done;
+                break;
+                
+            case SBNumberPoint:
+                if (!digit) {
+                    [parser failWithCode:EPARSENUM description:@"No digits after decimal point"];
+                    return end;
+                }
+                parser->numberState = SBNumberFraction;
+                break;
+                
+            case SBNumberE:
+                if (ch == '-' || ch == '+') {
+                    parser->numberState = SBNumberExponentSign;
+                    break;
+                }
+            case SBNumberExponentSign:
+                if (!digit) {
+                    [parser failWithCode:EPARSENUM description:@"No digits after exponent"];
+                    return end;
+                }
+                parser->numberState = SBNumberExponent;
+                break;
+                
+            case SBNumberExponent:
+                if (!digit)
+                    goto done;
+                p = SBJsonSkipDigits(p + 1, end) - 1;
+                break;
         }
-        
-        [*o addObject:v];
-        
-        skipWhitespace(c);
-        if (*c == ',' && c++) {
-            skipWhitespace(c);
-            if (*c == ']') {
-                [self addErrorWithCode:ETRAILCOMMA description: @"Trailing comma disallowed in array"];
-                return NO;
-            }
-        }        
     }
     
-    [self addErrorWithCode:EEOF description: @"End of input while parsing array"];
-    return NO;
+    // The number goes on in the next chunk
+    [parser->tokenBuffer appendBytes:start length:p - start];
+    return p;
+    
+done:
+    if ([parser->tokenBuffer length]) {
+        [parser->tokenBuffer appendBytes:start length:p - start];
+        foundNumber(parser, [parser->tokenBuffer bytes], [parser->tokenBuffer length]);
+    } else {
+        foundNumber(parser, start, p - start);
+    }
+    // The character after the number belongs to the surrounding structure
+    return p;
 }
 
-- (BOOL)scanRestOfDictionary:(NSMutableDictionary **)o 
-{
-    if (maxDepth && ++depth > maxDepth) {
-        [self addErrorWithCode:EDEPTH description: @"Nested too deep"];
-        return NO;
-    }
-    
-    *o = [NSMutableDictionary dictionaryWithCapacity:7];
-    
-    for (; *c ;) {
-        id k, v;
-        
-        skipWhitespace(c);
-        if (*c == '}' && c++) {
-            depth--;
-            return YES;
-        }    
-        
-        if (!(*c == '\"' && c++ && [self scanRestOfString:&k])) {
-            [self addErrorWithCode:EPARSE description: @"Object key string expected"];
-            return NO;
-        }
-        
-        skipWhitespace(c);
-        if (*c != ':') {
-            [self addErrorWithCode:EPARSE description: @"Expected ':' separating key and value"];
-            return NO;
+static const unsigned char *streamLiteral(SBJsonParser *parser, const unsigned char *p, const unsigned char *end) {
+    while (p < end) {
+        if (*p != (unsigned char)parser->literal[parser->literalIndex]) {
+            [parser failWithCode:EPARSE description:[NSString stringWithFormat:@"Expected '%s'", parser->literal]];
+            return end;
         }
-        
-        c++;
-        if (![self scanValue:&v]) {
-            NSString *string = [NSString stringWithFormat:@"Object value expected for key: %@", k];
-            [self addErrorWithCode:EPARSE description: string];
-            return NO;
+        p++;
+        if (!parser->literal[++parser->literalIndex]) {
+            parser->tokenState = SBTokenNone;
+            if (parser->delegate) {
+                if (parser->literal[0] == 'n')
+                    [parser->delegate parserFoundNull:parser];
+                else
+                    [parser->delegate parser:parser foundBoolean:parser->literal[0] == 't'];
+                foundValue(parser, nil);
+            } else if (parser->literal[0] == 'n')
+                foundValue(parser, [NSNull null]);
+            else
+                foundValue(parser, [NSNumber numberWithBool:parser->literal[0] == 't']);
+            break;
         }
-        
-        [*o setObject:v forKey:k];
-        
-        skipWhitespace(c);
-        if (*c == ',' && c++) {
-            skipWhitespace(c);
-            if (*c == '}') {
-                [self addErrorWithCode:ETRAILCOMMA description: @"Trailing comma disallowed in object"];
-                return NO;
-            }
-        }        
     }
-    
-    [self addErrorWithCode:EEOF description: @"End of input while parsing object"];
-    return NO;
+    return p;
 }
 
-- (BOOL)scanRestOfString:(NSMutableString **)o 
-{
-    *o = [NSMutableString stringWithCapacity:16];
-    do {
-        // First see if there's a portion we can grab in one go. 
-        // Doing this caused a massive speedup on the long string.
-        size_t len = strcspn(c, ctrl);
-        if (len) {
-            // check for 
-            id t = [[NSString alloc] initWithBytesNoCopy:(char*)c
-                                                  length:len
-                                                encoding:NSUTF8StringEncoding
-                                            freeWhenDone:NO];
-            if (t) {
-                [*o appendString:t];
-                [t release];
-                c += len;
-            }
-        }
-        
-        if (*c == '"') {
-            c++;
-            return YES;
-            
-        } else if (*c == '\\') {
-            unichar uc = *++c;
-            switch (uc) {
-                case '\\':
-                case '/':
-                case '"':
-                    break;
-                    
-                case 'b':   uc = '\b';  break;
-                case 'n':   uc = '\n';  break;
-                case 'r':   uc = '\r';  break;
-                case 't':   uc = '\t';  break;
-                case 'f':   uc = '\f';  break;                    
-                    
-                case 'u':
-                    c++;
-                    if (![self scanUnicodeChar:&uc]) {
-                        [self addErrorWithCode:EUNICODE description: @"Broken unicode character"];
-                        return NO;
-                    }
-                    c--; // hack.
-                    break;
-                default:
-                    [self addErrorWithCode:EESCAPE description: [NSString stringWithFormat:@"Illegal escape sequence '0x%x'", uc]];
-                    return NO;
-                    break;
-            }
-            CFStringAppendCharacters((CFMutableStringRef)*o, &uc, 1);
-            c++;
-            
-        } else if (*c < 0x20) {
-            [self addErrorWithCode:ECTRL description: [NSString stringWithFormat:@"Unescaped control character '0x%x'", *c]];
-            return NO;
-            
-        } else {
-            DLog(@"should not be able to get here");
-        }
-    } while (*c);
+// With a delegate o and the containers are nil, so only the states move on
+static void foundValue(SBJsonParser *parser, id o) {
+    if (!parser->frameCount) {
+        // The delegate stands in for the document it has been sent
+        parser->result = [(parser->delegate ? parser->delegate : o) retain];
+        return;
+    }
     
-    [self addErrorWithCode:EEOF description:@"Unexpected EOF while parsing string"];
-    return NO;
+    SBJsonFrame *top = &parser->frames[parser->frameCount - 1];
+    if (top->state <= SBFrameArrayComma) {
+        [top->container addObject:o];
+        top->state = SBFrameArrayComma;
+    } else {
+        [top->container setObject:o forKey:top->key];
+        [top->key release];
+        top->key = nil;
+        top->state = SBFrameObjectComma;
+    }
 }
 
-- (BOOL)scanUnicodeChar:(unichar *)x
-{
-    unichar hi, lo;
+static void foundString(SBJsonParser *parser, const void *bytes, NSUInteger len) {
+    SBJsonFrame *top = parser->frameCount ? &parser->frames[parser->frameCount - 1] : NULL;
+    BOOL isKey = top && (top->state == SBFrameObjectStart || top->state == SBFrameObjectSpace || top->state == SBFrameObjectKey || top->state == SBFrameObjectComma);
     
-    if (![self scanHexQuad:&hi]) {
-        [self addErrorWithCode:EUNICODE description: @"Missing hex quad"];
-        return NO;        
+    id o = isKey ? [keyWithBytes(parser, bytes, len) retain] : nil;
+    if (!o)
+        o = [[NSMutableString alloc] initWithBytes:bytes length:len encoding:NSUTF8StringEncoding];
+    parser->tokenState = SBTokenNone;
+    [parser->tokenBuffer setLength:0];
+    if (!o) {
+        [parser failWithCode:EUNICODE description:@"Invalid UTF-8 in string"];
+        return;
     }
     
-    if (hi >= 0xd800) {     // high surrogate char?
-        if (hi < 0xdc00) {  // yes - expect a low char
-            
-            if (!(*c == '\\' && ++c && *c == 'u' && ++c && [self scanHexQuad:&lo])) {
-                [self addErrorWithCode:EUNICODE description: @"Missing low character in surrogate pair"];
-                return NO;
-            }
-            
-            if (lo < 0xdc00 || lo >= 0xdfff) {
-                [self addErrorWithCode:EUNICODE description:@"Invalid low surrogate char"];
-                return NO;
-            }
-            
-            hi = (hi - 0xd800) * 0x400 + (lo - 0xdc00) + 0x10000;
-            
-        } else if (hi < 0xe000) {
-            [self addErrorWithCode:EUNICODE description:@"Invalid high character in surrogate pair"];
-            return NO;
-        }
+    // With a delegate the key is still kept, the error messages need it
+    if (isKey) {
+        top->key = o;
+        top->state = SBFrameObjectColon;
+        [parser->delegate parser:parser foundKey:o];
+    } else {
+        [parser->delegate parser:parser foundString:o];
+        foundValue(parser, o);
+        [o release];
     }
-    
-    *x = hi;
-    return YES;
 }
 
-- (BOOL)scanHexQuad:(unichar *)x
-{
-    *x = 0;
-    for (int i = 0; i < 4; i++) {
-        unichar uc = *c;
-        c++;
-        int d = (uc >= '0' && uc <= '9')
-        ? uc - '0' : (uc >= 'a' && uc <= 'f')
-        ? (uc - 'a' + 10) : (uc >= 'A' && uc <= 'F')
-        ? (uc - 'A' + 10) : -1;
-        if (d == -1) {
-            [self addErrorWithCode:EUNICODE description:@"Missing hex digit in quad"];
-            return NO;
-        }
-        *x *= 16;
-        *x += d;
+static void foundNumber(SBJsonParser *parser, const void *bytes, NSUInteger len) {
+    id o = numberWithBytes(bytes, len, parser->decimalNumbers);
+    parser->tokenState = SBTokenNone;
+    [parser->tokenBuffer setLength:0];
+    if (!o) {
+        [parser failWithCode:EPARSENUM description:@"Failed creating decimal instance"];
+        return;
     }
-    return YES;
+    [parser->delegate parser:parser foundNumber:o];
+    foundValue(parser, o);
 }
 
-- (BOOL)scanNumber:(NSNumber **)o
-{
-    const char *ns = c;
-    
-    // The logic to test for validity of the number formatting is relicensed
-    // from JSON::XS with permission from its author Marc Lehmann.
-    // (Available at the CPAN: http://search.cpan.org/dist/JSON-XS/ .)
+// Returns the shared string for an object key, or nil if the key is too long to be kept or not valid UTF-8
+static NSString *keyWithBytes(SBJsonParser *parser, const void *bytes, NSUInteger len) {
+    if (len > SBKeyMaxLength)
+        return nil;
+    if (!parser->keyTable)
+        [parser resetKeyTable];
     
-    if ('-' == *c)
-        c++;
+    NSUInteger hash = keyHash(bytes, len);
+    for (NSUInteger i = hash & (SBKeyTableSize - 1); parser->keyTable[i].string; i = (i + 1) & (SBKeyTableSize - 1)) {
+        SBJsonKeyEntry *entry = &parser->keyTable[i];
+        if (entry->hash == hash && entry->length == len && !memcmp(entry->bytes, bytes, len))
+            return entry->string;
+    }
     
-    if ('0' == *c && c++) {        
-        if (isdigit(*c)) {
-            [self addErrorWithCode:EPARSENUM description: @"Leading 0 disallowed in number"];
-            return NO;
-        }
-        
-    } else if (!isdigit(*c) && c != ns) {
-        [self addErrorWithCode:EPARSENUM description: @"No digits after initial minus"];
-        return NO;
-        
+    NSString *key = [[NSString alloc] initWithBytes:bytes length:len encoding:NSUTF8StringEncoding];
+    if (!key)
+        return nil;
+    if (parser->keyCount == SBKeyTableLimit)
+        [parser resetKeyTable];
+    insertKey(parser->keyTable, key, bytes, len, hash);
+    parser->keyCount++;
+    return key;
+}
+
+// Empties the key table down to the known keys
+- (void)resetKeyTable {
+    if (keyTable) {
+        for (NSUInteger i = 0; i < SBKeyTableSize; i++)
+            [keyTable[i].string release];
+        memset(keyTable, 0, SBKeyTableSize * sizeof(SBJsonKeyEntry));
     } else {
-        skipDigits(c);
+        keyTable = calloc(SBKeyTableSize, sizeof(SBJsonKeyEntry));
+        if (!keyTable)
+            [NSException raise:NSMallocException format:@"Failed to allocate the key table"];
     }
     
-    // Fractional part
-    if ('.' == *c && c++) {
-        
-        if (!isdigit(*c)) {
-            [self addErrorWithCode:EPARSENUM description: @"No digits after decimal point"];
-            return NO;
-        }        
-        skipDigits(c);
+    keyCount = sizeof(knownKeys) / sizeof(knownKeys[0]);
+    for (NSUInteger i = 0; i < keyCount; i++) {
+        const char *bytes = [knownKeys[i] UTF8String];
+        NSUInteger len = strlen(bytes);
+        insertKey(keyTable, [knownKeys[i] retain], bytes, len, keyHash((const unsigned char *)bytes, len));
     }
+}
+
+// Takes over the reference to container
+static void pushFrame(SBJsonParser *parser, id container, int state) {
+    if (parser->frameCount == parser->frameCapacity) {
+        parser->frameCapacity = parser->frameCapacity ? parser->frameCapacity * 2 : 16;
+        parser->frames = reallocf(parser->frames, parser->frameCapacity * sizeof(SBJsonFrame));
+        if (!parser->frames)
+            [NSException raise:NSMallocException format:@"Failed to grow the parser stack"];
+    }
+    parser->frames[parser->frameCount].container = container;
+    parser->frames[parser->frameCount].key = nil;
+    parser->frames[parser->frameCount].state = state;
+    parser->frameCount++;
+}
+
+static void popFrame(SBJsonParser *parser) {
+    SBJsonFrame *frame = &parser->frames[--parser->frameCount];
+    id container = frame->container;
+    if (parser->delegate) {
+        if (frame->state <= SBFrameArrayComma)
+            [parser->delegate parserDidEndArray:parser];
+        else
+            [parser->delegate parserDidEndObject:parser];
+    }
+    foundValue(parser, container);
+    [container release];
+}
+
+- (void)finishToken {
+    static const unsigned char terminator = ' ';
     
-    // Exponential part
-    if ('e' == *c || 'E' == *c) {
-        c++;
-        
-        if ('-' == *c || '+' == *c)
-            c++;
-        
-        if (!isdigit(*c)) {
-            [self addErrorWithCode:EPARSENUM description: @"No digits after exponent"];
-            return NO;
-        }
-        skipDigits(c);
+    switch (tokenState) {
+        case SBTokenNone:
+            break;
+        case SBTokenNumber:
+            streamNumber(self, &terminator, &terminator + 1);
+            break;
+        case SBTokenLiteral:
+            streamLiteral(self, &terminator, &terminator + 1);
+            break;
+        case SBTokenString:
+            // The recursive scanner saw the terminating NUL as a control character, unless it came right after an escape
+            [self failWithCode:ECTRL description:@"Unescaped control character '0x0'"];
+            break;
+        case SBTokenStringAfterEscape:
+            [self failWithCode:EEOF description:@"Unexpected EOF while parsing string"];
+            break;
+        case SBTokenEscape:
+            [self failWithCode:EESCAPE description:@"Illegal escape sequence '0x0'"];
+            break;
+        case SBTokenHexQuad:
+            [self failHexQuad];
+            break;
+        default:
+            [self failLowSurrogate];
+            break;
+    }
+}
+
+- (void)finishStructure {
+    if (!frameCount) {
+        if (!result)
+            [self failWithCode:EEOF description:@"Unexpected end of string"];
+        return;
     }
     
-    id str = [[NSString alloc] initWithBytesNoCopy:(char*)ns
-                                            length:c - ns
-                                          encoding:NSUTF8StringEncoding
-                                      freeWhenDone:NO];
-    [str autorelease];
-    if (str && (*o = [NSDecimalNumber decimalNumberWithString:str]))
-        return YES;
+    switch (frames[frameCount - 1].state) {
+        case SBFrameArrayStart:
+        case SBFrameArrayValue:
+        case SBFrameArrayComma:
+            [self failFrameWithCode:EEOF description:@"End of input while parsing array"];
+            break;
+        case SBFrameArraySpace:
+            [self failWithCode:EEOF description:@"Unexpected end of string"];
+            break;
+        case SBFrameObjectSpace:
+            [self failFrameWithCode:EPARSE description:@"Object key string expected"];
+            break;
+        case SBFrameObjectColon:
+            [self failFrameWithCode:EPARSE description:@"Expected ':' separating key and value"];
+            break;
+        case SBFrameObjectValue:
+            [self failWithCode:EEOF description:@"Unexpected end of string"];
+            break;
+        default:
+            [self failFrameWithCode:EEOF description:@"End of input while parsing object"];
+            break;
+    }
+}
+
+- (id)finishParsingAllowingFragment:(BOOL)allowFragment {
+    if (streamState == SBStreamIdle) {
+        [self clearErrorTrace];
+        streamState = SBStreamParsing;
+    }
+    if (streamState == SBStreamParsing)
+        [self finishToken];
+    if (streamState == SBStreamParsing)
+        [self finishStructure];
+    
+    id o = streamState == SBStreamParsing ? [[result retain] autorelease] : nil;
+    BOOL isContainer = rootIsContainer;
+    [self resetStream];
     
-    [self addErrorWithCode:EPARSENUM description: @"Failed creating decimal instance"];
-    return NO;
+    if (o && !allowFragment && !isContainer) {
+        [self addErrorWithCode:EFRAGMENT description:@"Valid fragment, but not JSON"];
+        return nil;
+    }
+    return o;
 }
 
-- (BOOL)scanIsAtEnd
-{
-    skipWhitespace(c);
-    return !*c;
+- (void)resetStream {
+    while (frameCount) {
+        frameCount--;
+        [frames[frameCount].container release];
+        [frames[frameCount].key release];
+    }
+    [result release];
+    result = nil;
+    [tokenBuffer setLength:0];
+    tokenState = SBTokenNone;
+    highSurrogate = 0;
+    rootIsContainer = NO;
+    streamState = SBStreamIdle;
+}
+
+- (void)failWithCode:(NSUInteger)code description:(NSString *)str {
+    [self addErrorWithCode:code description:str];
+    [self unwindFrames:frameCount];
+}
+
+// For errors found by the innermost container itself rather than by a value inside it
+- (void)failFrameWithCode:(NSUInteger)code description:(NSString *)str {
+    [self addErrorWithCode:code description:str];
+    [self unwindFrames:frameCount - 1];
 }
 
+- (void)failHexQuad {
+    [self addErrorWithCode:EUNICODE description:@"Missing hex digit in quad"];
+    if (highSurrogate)
+        [self addErrorWithCode:EUNICODE description:@"Missing low character in surrogate pair"];
+    else
+        [self addErrorWithCode:EUNICODE description:@"Missing hex quad"];
+    [self failWithCode:EUNICODE description:@"Broken unicode character"];
+}
+
+- (void)failLowSurrogate {
+    [self addErrorWithCode:EUNICODE description:@"Missing low character in surrogate pair"];
+    [self failWithCode:EUNICODE description:@"Broken unicode character"];
+}
+
+// Adds the error each open container added on its way out of the recursive scanner this parser replaced
+- (void)unwindFrames:(NSUInteger)count {
+    while (count--) {
+        SBJsonFrame *frame = &frames[count];
+        if (frame->state <= SBFrameArrayComma)
+            [self addErrorWithCode:EPARSE description:@"Expected value while parsing array"];
+        else if (frame->state == SBFrameObjectValue)
+            [self addErrorWithCode:EPARSE description:[NSString stringWithFormat:@"Object value expected for key: %@", frame->key]];
+        else
+            [self addErrorWithCode:EPARSE description:@"Object key string expected"];
+    }
+    streamState = SBStreamFailed;
+}
 
 @end
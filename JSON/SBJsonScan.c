@@ -0,0 +1,224 @@
+//
+//  SBJsonScan.c
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#include "SBJsonScan.h"
+
+#if defined(__SSE2__)
+#define SBJSON_SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 code is compiled for this one file through the target attribute, the rest of the framework stays SSE2
+#if defined(SBJSON_SCAN_SSE2) && (defined(__x86_64__) || defined(__i386__)) && defined(__has_attribute)
+#if __has_attribute(target)
+#define SBJSON_SCAN_AVX2 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+#endif
+
+
+#pragma mark Scalar
+
+#define SBIsStringStop(ch) ((ch) == '"' || (ch) == '\\' || (ch) < 0x20)
+#define SBIsWhitespace(ch) ((ch) == ' ' || ((ch) >= '\t' && (ch) <= '\r'))
+#define SBIsDigit(ch) ((ch) >= '0' && (ch) <= '9')
+
+static const unsigned char *SBScanStringScalar(const unsigned char *p, const unsigned char *end)
+{
+    while (p < end && !SBIsStringStop(*p))
+        p++;
+    return p;
+}
+
+static const unsigned char *SBSkipWhitespaceScalar(const unsigned char *p, const unsigned char *end)
+{
+    while (p < end && SBIsWhitespace(*p))
+        p++;
+    return p;
+}
+
+static const unsigned char *SBSkipDigitsScalar(const unsigned char *p, const unsigned char *end)
+{
+    while (p < end && SBIsDigit(*p))
+        p++;
+    return p;
+}
+
+
+#ifdef SBJSON_SCAN_SSE2
+#pragma mark SSE2
+
+/*
+ SSE2 has no unsigned byte compare, but min_epu8(v, n) == v is the same as v <= n. Ranges are
+ shifted down to start at 0 first, bytes below the range wrap around and end up above it.
+ */
+#define SBLessOrEqual16(v, n) _mm_cmpeq_epi8(_mm_min_epu8((v), (n)), (v))
+
+static const unsigned char *SBScanStringSSE2(const unsigned char *p, const unsigned char *end)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                    SBLessOrEqual16(v, control));
+        int mask = _mm_movemask_epi8(stop);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return SBScanStringScalar(p, end);
+}
+
+static const unsigned char *SBSkipWhitespaceSSE2(const unsigned char *p, const unsigned char *end)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i range = _mm_set1_epi8('\r' - '\t');
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i white = _mm_or_si128(_mm_cmpeq_epi8(v, space), SBLessOrEqual16(_mm_sub_epi8(v, tab), range));
+        int mask = _mm_movemask_epi8(white) ^ 0xffff;
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return SBSkipWhitespaceScalar(p, end);
+}
+
+static const unsigned char *SBSkipDigitsSSE2(const unsigned char *p, const unsigned char *end)
+{
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(SBLessOrEqual16(_mm_sub_epi8(v, zero), nine)) ^ 0xffff;
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return SBSkipDigitsScalar(p, end);
+}
+#endif
+
+
+#ifdef SBJSON_SCAN_AVX2
+#pragma mark AVX2
+
+#define SBAVX2 __attribute__((target("avx2")))
+#define SBLessOrEqual32(v, n) _mm256_cmpeq_epi8(_mm256_min_epu8((v), (n)), (v))
+
+// The last 16 to 31 bytes go through the SSE2 kernels
+
+static SBAVX2 const unsigned char *SBScanStringAVX2(const unsigned char *p, const unsigned char *end)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1f);
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i stop = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                                       SBLessOrEqual32(v, control));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(stop);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return SBScanStringSSE2(p, end);
+}
+
+static SBAVX2 const unsigned char *SBSkipWhitespaceAVX2(const unsigned char *p, const unsigned char *end)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i range = _mm256_set1_epi8('\r' - '\t');
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i white = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), SBLessOrEqual32(_mm256_sub_epi8(v, tab), range));
+        unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(white);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return SBSkipWhitespaceSSE2(p, end);
+}
+
+static SBAVX2 const unsigned char *SBSkipDigitsAVX2(const unsigned char *p, const unsigned char *end)
+{
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i nine = _mm256_set1_epi8(9);
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(SBLessOrEqual32(_mm256_sub_epi8(v, zero), nine));
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return SBSkipDigitsSSE2(p, end);
+}
+
+// AVX2 needs the processor to have it and the OS to save the YMM registers
+static int SBHasAVX2(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx) || eax < 7)
+        return 0;
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & (1 << 27)) || !(ecx & (1 << 28)))   // OSXSAVE, AVX
+        return 0;
+
+    unsigned int xcr0, xcr0High;
+    __asm__ __volatile__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0High) : "c" (0));
+    if ((xcr0 & 6) != 6)                            // XMM and YMM state
+        return 0;
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1 << 5)) != 0;
+}
+#endif
+
+
+#pragma mark Selection
+
+#ifdef SBJSON_SCAN_SSE2
+SBJsonScanFunction SBJsonScanString = SBScanStringSSE2;
+SBJsonScanFunction SBJsonSkipWhitespace = SBSkipWhitespaceSSE2;
+SBJsonScanFunction SBJsonSkipDigits = SBSkipDigitsSSE2;
+static const char *SBKernelName = "sse2";
+#else
+SBJsonScanFunction SBJsonScanString = SBScanStringScalar;
+SBJsonScanFunction SBJsonSkipWhitespace = SBSkipWhitespaceScalar;
+SBJsonScanFunction SBJsonSkipDigits = SBSkipDigitsScalar;
+static const char *SBKernelName = "scalar";
+#endif
+
+void SBJsonScanInitialize(void)
+{
+#ifdef SBJSON_SCAN_AVX2
+    if (SBHasAVX2()) {
+        SBJsonScanString = SBScanStringAVX2;
+        SBJsonSkipWhitespace = SBSkipWhitespaceAVX2;
+        SBJsonSkipDigits = SBSkipDigitsAVX2;
+        SBKernelName = "avx2";
+    }
+#endif
+}
+
+const char *SBJsonScanKernelName(void)
+{
+    return SBKernelName;
+}
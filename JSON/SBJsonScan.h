@@ -0,0 +1,46 @@
+//
+//  SBJsonScan.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Scanning kernels for SBJsonParser. Each one takes the bytes from p up to end and returns the first
+ byte that doesn't belong to the run, or end.
+
+ The SSE2 kernels look at 16 bytes at a time and are used whenever the compiler targets SSE2. The
+ AVX2 kernels look at 32 bytes at a time and are picked by SBJsonScanInitialize() on processors that
+ support them. Everything else, PowerPC included, uses the plain C loops.
+ */
+
+#ifndef SBJSON_SCAN_H
+#define SBJSON_SCAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef const unsigned char *(*SBJsonScanFunction)(const unsigned char *p, const unsigned char *end);
+
+/* First '"', '\\' or control character */
+extern SBJsonScanFunction SBJsonScanString;
+
+/* First byte that isspace() in the C locale doesn't accept */
+extern SBJsonScanFunction SBJsonSkipWhitespace;
+
+/* First byte that isn't '0' to '9' */
+extern SBJsonScanFunction SBJsonSkipDigits;
+
+/* Picks the fastest kernels for this processor. Safe to call more than once. Until it is called the SSE2 kernels are used if the compiler targets SSE2, the plain C kernels otherwise. */
+void SBJsonScanInitialize(void);
+
+/* "avx2", "sse2" or "scalar" */
+const char *SBJsonScanKernelName(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -10,8 +10,19 @@
 #import "MKFacebookRequest.h"
 #import "MKPhotosRequest.h"
 #import "MKVideoRequest.h"
+#import "MKVideoUploadSession.h"
 #import "MKFacebookResponseError.h"
 #import "MKFaceBookRequestQueue.h"
+#import "MKFacebookBatchRequest.h"
+#import "MKFacebookRateLimiter.h"
+#import "MKFacebookResponseCache.h"
+#import "MKFacebookTransport.h"
+#import "MKLoopbackTransport.h"
+#import "MKHostThrottleTransport.h"
+#import "MKFacebookParsePool.h"
+#import "MKFacebookCircuitBreaker.h"
+#import "MKFacebookRequestMetrics.h"
+#import "SBJsonParser.h"
 #import "NSXMLDocumentAdditions.h"
 #import "NSXMLElementAdditions.h"
 #import "MKErrorWindow.h"
@@ -0,0 +1,79 @@
+//
+//  MKDelegateDispatchTable.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/*
+ Delegate messages sent by MKFacebookRequest and MKFacebookRequestQueue.
+ */
+enum MKDelegateMessage
+{
+	MKDelegateMessageResponseReceived,				//facebookRequest:responseReceived:
+	MKDelegateMessageDeprecatedResponseReceived,	//facebookResponseReceived:
+	MKDelegateMessageErrorReceived,					//facebookRequest:errorReceived:
+	MKDelegateMessageDeprecatedErrorReceived,		//facebookErrorResponseReceived:
+	MKDelegateMessageFailed,						//facebookRequest:failed:
+	MKDelegateMessageDeprecatedFailed,				//facebookRequestFailed:
+	MKDelegateMessageBytesWritten,					//facebookRequest:bytesWritten:totalBytesWritten:totalBytesExpectedToWrite:
+	MKDelegateMessageQueueActiveRequest,			//requestQueue:activeRequest:ofRequests:
+	MKDelegateMessageQueueDidFinish,				//requestQueueDidFinish:
+	MKDelegateMessageQueueResponseReceived,			//requestQueue:lastRequest:responseReceived:
+	MKDelegateMessageQueueErrorReceived,			//requestQueue:lastRequest:errorReceived:
+	MKDelegateMessageQueueFailed,					//requestQueue:lastRequest:failed:
+	MKDelegateMessageCount
+};
+typedef int MKDelegateMessage;
+
+//what the implementations are cast to before they are called, the receiver and selector come first
+typedef void (*MKDelegateObjectIMP)(id, SEL, id);
+typedef void (*MKDelegateTwoObjectIMP)(id, SEL, id, id);
+typedef void (*MKDelegateThreeObjectIMP)(id, SEL, id, id, id);
+typedef void (*MKDelegateIndexIMP)(id, SEL, id, NSUInteger, NSUInteger);
+typedef void (*MKDelegateProgressIMP)(id, SEL, id, NSUInteger, NSUInteger, NSUInteger);
+
+
+/*
+ The delegate methods a class implements, looked up once per class instead of asking respondsToSelector: and building an NSInvocation for every callback.
+
+ Classes that override respondsToSelector: or forward messages, i.e. NSProxy subclasses, answer differently per instance. For them every lookup asks the delegate and the message is sent normally, so they see exactly the calls they saw before.
+
+ Implementations added or exchanged at runtime after a class was first used as a delegate are only seen after flushDispatchTables.
+ */
+@interface MKDelegateDispatchTable : NSObject {
+	Class _delegateClass;
+	BOOL _askDelegate;
+	IMP _implementations[MKDelegateMessageCount];
+	NSMapTable *_selectorImplementations;
+}
+
+/*
+ Table for the class of the delegate, nil for a nil delegate.
+ */
++ (MKDelegateDispatchTable *)dispatchTableForDelegate:(id)delegate;
+
+/*
+ Returns *table if it still belongs to the delegate's class. Otherwise looks up the right table and stores it in *table, which is retained.
+ */
++ (MKDelegateDispatchTable *)dispatchTableForDelegate:(id)delegate cachedTable:(MKDelegateDispatchTable **)table;
+
+/*
+ Forget every table, for code that adds or exchanges delegate methods at runtime.
+ */
++ (void)flushDispatchTables;
+
+/*
+ Implementation to call for a message, NULL if the delegate doesn't respond to it.
+ */
+- (IMP)implementationForMessage:(MKDelegateMessage)message delegate:(id)delegate;
+
+/*
+ Same for a custom selector, i.e. the selector property of a request.
+ */
+- (IMP)implementationForSelector:(SEL)aSelector delegate:(id)delegate;
+
+@end
@@ -0,0 +1,185 @@
+//
+//  MKDelegateDispatchTable.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKDelegateDispatchTable.h"
+#import <objc/runtime.h>
+#import <objc/message.h>
+
+static NSMapTable *MKDelegateDispatchTables = nil;
+
+//stands in for "doesn't respond" in _selectorImplementations, the map can't hold NULL
+static void MKDelegateNoImplementation(id self, SEL _cmd) {}
+
+
+@interface MKDelegateDispatchTable (Private)
++ (SEL)selectorForMessage:(MKDelegateMessage)message;
++ (BOOL)classAnswersPerInstance:(Class)aClass;
+- (id)initWithClass:(Class)aClass;
+@end
+
+
+@implementation MKDelegateDispatchTable
+
++ (void)initialize
+{
+	if (self == [MKDelegateDispatchTable class]) {
+		MKDelegateDispatchTables = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+															  valueOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPersonality
+																  capacity:0];
+	}
+}
+
+
++ (MKDelegateDispatchTable *)dispatchTableForDelegate:(id)delegate
+{
+	if (delegate == nil) {
+		return nil;
+	}
+
+	Class delegateClass = object_getClass(delegate);
+	@synchronized(MKDelegateDispatchTables) {
+		MKDelegateDispatchTable *table = NSMapGet(MKDelegateDispatchTables, delegateClass);
+		if (table == nil) {
+			table = [[[MKDelegateDispatchTable alloc] initWithClass:delegateClass] autorelease];
+			NSMapInsert(MKDelegateDispatchTables, delegateClass, table);
+		}
+		return [[table retain] autorelease];
+	}
+	return nil;
+}
+
+
++ (MKDelegateDispatchTable *)dispatchTableForDelegate:(id)delegate cachedTable:(MKDelegateDispatchTable **)table
+{
+	if (delegate == nil) {
+		return nil;
+	}
+	//the class changes when the delegate gets observed with KVO
+	if (*table == nil || (*table)->_delegateClass != object_getClass(delegate)) {
+		[*table release];
+		*table = [[self dispatchTableForDelegate:delegate] retain];
+	}
+	return *table;
+}
+
+
++ (void)flushDispatchTables
+{
+	@synchronized(MKDelegateDispatchTables) {
+		NSResetMapTable(MKDelegateDispatchTables);
+	}
+}
+
+
+- (id)initWithClass:(Class)aClass
+{
+	self = [super init];
+	if (self != nil) {
+		_delegateClass = aClass;
+		_askDelegate = [MKDelegateDispatchTable classAnswersPerInstance:aClass];
+		_selectorImplementations = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+															  valueOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+																  capacity:0];
+		if (_askDelegate == NO) {
+			MKDelegateMessage message;
+			for (message = 0; message < MKDelegateMessageCount; message++) {
+				SEL aSelector = [MKDelegateDispatchTable selectorForMessage:message];
+				//class_respondsToSelector gives resolveInstanceMethod: a chance, like respondsToSelector: does
+				_implementations[message] = class_respondsToSelector(aClass, aSelector) ? class_getMethodImplementation(aClass, aSelector) : NULL;
+			}
+		}
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[_selectorImplementations release];
+	[super dealloc];
+}
+
+
+- (IMP)implementationForMessage:(MKDelegateMessage)message delegate:(id)delegate
+{
+	if (_askDelegate == YES) {
+		return [delegate respondsToSelector:[MKDelegateDispatchTable selectorForMessage:message]] ? (IMP)objc_msgSend : NULL;
+	}
+	return _implementations[message];
+}
+
+
+- (IMP)implementationForSelector:(SEL)aSelector delegate:(id)delegate
+{
+	if (aSelector == NULL) {
+		return NULL;
+	}
+	if (_askDelegate == YES) {
+		return [delegate respondsToSelector:aSelector] ? (IMP)objc_msgSend : NULL;
+	}
+
+	IMP implementation = NULL;
+	@synchronized(self) {
+		implementation = (IMP)NSMapGet(_selectorImplementations, aSelector);
+		if (implementation == NULL) {
+			implementation = class_respondsToSelector(_delegateClass, aSelector) ? class_getMethodImplementation(_delegateClass, aSelector) : (IMP)MKDelegateNoImplementation;
+			NSMapInsert(_selectorImplementations, aSelector, implementation);
+		}
+	}
+	return implementation == (IMP)MKDelegateNoImplementation ? NULL : implementation;
+}
+
+
+#pragma mark Private Methods
+
++ (SEL)selectorForMessage:(MKDelegateMessage)message
+{
+	switch (message) {
+		case MKDelegateMessageResponseReceived:
+			return @selector(facebookRequest:responseReceived:);
+		case MKDelegateMessageDeprecatedResponseReceived:
+			return @selector(facebookResponseReceived:);
+		case MKDelegateMessageErrorReceived:
+			return @selector(facebookRequest:errorReceived:);
+		case MKDelegateMessageDeprecatedErrorReceived:
+			return @selector(facebookErrorResponseReceived:);
+		case MKDelegateMessageFailed:
+			return @selector(facebookRequest:failed:);
+		case MKDelegateMessageDeprecatedFailed:
+			return @selector(facebookRequestFailed:);
+		case MKDelegateMessageBytesWritten:
+			return @selector(facebookRequest:bytesWritten:totalBytesWritten:totalBytesExpectedToWrite:);
+		case MKDelegateMessageQueueActiveRequest:
+			return @selector(requestQueue:activeRequest:ofRequests:);
+		case MKDelegateMessageQueueDidFinish:
+			return @selector(requestQueueDidFinish:);
+		case MKDelegateMessageQueueResponseReceived:
+			return @selector(requestQueue:lastRequest:responseReceived:);
+		case MKDelegateMessageQueueErrorReceived:
+			return @selector(requestQueue:lastRequest:errorReceived:);
+		case MKDelegateMessageQueueFailed:
+			return @selector(requestQueue:lastRequest:failed:);
+	}
+	return NULL;
+}
+
+
+//NSObject's respondsToSelector: only depends on the class. anything else has to be asked every time
++ (BOOL)classAnswersPerInstance:(Class)aClass
+{
+	Class rootClass = aClass;
+	while (class_getSuperclass(rootClass) != Nil) {
+		rootClass = class_getSuperclass(rootClass);
+	}
+	if (rootClass != [NSObject class]) {
+		return YES;
+	}
+	return class_getMethodImplementation(aClass, @selector(respondsToSelector:)) != class_getMethodImplementation([NSObject class], @selector(respondsToSelector:));
+}
+
+@end
@@ -0,0 +1,89 @@
+//
+//  MKFacebookBatchRequest.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "MKFacebookRequest.h"
+
+/*!
+ @brief Maximum number of requests Facebook accepts in a single batch.run call.
+ */
+extern const NSUInteger MKFacebookBatchRequestMaximumRequests;
+
+extern NSString *MKFacebookBatchRequestErrorDomain;
+
+
+/*!
+ @enum MKFacebookBatchRequestError
+ */
+enum MKFacebookBatchRequestError
+{
+	MKFacebookBatchRequestMismatchedResponseError = 1	//the response doesn't hold one part per request
+};
+
+
+/*!
+ @class MKFacebookBatchRequest
+
+ Sends up to MKFacebookBatchRequestMaximumRequests prepared requests to Facebook in a single batch.run call.
+
+ Prepare each request exactly as you would to send it on its own, setting its delegate, selector, method, parameters and responseFormat, and add it to the batch instead of sending it. When the batch response arrives it is split up and each request passes its part to its own delegate through the usual MKFacebookRequestDelegate methods, as if it had been sent separately. If one of the calls in the batch is throttled or fails temporarily, that request is sent again on its own.
+
+ @verbatim
+ MKFacebookBatchRequest *batch = [MKFacebookBatchRequest requestWithDelegate:nil];
+ for (NSString *albumID in albumIDs) {
+	MKPhotosRequest *request = [MKPhotosRequest requestWithDelegate:self];
+	request.method = @"photos.get";
+	[request setParameters:[NSDictionary dictionaryWithObject:albumID forKey:@"aid"]];
+	[batch addRequest:request];
+ }
+ [batch sendRequest];
+ @endverbatim
+
+ The batch itself is also an MKFacebookRequest. If it has a delegate, the delegate receives the unsplit batch.run response. If the whole batch fails every request in it is told about the failure through its delegate. A response that isn't an array with one part per request fails the batch and every request in it with an NSError in MKFacebookBatchRequestErrorDomain, passed to facebookRequest:failed:.
+
+ Requests uploading images, data or files can't be sent in a batch.
+
+ @version 0.9 and later
+ */
+@interface MKFacebookBatchRequest : MKFacebookRequest {
+	NSMutableArray *_requests;
+	BOOL serialOnly;
+}
+
+/*!
+ @brief Ask Facebook to run the calls one after another in the order they were added.
+
+ Default is NO, the calls may be run in parallel.
+ */
+@property BOOL serialOnly;
+
+/*!
+ @brief Add a prepared request to the batch.
+
+ The request is retained until the batch has finished.
+
+ @return NO if the batch is full or the request has parameters that can't be sent in a batch.
+ */
+- (BOOL)addRequest:(MKFacebookRequest *)request;
+
+/*!
+ @brief The requests added to the batch.
+ */
+- (NSArray *)requests;
+
+/*!
+ @brief YES when no more requests can be added.
+ */
+- (BOOL)isFull;
+
+/*!
+ @brief Remove all requests from the batch.
+ */
+- (void)removeAllRequests;
+
+@end
@@ -0,0 +1,207 @@
+//
+//  MKFacebookBatchRequest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookBatchRequest.h"
+#import "MKFacebookRequestPrivate.h"
+#import "MKMultipartInputStream.h"
+#import "JSON.h"
+#import "NSStringExtras.h"
+
+const NSUInteger MKFacebookBatchRequestMaximumRequests = 20;
+
+NSString *MKFacebookBatchRequestErrorDomain = @"MKFacebookBatchRequestErrorDomain";
+
+
+@interface MKFacebookBatchRequest (Private)
+- (NSString *)methodFeedEntryForRequest:(MKFacebookRequest *)request;
+- (NSError *)mismatchedResponseError:(id)response;
+@end
+
+
+@implementation MKFacebookBatchRequest
+
+@synthesize serialOnly;
+
+
++ (id)requestWithDelegate:(id)aDelegate
+{
+	return [[[MKFacebookBatchRequest alloc] initWithDelegate:aDelegate selector:nil] autorelease];
+}
+
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_requests = [[NSMutableArray alloc] initWithCapacity:MKFacebookBatchRequestMaximumRequests];
+		serialOnly = NO;
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[_requests release];
+	[super dealloc];
+}
+
+
+- (BOOL)addRequest:(MKFacebookRequest *)request
+{
+	NSAssert(request.method != nil, @"Request method not set");
+
+	if ([self isFull]) {
+		return NO;
+	}
+
+	for (id value in [[request parameters] objectEnumerator]) {
+		if ([value isKindOfClass:[NSData class]] || [value isKindOfClass:[NSImage class]] ||
+			[value isKindOfClass:[NSURL class]] || [value isKindOfClass:[MKFileRange class]]) {
+			DLog(@"%@ can't be sent in a batch because it uploads a file", request.method);
+			return NO;
+		}
+	}
+
+	[_requests addObject:request];
+	return YES;
+}
+
+
+- (NSArray *)requests
+{
+	return [[_requests copy] autorelease];
+}
+
+
+- (BOOL)isFull
+{
+	return [_requests count] >= MKFacebookBatchRequestMaximumRequests;
+}
+
+
+- (void)removeAllRequests
+{
+	[_requests removeAllObjects];
+}
+
+
+- (void)sendRequest
+{
+	NSAssert([_requests count] > 0, @"Batch has no requests");
+
+	NSMutableArray *methodFeed = [NSMutableArray arrayWithCapacity:[_requests count]];
+	for (MKFacebookRequest *request in _requests) {
+		[methodFeed addObject:[self methodFeedEntryForRequest:request]];
+		if (_retryInProgress == NO) {
+			[request beginRequest];
+		}
+	}
+
+	NSMutableDictionary *params = [NSMutableDictionary dictionaryWithCapacity:2];
+	[params setObject:[methodFeed JSONRepresentation] forKey:@"method_feed"];
+	if (serialOnly == YES) {
+		[params setObject:@"1" forKey:@"serial_only"];
+	}
+
+	self.method = @"batch.run";
+	self.responseFormat = MKFacebookRequestResponseFormatJSON;
+	[self setParameters:params];
+	[super sendRequest];
+}
+
+
+#pragma mark Private Methods
+
+//batch.run takes each call as a url encoded query string. every call keeps its own response format so it can parse its part of the response as usual
+- (NSString *)methodFeedEntryForRequest:(MKFacebookRequest *)request
+{
+	NSMutableString *entry = [NSMutableString stringWithFormat:@"method=%@", [request.method encodeURLComponent]];
+	[entry appendString:request.responseFormat == MKFacebookRequestResponseFormatJSON ? @"&format=JSON" : @"&format=XML"];
+
+	NSDictionary *requestParameters = [request parameters];
+	for (NSString *key in [[requestParameters allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+		if ([key isEqualToString:@"format"]) {
+			continue;
+		}
+		id value = [requestParameters objectForKey:key];
+		if ([value isKindOfClass:[NSArray class]]) {
+			value = [value componentsJoinedByString:@","];
+		}
+		[entry appendFormat:@"&%@=%@", [key encodeURLComponent], [[value description] encodeURLComponent]];
+	}
+	return entry;
+}
+
+
+- (NSError *)mismatchedResponseError:(id)response
+{
+	NSString *description = nil;
+	if ([response isKindOfClass:[NSArray class]]) {
+		description = [NSString stringWithFormat:@"Facebook returned %lu responses for a batch of %lu requests.", (unsigned long)[response count], (unsigned long)[_requests count]];
+	} else {
+		description = @"Facebook returned an unexpected response to batch.run.";
+	}
+	NSDictionary *userInfo = [NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey];
+	return [NSError errorWithDomain:MKFacebookBatchRequestErrorDomain code:MKFacebookBatchRequestMismatchedResponseError userInfo:userInfo];
+}
+
+
+//the response to batch.run is an array holding the raw response of each call in the order they were sent
+- (void)handleParsedResponse:(id)response errorDictionary:(NSDictionary *)errorDictionary data:(NSData *)data allowRetry:(BOOL)allowRetry
+{
+	if ([response isKindOfClass:[NSArray class]] && [response count] == [_requests count]) {
+		NSUInteger i = 0;
+		for (id part in response) {
+			MKFacebookRequest *request = [_requests objectAtIndex:i++];
+			if ([request requestIsDone]) {
+				continue;
+			}
+			//each part should be a string, in case Facebook already decoded it we turn it back into JSON
+			NSString *partString = [part isKindOfClass:[NSString class]] ? part : [part JSONRepresentation];
+			[request handleResponseData:[partString dataUsingEncoding:NSUTF8StringEncoding] allowRetry:YES];
+		}
+	} else if (response != nil) {
+		//Facebook answered, but with something that doesn't split into one part per request. nobody can tell which part is theirs, so the batch fails along with every request
+		[self reportAttemptFailed:NO];
+		[self setRawResponseData:data];
+		[self handleConnectionError:[self mismatchedResponseError:response]];
+		return;
+	} else {
+		//the whole batch failed. the circuit breaker hears about the attempt before a retry goes back through it
+		int errorInt = [[errorDictionary valueForKey:@"error_code"] intValue];
+		[self reportAttemptFailed:(errorDictionary == nil || errorInt == 1 || errorInt == 2)];
+		//try it again if it's worth it, otherwise every request reports the error itself
+		if (allowRetry == YES && errorDictionary != nil && [self scheduleRetryForErrorCode:errorInt]) {
+			[self recordMetrics];
+			return;
+		}
+		//the error is parsed once and shared, not once per request
+		for (MKFacebookRequest *request in _requests) {
+			if ([request requestIsDone] == NO) {
+				[request handleErrorDictionary:errorDictionary responseData:data];
+			}
+		}
+		allowRetry = NO;
+	}
+
+	[super handleParsedResponse:response errorDictionary:errorDictionary data:data allowRetry:allowRetry];
+}
+
+
+- (void)handleConnectionError:(NSError *)error
+{
+	for (MKFacebookRequest *request in _requests) {
+		if ([request requestIsDone] == NO) {
+			[request handleConnectionError:error];
+		}
+	}
+	[super handleConnectionError:error];
+}
+
+@end
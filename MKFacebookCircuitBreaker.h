@@ -0,0 +1,138 @@
+//
+//  MKFacebookCircuitBreaker.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "SynthesizeSingleton.h"
+
+@class MKFacebookRequest;
+
+extern NSString *MKFacebookCircuitBreakerErrorDomain;
+extern NSString *MKFacebookCircuitBreakerRetryDateKey;
+
+extern NSString *MKFacebookCircuitBreakerStateChangedNotification;
+extern NSString *MKFacebookCircuitBreakerHostKey;
+extern NSString *MKFacebookCircuitBreakerStateKey;
+extern NSString *MKFacebookCircuitBreakerPreviousStateKey;
+extern NSString *MKFacebookCircuitBreakerFailureRateKey;
+
+
+/*!
+ @enum MKFacebookCircuitState
+ */
+enum MKFacebookCircuitState
+{
+	MKFacebookCircuitStateClosed,	//requests are sent
+	MKFacebookCircuitStateOpen,		//requests fail without being sent
+	MKFacebookCircuitStateHalfOpen	//one request is sent to see if the host is back
+};
+typedef int MKFacebookCircuitState;
+
+
+/*!
+ @enum MKFacebookCircuitBreakerError
+ */
+enum MKFacebookCircuitBreakerError
+{
+	MKFacebookCircuitBreakerOpenError = 1
+};
+
+
+/*!
+ @class MKFacebookCircuitBreaker
+
+ Shared circuit breaker consulted by every MKFacebookRequest before a connection is opened, one circuit per host (MKAPIServerURL, MKVideoAPIServerURL).
+
+ During an outage every request would otherwise retry on its own. The breaker counts, for each host, the attempts that failed over the last rollingWindow seconds: connection failures, responses that are neither JSON nor XML, and Facebook errors 1 (unknown) and 2 (service unavailable). Other Facebook errors mean the host is up and count as successes.
+
+ Once at least minimumRequestCount attempts were made and failureRateThreshold of them failed, the circuit opens. Requests to an open host fail on the next pass of the run loop, without being sent, with an NSError in MKFacebookCircuitBreakerErrorDomain passed to facebookRequest:failed:. Retries already scheduled fail the same way. After openInterval seconds the circuit is half open and lets a single request through as a probe, every other request still fails. The circuit closes when the probe succeeds and opens for another openInterval when it fails.
+
+ Every change of state posts MKFacebookCircuitBreakerStateChangedNotification on the thread the change happened on. The notification object is the breaker and its user info contains MKFacebookCircuitBreakerHostKey, MKFacebookCircuitBreakerStateKey, MKFacebookCircuitBreakerPreviousStateKey and MKFacebookCircuitBreakerFailureRateKey.
+
+ Responses answered from MKFacebookResponseCache never reach the breaker.
+
+ @version 0.9 and later
+ */
+@interface MKFacebookCircuitBreaker : NSObject {
+	NSMutableDictionary *_circuits;
+	BOOL enabled;
+	double failureRateThreshold;
+	NSUInteger minimumRequestCount;
+	NSTimeInterval rollingWindow;
+	NSTimeInterval openInterval;
+}
+
++ (MKFacebookCircuitBreaker *)sharedMKFacebookCircuitBreaker;
+
+/*! @name Properties */
+//@{
+/*!
+ @brief Turns the breaker on or off. Turning it off closes every circuit. Default is YES.
+ */
+@property BOOL enabled;
+
+/*!
+ @brief Share of failed attempts that opens a circuit, between 0 and 1. Default is 0.5.
+ */
+@property double failureRateThreshold;
+
+/*!
+ @brief Attempts needed within rollingWindow before a circuit can open. Default is 10.
+ */
+@property NSUInteger minimumRequestCount;
+
+/*!
+ @brief How far back attempts are counted, in seconds. Default is 60 seconds.
+ */
+@property NSTimeInterval rollingWindow;
+
+/*!
+ @brief How long a circuit stays open before a probe is sent, in seconds. Default is 30 seconds.
+ */
+@property NSTimeInterval openInterval;
+//@}
+
+
+/*! @name Circuits */
+//@{
+/*!
+ @brief State of the circuit for an endpoint.
+
+ @param endpointURL The API server, for example MKAPIServerURL or MKVideoAPIServerURL. Only the host is used.
+ */
+- (MKFacebookCircuitState)stateForEndpoint:(NSString *)endpointURL;
+
+/*!
+ @brief Close the circuit for an endpoint and forget its failures.
+ */
+- (void)resetEndpoint:(NSString *)endpointURL;
+
+/*!
+ @brief Close every circuit.
+ */
+- (void)reset;
+//@}
+
+
+/*! @name Called by MKFacebookRequest */
+//@{
+/*!
+ @brief Returns YES if the request may be sent. Every request that was let through has to be answered with request:finishedWithFailure: or requestWasCancelled:.
+ */
+- (BOOL)shouldSendRequest:(MKFacebookRequest *)request;
+
+- (void)request:(MKFacebookRequest *)request finishedWithFailure:(BOOL)failed;
+
+- (void)requestWasCancelled:(MKFacebookRequest *)request;
+
+/*!
+ @brief The error passed to requests that were not sent because their circuit is open.
+ */
+- (NSError *)openCircuitErrorForRequest:(MKFacebookRequest *)request;
+//@}
+
+@end
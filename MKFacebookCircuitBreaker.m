@@ -0,0 +1,355 @@
+//
+//  MKFacebookCircuitBreaker.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookCircuitBreaker.h"
+#import "MKFacebookRequest.h"
+
+NSString *MKFacebookCircuitBreakerErrorDomain = @"MKFacebookCircuitBreakerErrorDomain";
+NSString *MKFacebookCircuitBreakerRetryDateKey = @"MKFacebookCircuitBreakerRetryDate";
+
+NSString *MKFacebookCircuitBreakerStateChangedNotification = @"MKFacebookCircuitBreakerStateChangedNotification";
+NSString *MKFacebookCircuitBreakerHostKey = @"MKFacebookCircuitBreakerHost";
+NSString *MKFacebookCircuitBreakerStateKey = @"MKFacebookCircuitBreakerState";
+NSString *MKFacebookCircuitBreakerPreviousStateKey = @"MKFacebookCircuitBreakerPreviousState";
+NSString *MKFacebookCircuitBreakerFailureRateKey = @"MKFacebookCircuitBreakerFailureRate";
+
+//the rolling window is split into this many slices, a slice is dropped as a whole when it gets too old
+#define MKCircuitBucketCount 10
+
+
+//state and recent attempts of one host
+@interface MKFacebookCircuit : NSObject {
+@public
+	NSString *host;
+	MKFacebookCircuitState state;
+	NSTimeInterval openedAt;
+	MKFacebookRequest *probe; //not retained, only compared. a request clears it when it is cancelled or deallocated
+	NSUInteger successes[MKCircuitBucketCount];
+	NSUInteger failures[MKCircuitBucketCount];
+	long long bucketNumbers[MKCircuitBucketCount];
+}
+- (void)recordFailure:(BOOL)failed at:(NSTimeInterval)now window:(NSTimeInterval)window;
+- (NSUInteger)attemptCountAt:(NSTimeInterval)now window:(NSTimeInterval)window failures:(NSUInteger *)failureCount;
+- (void)clearAttempts;
+@end
+
+@implementation MKFacebookCircuit
+
+- (void)dealloc
+{
+	[host release];
+	[super dealloc];
+}
+
+
+- (void)recordFailure:(BOOL)failed at:(NSTimeInterval)now window:(NSTimeInterval)window
+{
+	window = MAX(window, 1.0);
+	long long bucketNumber = (long long)floor(now / (window / MKCircuitBucketCount));
+	NSUInteger i = (NSUInteger)(bucketNumber % MKCircuitBucketCount);
+	if (bucketNumbers[i] != bucketNumber) {
+		bucketNumbers[i] = bucketNumber;
+		successes[i] = 0;
+		failures[i] = 0;
+	}
+	if (failed == YES) {
+		failures[i]++;
+	} else {
+		successes[i]++;
+	}
+}
+
+
+- (NSUInteger)attemptCountAt:(NSTimeInterval)now window:(NSTimeInterval)window failures:(NSUInteger *)failureCount
+{
+	window = MAX(window, 1.0);
+	long long currentBucket = (long long)floor(now / (window / MKCircuitBucketCount));
+	NSUInteger attempts = 0;
+	*failureCount = 0;
+	NSUInteger i;
+	for (i = 0; i < MKCircuitBucketCount; i++) {
+		if (currentBucket - bucketNumbers[i] < MKCircuitBucketCount) {
+			attempts += successes[i] + failures[i];
+			*failureCount += failures[i];
+		}
+	}
+	return attempts;
+}
+
+
+- (void)clearAttempts
+{
+	NSUInteger i;
+	for (i = 0; i < MKCircuitBucketCount; i++) {
+		successes[i] = 0;
+		failures[i] = 0;
+	}
+}
+
+@end
+
+
+@interface MKFacebookCircuitBreaker (Private)
+- (MKFacebookCircuit *)circuitForHost:(NSString *)host;
+- (NSDictionary *)moveCircuit:(MKFacebookCircuit *)circuit toState:(MKFacebookCircuitState)newState failureRate:(double)failureRate;
+- (void)postStateChanges:(NSArray *)changes;
+@end
+
+
+@implementation MKFacebookCircuitBreaker
+
+SYNTHESIZE_SINGLETON_FOR_CLASS(MKFacebookCircuitBreaker);
+
+@synthesize failureRateThreshold;
+@synthesize minimumRequestCount;
+@synthesize rollingWindow;
+@synthesize openInterval;
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_circuits = [[NSMutableDictionary alloc] init];
+		enabled = YES;
+		failureRateThreshold = 0.5;
+		minimumRequestCount = 10;
+		rollingWindow = 60.0;
+		openInterval = 30.0;
+	}
+	return self;
+}
+
+
+- (BOOL)enabled
+{
+	@synchronized(self) {
+		return enabled;
+	}
+	return NO;
+}
+
+
+- (void)setEnabled:(BOOL)aBool
+{
+	if (aBool == NO) {
+		[self reset];
+	}
+	@synchronized(self) {
+		enabled = aBool;
+	}
+}
+
+
+- (MKFacebookCircuitState)stateForEndpoint:(NSString *)endpointURL
+{
+	NSString *host = [[[NSURL URLWithString:endpointURL] host] lowercaseString];
+	@synchronized(self) {
+		MKFacebookCircuit *circuit = host != nil ? [_circuits objectForKey:host] : nil;
+		if (circuit == nil) {
+			return MKFacebookCircuitStateClosed;
+		}
+		//an open circuit lets the next request probe once openInterval has passed
+		if (circuit->state == MKFacebookCircuitStateOpen && [NSDate timeIntervalSinceReferenceDate] - circuit->openedAt >= openInterval) {
+			return MKFacebookCircuitStateHalfOpen;
+		}
+		return circuit->state;
+	}
+	return MKFacebookCircuitStateClosed;
+}
+
+
+- (void)resetEndpoint:(NSString *)endpointURL
+{
+	NSString *host = [[[NSURL URLWithString:endpointURL] host] lowercaseString];
+	NSDictionary *change = nil;
+	@synchronized(self) {
+		MKFacebookCircuit *circuit = host != nil ? [_circuits objectForKey:host] : nil;
+		if (circuit != nil) {
+			change = [self moveCircuit:circuit toState:MKFacebookCircuitStateClosed failureRate:0];
+			[_circuits removeObjectForKey:host];
+		}
+	}
+	[self postStateChanges:change != nil ? [NSArray arrayWithObject:change] : nil];
+}
+
+
+- (void)reset
+{
+	NSMutableArray *changes = [NSMutableArray array];
+	@synchronized(self) {
+		for (MKFacebookCircuit *circuit in [_circuits allValues]) {
+			NSDictionary *change = [self moveCircuit:circuit toState:MKFacebookCircuitStateClosed failureRate:0];
+			if (change != nil) {
+				[changes addObject:change];
+			}
+		}
+		[_circuits removeAllObjects];
+	}
+	[self postStateChanges:changes];
+}
+
+
+- (BOOL)shouldSendRequest:(MKFacebookRequest *)request
+{
+	NSString *host = [[[request requestURL] host] lowercaseString];
+	if (host == nil) {
+		return YES;
+	}
+
+	BOOL shouldSend = YES;
+	NSDictionary *change = nil;
+	@synchronized(self) {
+		if (enabled == NO) {
+			return YES;
+		}
+		MKFacebookCircuit *circuit = [self circuitForHost:host];
+		if (circuit->state == MKFacebookCircuitStateOpen) {
+			NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+			if (now - circuit->openedAt >= openInterval) {
+				NSUInteger failureCount = 0;
+				NSUInteger attempts = [circuit attemptCountAt:now window:rollingWindow failures:&failureCount];
+				change = [self moveCircuit:circuit toState:MKFacebookCircuitStateHalfOpen failureRate:attempts > 0 ? (double)failureCount / attempts : 0];
+			} else {
+				shouldSend = NO;
+			}
+		}
+		if (circuit->state == MKFacebookCircuitStateHalfOpen) {
+			//the first request to come along is the probe, the rest wait for its answer
+			if (circuit->probe == nil) {
+				circuit->probe = request;
+			} else if (circuit->probe != request) {
+				shouldSend = NO;
+			}
+		}
+	}
+	[self postStateChanges:change != nil ? [NSArray arrayWithObject:change] : nil];
+	return shouldSend;
+}
+
+
+- (void)request:(MKFacebookRequest *)request finishedWithFailure:(BOOL)failed
+{
+	NSString *host = [[[request requestURL] host] lowercaseString];
+	if (host == nil) {
+		return;
+	}
+
+	NSDictionary *change = nil;
+	@synchronized(self) {
+		if (enabled == NO) {
+			return;
+		}
+		MKFacebookCircuit *circuit = [self circuitForHost:host];
+		NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+		[circuit recordFailure:failed at:now window:rollingWindow];
+
+		NSUInteger failureCount = 0;
+		NSUInteger attempts = [circuit attemptCountAt:now window:rollingWindow failures:&failureCount];
+		double failureRate = attempts > 0 ? (double)failureCount / attempts : 0;
+
+		if (circuit->state == MKFacebookCircuitStateHalfOpen && circuit->probe == request) {
+			//the probe decides, attempts that were let through before the circuit opened don't
+			circuit->probe = nil;
+			if (failed == YES) {
+				circuit->openedAt = now;
+				change = [self moveCircuit:circuit toState:MKFacebookCircuitStateOpen failureRate:failureRate];
+			} else {
+				[circuit clearAttempts];
+				change = [self moveCircuit:circuit toState:MKFacebookCircuitStateClosed failureRate:0];
+			}
+		} else if (circuit->state == MKFacebookCircuitStateClosed && failed == YES &&
+				   attempts >= minimumRequestCount && failureRate >= failureRateThreshold) {
+			circuit->openedAt = now;
+			change = [self moveCircuit:circuit toState:MKFacebookCircuitStateOpen failureRate:failureRate];
+		}
+	}
+	[self postStateChanges:change != nil ? [NSArray arrayWithObject:change] : nil];
+}
+
+
+- (void)requestWasCancelled:(MKFacebookRequest *)request
+{
+	NSString *host = [[[request requestURL] host] lowercaseString];
+	if (host == nil) {
+		return;
+	}
+	@synchronized(self) {
+		//the next request gets to probe instead
+		MKFacebookCircuit *circuit = [_circuits objectForKey:host];
+		if (circuit != nil && circuit->probe == request) {
+			circuit->probe = nil;
+		}
+	}
+}
+
+
+- (NSError *)openCircuitErrorForRequest:(MKFacebookRequest *)request
+{
+	NSString *host = [[[request requestURL] host] lowercaseString];
+	NSDate *retryDate = nil;
+	@synchronized(self) {
+		MKFacebookCircuit *circuit = host != nil ? [_circuits objectForKey:host] : nil;
+		if (circuit != nil) {
+			retryDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MAX(circuit->openedAt + openInterval, [NSDate timeIntervalSinceReferenceDate])];
+		}
+	}
+
+	NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+	[userInfo setObject:[NSString stringWithFormat:@"Requests to %@ are failing, the request was not sent.", host] forKey:NSLocalizedDescriptionKey];
+	if ([request requestURL] != nil) {
+		[userInfo setObject:[request requestURL] forKey:NSURLErrorKey];
+	}
+	if (retryDate != nil) {
+		[userInfo setObject:retryDate forKey:MKFacebookCircuitBreakerRetryDateKey];
+	}
+	return [NSError errorWithDomain:MKFacebookCircuitBreakerErrorDomain code:MKFacebookCircuitBreakerOpenError userInfo:userInfo];
+}
+
+
+#pragma mark Private Methods
+
+- (MKFacebookCircuit *)circuitForHost:(NSString *)host
+{
+	MKFacebookCircuit *circuit = [_circuits objectForKey:host];
+	if (circuit == nil) {
+		circuit = [[[MKFacebookCircuit alloc] init] autorelease];
+		circuit->host = [host copy];
+		circuit->state = MKFacebookCircuitStateClosed;
+		[_circuits setObject:circuit forKey:host];
+	}
+	return circuit;
+}
+
+
+//returns the user info of the notification to post, nil if the state didn't change
+- (NSDictionary *)moveCircuit:(MKFacebookCircuit *)circuit toState:(MKFacebookCircuitState)newState failureRate:(double)failureRate
+{
+	MKFacebookCircuitState previousState = circuit->state;
+	if (previousState == newState) {
+		return nil;
+	}
+	circuit->state = newState;
+	DLog(@"circuit for %@ changed from %d to %d", circuit->host, previousState, newState);
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			circuit->host, MKFacebookCircuitBreakerHostKey,
+			[NSNumber numberWithInt:newState], MKFacebookCircuitBreakerStateKey,
+			[NSNumber numberWithInt:previousState], MKFacebookCircuitBreakerPreviousStateKey,
+			[NSNumber numberWithDouble:failureRate], MKFacebookCircuitBreakerFailureRateKey,
+			nil];
+}
+
+
+//observers may call back into the breaker, so notifications are posted outside the lock
+- (void)postStateChanges:(NSArray *)changes
+{
+	for (NSDictionary *userInfo in changes) {
+		[[NSNotificationCenter defaultCenter] postNotificationName:MKFacebookCircuitBreakerStateChangedNotification object:self userInfo:userInfo];
+	}
+}
+
+@end
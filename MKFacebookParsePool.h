@@ -0,0 +1,98 @@
+//
+//  MKFacebookParsePool.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "SynthesizeSingleton.h"
+
+@class MKFacebookRequest;
+@class SBJsonParser;
+
+extern NSString *MKFacebookParsePoolParsedResponseCountKey;
+extern NSString *MKFacebookParsePoolTotalQueueWaitTimeKey;
+extern NSString *MKFacebookParsePoolAverageQueueWaitTimeKey;
+extern NSString *MKFacebookParsePoolMaximumQueueWaitTimeKey;
+extern NSString *MKFacebookParsePoolTotalParseTimeKey;
+extern NSString *MKFacebookParsePoolAverageParseTimeKey;
+extern NSString *MKFacebookParsePoolMaximumParseTimeKey;
+
+
+/*!
+ @class MKFacebookParsePool
+
+ Parses responses on background threads, so a large response doesn't block the thread its request was sent from, which is usually the main thread.
+
+ JSON responses are parsed chunk by chunk as they arrive, and XML responses once they are complete. JSON responses of requests with a streamingDelegate are passed to it as events while they are parsed. Different responses are parsed in parallel, up to maximumConcurrentParses at a time. Each parsed response goes back to its request on the thread that scheduled the connection. Requests that finished loading on the same thread are answered in the order they finished, so delegates are called the same way as before.
+
+ @verbatim
+ //parse everything on the thread that sent the request, like earlier versions
+ [[MKFacebookParsePool sharedMKFacebookParsePool] setMaximumConcurrentParses:0];
+ @endverbatim
+
+ @version 0.9 and later
+ */
+@interface MKFacebookParsePool : NSObject {
+	NSOperationQueue *_queue;
+	NSMutableArray *_idleParsers;
+	NSUInteger maximumConcurrentParses;
+	NSMutableDictionary *_jobs;
+	NSMutableArray *_deliveries;
+
+	NSUInteger _parsedCount;
+	NSTimeInterval _totalQueueWaitTime;
+	NSTimeInterval _maximumQueueWaitTime;
+	NSTimeInterval _totalParseTime;
+	NSTimeInterval _maximumParseTime;
+}
+
++ (MKFacebookParsePool *)sharedMKFacebookParsePool;
+
+/*!
+ @brief Most responses parsed at the same time.
+
+ Defaults to the number of active processors. 0 parses every response on the thread its request was sent from.
+ */
+@property NSUInteger maximumConcurrentParses;
+
+
+/*! @name Called by MKFacebookRequest */
+//@{
+- (void)request:(MKFacebookRequest *)request didReceiveData:(NSData *)data;
+
+/*!
+ @brief Finish parsing a response and pass the result back to the request with handleParsedResponse:errorDictionary:data:allowRetry:.
+ */
+- (void)requestDidFinishLoading:(MKFacebookRequest *)request data:(NSData *)data;
+
+/*!
+ @brief Drop the response of a cancelled request, the request hears nothing more about it.
+ */
+- (void)cancelParsingForRequest:(MKFacebookRequest *)request;
+
+/*!
+ @brief A JSON parser nobody else is using.
+
+ Parsers are reused, each keeps the object keys of the documents it has parsed, so the keys of the next response of the same kind aren't created again. Hand the parser back with checkInParser: once the document has been parsed, the parser may not be used afterwards.
+ */
+- (SBJsonParser *)checkOutParser;
+
+- (void)checkInParser:(SBJsonParser *)parser;
+//@}
+
+
+/*!
+ @brief Parse pool statistics.
+
+ Contains NSNumbers for MKFacebookParsePoolParsedResponseCountKey and, in seconds, the totals, averages and maximums of queue wait time and parse time.
+
+ Queue wait time runs from the moment a response finishes loading until its last part starts being parsed. Parse time is the time spent parsing one response.
+ */
+- (NSDictionary *)statistics;
+
+- (void)resetStatistics;
+
+@end
@@ -0,0 +1,392 @@
+//
+//  MKFacebookParsePool.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookParsePool.h"
+#import "MKFacebookRequest.h"
+#import "MKFacebookRequestPrivate.h"
+#import "JSON.h"
+#import "MKFacebookStreamingAdapter.h"
+
+NSString *MKFacebookParsePoolParsedResponseCountKey = @"MKFacebookParsePoolParsedResponseCount";
+NSString *MKFacebookParsePoolTotalQueueWaitTimeKey = @"MKFacebookParsePoolTotalQueueWaitTime";
+NSString *MKFacebookParsePoolAverageQueueWaitTimeKey = @"MKFacebookParsePoolAverageQueueWaitTime";
+NSString *MKFacebookParsePoolMaximumQueueWaitTimeKey = @"MKFacebookParsePoolMaximumQueueWaitTime";
+NSString *MKFacebookParsePoolTotalParseTimeKey = @"MKFacebookParsePoolTotalParseTime";
+NSString *MKFacebookParsePoolAverageParseTimeKey = @"MKFacebookParsePoolAverageParseTime";
+NSString *MKFacebookParsePoolMaximumParseTimeKey = @"MKFacebookParsePoolMaximumParseTime";
+
+//parsers kept for reuse, enough for every worker and a few requests receiving data at the same time
+static const NSUInteger MKParsePoolMaximumIdleParsers = 16;
+
+
+//the response of one request. its operations run one after another on the pool's queue, so only one thread touches it at a time
+@interface MKFacebookParseJob : NSObject {
+@public
+	MKFacebookRequest *request;
+	NSThread *thread;
+	SBJsonParser *parser;
+	MKFacebookStreamingAdapter *adapter;
+	NSOperation *lastOperation;
+	NSData *data;
+	id response;
+	NSDictionary *errorDictionary;
+	NSTimeInterval finishedLoadingTime;
+	NSTimeInterval queueWaitTime;
+	NSTimeInterval parseTime;
+	BOOL parsed;
+	BOOL cancelled;
+}
+- (id)initWithRequest:(MKFacebookRequest *)aRequest;
+- (void)parseChunk:(NSData *)chunk;
+- (void)finishParsing;
+@end
+
+
+@interface MKFacebookParsePool (Private)
+- (void)runJob:(MKFacebookParseJob *)job selector:(SEL)aSelector object:(id)object;
+- (void)jobDidFinishParsing:(MKFacebookParseJob *)job;
+- (void)deliverParsedResponses;
+@end
+
+
+@implementation MKFacebookParseJob
+
+- (id)initWithRequest:(MKFacebookRequest *)aRequest
+{
+	self = [super init];
+	if (self != nil) {
+		//the request has to stay around until it has its response
+		request = [aRequest retain];
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[request release];
+	[thread release];
+	//nothing runs on a job that is going away, a parser left over from a cancelled response can be handed out again
+	if (parser != nil) {
+		[[MKFacebookParsePool sharedMKFacebookParsePool] checkInParser:parser];
+	}
+	[parser release];
+	[adapter release];
+	[lastOperation release];
+	[data release];
+	[response release];
+	[errorDictionary release];
+	[super dealloc];
+}
+
+
+- (void)parseChunk:(NSData *)chunk
+{
+	if (cancelled == YES) {
+		return;
+	}
+	NSAutoreleasePool *autoreleasePool = [[NSAutoreleasePool alloc] init];
+	NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+	[parser parseData:chunk];
+	parseTime += [NSDate timeIntervalSinceReferenceDate] - start;
+	[autoreleasePool drain];
+}
+
+
+- (void)finishParsing
+{
+	NSAutoreleasePool *autoreleasePool = [[NSAutoreleasePool alloc] init];
+	NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+	queueWaitTime = start - finishedLoadingTime;
+
+	if (cancelled == NO) {
+		//JSON has been parsed as it arrived, XML is parsed now
+		id parsedResponse = parser != nil ? [parser finishParsing] : [request parseResponseData:data];
+		//the parser is done with this response, the next one can have it
+		if (parser != nil) {
+			[[MKFacebookParsePool sharedMKFacebookParsePool] checkInParser:parser];
+			[parser release];
+			parser = nil;
+		}
+		if (adapter != nil) {
+			//the response has gone to the streaming delegate, only a Facebook error is left to deliver
+			errorDictionary = [[adapter errorDictionary] retain];
+			if (parsedResponse != nil && errorDictionary == nil) {
+				response = [MKFacebookStreamedResponse retain];
+			}
+		} else {
+			NSDictionary *errors = nil;
+			response = [[request validResponseFromParsedResponse:parsedResponse errorDictionary:&errors] retain];
+			errorDictionary = [errors retain];
+		}
+	}
+
+	parseTime += [NSDate timeIntervalSinceReferenceDate] - start;
+	[autoreleasePool drain];
+	[[MKFacebookParsePool sharedMKFacebookParsePool] jobDidFinishParsing:self];
+}
+
+@end
+
+
+
+@implementation MKFacebookParsePool
+
+SYNTHESIZE_SINGLETON_FOR_CLASS(MKFacebookParsePool);
+
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_queue = [[NSOperationQueue alloc] init];
+		_idleParsers = [[NSMutableArray alloc] init];
+		_jobs = [[NSMutableDictionary alloc] init];
+		_deliveries = [[NSMutableArray alloc] init];
+		[self setMaximumConcurrentParses:[[NSProcessInfo processInfo] activeProcessorCount]];
+	}
+	return self;
+}
+
+
+- (NSUInteger)maximumConcurrentParses
+{
+	@synchronized(self) {
+		return maximumConcurrentParses;
+	}
+	return 0;
+}
+
+
+- (void)setMaximumConcurrentParses:(NSUInteger)count
+{
+	@synchronized(self) {
+		maximumConcurrentParses = count;
+		//responses already on the queue still need a thread to finish on
+		[_queue setMaxConcurrentOperationCount:MAX(count, (NSUInteger)1)];
+	}
+}
+
+
+- (void)request:(MKFacebookRequest *)request didReceiveData:(NSData *)data
+{
+	//XML can't be parsed in pieces, it waits for the whole response
+	if (request.responseFormat != MKFacebookRequestResponseFormatJSON) {
+		return;
+	}
+
+	MKFacebookParseJob *job = nil;
+	@synchronized(self) {
+		NSValue *key = [NSValue valueWithNonretainedObject:request];
+		job = [[[_jobs objectForKey:key] retain] autorelease];
+		if (job == nil) {
+			job = [[[MKFacebookParseJob alloc] initWithRequest:request] autorelease];
+			job->parser = [[self checkOutParser] retain];
+			if (request.streamingDelegate != nil) {
+				job->adapter = [[MKFacebookStreamingAdapter alloc] initWithConsumer:request.streamingDelegate];
+				[job->parser setDelegate:job->adapter];
+			}
+			[_jobs setObject:job forKey:key];
+		}
+	}
+	[self runJob:job selector:@selector(parseChunk:) object:data];
+}
+
+
+- (void)requestDidFinishLoading:(MKFacebookRequest *)request data:(NSData *)data
+{
+	MKFacebookParseJob *job = nil;
+	@synchronized(self) {
+		NSValue *key = [NSValue valueWithNonretainedObject:request];
+		job = [[[_jobs objectForKey:key] retain] autorelease];
+		if (job == nil) {
+			job = [[[MKFacebookParseJob alloc] initWithRequest:request] autorelease];
+		}
+		[_jobs removeObjectForKey:key];
+
+		job->data = [data retain];
+		job->thread = [[NSThread currentThread] retain];
+		job->finishedLoadingTime = [NSDate timeIntervalSinceReferenceDate];
+		[_deliveries addObject:job];
+	}
+	[self runJob:job selector:@selector(finishParsing) object:nil];
+}
+
+
+- (void)cancelParsingForRequest:(MKFacebookRequest *)request
+{
+	NSMutableArray *cancelledJobs = [NSMutableArray array];
+	@synchronized(self) {
+		NSValue *key = [NSValue valueWithNonretainedObject:request];
+		MKFacebookParseJob *job = [_jobs objectForKey:key];
+		if (job != nil) {
+			[cancelledJobs addObject:job];
+			[_jobs removeObjectForKey:key];
+		}
+		for (job in _deliveries) {
+			if (job->request == request) {
+				[cancelledJobs addObject:job];
+			}
+		}
+		for (job in cancelledJobs) {
+			job->cancelled = YES;
+		}
+	}
+	//operations still on the queue skip the work, dropping the last one breaks the cycle between the job and its operation
+	for (MKFacebookParseJob *job in cancelledJobs) {
+		@synchronized(job) {
+			[job->lastOperation release];
+			job->lastOperation = nil;
+		}
+	}
+}
+
+
+- (SBJsonParser *)checkOutParser
+{
+	@synchronized(self) {
+		SBJsonParser *parser = [_idleParsers lastObject];
+		if (parser != nil) {
+			[[parser retain] autorelease];
+			[_idleParsers removeLastObject];
+			return parser;
+		}
+	}
+	return [[[SBJsonParser alloc] init] autorelease];
+}
+
+
+- (void)checkInParser:(SBJsonParser *)parser
+{
+	//whatever a previous response left behind goes, the keys it has seen stay
+	[parser setDelegate:nil];
+	[parser resetStream];
+	@synchronized(self) {
+		if ([_idleParsers count] < MKParsePoolMaximumIdleParsers && [_idleParsers indexOfObjectIdenticalTo:parser] == NSNotFound) {
+			[_idleParsers addObject:parser];
+		}
+	}
+}
+
+
+- (NSDictionary *)statistics
+{
+	@synchronized(self) {
+		return [NSDictionary dictionaryWithObjectsAndKeys:
+				[NSNumber numberWithUnsignedInteger:_parsedCount], MKFacebookParsePoolParsedResponseCountKey,
+				[NSNumber numberWithDouble:_totalQueueWaitTime], MKFacebookParsePoolTotalQueueWaitTimeKey,
+				[NSNumber numberWithDouble:_parsedCount > 0 ? _totalQueueWaitTime / _parsedCount : 0], MKFacebookParsePoolAverageQueueWaitTimeKey,
+				[NSNumber numberWithDouble:_maximumQueueWaitTime], MKFacebookParsePoolMaximumQueueWaitTimeKey,
+				[NSNumber numberWithDouble:_totalParseTime], MKFacebookParsePoolTotalParseTimeKey,
+				[NSNumber numberWithDouble:_parsedCount > 0 ? _totalParseTime / _parsedCount : 0], MKFacebookParsePoolAverageParseTimeKey,
+				[NSNumber numberWithDouble:_maximumParseTime], MKFacebookParsePoolMaximumParseTimeKey,
+				nil];
+	}
+	return nil;
+}
+
+
+- (void)resetStatistics
+{
+	@synchronized(self) {
+		_parsedCount = 0;
+		_totalQueueWaitTime = 0;
+		_maximumQueueWaitTime = 0;
+		_totalParseTime = 0;
+		_maximumParseTime = 0;
+	}
+}
+
+
+#pragma mark Private Methods
+
+- (void)runJob:(MKFacebookParseJob *)job selector:(SEL)aSelector object:(id)object
+{
+	BOOL parseHere = [self maximumConcurrentParses] == 0;
+
+	@synchronized(job) {
+		//parts of a response that are already on the queue have to be parsed first
+		if (parseHere == YES && job->lastOperation != nil && [job->lastOperation isFinished] == NO) {
+			parseHere = NO;
+		}
+		if (parseHere == NO) {
+			//the parts of one response are parsed one after another, in the order they arrived
+			NSInvocationOperation *operation = [[[NSInvocationOperation alloc] initWithTarget:job selector:aSelector object:object] autorelease];
+			if (job->lastOperation != nil) {
+				[operation addDependency:job->lastOperation];
+			}
+			[job->lastOperation release];
+			job->lastOperation = [operation retain];
+			[_queue addOperation:operation];
+		}
+	}
+
+	if (parseHere == YES) {
+		[job performSelector:aSelector withObject:object];
+	}
+}
+
+
+- (void)jobDidFinishParsing:(MKFacebookParseJob *)job
+{
+	@synchronized(self) {
+		job->parsed = YES;
+		if (job->cancelled == NO) {
+			_parsedCount++;
+			_totalQueueWaitTime += job->queueWaitTime;
+			_maximumQueueWaitTime = MAX(_maximumQueueWaitTime, job->queueWaitTime);
+			_totalParseTime += job->parseTime;
+			_maximumParseTime = MAX(_maximumParseTime, job->parseTime);
+		}
+	}
+	@synchronized(job) {
+		[job->lastOperation release];
+		job->lastOperation = nil;
+	}
+
+	if ([NSThread currentThread] == job->thread) {
+		[self deliverParsedResponses];
+	} else {
+		[self performSelector:@selector(deliverParsedResponses) onThread:job->thread withObject:nil waitUntilDone:NO modes:[NSArray arrayWithObject:NSRunLoopCommonModes]];
+	}
+}
+
+
+//runs on the thread the requests were sent from. a response that is parsed early waits for the responses that finished loading before it
+- (void)deliverParsedResponses
+{
+	NSThread *thread = [NSThread currentThread];
+	NSMutableArray *ready = [NSMutableArray array];
+
+	@synchronized(self) {
+		NSUInteger i = 0;
+		while (i < [_deliveries count]) {
+			MKFacebookParseJob *job = [_deliveries objectAtIndex:i];
+			if (job->thread != thread) {
+				i++;
+				continue;
+			}
+			if (job->cancelled == NO && job->parsed == NO) {
+				break;
+			}
+			if (job->cancelled == NO) {
+				[ready addObject:job];
+			}
+			[_deliveries removeObjectAtIndex:i];
+		}
+	}
+
+	for (MKFacebookParseJob *job in ready) {
+		//an earlier delegate may have cancelled this request
+		if (job->cancelled == NO && [job->request requestIsDone] == NO) {
+			[job->request handleParsedResponse:job->response errorDictionary:job->errorDictionary data:job->data allowRetry:YES];
+		}
+	}
+}
+
+@end
@@ -0,0 +1,122 @@
+//
+//  MKFacebookRateLimiter.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "SynthesizeSingleton.h"
+
+extern NSString *MKFacebookRateLimiterRequestCountKey;
+extern NSString *MKFacebookRateLimiterDelayedRequestCountKey;
+extern NSString *MKFacebookRateLimiterTotalWaitTimeKey;
+extern NSString *MKFacebookRateLimiterMaximumWaitTimeKey;
+extern NSString *MKFacebookRateLimiterWaitingRequestCountKey;
+
+
+/*!
+ @class MKFacebookRateLimiter
+
+ Shared token bucket rate limiter consulted by every MKFacebookRequest before a connection is opened.
+
+ Facebook answers with error 4 when an application sends too many requests. Rather than paying for a round trip and a retry after the server throttles us, limits can be configured per App ID and per endpoint (MKAPIServerURL or MKVideoAPIServerURL) so requests are held back before they are sent.  Requests over the budget wait in a first in, first out queue and are started from a timer on the main run loop, each on the thread it was sent from. Nothing blocks while waiting.
+
+ No limits are configured by default, requests pass straight through until setRequestsPerSecond:burst:forAppID:endpoint: is called.
+
+ @verbatim
+ //allow 5 requests per second with bursts of up to 10 requests against the REST API for any application
+ [[MKFacebookRateLimiter sharedMKFacebookRateLimiter] setRequestsPerSecond:5.0 burst:10 forAppID:nil endpoint:MKAPIServerURL];
+ @endverbatim
+
+ @version 0.9 and later
+ */
+@interface MKFacebookRateLimiter : NSObject {
+	NSMutableDictionary *_buckets;
+	NSUInteger _requestCount;
+	NSUInteger _delayedRequestCount;
+	NSTimeInterval _totalWaitTime;
+	NSTimeInterval _maximumWaitTime;
+}
+
++ (MKFacebookRateLimiter *)sharedMKFacebookRateLimiter;
+
+/*! @name Configuring Limits */
+//@{
+/*!
+ @brief Limit requests for an App ID and endpoint.
+
+ @param rate Number of tokens added to the bucket every second.
+
+ @param burst Maximum number of tokens the bucket can hold, the number of requests that can be sent at once after a quiet period. Values less than 1 are treated as 1.
+
+ @param appID The App ID the limit applies to. Pass nil to apply the limit to every App ID without a limit of its own.
+
+ @param endpointURL The API server the limit applies to, for example MKAPIServerURL or MKVideoAPIServerURL. Only the host is used. Pass nil to apply the limit to every endpoint without a limit of its own.
+
+ @version 0.9 and later
+ */
+- (void)setRequestsPerSecond:(double)rate burst:(NSUInteger)burst forAppID:(NSString *)appID endpoint:(NSString *)endpointURL;
+
+/*!
+ @brief Remove a limit set with setRequestsPerSecond:burst:forAppID:endpoint:.
+
+ Requests waiting on the limit are started immediately.
+
+ @version 0.9 and later
+ */
+- (void)removeLimitForAppID:(NSString *)appID endpoint:(NSString *)endpointURL;
+//@}
+
+
+/*! @name Acquiring Tokens */
+//@{
+/*!
+ @brief Perform a selector once a token is available.
+
+ If the bucket for the App ID and endpoint has a token, or no limit applies, the selector is performed before this method returns.  Otherwise the target is retained and the selector is performed on the current thread once a token becomes available, so the thread has to run its run loop. The refill timer itself runs on the main run loop.
+
+ @param appID The App ID of the application sending the request.
+
+ @param endpointURL The URL the request will be sent to.
+
+ @param target Object to receive the selector.
+
+ @param aSelector Selector taking no arguments.
+
+ @version 0.9 and later
+ */
+- (void)waitForTokenForAppID:(NSString *)appID endpoint:(NSURL *)endpointURL target:(id)target selector:(SEL)aSelector;
+
+/*!
+ @brief Remove a target from every wait queue.
+
+ The selector will not be performed. Used when a waiting request is cancelled.
+
+ @version 0.9 and later
+ */
+- (void)cancelWaitForTarget:(id)target;
+//@}
+
+
+/*! @name Statistics */
+//@{
+/*!
+ @brief Counters describing how long requests waited for tokens.
+
+ Returns a dictionary with NSNumber values for the MKFacebookRateLimiterRequestCountKey, MKFacebookRateLimiterDelayedRequestCountKey, MKFacebookRateLimiterTotalWaitTimeKey, MKFacebookRateLimiterMaximumWaitTimeKey and MKFacebookRateLimiterWaitingRequestCountKey keys. Wait times are in seconds.
+
+ @version 0.9 and later
+ */
+- (NSDictionary *)statistics;
+
+/*!
+ @brief Reset the counters returned by statistics.
+
+ @version 0.9 and later
+ */
+- (void)resetStatistics;
+//@}
+
+@end
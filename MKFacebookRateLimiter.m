@@ -0,0 +1,358 @@
+//
+//  MKFacebookRateLimiter.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookRateLimiter.h"
+
+NSString *MKFacebookRateLimiterRequestCountKey = @"MKFacebookRateLimiterRequestCount";
+NSString *MKFacebookRateLimiterDelayedRequestCountKey = @"MKFacebookRateLimiterDelayedRequestCount";
+NSString *MKFacebookRateLimiterTotalWaitTimeKey = @"MKFacebookRateLimiterTotalWaitTime";
+NSString *MKFacebookRateLimiterMaximumWaitTimeKey = @"MKFacebookRateLimiterMaximumWaitTime";
+NSString *MKFacebookRateLimiterWaitingRequestCountKey = @"MKFacebookRateLimiterWaitingRequestCount";
+
+//used in bucket keys when a limit applies to any App ID or any endpoint
+static NSString *MKFacebookRateLimiterWildcard = @"*";
+
+
+//a request waiting for a token, and the thread it is started on
+@interface MKFacebookRateLimiterWaiter : NSObject {
+@public
+	id target;
+	SEL selector;
+	NSThread *thread;
+	NSTimeInterval enqueuedAt;
+}
+@end
+
+@implementation MKFacebookRateLimiterWaiter
+
+- (void)dealloc
+{
+	[target release];
+	[thread release];
+	[super dealloc];
+}
+
+@end
+
+
+@interface MKFacebookTokenBucket : NSObject {
+@public
+	double rate;
+	double capacity;
+	double tokens;
+	NSTimeInterval lastRefill;
+	NSMutableArray *waiters;
+	NSTimer *timer;
+}
+- (void)refill;
+- (NSTimeInterval)timeUntilNextToken;
+@end
+
+@implementation MKFacebookTokenBucket
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		waiters = [[NSMutableArray alloc] init];
+		lastRefill = [NSDate timeIntervalSinceReferenceDate];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (timer != nil) {
+		CFRunLoopTimerInvalidate((CFRunLoopTimerRef)timer);
+	}
+	[waiters release];
+	[super dealloc];
+}
+
+- (void)refill
+{
+	NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+	tokens += (now - lastRefill) * rate;
+	if (tokens > capacity) {
+		tokens = capacity;
+	}
+	lastRefill = now;
+}
+
+- (NSTimeInterval)timeUntilNextToken
+{
+	if (tokens >= 1.0 || rate <= 0) {
+		return 0;
+	}
+	return (1.0 - tokens) / rate;
+}
+
+@end
+
+
+@interface MKFacebookRateLimiter (Private)
+- (NSString *)bucketKeyForAppID:(NSString *)appID host:(NSString *)host;
+- (MKFacebookTokenBucket *)bucketForAppID:(NSString *)appID host:(NSString *)host;
+- (NSArray *)drainBucket:(MKFacebookTokenBucket *)bucket;
+- (void)scheduleTimerForBucket:(MKFacebookTokenBucket *)bucket;
+- (void)bucketTimerFired:(NSTimer *)timer;
+- (void)performWaiters:(NSArray *)waiters;
+@end
+
+
+@implementation MKFacebookRateLimiter
+
+SYNTHESIZE_SINGLETON_FOR_CLASS(MKFacebookRateLimiter);
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_buckets = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+
+- (void)setRequestsPerSecond:(double)rate burst:(NSUInteger)burst forAppID:(NSString *)appID endpoint:(NSString *)endpointURL
+{
+	NSString *host = endpointURL != nil ? [[NSURL URLWithString:endpointURL] host] : nil;
+	NSString *key = [self bucketKeyForAppID:appID host:host];
+	NSArray *ready = nil;
+
+	@synchronized(self) {
+		MKFacebookTokenBucket *bucket = [_buckets objectForKey:key];
+		if (bucket == nil) {
+			bucket = [[[MKFacebookTokenBucket alloc] init] autorelease];
+			[_buckets setObject:bucket forKey:key];
+			//start with a full bucket so the first burst goes out immediately
+			bucket->tokens = burst > 0 ? burst : 1;
+		}
+		[bucket refill];
+		bucket->rate = rate;
+		bucket->capacity = burst > 0 ? burst : 1;
+		if (bucket->tokens > bucket->capacity) {
+			bucket->tokens = bucket->capacity;
+		}
+		ready = [self drainBucket:bucket];
+	}
+
+	[self performWaiters:ready];
+}
+
+
+- (void)removeLimitForAppID:(NSString *)appID endpoint:(NSString *)endpointURL
+{
+	NSString *host = endpointURL != nil ? [[NSURL URLWithString:endpointURL] host] : nil;
+	NSString *key = [self bucketKeyForAppID:appID host:host];
+	NSArray *ready = nil;
+
+	@synchronized(self) {
+		MKFacebookTokenBucket *bucket = [_buckets objectForKey:key];
+		if (bucket != nil) {
+			if (bucket->timer != nil) {
+				CFRunLoopTimerInvalidate((CFRunLoopTimerRef)bucket->timer);
+				bucket->timer = nil;
+			}
+			ready = [[bucket->waiters copy] autorelease];
+			[bucket->waiters removeAllObjects];
+			[_buckets removeObjectForKey:key];
+		}
+	}
+
+	[self performWaiters:ready];
+}
+
+
+- (void)waitForTokenForAppID:(NSString *)appID endpoint:(NSURL *)endpointURL target:(id)target selector:(SEL)aSelector
+{
+	BOOL performNow = NO;
+
+	@synchronized(self) {
+		_requestCount++;
+		MKFacebookTokenBucket *bucket = [self bucketForAppID:appID host:[endpointURL host]];
+		if (bucket == nil) {
+			performNow = YES;
+		} else {
+			[bucket refill];
+			//requests already waiting go first
+			if ([bucket->waiters count] == 0 && bucket->tokens >= 1.0) {
+				bucket->tokens -= 1.0;
+				performNow = YES;
+			} else {
+				MKFacebookRateLimiterWaiter *waiter = [[MKFacebookRateLimiterWaiter alloc] init];
+				waiter->target = [target retain];
+				waiter->selector = aSelector;
+				waiter->thread = [[NSThread currentThread] retain];
+				waiter->enqueuedAt = [NSDate timeIntervalSinceReferenceDate];
+				[bucket->waiters addObject:waiter];
+				[waiter release];
+				_delayedRequestCount++;
+				DLog(@"rate limit reached, %lu requests waiting", (unsigned long)[bucket->waiters count]);
+				[self scheduleTimerForBucket:bucket];
+			}
+		}
+	}
+
+	if (performNow == YES) {
+		[target performSelector:aSelector];
+	}
+}
+
+
+- (void)cancelWaitForTarget:(id)target
+{
+	NSMutableArray *cancelled = [NSMutableArray array];
+	@synchronized(self) {
+		for (MKFacebookTokenBucket *bucket in [_buckets allValues]) {
+			for (MKFacebookRateLimiterWaiter *waiter in bucket->waiters) {
+				if (waiter->target == target) {
+					[cancelled addObject:waiter];
+				}
+			}
+			[bucket->waiters removeObjectsInArray:cancelled];
+		}
+	}
+}
+
+
+- (NSDictionary *)statistics
+{
+	@synchronized(self) {
+		NSUInteger waiting = 0;
+		for (MKFacebookTokenBucket *bucket in [_buckets allValues]) {
+			waiting += [bucket->waiters count];
+		}
+		return [NSDictionary dictionaryWithObjectsAndKeys:
+				[NSNumber numberWithUnsignedInteger:_requestCount], MKFacebookRateLimiterRequestCountKey,
+				[NSNumber numberWithUnsignedInteger:_delayedRequestCount], MKFacebookRateLimiterDelayedRequestCountKey,
+				[NSNumber numberWithDouble:_totalWaitTime], MKFacebookRateLimiterTotalWaitTimeKey,
+				[NSNumber numberWithDouble:_maximumWaitTime], MKFacebookRateLimiterMaximumWaitTimeKey,
+				[NSNumber numberWithUnsignedInteger:waiting], MKFacebookRateLimiterWaitingRequestCountKey,
+				nil];
+	}
+	return nil;
+}
+
+
+- (void)resetStatistics
+{
+	@synchronized(self) {
+		_requestCount = 0;
+		_delayedRequestCount = 0;
+		_totalWaitTime = 0;
+		_maximumWaitTime = 0;
+	}
+}
+
+
+#pragma mark Private Methods
+
+- (NSString *)bucketKeyForAppID:(NSString *)appID host:(NSString *)host
+{
+	return [NSString stringWithFormat:@"%@|%@", appID != nil ? appID : MKFacebookRateLimiterWildcard, host != nil ? [host lowercaseString] : MKFacebookRateLimiterWildcard];
+}
+
+
+//the most specific limit wins: App ID and endpoint, App ID only, endpoint only, then the catch all
+- (MKFacebookTokenBucket *)bucketForAppID:(NSString *)appID host:(NSString *)host
+{
+	if ([_buckets count] == 0) {
+		return nil;
+	}
+
+	MKFacebookTokenBucket *bucket = nil;
+	if (appID != nil && host != nil) {
+		bucket = [_buckets objectForKey:[self bucketKeyForAppID:appID host:host]];
+	}
+	if (bucket == nil && appID != nil) {
+		bucket = [_buckets objectForKey:[self bucketKeyForAppID:appID host:nil]];
+	}
+	if (bucket == nil && host != nil) {
+		bucket = [_buckets objectForKey:[self bucketKeyForAppID:nil host:host]];
+	}
+	if (bucket == nil) {
+		bucket = [_buckets objectForKey:[self bucketKeyForAppID:nil host:nil]];
+	}
+	return bucket;
+}
+
+
+//hands out the tokens that have accumulated to waiting requests, must be called while synchronized
+- (NSArray *)drainBucket:(MKFacebookTokenBucket *)bucket
+{
+	NSMutableArray *ready = [NSMutableArray array];
+	NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+
+	[bucket refill];
+	while ([bucket->waiters count] > 0 && bucket->tokens >= 1.0) {
+		MKFacebookRateLimiterWaiter *waiter = [bucket->waiters objectAtIndex:0];
+		NSTimeInterval waited = now - waiter->enqueuedAt;
+		_totalWaitTime += waited;
+		if (waited > _maximumWaitTime) {
+			_maximumWaitTime = waited;
+		}
+		bucket->tokens -= 1.0;
+		[ready addObject:waiter];
+		[bucket->waiters removeObjectAtIndex:0];
+	}
+
+	[self scheduleTimerForBucket:bucket];
+	return ready;
+}
+
+
+- (void)scheduleTimerForBucket:(MKFacebookTokenBucket *)bucket
+{
+	if ([bucket->waiters count] == 0 || bucket->timer != nil) {
+		return;
+	}
+
+	NSTimeInterval wait = [bucket timeUntilNextToken];
+	//a rate of 0 pauses the bucket until a new limit is set
+	if (bucket->rate <= 0) {
+		return;
+	}
+
+	//always on the main run loop, the thread that queued the first waiter may not run its run loop. waiters are handed back to their own threads
+	NSTimer *timer = [NSTimer timerWithTimeInterval:wait
+											 target:self
+										   selector:@selector(bucketTimerFired:)
+										   userInfo:bucket
+											repeats:NO];
+	CFRunLoopAddTimer(CFRunLoopGetMain(), (CFRunLoopTimerRef)timer, kCFRunLoopCommonModes);
+	bucket->timer = timer;
+}
+
+
+- (void)bucketTimerFired:(NSTimer *)timer
+{
+	MKFacebookTokenBucket *bucket = [timer userInfo];
+	NSArray *ready = nil;
+	@synchronized(self) {
+		bucket->timer = nil;
+		ready = [self drainBucket:bucket];
+	}
+	[self performWaiters:ready];
+}
+
+
+//each waiter is started on the thread it was queued on, where its connection is scheduled
+- (void)performWaiters:(NSArray *)waiters
+{
+	NSThread *currentThread = [NSThread currentThread];
+	for (MKFacebookRateLimiterWaiter *waiter in waiters) {
+		if (waiter->thread == currentThread) {
+			[waiter->target performSelector:waiter->selector];
+		} else {
+			[waiter->target performSelector:waiter->selector onThread:waiter->thread withObject:nil waitUntilDone:NO modes:[NSArray arrayWithObject:NSRunLoopCommonModes]];
+		}
+	}
+}
+
+@end
@@ -20,10 +20,27 @@
 #import "MKFacebook.h"
 #import "MKFacebookSession.h"
 #import "MKFacebookResponseError.h"
+#import "MKFacebookTransport.h"
+#import "MKFacebookRequestMetrics.h"
 
 extern NSString *MKFacebookRequestActivityStarted;
 extern NSString *MKFacebookRequestActivityEnded;
 
+@class MKFacebookRequest;
+@class MKDelegateDispatchTable;
+@protocol SBJsonStreamParserDelegate;
+
+#if NS_BLOCKS_AVAILABLE
+/*!
+ @brief Block passed the result of a request.
+
+ Exactly one of response, responseError and error is set: response for a valid response, responseError when Facebook returned an error and error when the request failed.
+
+ @version 0.9 and later (Mac OS X v10.6 required)
+ */
+typedef void (^MKFacebookRequestCompletionHandler)(MKFacebookRequest *request, id response, MKFacebookResponseError *responseError, NSError *error);
+#endif
+
 
 /*!
  @enum MKFacebookRequestType
@@ -47,6 +64,19 @@ enum MKFacebookRequestResponseFormat
 typedef int MKFacebookRequestResponseFormat;
 
 
+/*!
+ @enum MKFacebookRequestPriority
+ @brief Order in which MKFacebookRequestQueue starts requests.
+ */
+enum MKFacebookRequestPriority
+{
+	MKFacebookRequestPriorityBackground = -1,
+	MKFacebookRequestPriorityNormal = 0,
+	MKFacebookRequestPriorityInteractive = 1
+};
+typedef int MKFacebookRequestPriority;
+
+
 
 /*!
  @class MKFacebookRequest
@@ -66,11 +96,18 @@ typedef int MKFacebookRequestResponseFormat;
   @version 0.7 and later
  */
 @interface MKFacebookRequest : NSObject {
-	NSURLConnection *theConnection; //internal connection used if object is used multiple times.
+	id theConnection; //connection of the attempt that is loading, nil between attempts. retained
+	id <MKFacebookTransport> transport;
 	BOOL _requestIsDone; //dirty stupid way of trying to prevent crashing when trying to cancel the request when it's not active.  isn't there a better way to do this?
 	NSURL *requestURL;
 	int _requestAttemptCount;
+	BOOL _retryInProgress;
+	NSDate *_firstAttemptDate;
 	MKFacebookSession *_session;
+	NSString *_encodedMethodPrefix;
+	NSString *_encodedMethodPrefixMethod;
+	NSString *_accessTokenFragment;
+	NSString *_accessTokenFragmentToken;
 
 	//exposed via properties
 	id delegate;
@@ -83,18 +120,22 @@ typedef int MKFacebookRequestResponseFormat;
     int numberOfRequestAttempts;
 	BOOL displayAPIErrorAlerts;
     NSTimeInterval connectionTimeoutInterval;
+	NSTimeInterval retryDelay;
+	NSTimeInterval maximumRetryDelay;
+	double retryJitter;
+	NSTimeInterval requestDeadline;
+	BOOL coalescesRequests;
+	MKFacebookRequestPriority priority;
+	id <SBJsonStreamParserDelegate> streamingDelegate;
+	BOOL _detachedFromDelegate;
+	BOOL _sentThroughCircuitBreaker;
+	uint64_t _timestamps[MKFacebookRequestTimestampCount];
+	uint64_t _firstAttemptTimestamp;
 	NSMutableData *_responseData;
-
-    
-	//default selectors
-	SEL defaultResponseSelector;
-	SEL defaultErrorSelector;
-	SEL defaultFailedSelector;
-	
-	//deprecated selectors
-	SEL deprecatedResponseSelector;
-	SEL deprecatedErrorSelector;
-	SEL deprecatedFailedSelector;
+	NSData *_rawResponseData;
+	MKDelegateDispatchTable *_delegateDispatchTable;
+	id _completionHandler;
+	id _cacheLookup; //disk cache lookup the request is waiting for, nil otherwise
 }
 
 
@@ -139,6 +180,8 @@ typedef int MKFacebookRequestResponseFormat;
  
  Contains unparsed XML or JSON result from Facebook. Use responseFormat property to specify which type of response you want returned from Facebook. Only available when using asynchronous requests.
  
+ The string is created from the response bytes the first time this property is read, responses are parsed without it. Responses sent to a streamingDelegate are not kept, the property is nil for them.
+ 
  @see responseFormat
  
  @version 0.9 and later
@@ -174,10 +217,98 @@ typedef int MKFacebookRequestResponseFormat;
  @brief Set the number of times to attempt a request before giving up.
  
  Sets how many times the request should be attempted before giving up.  Note: the delegate will not receive notification of a failed attempt unless all attempts fail.  Default is 5.
+ 
+ @see retryDelay
+ @see requestDeadline
  */
 @property (readwrite) int numberOfRequestAttempts;
 
 
+/*!
+ @brief How long to wait before the first retry.
+ 
+ When Facebook returns an error that can be retried the request is sent again after this delay. Each following retry waits twice as long as the one before it, up to maximumRetryDelay. Retries are scheduled on the current run loop and never block the thread. Default is 2 seconds.
+ 
+ @version 0.9 and later
+ */
+@property NSTimeInterval retryDelay;
+
+
+/*!
+ @brief Longest delay between two attempts.
+ 
+ Caps the exponential backoff. Default is 60 seconds.
+ 
+ @version 0.9 and later
+ */
+@property NSTimeInterval maximumRetryDelay;
+
+
+/*!
+ @brief Random spread applied to each retry delay.
+ 
+ A value between 0 and 1. A jitter of 0.25 spreads each delay randomly between 75% and 125% of its nominal value so throttled requests do not all retry at the same moment. Set to 0 to disable. Default is 0.25.
+ 
+ @version 0.9 and later
+ */
+@property double retryJitter;
+
+
+/*!
+ @brief Time limit for all attempts of a request.
+ 
+ Measured in seconds from the first time the request is sent. A retry that would start after the deadline is not attempted and the error is passed to the delegate instead. 0 means no deadline. Default is 0.
+ 
+ @version 0.9 and later
+ */
+@property NSTimeInterval requestDeadline;
+
+
+/*!
+ @brief Share the response of identical reads that are already loading.
+
+ When a read method (users.getLoggedInUser, photos.getAlbums, photos.get, any method whose name starts with "get", and fql.query) is sent while an identical request, same method, parameters and response format, is still loading, no second connection is made. The request waits for the first one and receives the same response, error or failure through its own delegate. Cancelling a waiting request does not affect the others. Default is YES.
+
+ @version 0.9 and later
+ */
+@property BOOL coalescesRequests;
+
+
+/*!
+ @brief How urgent the request is.
+
+ Used by MKFacebookRequestQueue to pick the next request to start. Interactive requests, i.e. something the user is waiting for, start before normal ones and normal ones before background ones. Requests of the same priority start in the order they were added. The priority is read when the request is added to a queue. Setting it on a request that is already in a queue does not move the request, use setPriority:forRequest: on the queue instead. Default is MKFacebookRequestPriorityNormal.
+
+ @see MKFacebookRequestQueue
+
+ @version 0.9 and later
+ */
+@property MKFacebookRequestPriority priority;
+
+
+/*!
+ @brief Receives a JSON response as parser events instead of a parsed object.
+
+ Set this to handle responses too large to hold in memory, i.e. tens of thousands of photos. The response is passed to the streaming delegate as it arrives, without building dictionaries or arrays and without keeping the response bytes, so memory use stays the same however large the response is. The delegate then receives facebookRequest:responseReceived: with a nil response once the whole response has been streamed. Facebook errors are not streamed, they go to the delegate as usual and are retried like any other request's.
+
+ The events are sent one at a time and in order on MKFacebookParsePool's threads, or on the thread the request was sent from if maximumConcurrentParses is 0. Events already sent are not taken back if the response turns out to be invalid, the delegate receives an error instead. Streamed responses skip MKFacebookResponseCache and are never shared with identical requests, see coalescesRequests.
+
+ Only used with MKFacebookRequestResponseFormatJSON. Requests sent as part of a MKFacebookBatchRequest receive their part of the batch response as usual. The streaming delegate is retained while a response is streamed to it. Default is nil.
+
+ @verbatim
+ MKFacebookRequest *request = [MKFacebookRequest requestWithDelegate:self];
+ request.responseFormat = MKFacebookRequestResponseFormatJSON;
+ request.streamingDelegate = photoIndexer;	//implements SBJsonStreamParserDelegate
+ [request sendRequest:@"photos.get" withParameters:parameters];
+ @endverbatim
+
+ @see SBJsonStreamParserDelegate
+
+ @version 0.9 and later
+ */
+@property (assign) id <SBJsonStreamParserDelegate> streamingDelegate;
+
+
 /*!
  @brief Display API Error alert windows.
  
@@ -195,6 +326,38 @@ typedef int MKFacebookRequestResponseFormat;
  */
 @property NSTimeInterval connectionTimeoutInterval;
 
+
+/*!
+ @brief API server the request is sent to.
+
+ Default is MKAPIServerURL, MKVideoRequest uses MKVideoAPIServerURL.
+
+ @version 0.9 and later
+ */
+@property (retain, nonatomic) NSURL *requestURL;
+
+
+/*!
+ @brief Sends the request and receives the response.
+
+ Default is the transport set with setDefaultTransport:, an MKURLConnectionTransport unless changed.
+
+ @see MKFacebookTransport
+ @version 0.9 and later
+ */
+@property (retain) id <MKFacebookTransport> transport;
+
+#if NS_BLOCKS_AVAILABLE
+/*!
+ @brief Block called with the result of the request.
+
+ Called after the delegate with the same result, so requests sent from a MKFacebookRequestQueue can use it too. The request lets go of the block once it has been called, set it again before sending the request again. Retries don't call it and keep it. Use the request passed to the block instead of capturing the request, the request keeps the block until then and a captured request would not be released before the request finishes.
+
+ @version 0.9 and later (Mac OS X v10.6 required)
+ */
+@property (copy) MKFacebookRequestCompletionHandler completionHandler;
+#endif
+
 //@}
 
 #pragma mark init methods
@@ -227,6 +390,18 @@ typedef int MKFacebookRequestResponseFormat;
 + (id)requestWithDelegate:(id)aDelegate selector:(SEL)aSelector;
 
 
+/*!
+ @brief Transport given to new requests.
+
+ Set an MKLoopbackTransport to answer every request from scripted responses without touching the network. Requests that already exist keep their transport.
+
+ @version 0.9 and later
+ */
++ (id <MKFacebookTransport>)defaultTransport;
+
++ (void)setDefaultTransport:(id <MKFacebookTransport>)aTransport;
+
+
 
 - (id)init;
 
@@ -280,6 +455,8 @@ typedef int MKFacebookRequestResponseFormat;
  [parameters release];
  @endverbatim
  
+ Values can be NSString, NSArray, NSImage, NSData, file NSURL or MKFileRange objects. NSImage and NSData values are sent in the body of a POST request. Files referenced by a file NSURL or MKFileRange are streamed from disk while the request is sent, so they never have to be loaded into memory.
+ 
  @warning Using a NSArray instead of a comma separated string for a list parameter is only available in 0.9 and later.
  
  @version 0.7 and later
@@ -295,6 +472,10 @@ typedef int MKFacebookRequestResponseFormat;
  - unknown error
  - service unavailable
  
+ Retries back off exponentially and are limited by numberOfRequestAttempts and requestDeadline.
+
+ If a limit has been configured with MKFacebookRateLimiter the request waits, without blocking, until the limiter allows it to be sent.
+ 
  The result will be passed to the delegate / selector that were assigned to this object. Make sure you have either set the method property or have set the parameters value with a NSDictionary containing a 'method' key before calling sendRequest.
  
  @verbatim
@@ -355,6 +536,26 @@ typedef int MKFacebookRequestResponseFormat;
 */
 - (void)sendRequest:(NSString *)aMethod withParameters:(NSDictionary *)params;
 
+#if NS_BLOCKS_AVAILABLE
+/*!
+ @brief Sets method, parameters and completion handler before sending the request.
+
+ @verbatim
+ MKFacebookRequest *request = [[[MKFacebookRequest alloc] init] autorelease];
+ [request sendRequest:@"users.getLoggedInUser" withParameters:nil completionHandler:^(MKFacebookRequest *request, id response, MKFacebookResponseError *responseError, NSError *error) {
+	 if (response != nil) {
+		 NSLog(@"%@", response);
+	 }
+ }];
+ @endverbatim
+
+ @see completionHandler
+
+ @version 0.9 and later (Mac OS X v10.6 required)
+ */
+- (void)sendRequest:(NSString *)aMethod withParameters:(NSDictionary *)params completionHandler:(MKFacebookRequestCompletionHandler)handler;
+#endif
+
 //@}
 
 
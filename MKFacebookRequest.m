@@ -17,6 +17,7 @@
  */
 
 #import "MKFacebookRequest.h"
+#import "MKFacebookRequestPrivate.h"
 #import "NSStringExtras.h"
 #import "NSXMLDocumentAdditions.h"
 #import "NSXMLElementAdditions.h"
@@ -24,14 +25,23 @@
 #import "CocoaCryptoHashing.h"
 #import "JSON.h"
 #import "NSDictionaryAdditions.h"
+#import "MKFacebookRateLimiter.h"
+#import "MKMultipartInputStream.h"
+#import "MKMultipartFormEncoder.h"
+#import "MKFacebookRequestCoalescer.h"
+#import "MKFacebookResponseCache.h"
+#import "MKFacebookParsePool.h"
+#import "MKDelegateDispatchTable.h"
+#import "MKFacebookCircuitBreaker.h"
+#include <mach/mach_time.h>
 
 
 NSString *MKFacebookRequestActivityStarted = @"MKFacebookRequestActivityStarted";
 NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 
-@interface MKFacebookRequest (Private)
-- (NSString *)generateFacebookMethodURL;
-@end
+//timestamp for MKFacebookRequestMetrics, only a flag check while metrics are off
+#define MKMarkTimestamp(moment) do { if (MKFacebookRequestMetricsEnabled == YES) { _timestamps[(moment)] = mach_absolute_time(); } } while (0)
+
 
 
 @implementation MKFacebookRequest
@@ -40,12 +50,43 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 @synthesize selector;
 @synthesize method;
 @synthesize parameters;
-@synthesize rawResponse;
 @synthesize urlRequestType;
 @synthesize responseFormat;
 @synthesize numberOfRequestAttempts;
 @synthesize displayAPIErrorAlerts;
 @synthesize connectionTimeoutInterval;
+@synthesize retryDelay;
+@synthesize maximumRetryDelay;
+@synthesize retryJitter;
+@synthesize requestDeadline;
+@synthesize coalescesRequests;
+@synthesize priority;
+@synthesize streamingDelegate;
+@synthesize requestURL;
+@synthesize transport;
+
+
+static id <MKFacebookTransport> MKFacebookDefaultTransport = nil;
+
++ (id <MKFacebookTransport>)defaultTransport
+{
+	@synchronized(self) {
+		if (MKFacebookDefaultTransport == nil) {
+			MKFacebookDefaultTransport = [[MKURLConnectionTransport alloc] init];
+		}
+		return [[MKFacebookDefaultTransport retain] autorelease];
+	}
+	return nil;
+}
+
+
++ (void)setDefaultTransport:(id <MKFacebookTransport>)aTransport
+{
+	@synchronized(self) {
+		[MKFacebookDefaultTransport autorelease];
+		MKFacebookDefaultTransport = [aTransport retain];
+	}
+}
 
 
 #pragma mark init methods
@@ -76,21 +117,24 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 		urlRequestType = MKFacebookRequestTypePOST;
 		responseFormat = MKFacebookRequestResponseFormatXML;
 		requestURL = [[NSURL URLWithString:MKAPIServerURL] retain];
+		transport = [[MKFacebookRequest defaultTransport] retain];
 		displayAPIErrorAlerts = NO;
 		numberOfRequestAttempts = 5;
+		retryDelay = 2.0;
+		maximumRetryDelay = 60.0;
+		retryJitter = 0.25;
+		requestDeadline = 0;
+		coalescesRequests = YES;
+		priority = MKFacebookRequestPriorityNormal;
+		streamingDelegate = nil;
+		_detachedFromDelegate = NO;
+		_requestAttemptCount = 0;
+		_retryInProgress = NO;
+		_firstAttemptDate = nil;
 		_session = [MKFacebookSession sharedMKFacebookSession];
 		self.connectionTimeoutInterval = 30;
 		self.method = nil;
 		rawResponse = nil;
-		
-		defaultResponseSelector = @selector(facebookRequest:responseReceived:);
-		defaultErrorSelector = @selector(facebookRequest:errorReceived:);
-		defaultFailedSelector = @selector(facebookRequest:failed:);
-		
-		deprecatedResponseSelector = @selector(facebookResponseReceived:);
-		deprecatedErrorSelector = @selector(facebookErrorResponseReceived:);
-		deprecatedFailedSelector = @selector(facebookRequestFailed:);
-		
 	}
 	return self;
 }
@@ -113,11 +157,26 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 
 -(void)dealloc
 {
+	//released without being cancelled while it may be the circuit breaker's probe, the next request gets to probe instead
+	if (_sentThroughCircuitBreaker == YES) {
+		[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] requestWasCancelled:self];
+	}
+	[theConnection release];
 	[requestURL release];
+	[transport release];
 	[parameters release];
 	[_responseData release];
+	[_rawResponseData release];
 	[method release];
 	[rawResponse release];
+	[_firstAttemptDate release];
+	[_encodedMethodPrefix release];
+	[_encodedMethodPrefixMethod release];
+	[_accessTokenFragment release];
+	[_accessTokenFragmentToken release];
+	[_delegateDispatchTable release];
+	[_completionHandler release];
+	[_cacheLookup release];
 	[super dealloc];
 }
 #pragma mark -
@@ -125,6 +184,27 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 
 #pragma mark Instance Methods
 
+//the cached URL prefix is built from the endpoint
+- (void)setRequestURL:(NSURL *)aURL
+{
+	[aURL retain];
+	[requestURL release];
+	requestURL = aURL;
+	[_encodedMethodPrefix release];
+	_encodedMethodPrefix = nil;
+}
+
+
+//the string is made from the response bytes the first time it's asked for, most responses are only ever parsed
+- (NSString *)rawResponse
+{
+	if (rawResponse == nil && [_rawResponseData length] > 0) {
+		rawResponse = [[NSString alloc] initWithData:_rawResponseData encoding:NSUTF8StringEncoding];
+	}
+	return [[rawResponse retain] autorelease];
+}
+
+
 - (void)setParameters:(NSDictionary *)params
 {
     if (parameters != nil) {
@@ -158,10 +238,127 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 }
 
 
+#if NS_BLOCKS_AVAILABLE
+- (MKFacebookRequestCompletionHandler)completionHandler
+{
+	return [[_completionHandler retain] autorelease];
+}
+
+
+- (void)setCompletionHandler:(MKFacebookRequestCompletionHandler)handler
+{
+	if (handler != _completionHandler) {
+		[_completionHandler release];
+		_completionHandler = [handler copy];
+	}
+}
+
+
+- (void)sendRequest:(NSString *)aMethod withParameters:(NSDictionary *)params completionHandler:(MKFacebookRequestCompletionHandler)handler
+{
+	self.completionHandler = handler;
+	[self sendRequest:aMethod withParameters:params];
+}
+#endif
+
+
 - (void)sendRequest
 {	
     NSAssert(self.method != nil, @"Request method not set");
     
+    [self beginRequest];
+    
+    //answered from the cache without touching the network, the delegate hears back on the next pass of the run loop like it would for a connection. streamed responses are never cached
+    if (_retryInProgress == NO && streamingDelegate == nil) {
+        NSData *cachedResponseData = nil;
+        MKFacebookResponseCache *cache = [MKFacebookResponseCache sharedMKFacebookResponseCache];
+        id cachedResponse = [cache cachedResponseForRequest:self responseData:&cachedResponseData];
+        if (cachedResponse != nil) {
+            [self setRawResponseData:cachedResponseData];
+            [self performSelector:@selector(deliverCachedResponse:) withObject:cachedResponse afterDelay:0];
+            return;
+        }
+        //not in memory, the disk is read in the background and the request carries on in cacheLookup:didFindResponse:responseData:
+        id lookup = [cache lookUpCachedResponseForRequest:self];
+        if (lookup != nil) {
+            _cacheLookup = [lookup retain];
+            return;
+        }
+    }
+    
+    [self sendUncachedRequest];
+}
+
+
+//sends the request to Facebook, or waits for an identical request that is already on its way there
+- (void)sendUncachedRequest
+{
+    //an identical read already on its way to Facebook answers this request too, unless the response has to be streamed to this request's own consumer
+    if (_retryInProgress == NO && coalescesRequests == YES && streamingDelegate == nil &&
+        [[MKFacebookRequestCoalescer sharedMKFacebookRequestCoalescer] attachRequest:self] == YES) {
+        return;
+    }
+    
+    //Facebook has been failing for this host, don't add to the pile. asked before the rate limiter so a request that won't be sent doesn't use up a token. the delegate hears back on the next pass of the run loop like it would for a connection
+    if ([[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] shouldSendRequest:self] == NO) {
+        [self performSelector:@selector(deliverOpenCircuitFailure) withObject:nil afterDelay:0];
+        return;
+    }
+    _sentThroughCircuitBreaker = YES;
+    
+    //stay under the request budget up front instead of waiting for Facebook to throttle us. startRequest is called right away when a token is available.
+    [[MKFacebookRateLimiter sharedMKFacebookRateLimiter] waitForTokenForAppID:[_session appID]
+                                                                     endpoint:requestURL
+                                                                       target:self
+                                                                     selector:@selector(startRequest)];
+}
+
+
+//a new request starts counting attempts from scratch, retries keep counting towards numberOfRequestAttempts and requestDeadline
+- (void)beginRequest
+{
+    if (_retryInProgress == NO) {
+        _requestAttemptCount = 0;
+        [_firstAttemptDate release];
+        _firstAttemptDate = [[NSDate alloc] init];
+        _firstAttemptTimestamp = MKFacebookRequestMetricsEnabled == YES ? mach_absolute_time() : 0;
+        _detachedFromDelegate = NO;
+    }
+    //a disk cache lookup for an earlier send is ignored when it comes back
+    [_cacheLookup release];
+    _cacheLookup = nil;
+    _requestIsDone = NO;
+}
+
+
+//the request was cancelled but keeps loading for the requests waiting on it, its own delegate hears nothing more
+- (void)detachFromDelegate
+{
+    _detachedFromDelegate = YES;
+}
+
+
+- (BOOL)requestIsDone
+{
+    return _requestIsDone;
+}
+
+
+- (void)startRequest
+{
+    //the request may have been cancelled while it was waiting for the rate limiter
+    if (_requestIsDone == YES) {
+        return;
+    }
+    
+    if (MKFacebookRequestMetricsEnabled == YES) {
+        memset(_timestamps, 0, sizeof(_timestamps));
+        _timestamps[MKFacebookRequestTimestampStart] = mach_absolute_time();
+    }
+    
+    //drop whatever was parsed of a previous attempt
+    [[MKFacebookParsePool sharedMKFacebookParsePool] cancelParsingForRequest:self];
+    
     //a valid access token is required for all requests
     //TODO: error out request if toke is not found
 	NSString *accessToken = [[MKFacebookSession sharedMKFacebookSession] accessToken];
@@ -179,7 +376,18 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 		userAgent = @"MKAbeFook";
 	
 	
-	_requestIsDone = NO;
+	switch (self.responseFormat) {
+		case MKFacebookRequestResponseFormatXML:
+			[parameters setValue:@"XML" forKey:@"format"];
+			break;
+		case MKFacebookRequestResponseFormatJSON:
+			[parameters setValue:@"JSON" forKey:@"format"];
+			break;
+		default:
+			[parameters setValue:@"XML" forKey:@"format"];
+			break;
+	}
+	
 	if(urlRequestType == MKFacebookRequestTypePOST)
 	{
 		//NSLog([_facebookConnection description]);
@@ -190,88 +398,72 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 		
 		[postRequest setValue:userAgent forHTTPHeaderField:@"User-Agent"];
 		
-		NSMutableData *postBody = [NSMutableData data];
-		NSString *stringBoundary = [NSString stringWithString:@"xXxiFyOuTyPeThIsThEwOrLdWiLlExPlOdExXx"];
-		NSData *endLineData = [[NSString stringWithFormat:@"\r\n--%@\r\n", stringBoundary] dataUsingEncoding:NSUTF8StringEncoding];
-		NSString *contentType = [NSString stringWithFormat:@"multipart/form-data; boundary=%@", stringBoundary];
 		[postRequest setHTTPMethod:@"POST"];
-		[postRequest addValue:contentType forHTTPHeaderField:@"Content-Type"];
-		[postBody appendData:[[NSString stringWithFormat:@"--%@\r\n", stringBoundary] dataUsingEncoding:NSUTF8StringEncoding]];
-
-		switch (self.responseFormat) {
-			case MKFacebookRequestResponseFormatXML:
-				[parameters setValue:@"XML" forKey:@"format"];
-				break;
-			case MKFacebookRequestResponseFormatJSON:
-				[parameters setValue:@"JSON" forKey:@"format"];
-				break;
-			default:
-				[parameters setValue:@"XML" forKey:@"format"];
-				break;
-		}
+		[postRequest addValue:[MKMultipartFormEncoder contentType] forHTTPHeaderField:@"Content-Type"];
+
 		
 		
 		
 		
-		//if parameters contains a NSImage or NSData object we need store the key so it can be removed from the _parameters dictionary before a signature is generated for the request
-		NSString *imageKey = nil;
-		NSString *dataKey = nil;
+		//the encoder sizes the body before writing it, binary data and files are referenced instead of copied
+		MKMultipartFormEncoder *encoder = [[[MKMultipartFormEncoder alloc] initWithCapacity:[parameters count]] autorelease];
 		
 		for(id key in [parameters allKeys])
 		{
+			id value = [parameters objectForKey:key];
 			
-			if([[parameters objectForKey:key] isKindOfClass:[NSImage class]])
+			if([value isKindOfClass:[NSImage class]])
 			{
-				NSData *resizedTIFFData = [[parameters objectForKey:key] TIFFRepresentation];
+				NSData *resizedTIFFData = [value TIFFRepresentation];
 				NSBitmapImageRep *resizedImageRep = [NSBitmapImageRep imageRepWithData: resizedTIFFData];
 				NSDictionary *imageProperties = [NSDictionary dictionaryWithObject:[NSNumber numberWithFloat: 1.0] forKey:NSImageCompressionFactor];
 				NSData *imageData = [resizedImageRep representationUsingType: NSJPEGFileType properties: imageProperties];
 				
-				[postBody appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; filename=\"image\"\r\n"] dataUsingEncoding:NSUTF8StringEncoding]];
-				[postBody appendData:[[NSString stringWithString:@"Content-Type: image/jpeg\r\n\r\n"] dataUsingEncoding:NSUTF8StringEncoding]];	
-				[postBody appendData: imageData];
-				[postBody appendData:endLineData];
-				
-				//we need to remove this the image object from the dictionary so we can generate a correct sig from the other values, but we can't do it here or leopard will complain.  so we'll do it outside the loop.
-				//[_parameters removeObjectForKey:key];
-				imageKey = [NSString stringWithString:key];
-
+				[encoder addData:imageData filename:@"image" contentType:@"image/jpeg"];
 			}
-			else if( [[parameters objectForKey:key] isKindOfClass:[NSData class]] ){
-				[postBody appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; filename=\"data.mov\"\r\n"] dataUsingEncoding:NSUTF8StringEncoding]];
-				[postBody appendData:[[NSString stringWithString:@"Content-Type: content/unknown\r\n\r\n"] dataUsingEncoding:NSUTF8StringEncoding]];	
-				[postBody appendData:(NSData *)[parameters objectForKey:key]];
-				[postBody appendData:endLineData];
-				dataKey = [NSString stringWithString:key];
-				
+			else if( [value isKindOfClass:[NSData class]] ){
+				[encoder addData:value filename:@"data.mov" contentType:@"content/unknown"];
 			}
-			else if ([[parameters objectForKey:key] isKindOfClass:[NSArray class]])
+			else if ([value isKindOfClass:[MKFileRange class]])
 			{
-				NSString *stringFromArray = [[parameters objectForKey:key] componentsJoinedByString:@","];
-				[postBody appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; name=\"%@\"\r\n\r\n", key] dataUsingEncoding:NSUTF8StringEncoding]];
-				[postBody appendData:[stringFromArray dataUsingEncoding:NSUTF8StringEncoding]];
-				[postBody appendData:endLineData];
+				NSString *path = [[value fileURL] path];
+				[encoder addFileAtPath:path offset:[value offset] length:[value length] filename:[path lastPathComponent] contentType:@"content/unknown"];
+			}
+			else if ([value isKindOfClass:[NSURL class]] && [value isFileURL])
+			{
+				NSString *path = [value path];
+				unsigned long long fileSize = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil] fileSize];
+				[encoder addFileAtPath:path offset:0 length:fileSize filename:[path lastPathComponent] contentType:@"content/unknown"];
+			}
+			else if ([value isKindOfClass:[NSArray class]])
+			{
+				[encoder addFieldWithName:key value:[value componentsJoinedByString:@","]];
 			}
 			else
 			{
-			 
-				[postBody appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; name=\"%@\"\r\n\r\n", key] dataUsingEncoding:NSUTF8StringEncoding]];
-				[postBody appendData:[[parameters valueForKey:key] dataUsingEncoding:NSUTF8StringEncoding]];
-				[postBody appendData:endLineData];
+				[encoder addFieldWithName:key value:value];
 			}
 			 
 		}
-		//0.7.1 fix.  we can't remove this during the while loop so we'll do it here
-		if(imageKey != nil)
-			[parameters removeObjectForKey:imageKey];
-		
-		if (dataKey != nil)
-			[parameters removeObjectForKey:dataKey];
-					
-		[postBody appendData:endLineData];
 		
-		[postRequest setHTTPBody:postBody];
-		theConnection = [NSURLConnection connectionWithRequest:postRequest delegate:self];
+		if ([encoder hasBinaryParts]) {
+			NSError *bodyError = nil;
+			MKMultipartInputStream *bodyStream = [encoder bodyStream:&bodyError];
+			if (bodyStream == nil) {
+				//nothing was sent, Facebook's health isn't in question. the delegate hears back on the next pass of the run loop like it would for a connection
+				_sentThroughCircuitBreaker = NO;
+				[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] requestWasCancelled:self];
+				[self performSelector:@selector(handleConnectionError:) withObject:bodyError afterDelay:0];
+				return;
+			}
+			[postRequest setValue:[NSString stringWithFormat:@"%llu", [bodyStream length]] forHTTPHeaderField:@"Content-Length"];
+			[postRequest setHTTPBodyStream:bodyStream];
+		} else {
+			[postRequest setHTTPBody:[encoder bodyData]];
+		}
+		MKMarkTimestamp(MKFacebookRequestTimestampBuilt);
+		[self releaseConnection];
+		theConnection = [[transport connectionWithRequest:postRequest delegate:self] retain];
 	}
 	
 	if(urlRequestType == MKFacebookRequestTypeGET)
@@ -284,7 +476,9 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 															  timeoutInterval:[self connectionTimeoutInterval]];
 		[getRequest setValue:userAgent forHTTPHeaderField:@"User-Agent"];
 		
-		theConnection = [NSURLConnection connectionWithRequest:getRequest delegate:self];
+		MKMarkTimestamp(MKFacebookRequestTimestampBuilt);
+		[self releaseConnection];
+		theConnection = [[transport connectionWithRequest:getRequest delegate:self] retain];
 	}
 
 	[[NSNotificationCenter defaultCenter] postNotificationName:@"MKFacebookRequestActivityStarted" object:nil];
@@ -292,18 +486,109 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 }
 
 
+//the connection of the current attempt is kept until it finishes, fails or is cancelled
+- (void)releaseConnection
+{
+	[theConnection release];
+	theConnection = nil;
+}
+
+
 - (void)cancelRequest
 {
-	if(_requestIsDone == NO)
+	//waiting on another request's fetch, or leading a fetch other requests still need
+	if ([[MKFacebookRequestCoalescer sharedMKFacebookRequestCoalescer] cancelRequest:self] == YES) {
+		return;
+	}
+	[self cancelConnection];
+}
+
+
+- (void)cancelConnection
+{
+	//a retry, a cached response or a failure may be waiting to be sent. those are the only delayed performs on a request, and the ones with an argument only match it, so all of them go at once
+	[NSObject cancelPreviousPerformRequestsWithTarget:self];
+	[[MKFacebookRateLimiter sharedMKFacebookRateLimiter] cancelWaitForTarget:self];
+	//a disk cache lookup that is still running is ignored when it comes back
+	[_cacheLookup release];
+	_cacheLookup = nil;
+	if (_sentThroughCircuitBreaker == YES) {
+		_sentThroughCircuitBreaker = NO;
+		[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] requestWasCancelled:self];
+	}
+	[[MKFacebookParsePool sharedMKFacebookParsePool] cancelParsingForRequest:self];
+	//only a connection that is still loading is cancelled, between attempts there is none
+	if (theConnection != nil)
 	{
 		//NSLog(@"cancelling request...");
 		[theConnection cancel];
-		_requestIsDone = YES;
+		[self releaseConnection];
 	}
+	_requestIsDone = YES;
 	[[NSNotificationCenter defaultCenter] postNotificationName:@"MKFacebookRequestActivityEnded" object:nil];
 }
 
 
+//only errors 4 (too many requests), 1 (unknown) and 2 (service unavailable) are worth trying again, see connectionDidFinishLoading:
+//retries are scheduled on the current run loop instead of sleeping so other connections and the UI keep running while we wait
+- (BOOL)scheduleRetryForErrorCode:(int)errorCode
+{
+	if (errorCode != 4 && errorCode != 1 && errorCode != 2) {
+		return NO;
+	}
+	
+	if (_requestAttemptCount + 1 >= numberOfRequestAttempts) {
+		DLog(@"I give up, the request has been attempted %i times but it just won't work.", _requestAttemptCount + 1);
+		return NO;
+	}
+	
+	NSTimeInterval delay = [self nextRetryDelay];
+	if (requestDeadline > 0 && [[NSDate date] timeIntervalSinceDate:_firstAttemptDate] + delay > requestDeadline) {
+		DLog(@"Not retrying, the next attempt would start after the request deadline.");
+		return NO;
+	}
+	
+	[_responseData setData:[NSData data]];
+	_requestAttemptCount++;
+	_requestIsDone = YES;
+	DLog(@"Facebook returned error %i, trying again in %.2f seconds....%@", errorCode, delay, [self description]);
+	[self performSelector:@selector(retryRequest) withObject:nil afterDelay:delay];
+	return YES;
+}
+
+
+//exponential backoff starting at retryDelay and capped at maximumRetryDelay, randomly spread by retryJitter so throttled requests don't all come back at once
+- (NSTimeInterval)nextRetryDelay
+{
+	NSTimeInterval delay = retryDelay;
+	for (int i = 0; i < _requestAttemptCount && delay < maximumRetryDelay; i++) {
+		delay *= 2.0;
+	}
+	if (delay > maximumRetryDelay) {
+		delay = maximumRetryDelay;
+	}
+	
+	double jitter = retryJitter;
+	if (jitter > 1.0) {
+		jitter = 1.0;
+	}
+	if (jitter > 0) {
+		double random = (double)arc4random() / (double)UINT32_MAX;
+		delay = delay * (1.0 - jitter) + delay * jitter * 2.0 * random;
+	}
+	
+	return delay > 0 ? delay : 0;
+}
+
+
+- (void)retryRequest
+{
+	_retryInProgress = YES;
+	[self sendRequest];
+	_retryInProgress = NO;
+}
+
+
 //this private method prepares the url to call the appropriate method but does not add any of the required parameters. it is used to prepare the first part of the URL.
 /*
  i.e. if a method users.getInfo is specified for the request, this method will prepare the url up to this point:
@@ -320,31 +605,53 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 }
 
 
+//keys are sorted and every key and value is encoded on its own so identical requests always produce identical URLs
 - (NSURL *)generateFacebookURLForMethod:(NSString *)aMethodName parameters:(NSDictionary *)params
 {
     
     self.method = aMethodName;
-    [self setParameters:params];
+    //sendRequest passes our own parameters, setParameters: would empty the dictionary before copying it
+    if (params != parameters) {
+        [self setParameters:params];
+    }
     
 	NSString *accessToken = [[MKFacebookSession sharedMKFacebookSession] accessToken];
     
-    NSMutableString *urlString = [NSMutableString stringWithString:[self generateFacebookMethodURL]];
+    //the method part only changes with the method and the token part only with the token, both are kept between calls
+    if (_encodedMethodPrefix == nil || ![_encodedMethodPrefixMethod isEqualToString:self.method]) {
+        [_encodedMethodPrefix release];
+        _encodedMethodPrefix = [[NSString alloc] initWithFormat:@"%@%@?", [requestURL absoluteString], [self.method encodeURLComponent]];
+        [_encodedMethodPrefixMethod release];
+        _encodedMethodPrefixMethod = [self.method copy];
+    }
+    if (_accessTokenFragment == nil || ![_accessTokenFragmentToken isEqualToString:accessToken]) {
+        [_accessTokenFragment release];
+        _accessTokenFragment = [[NSString alloc] initWithFormat:@"access_token=%@", accessToken != nil ? [accessToken encodeURLComponent] : @""];
+        [_accessTokenFragmentToken release];
+        _accessTokenFragmentToken = [accessToken copy];
+    }
+    
+    NSMutableString *urlString = [NSMutableString stringWithCapacity:[_encodedMethodPrefix length] + [_accessTokenFragment length] + [parameters count] * 32];
+    [urlString appendString:_encodedMethodPrefix];
     
     //add the accessToken that all requests need
-    [urlString appendFormat:@"?access_token=%@", accessToken];
+    [urlString appendString:_accessTokenFragment];
     
     //support arrays or strings
-    for(NSString *key in [parameters allKeys]){
+    for(NSString *key in [[parameters allKeys] sortedArrayUsingSelector:@selector(compare:)]){
+        if ([key isEqualToString:@"access_token"]) {
+            continue;
+        }
         id object = [parameters objectForKey:key];
         if ([object isKindOfClass:[NSArray class]]) {
-            [urlString appendFormat:@"&%@=%@", key, [object componentsJoinedByString:@","]];
+            object = [object componentsJoinedByString:@","];
         }
         if([object isKindOfClass:[NSString class]]){
-            [urlString appendFormat:@"&%@=%@", key, object];
+            [urlString appendFormat:@"&%@=%@", [key encodeURLComponent], [object encodeURLComponent]];
         }
     }
     DLog(@"generateFacebookURLForMethod: %@", urlString);
-	return [NSURL URLWithString:[[urlString encodeURLLegally] autorelease]];
+	return [NSURL URLWithString:urlString];
 }
 
 
@@ -353,12 +660,12 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 	NSURLRequest *urlRequest = [NSURLRequest requestWithURL:theURL 
 												cachePolicy:NSURLRequestReloadIgnoringCacheData
 											timeoutInterval:[self connectionTimeoutInterval]];
-	NSHTTPURLResponse *xmlResponse;  //not used right now
+	NSURLResponse *xmlResponse;  //not used right now
 	NSXMLDocument *returnXML = nil;
 	NSError *fetchError = nil;
-	NSData *responseData = [NSURLConnection sendSynchronousRequest:urlRequest
-												 returningResponse:&xmlResponse
-															 error:&fetchError];
+	NSData *responseData = [transport sendSynchronousRequest:urlRequest
+										   returningResponse:&xmlResponse
+													   error:&fetchError];
 	
 	if(fetchError != nil)
 	{
@@ -385,159 +692,251 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 
 
 #pragma mark NSURLConnection Delegate Methods
+- (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response
+{
+	MKMarkTimestamp(MKFacebookRequestTimestampResponse);
+}
+
+
 - (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data
 {
-	[_responseData appendData:data];
+	if (_timestamps[MKFacebookRequestTimestampFirstByte] == 0) {
+		MKMarkTimestamp(MKFacebookRequestTimestampFirstByte);
+	}
+	//a streamed response isn't kept, the parse pool passes it on as it goes
+	if (streamingDelegate == nil || self.responseFormat != MKFacebookRequestResponseFormatJSON) {
+		[_responseData appendData:data];
+	}
+	
+	//JSON is parsed as it arrives, so most of the parsing is done by the time the last byte is in
+	[[MKFacebookParsePool sharedMKFacebookParsePool] request:self didReceiveData:data];
 }
 
 //responses are ONLY passed back if they do not contain any errors
 - (void)connectionDidFinishLoading:(NSURLConnection *)connection
 {
+	MKMarkTimestamp(MKFacebookRequestTimestampLastByte);
+	[self releaseConnection];
 	[[NSNotificationCenter defaultCenter] postNotificationName:@"MKFacebookRequestActivityEnded" object:nil];
 	
+	//the parse pool reads the response on another thread, so it gets the buffer and the next attempt gets a new one
+	NSData *data = [_responseData autorelease];
+	_responseData = [[NSMutableData alloc] init];
 	
-	NSError *error = nil;
-	//assume the response is not valid until we can verify it is good
-	BOOL validResponse = NO;
+	//handleParsedResponse:errorDictionary:data:allowRetry: is called back on this thread
+	[[MKFacebookParsePool sharedMKFacebookParsePool] requestDidFinishLoading:self data:data];
+}
 
-	
-	//turn the response into a string so we can parse it if it's JSON or turn it into NSXML if we're expecting XML
-	NSString *responseString = [[[NSString alloc] initWithData:_responseData encoding:NSUTF8StringEncoding] autorelease];
 
-	
-	if (responseString != nil && [responseString length] > 0) {
-		validResponse = YES;
-		rawResponse = [responseString copy];
-	}else {
-		rawResponse = nil;
+//parses a complete response in the response format. safe to call from any thread
+- (id)parseResponseData:(NSData *)data
+{
+	if ([data length] == 0) {
+		return nil;
+	}
+	if (self.responseFormat == MKFacebookRequestResponseFormatJSON) {
+		MKFacebookParsePool *parsePool = [MKFacebookParsePool sharedMKFacebookParsePool];
+		SBJsonParser *parser = [parsePool checkOutParser];
+		id parsedResponse = [parser objectWithData:data];
+		[parsePool checkInParser:parser];
+		return parsedResponse;
 	}
+	return [[[NSXMLDocument alloc] initWithData:data options:0 error:nil] autorelease];
+}
 
 
+//returns a parsed response if it is a valid Facebook response. for error responses returns nil and the error as a dictionary, the dictionary is nil too if the response couldn't be parsed. safe to call from any thread
+- (id)validResponseFromParsedResponse:(id)parsedResponse errorDictionary:(NSDictionary **)errorDictionary
+{
+	*errorDictionary = nil;
 	
-	if (self.responseFormat == MKFacebookRequestResponseFormatXML && validResponse == YES) {
-		
-		NSXMLDocument *returnXML = [[[NSXMLDocument alloc] initWithXMLString:responseString options:0 error:&error] autorelease];
-		
-		if (error != nil) {
-			validResponse = NO;
+	if ([parsedResponse isKindOfClass:[NSXMLDocument class]]) {
+		if ([parsedResponse validFacebookResponse] == YES) {
+			return parsedResponse;
 		}
-		
-		
+		*errorDictionary = [[parsedResponse rootElement] dictionaryFromXMLElement];
+		return nil;
+	}
+	
+	//JSON returning a NSDictionary can be good or bad because errors are turned into dictionaries.
+	if ([parsedResponse isKindOfClass:[NSDictionary class]]) {
+		if ([parsedResponse validFacebookResponse] == YES) {
+			return parsedResponse;
+		}
+		*errorDictionary = parsedResponse;
+		return nil;
+	}
+	
+	//if the JSON parses out to an array i think it can only mean it's valid...
+	if ([parsedResponse isKindOfClass:[NSArray class]]) {
+		return parsedResponse;
+	}
+	
+	//not JSON or XML at all, i.e. a proxy error page
+	return nil;
+}
+
+
+//the raw response keeps the bytes it was parsed from
+- (void)setRawResponseData:(NSData *)data
+{
+	if (data == _responseData) {
+		//hand the buffer over instead of copying it, the next attempt gets a new one
+		[_rawResponseData release];
+		_rawResponseData = _responseData;
+		_responseData = [[NSMutableData alloc] init];
+	} else if (data != _rawResponseData) {
+		[_rawResponseData release];
+		_rawResponseData = [data retain];
+	}
+	[rawResponse release];
+	rawResponse = nil;
+}
+
+
+- (NSData *)rawResponseData
+{
+	return [[_rawResponseData retain] autorelease];
+}
+
+
+//parses a complete response and passes it to the delegate. also used by MKFacebookBatchRequest to hand each request its part of a batch response
+- (void)handleResponseData:(NSData *)data allowRetry:(BOOL)allowRetry
+{
+	NSDictionary *errorDictionary = nil;
+	id response = [self validResponseFromParsedResponse:[self parseResponseData:data] errorDictionary:&errorDictionary];
+	[self handleParsedResponse:response errorDictionary:errorDictionary data:data allowRetry:allowRetry];
+}
+
+
+//response is a valid response or nil, errorDictionary is the parsed error response. the error is also used for the retry decision so the response is only parsed once
+- (void)handleParsedResponse:(id)response errorDictionary:(NSDictionary *)errorDictionary data:(NSData *)data allowRetry:(BOOL)allowRetry
+{
+	MKMarkTimestamp(MKFacebookRequestTimestampParsed);
+	[self setRawResponseData:data];
+	
+	int errorInt = [[errorDictionary valueForKey:@"error_code"] intValue];
+	//garbage instead of JSON or XML, or an unknown error or service unavailable, means Facebook is having trouble. any other answer means it's up
+	[self reportAttemptFailed:(response == nil && (errorDictionary == nil || errorInt == 1 || errorInt == 2))];
+	
+	if (response == nil) {
 		//facebook has returned an error of some kind. evaluate the error and try resending the request if possible
-		if([returnXML validFacebookResponse] == NO)
-		{
-			NSDictionary *errorDictionary = [[returnXML rootElement] dictionaryFromXMLElement];
-			//4 is a magic number that represents "The application has reached the maximum number of requests allowed. More requests are allowed once the time window has completed."
-			//luckily for us Facebook doesn't define "the time window".
-			//we will also try the request again if we see a 1 (unknown) or 2 (service unavailable) error
-			int errorInt = [[errorDictionary valueForKey:@"error_code"] intValue];
-			if((errorInt == 4 || errorInt == 1 || errorInt == 2 ) && numberOfRequestAttempts <= _requestAttemptCount)
-			{
-				NSDate *sleepUntilDate = [[NSDate date] addTimeInterval:2.0];
-				[NSThread sleepUntilDate:sleepUntilDate];
-				[_responseData setData:[NSData data]];
-				_requestAttemptCount++;
-				DLog(@"Too many requests, waiting just a moment....%@", [self description]);
-				[self sendRequest];
-				return;
-			}
-			//DLog(@"I give up, the request has been attempted %i times but it just won't work. Here is the failed request: %@", _requestAttemptCount, [_parameters description]);
-			//we've tried the request a few times, now we're giving up.
-			validResponse = NO;
-		}else
+		//4 is a magic number that represents "The application has reached the maximum number of requests allowed. More requests are allowed once the time window has completed."
+		//luckily for us Facebook doesn't define "the time window".
+		//we will also try the request again if we see a 1 (unknown) or 2 (service unavailable) error
+		if(allowRetry == YES && [self scheduleRetryForErrorCode:errorInt])
 		{
-			//the response we have received from facebook is valid, pass it back to the delegate.
-			if([delegate respondsToSelector:selector]){
-				[delegate performSelector:selector withObject:returnXML];
-			}else if ([delegate respondsToSelector:defaultResponseSelector]) {
-				NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[delegate methodSignatureForSelector:defaultResponseSelector]];
-				[invocation setTarget:delegate];
-				[invocation setSelector:defaultResponseSelector];
-				[invocation setArgument:&self atIndex:2];
-				[invocation setArgument:&returnXML atIndex:3];
-				[invocation invoke];
-			}else if ([delegate respondsToSelector:deprecatedResponseSelector]) {
-				[delegate performSelector:deprecatedResponseSelector withObject:returnXML];
-			}
-		}	
-		
+			[self recordMetrics];
+			return;
+		}
+		//we've tried the request a few times, now we're giving up.
+		[self handleErrorDictionary:errorDictionary responseData:data];
+		return;
 	}
 	
+	//the response we have received from facebook is valid, pass it back to the delegate. a streamed response has already been passed on piece by piece
+	if (response == MKFacebookStreamedResponse) {
+		[self deliverResponse:nil];
+	} else {
+		[[MKFacebookResponseCache sharedMKFacebookResponseCache] storeResponse:response responseData:_rawResponseData forRequest:self];
+		[self deliverResponse:response];
+	}
 	
+	[_responseData setData:[NSData data]];
+	_requestIsDone = YES;
+}
+
 
+//passes an error response that has already been parsed to the delegate. nil if the response couldn't be parsed at all
+- (void)handleErrorDictionary:(NSDictionary *)errorDictionary responseData:(NSData *)data
+{
+	[self setRawResponseData:data];
 	
+	MKFacebookResponseError *responseError = [MKFacebookResponseError errorWithDictionary:errorDictionary];
+	DLog(@"Facebook Error Code: %lu", (unsigned long)responseError.errorCode);
+	DLog(@"Facebook Error Message: %@", responseError.errorMessage);
+	DLog(@"Facebook Error Arguments: %@", [responseError.requestArgs description]);
+	[self deliverError:responseError];
 	
-	if (self.responseFormat == MKFacebookRequestResponseFormatJSON && validResponse == YES) {
-		id returnJSON = [responseString JSONValue];
+	[_responseData setData:[NSData data]];
+	_requestIsDone = YES;
+}
 
-		if ([returnJSON isKindOfClass:[NSDictionary class]] || [returnJSON isKindOfClass:[NSArray class]]) {
+//0.6 suggestion to pass connection error.  Thanks Adam.
+-  (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error
+{	
+	[self releaseConnection];
+	[self reportAttemptFailed:YES];
+	[self handleConnectionError:error];
+	[[NSNotificationCenter defaultCenter] postNotificationName:@"MKFacebookRequestActivityEnded" object:self];
+}
 
-			//JSON returning a NSDictionary can be good or bad because errors are turned into dictionaries.
-			if ([returnJSON isKindOfClass:[NSDictionary class]])
-			{
-				//DLog(@"JSON response parsed to dictionary");
-				if ([returnJSON validFacebookResponse] == YES) {
-					validResponse = YES;
-				}else{
-					//DLog(@"invalid facebook response received");
-					validResponse = NO;
-					//exactly like the XML part, check for error 4, 1, or 2 (defined above in the XML handling part)
-					int errorInt = [[returnJSON valueForKey:@"error_code"] intValue];
-					if((errorInt == 4 || errorInt == 1 || errorInt == 2 ) && numberOfRequestAttempts <= _requestAttemptCount)
-					{
-						NSDate *sleepUntilDate = [[NSDate date] addTimeInterval:2.0];
-						[NSThread sleepUntilDate:sleepUntilDate];
-						[_responseData setData:[NSData data]];
-						_requestAttemptCount++;
-						DLog(@"Too many requests, waiting just a moment....%@", [self description]);
-						[self sendRequest];
-						return;
-					}
-					//DLog(@"I give up, the request has been attempted %i times but it just won't work. Here is the failed request: %@", _requestAttemptCount, [_parameters description]);
-
-				} //end checking / handling a NSDictionary for a valid or failed response
-				
-			}else if ([returnJSON isKindOfClass:[NSArray class]]) {
-				//if the JSON parses out to an array i think it can only mean it's valid...
-				validResponse = YES;
-			}
-			
-			//response appears to be valid, return it to the delegate either via a specified selector or the default selector
-			if (validResponse == YES) {
-				//DLog(@"JSON looks good, trying to pass back to the delegate");
-				if ([delegate respondsToSelector:selector]) {
-					[delegate performSelector:selector withObject:returnJSON];
-				}else if ([delegate respondsToSelector:defaultResponseSelector]) {
-					NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[delegate methodSignatureForSelector:defaultResponseSelector]];
-					[invocation setTarget:delegate];
-					[invocation setSelector:defaultResponseSelector];
-					[invocation setArgument:&self atIndex:2];
-					[invocation setArgument:&returnJSON atIndex:3];
-					[invocation invoke];
-				}else if ([delegate respondsToSelector:deprecatedResponseSelector]) {
-					[delegate performSelector:deprecatedResponseSelector withObject:returnJSON];
-				}		
-			}
-			
-			//DLog(@"returnJSON class: %@", [returnJSON className]);
-			//DLog(@"parsed JSON: %@", [returnJSON description]);
-		}
+
+- (void)handleConnectionError:(NSError *)error
+{
+	//a JSON response that failed part way has been parsed as it arrived, the job holds on to the request until it is dropped
+	[[MKFacebookParsePool sharedMKFacebookParsePool] cancelParsingForRequest:self];
+	[self deliverFailure:error];
+	_requestIsDone = YES;
+}
+
+
+//tells the circuit breaker how the attempt it let through went. batch parts and cached responses were never sent on their own and aren't counted
+- (void)reportAttemptFailed:(BOOL)failed
+{
+	if (_sentThroughCircuitBreaker == YES) {
+		_sentThroughCircuitBreaker = NO;
+		[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] request:self finishedWithFailure:failed];
 	}
+}
+
+
+- (void)deliverOpenCircuitFailure
+{
+	[self handleConnectionError:[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] openCircuitErrorForRequest:self]];
+}
+
+
+#pragma mark Delivering Results
+
+//every result goes through these three methods. requests waiting on this one's fetch get the same result, see MKFacebookRequestCoalescer
+- (void)deliverResponse:(id)response
+{
+	NSArray *waiters = [self finishCoalescedFetch];
 	
+	MKMarkTimestamp(MKFacebookRequestTimestampDelivering);
+	if (_detachedFromDelegate == NO) {
+		MKDelegateDispatchTable *dispatchTable = [self delegateDispatchTable];
+		IMP implementation = NULL;
+		if ((implementation = [dispatchTable implementationForSelector:selector delegate:delegate]) != NULL) {
+			((MKDelegateObjectIMP)implementation)(delegate, selector, response);
+		}else if ((implementation = [dispatchTable implementationForMessage:MKDelegateMessageResponseReceived delegate:delegate]) != NULL) {
+			((MKDelegateTwoObjectIMP)implementation)(delegate, @selector(facebookRequest:responseReceived:), self, response);
+		}else if ((implementation = [dispatchTable implementationForMessage:MKDelegateMessageDeprecatedResponseReceived delegate:delegate]) != NULL) {
+			((MKDelegateObjectIMP)implementation)(delegate, @selector(facebookResponseReceived:), response);
+		}
+		[self callCompletionHandlerWithResponse:response responseError:nil error:nil];
+	}
+	MKMarkTimestamp(MKFacebookRequestTimestampDelivered);
+	[self recordMetrics];
 	
+	for (MKFacebookRequest *waiter in waiters) {
+		[waiter deliverResponse:response];
+	}
+}
+
 
+- (void)deliverError:(MKFacebookResponseError *)responseError
+{
+	NSArray *waiters = [self finishCoalescedFetch];
 	
-	if (validResponse == NO) {
-		
-		MKFacebookResponseError *responseError = [MKFacebookResponseError errorFromRequest:self];
-		DLog(@"Facebook Error Code: %lu", (unsigned long)responseError.errorCode);
-		DLog(@"Facebook Error Message: %@", responseError.errorMessage);
-		DLog(@"Facebook Error Arguments: %@", [responseError.requestArgs description]);
-		
+	MKMarkTimestamp(MKFacebookRequestTimestampDelivering);
+	if (_detachedFromDelegate == NO) {
 		if ([self displayAPIErrorAlerts] == YES) {
 			NSString *errorString = @"Unknown Error";
 			
-			if (self.rawResponse == nil) {
+			//streamed responses keep no raw response, but their errors still have a code
+			if (self.rawResponse == nil && responseError.errorCode == 0) {
 				errorString = [NSString stringWithString:@"Facebook did not return any data that could be interpreted as JSON or XML. Services may be unavailable."];				
 			}else {
 				errorString = [NSString stringWithString:@"Facebook returned an error."];
@@ -545,57 +944,137 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 
 			MKErrorWindow *errorWindow = [MKErrorWindow errorWindowWithTitle:@"API Error" 
 																	 message:errorString 
-																	 details:rawResponse];
+																	 details:self.rawResponse];
 			[errorWindow display];
 		}
 
 		
 		//pass the error back to the delegate
-		if([delegate respondsToSelector:defaultErrorSelector])
-		{
-			
-			NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[delegate methodSignatureForSelector:defaultErrorSelector]];
-			[invocation setTarget:delegate];
-			[invocation setSelector:defaultErrorSelector];
-			[invocation setArgument:&self atIndex:2];
-			[invocation setArgument:&responseError atIndex:3];
-			[invocation invoke];
-		}else if ([delegate respondsToSelector:deprecatedErrorSelector]) {
-			[delegate performSelector:deprecatedErrorSelector withObject:rawResponse];
+		MKDelegateDispatchTable *dispatchTable = [self delegateDispatchTable];
+		IMP implementation = NULL;
+		if ((implementation = [dispatchTable implementationForMessage:MKDelegateMessageErrorReceived delegate:delegate]) != NULL) {
+			((MKDelegateTwoObjectIMP)implementation)(delegate, @selector(facebookRequest:errorReceived:), self, responseError);
+		}else if ((implementation = [dispatchTable implementationForMessage:MKDelegateMessageDeprecatedErrorReceived delegate:delegate]) != NULL) {
+			((MKDelegateObjectIMP)implementation)(delegate, @selector(facebookErrorResponseReceived:), self.rawResponse);
 		}
+		[self callCompletionHandlerWithResponse:nil responseError:responseError error:nil];
 	}
-		
-	
-	
-	[_responseData setData:[NSData data]];
-	_requestIsDone = YES;
+	MKMarkTimestamp(MKFacebookRequestTimestampDelivered);
+	[self recordMetrics];
 	
+	for (MKFacebookRequest *waiter in waiters) {
+		[waiter deliverError:responseError];
+	}
 }
 
-//0.6 suggestion to pass connection error.  Thanks Adam.
--  (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error
-{	
+
+- (void)deliverFailure:(NSError *)error
+{
+	NSArray *waiters = [self finishCoalescedFetch];
 	
-	if([self displayAPIErrorAlerts])
-	{
-		MKErrorWindow *errorWindow = [MKErrorWindow errorWindowWithTitle:@"Connection Error" message:@"Are you connected to the internet?" details:[[error userInfo] description]];
-		[errorWindow display];
+	MKMarkTimestamp(MKFacebookRequestTimestampDelivering);
+	if (_detachedFromDelegate == NO) {
+		if([self displayAPIErrorAlerts])
+		{
+			MKErrorWindow *errorWindow = [MKErrorWindow errorWindowWithTitle:@"Connection Error" message:@"Are you connected to the internet?" details:[[error userInfo] description]];
+			[errorWindow display];
+		}
+		
+		MKDelegateDispatchTable *dispatchTable = [self delegateDispatchTable];
+		IMP implementation = NULL;
+		if ((implementation = [dispatchTable implementationForMessage:MKDelegateMessageFailed delegate:delegate]) != NULL) {
+			((MKDelegateTwoObjectIMP)implementation)(delegate, @selector(facebookRequest:failed:), self, error);
+		}else if ((implementation = [dispatchTable implementationForMessage:MKDelegateMessageDeprecatedFailed delegate:delegate]) != NULL) {
+			((MKDelegateObjectIMP)implementation)(delegate, @selector(facebookRequestFailed:), error);
+		}
+		[self callCompletionHandlerWithResponse:nil responseError:nil error:error];
 	}
+	MKMarkTimestamp(MKFacebookRequestTimestampDelivered);
+	[self recordMetrics];
 	
-	if([delegate respondsToSelector:defaultFailedSelector])
-	{
-		NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[delegate methodSignatureForSelector:defaultFailedSelector]];
-		[invocation setTarget:delegate];
-		[invocation setSelector:defaultFailedSelector];
-		[invocation setArgument:&self atIndex:2];
-		[invocation setArgument:&error atIndex:3];
-		[invocation invoke];
-	}else if ([delegate respondsToSelector:deprecatedFailedSelector]) {
-		[delegate performSelector:deprecatedFailedSelector withObject:error];
+	for (MKFacebookRequest *waiter in waiters) {
+		[waiter deliverFailure:error];
 	}
-		
+}
+
+
+//the delegate methods are looked up once per delegate class, see MKDelegateDispatchTable
+- (MKDelegateDispatchTable *)delegateDispatchTable
+{
+	return [MKDelegateDispatchTable dispatchTableForDelegate:delegate cachedTable:&_delegateDispatchTable];
+}
+
+
+//hands the timestamps of the attempt that just ended to MKFacebookRequestMetrics. cached responses and requests waiting on another request's fetch never started an attempt
+- (void)recordMetrics
+{
+	if (MKFacebookRequestMetricsEnabled == YES && _timestamps[MKFacebookRequestTimestampStart] != 0) {
+		uint64_t firstAttemptStart = _timestamps[MKFacebookRequestTimestampDelivered] != 0 ? _firstAttemptTimestamp : 0;
+		[[MKFacebookRequestMetrics sharedMKFacebookRequestMetrics] recordTimestamps:_timestamps firstAttemptStart:firstAttemptStart forMethod:method];
+	}
+	memset(_timestamps, 0, sizeof(_timestamps));
+}
+
+
+- (void)callCompletionHandlerWithResponse:(id)response responseError:(MKFacebookResponseError *)responseError error:(NSError *)error
+{
+#if NS_BLOCKS_AVAILABLE
+	if (_completionHandler != nil) {
+		//called once per request, letting go of it releases whatever it captured. the handler may release the request
+		MKFacebookRequestCompletionHandler handler = [_completionHandler autorelease];
+		_completionHandler = nil;
+		handler(self, response, responseError, error);
+	}
+#endif
+}
+
+
+- (void)deliverCachedResponse:(id)response
+{
+	_requestIsDone = YES;
+	[self deliverResponse:response];
+}
+
+
+- (void)cacheLookup:(id)lookup didFindResponse:(id)response responseData:(NSData *)data
+{
+	//the request has been cancelled or sent again since the lookup started
+	if (lookup != _cacheLookup) {
+		return;
+	}
+	[_cacheLookup autorelease];
+	_cacheLookup = nil;
 	
-	[[NSNotificationCenter defaultCenter] postNotificationName:@"MKFacebookRequestActivityEnded" object:self];
+	if (response != nil) {
+		[self setRawResponseData:data];
+		[self deliverCachedResponse:response];
+	} else {
+		[self sendUncachedRequest];
+	}
+}
+
+
+//ends a coalesced fetch led by this request and hands the raw response to the requests that were waiting on it
+- (NSArray *)finishCoalescedFetch
+{
+	NSArray *waiters = [[MKFacebookRequestCoalescer sharedMKFacebookRequestCoalescer] finishRequest:self];
+	for (MKFacebookRequest *waiter in waiters) {
+		[waiter setRawResponseData:_rawResponseData];
+		waiter->_requestIsDone = YES;
+	}
+	return waiters;
+}
+#pragma mark -
+
+
+//NSURLConnection needs to send a streamed body again, i.e. after a redirect
+- (NSInputStream *)connection:(NSURLConnection *)connection needNewBodyStream:(NSURLRequest *)request
+{
+	NSInputStream *bodyStream = [request HTTPBodyStream];
+	if ([bodyStream isKindOfClass:[MKMultipartInputStream class]]) {
+		return [(MKMultipartInputStream *)bodyStream unopenedCopy];
+	}
+	return nil;
 }
 
 
@@ -603,16 +1082,9 @@ NSString *MKFacebookRequestActivityEnded = @"MKFacebookRequestActivityEnded";
 - (void)connection:(NSURLConnection *)connection didSendBodyData:(NSInteger)bytesWritten 
 											   totalBytesWritten:(NSInteger)totalBytesWritten 
 									   totalBytesExpectedToWrite:(NSInteger)totalBytesExpectedToWrite{
-	SEL forwardSelector = @selector(facebookRequest:bytesWritten:totalBytesWritten:totalBytesExpectedToWrite:);
-	if ([delegate respondsToSelector:forwardSelector]) {
-		NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[delegate methodSignatureForSelector:forwardSelector]];
-		[invocation setTarget:delegate];
-		[invocation setSelector:forwardSelector];
-		[invocation setArgument:&self atIndex:2];
-		[invocation setArgument:&bytesWritten atIndex:3];
-		[invocation setArgument:&totalBytesWritten atIndex:4];
-		[invocation setArgument:&totalBytesExpectedToWrite atIndex:5];
-		[invocation invoke];
+	IMP implementation = [[self delegateDispatchTable] implementationForMessage:MKDelegateMessageBytesWritten delegate:delegate];
+	if (implementation != NULL) {
+		((MKDelegateProgressIMP)implementation)(delegate, @selector(facebookRequest:bytesWritten:totalBytesWritten:totalBytesExpectedToWrite:), self, bytesWritten, totalBytesWritten, totalBytesExpectedToWrite);
 	}
 }
 
@@ -0,0 +1,45 @@
+//
+//  MKFacebookRequestCoalescer.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "SynthesizeSingleton.h"
+
+@class MKFacebookRequest;
+
+/*
+ Keeps track of the reads that are loading so identical requests can share one connection.
+
+ The first request for a key leads the fetch, requests sent while it loads wait on it and receive the same result when the leader delivers. Used by MKFacebookRequest, see coalescesRequests.
+ */
+@interface MKFacebookRequestCoalescer : NSObject {
+	NSMutableDictionary *_fetches;
+}
+
++ (MKFacebookRequestCoalescer *)sharedMKFacebookRequestCoalescer;
+
+/*
+ Canonical key made of endpoint, method, response format and sorted parameters. nil if the request isn't a read or has parameters that can't be compared.
+ */
++ (NSString *)keyForRequest:(MKFacebookRequest *)request;
+
+/*
+ Returns YES if an identical request is loading and the request now waits on it. Otherwise the request leads a new fetch and should be sent.
+ */
+- (BOOL)attachRequest:(MKFacebookRequest *)request;
+
+/*
+ Called when a request delivers its result. Returns the requests waiting on it, nil if it isn't leading a fetch.
+ */
+- (NSArray *)finishRequest:(MKFacebookRequest *)request;
+
+/*
+ Returns YES if the cancel was handled here: a waiting request was removed, or the request leads a fetch other requests still wait on and keeps loading for them. NO if the request should cancel its connection itself.
+ */
+- (BOOL)cancelRequest:(MKFacebookRequest *)request;
+
+@end
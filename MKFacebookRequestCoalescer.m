@@ -0,0 +1,208 @@
+//
+//  MKFacebookRequestCoalescer.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookRequestCoalescer.h"
+#import "MKFacebookRequestPrivate.h"
+
+
+//one connection and the requests waiting on it
+@interface MKFacebookCoalescedFetch : NSObject {
+@public
+	NSString *key;
+	MKFacebookRequest *leader;
+	NSMutableArray *waiters;
+	BOOL leaderCancelled;
+}
+@end
+
+@implementation MKFacebookCoalescedFetch
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		waiters = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[key release];
+	[leader release];
+	[waiters release];
+	[super dealloc];
+}
+
+@end
+
+
+@interface MKFacebookRequestCoalescer (Private)
++ (BOOL)isReadMethod:(NSString *)aMethod;
+- (MKFacebookCoalescedFetch *)fetchLedByRequest:(MKFacebookRequest *)request;
+- (MKFacebookCoalescedFetch *)fetchWaitedOnByRequest:(MKFacebookRequest *)request;
+- (void)removeFetch:(MKFacebookCoalescedFetch *)fetch;
+@end
+
+
+@implementation MKFacebookRequestCoalescer
+
+SYNTHESIZE_SINGLETON_FOR_CLASS(MKFacebookRequestCoalescer);
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_fetches = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+
++ (NSString *)keyForRequest:(MKFacebookRequest *)request
+{
+	if (request.method == nil || [self isReadMethod:request.method] == NO) {
+		return nil;
+	}
+
+	NSDictionary *params = [request parameters];
+	NSMutableString *key = [NSMutableString stringWithFormat:@"%@%@\n%d", [request requestURL], request.method, request.responseFormat];
+	for (NSString *name in [[params allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+		//added to every request when it is sent, they don't tell requests apart
+		if ([name isEqualToString:@"access_token"] || [name isEqualToString:@"format"]) {
+			continue;
+		}
+		id value = [params objectForKey:name];
+		if ([value isKindOfClass:[NSArray class]]) {
+			value = [value componentsJoinedByString:@","];
+		} else if (![value isKindOfClass:[NSString class]] && ![value isKindOfClass:[NSNumber class]]) {
+			return nil;
+		}
+		[key appendFormat:@"\n%@=%@", name, value];
+	}
+	return key;
+}
+
+
+- (BOOL)attachRequest:(MKFacebookRequest *)request
+{
+	NSString *key = [MKFacebookRequestCoalescer keyForRequest:request];
+	if (key == nil) {
+		return NO;
+	}
+
+	@synchronized(self) {
+		MKFacebookCoalescedFetch *fetch = [_fetches objectForKey:key];
+		if (fetch != nil && fetch->leader != request && [fetch->waiters indexOfObjectIdenticalTo:request] == NSNotFound) {
+			DLog(@"%@ is already loading, waiting for the same response", request.method);
+			[fetch->waiters addObject:request];
+			return YES;
+		}
+		if (fetch == nil) {
+			fetch = [[[MKFacebookCoalescedFetch alloc] init] autorelease];
+			fetch->key = [key copy];
+			fetch->leader = [request retain];
+			[_fetches setObject:fetch forKey:key];
+		}
+	}
+	return NO;
+}
+
+
+- (NSArray *)finishRequest:(MKFacebookRequest *)request
+{
+	NSArray *waiters = nil;
+	@synchronized(self) {
+		MKFacebookCoalescedFetch *fetch = [self fetchLedByRequest:request];
+		if (fetch != nil) {
+			waiters = [[fetch->waiters copy] autorelease];
+			[self removeFetch:fetch];
+		}
+	}
+	return waiters;
+}
+
+
+- (BOOL)cancelRequest:(MKFacebookRequest *)request
+{
+	MKFacebookRequest *abandonedLeader = nil;
+	BOOL detachLeader = NO;
+	BOOL handled = NO;
+
+	@synchronized(self) {
+		MKFacebookCoalescedFetch *fetch = [self fetchWaitedOnByRequest:request];
+		if (fetch != nil) {
+			[fetch->waiters removeObjectIdenticalTo:request];
+			//nobody wants the response anymore, stop loading it
+			if (fetch->leaderCancelled == YES && [fetch->waiters count] == 0) {
+				abandonedLeader = [[fetch->leader retain] autorelease];
+				[self removeFetch:fetch];
+			}
+			handled = YES;
+		} else if ((fetch = [self fetchLedByRequest:request]) != nil) {
+			if ([fetch->waiters count] > 0) {
+				fetch->leaderCancelled = YES;
+				detachLeader = YES;
+				handled = YES;
+			} else {
+				[self removeFetch:fetch];
+			}
+		}
+	}
+
+	if (detachLeader == YES) {
+		[request detachFromDelegate];
+	}
+	[abandonedLeader cancelConnection];
+	return handled;
+}
+
+
+#pragma mark Private Methods
+
+//only reads are safe to share, anything that changes data on Facebook must be sent every time
++ (BOOL)isReadMethod:(NSString *)aMethod
+{
+	NSRange dot = [aMethod rangeOfString:@"." options:NSBackwardsSearch];
+	NSString *name = dot.location != NSNotFound ? [aMethod substringFromIndex:dot.location + 1] : aMethod;
+	return [name hasPrefix:@"get"] || [aMethod isEqualToString:@"fql.query"];
+}
+
+
+//callers hold the lock
+- (MKFacebookCoalescedFetch *)fetchLedByRequest:(MKFacebookRequest *)request
+{
+	for (MKFacebookCoalescedFetch *fetch in [_fetches objectEnumerator]) {
+		if (fetch->leader == request) {
+			return fetch;
+		}
+	}
+	return nil;
+}
+
+
+- (MKFacebookCoalescedFetch *)fetchWaitedOnByRequest:(MKFacebookRequest *)request
+{
+	for (MKFacebookCoalescedFetch *fetch in [_fetches objectEnumerator]) {
+		if ([fetch->waiters indexOfObjectIdenticalTo:request] != NSNotFound) {
+			return fetch;
+		}
+	}
+	return nil;
+}
+
+
+- (void)removeFetch:(MKFacebookCoalescedFetch *)fetch
+{
+	//the dictionary holds the last reference to the fetch and its key
+	[[fetch retain] autorelease];
+	[_fetches removeObjectForKey:fetch->key];
+}
+
+@end
@@ -0,0 +1,116 @@
+//
+//  MKFacebookRequestMetrics.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "SynthesizeSingleton.h"
+
+/*
+ Moments in the life of a request attempt, recorded by MKFacebookRequest with mach_absolute_time().
+ */
+enum MKFacebookRequestTimestamp
+{
+	MKFacebookRequestTimestampStart,		//startRequest
+	MKFacebookRequestTimestampBuilt,		//URL request and body assembled
+	MKFacebookRequestTimestampResponse,		//response headers, only with transports that report them
+	MKFacebookRequestTimestampFirstByte,
+	MKFacebookRequestTimestampLastByte,
+	MKFacebookRequestTimestampParsed,
+	MKFacebookRequestTimestampDelivering,
+	MKFacebookRequestTimestampDelivered,
+	MKFacebookRequestTimestampCount
+};
+typedef int MKFacebookRequestTimestamp;
+
+//phases, the keys of each method's dictionary in snapshot
+extern NSString *MKFacebookRequestPhaseBuildKey;
+extern NSString *MKFacebookRequestPhaseConnectKey;
+extern NSString *MKFacebookRequestPhaseFirstByteKey;
+extern NSString *MKFacebookRequestPhaseTransferKey;
+extern NSString *MKFacebookRequestPhaseParseKey;
+extern NSString *MKFacebookRequestPhaseDelegateKey;
+extern NSString *MKFacebookRequestPhaseTotalKey;
+
+//statistics of a phase, NSNumbers in seconds except for the count
+extern NSString *MKFacebookRequestMetricsCountKey;
+extern NSString *MKFacebookRequestMetricsMeanKey;
+extern NSString *MKFacebookRequestMetricsMinimumKey;
+extern NSString *MKFacebookRequestMetricsMaximumKey;
+extern NSString *MKFacebookRequestMetricsP50Key;
+extern NSString *MKFacebookRequestMetricsP95Key;
+extern NSString *MKFacebookRequestMetricsP99Key;
+
+//read by MKFacebookRequest before it takes a timestamp, change it with the enabled property
+extern BOOL MKFacebookRequestMetricsEnabled;
+
+
+/*!
+ @class MKFacebookRequestMetrics
+
+ Shared latency histograms, one set per Facebook method, showing where the time of a request goes.
+
+ Every attempt of a request is split into phases:
+ - build: parameters and multipart body assembled into a URL request
+ - connect: until the response headers arrive, or the first byte for transports that don't report headers
+ - first byte: from the response headers to the first byte of the body
+ - transfer: from the first to the last byte
+ - parse: from the last byte until the response has been parsed and checked for errors, including the wait for MKFacebookParsePool
+ - delegate: time spent in the delegate callback and completion handler
+ - total: from the first attempt of a request until its delegate returned, retries and waits included
+
+ Each phase goes into a histogram whose buckets split every power of two of microseconds in four, from a microsecond up to more than a day, so percentiles are accurate to within about 12%. Responses answered from MKFacebookResponseCache and requests waiting on another request's fetch are not recorded.
+
+ Collection is off by default and costs a single flag check per phase while it is off:
+
+ @verbatim
+ [[MKFacebookRequestMetrics sharedMKFacebookRequestMetrics] setEnabled:YES];
+ ...
+ NSDictionary *snapshot = [[MKFacebookRequestMetrics sharedMKFacebookRequestMetrics] snapshot];
+ NSNumber *p95 = [[[snapshot objectForKey:@"photos.get"] objectForKey:MKFacebookRequestPhaseTotalKey] objectForKey:MKFacebookRequestMetricsP95Key];
+ @endverbatim
+
+ @version 0.9 and later
+ */
+@interface MKFacebookRequestMetrics : NSObject {
+	NSMutableDictionary *_methods;
+	double _secondsPerTick;
+}
+
++ (MKFacebookRequestMetrics *)sharedMKFacebookRequestMetrics;
+
+/*!
+ @brief Record timings. Default is NO.
+ */
+@property BOOL enabled;
+
+/*!
+ @brief Latency statistics of every method seen since the last reset.
+
+ The keys are method names, the values dictionaries keyed by phase (MKFacebookRequestPhaseBuildKey and so on). Each phase is a dictionary with MKFacebookRequestMetricsCountKey, MKFacebookRequestMetricsMeanKey, MKFacebookRequestMetricsMinimumKey, MKFacebookRequestMetricsMaximumKey, MKFacebookRequestMetricsP50Key, MKFacebookRequestMetricsP95Key and MKFacebookRequestMetricsP99Key. Phases that were never recorded are left out.
+ */
+- (NSDictionary *)snapshot;
+
+/*!
+ @brief Take a snapshot and empty the histograms in one step, so no timing is lost or counted twice.
+ */
+- (NSDictionary *)snapshotAndReset;
+
+/*!
+ @brief Empty the histograms.
+ */
+- (void)reset;
+
+/*!
+ @brief Add the timestamps of one attempt. Called by MKFacebookRequest.
+
+ @param timestamps MKFacebookRequestTimestampCount values from mach_absolute_time(), 0 for moments that didn't happen.
+
+ @param firstAttemptStart When the first attempt of the request started, 0 if the total shouldn't be recorded.
+ */
+- (void)recordTimestamps:(const uint64_t *)timestamps firstAttemptStart:(uint64_t)firstAttemptStart forMethod:(NSString *)aMethod;
+
+@end
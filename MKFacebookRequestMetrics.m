@@ -0,0 +1,269 @@
+//
+//  MKFacebookRequestMetrics.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookRequestMetrics.h"
+#include <mach/mach_time.h>
+
+NSString *MKFacebookRequestPhaseBuildKey = @"MKFacebookRequestPhaseBuild";
+NSString *MKFacebookRequestPhaseConnectKey = @"MKFacebookRequestPhaseConnect";
+NSString *MKFacebookRequestPhaseFirstByteKey = @"MKFacebookRequestPhaseFirstByte";
+NSString *MKFacebookRequestPhaseTransferKey = @"MKFacebookRequestPhaseTransfer";
+NSString *MKFacebookRequestPhaseParseKey = @"MKFacebookRequestPhaseParse";
+NSString *MKFacebookRequestPhaseDelegateKey = @"MKFacebookRequestPhaseDelegate";
+NSString *MKFacebookRequestPhaseTotalKey = @"MKFacebookRequestPhaseTotal";
+
+NSString *MKFacebookRequestMetricsCountKey = @"MKFacebookRequestMetricsCount";
+NSString *MKFacebookRequestMetricsMeanKey = @"MKFacebookRequestMetricsMean";
+NSString *MKFacebookRequestMetricsMinimumKey = @"MKFacebookRequestMetricsMinimum";
+NSString *MKFacebookRequestMetricsMaximumKey = @"MKFacebookRequestMetricsMaximum";
+NSString *MKFacebookRequestMetricsP50Key = @"MKFacebookRequestMetricsP50";
+NSString *MKFacebookRequestMetricsP95Key = @"MKFacebookRequestMetricsP95";
+NSString *MKFacebookRequestMetricsP99Key = @"MKFacebookRequestMetricsP99";
+
+BOOL MKFacebookRequestMetricsEnabled = NO;
+
+enum
+{
+	MKPhaseBuild,
+	MKPhaseConnect,
+	MKPhaseFirstByte,
+	MKPhaseTransfer,
+	MKPhaseParse,
+	MKPhaseDelegate,
+	MKPhaseTotal,
+	MKPhaseCount
+};
+
+//bucket 0 holds durations under a microsecond. after that every power of two of microseconds is split in 4 buckets, the last one holds everything from about 38 hours up
+#define MKHistogramMaximumExponent 37
+#define MKHistogramBucketCount (1 + (MKHistogramMaximumExponent + 1) * 4)
+
+typedef struct MKLatencyHistogram {
+	uint32_t counts[MKHistogramBucketCount];
+	uint64_t count;
+	double sum;
+	double minimum;
+	double maximum;
+} MKLatencyHistogram;
+
+
+static NSUInteger MKHistogramBucketForSeconds(double seconds)
+{
+	uint64_t microseconds = (uint64_t)(seconds * 1000000.0);
+	if (microseconds == 0) {
+		return 0;
+	}
+	NSUInteger exponent = 0;
+	while ((microseconds >> (exponent + 1)) != 0) {
+		exponent++;
+	}
+	if (exponent > MKHistogramMaximumExponent) {
+		return MKHistogramBucketCount - 1;
+	}
+	//the two bits after the leading one pick the quarter
+	NSUInteger quarter = exponent >= 2 ? (NSUInteger)((microseconds >> (exponent - 2)) & 3) : (NSUInteger)((microseconds << (2 - exponent)) & 3);
+	return 1 + exponent * 4 + quarter;
+}
+
+
+//middle of the range a bucket covers
+static double MKHistogramSecondsForBucket(NSUInteger bucket)
+{
+	if (bucket == 0) {
+		return 0.0000005;
+	}
+	NSUInteger exponent = (bucket - 1) / 4;
+	NSUInteger quarter = (bucket - 1) % 4;
+	double lower = ldexp(1.0 + quarter / 4.0, (int)exponent);
+	return (lower + ldexp(0.125, (int)exponent)) / 1000000.0;
+}
+
+
+static void MKHistogramAdd(MKLatencyHistogram *histogram, double seconds)
+{
+	histogram->counts[MKHistogramBucketForSeconds(seconds)]++;
+	if (histogram->count == 0 || seconds < histogram->minimum) {
+		histogram->minimum = seconds;
+	}
+	if (histogram->count == 0 || seconds > histogram->maximum) {
+		histogram->maximum = seconds;
+	}
+	histogram->count++;
+	histogram->sum += seconds;
+}
+
+
+static double MKHistogramPercentile(MKLatencyHistogram *histogram, double percentile)
+{
+	uint64_t rank = (uint64_t)ceil(percentile * histogram->count);
+	if (rank == 0) {
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	NSUInteger bucket;
+	for (bucket = 0; bucket < MKHistogramBucketCount; bucket++) {
+		seen += histogram->counts[bucket];
+		if (seen >= rank) {
+			break;
+		}
+	}
+	//the bucket middle can lie outside what was actually measured
+	double seconds = MKHistogramSecondsForBucket(bucket);
+	return MIN(MAX(seconds, histogram->minimum), histogram->maximum);
+}
+
+
+//the histograms of one method
+@interface MKFacebookMethodMetrics : NSObject {
+@public
+	MKLatencyHistogram histograms[MKPhaseCount];
+}
+- (NSDictionary *)dictionary;
+@end
+
+@implementation MKFacebookMethodMetrics
+
+- (NSDictionary *)dictionary
+{
+	NSString *phaseKeys[MKPhaseCount] = {
+		MKFacebookRequestPhaseBuildKey,
+		MKFacebookRequestPhaseConnectKey,
+		MKFacebookRequestPhaseFirstByteKey,
+		MKFacebookRequestPhaseTransferKey,
+		MKFacebookRequestPhaseParseKey,
+		MKFacebookRequestPhaseDelegateKey,
+		MKFacebookRequestPhaseTotalKey
+	};
+
+	NSMutableDictionary *phases = [NSMutableDictionary dictionaryWithCapacity:MKPhaseCount];
+	NSUInteger phase;
+	for (phase = 0; phase < MKPhaseCount; phase++) {
+		MKLatencyHistogram *histogram = &histograms[phase];
+		if (histogram->count == 0) {
+			continue;
+		}
+		[phases setObject:[NSDictionary dictionaryWithObjectsAndKeys:
+						   [NSNumber numberWithUnsignedLongLong:histogram->count], MKFacebookRequestMetricsCountKey,
+						   [NSNumber numberWithDouble:histogram->sum / histogram->count], MKFacebookRequestMetricsMeanKey,
+						   [NSNumber numberWithDouble:histogram->minimum], MKFacebookRequestMetricsMinimumKey,
+						   [NSNumber numberWithDouble:histogram->maximum], MKFacebookRequestMetricsMaximumKey,
+						   [NSNumber numberWithDouble:MKHistogramPercentile(histogram, 0.50)], MKFacebookRequestMetricsP50Key,
+						   [NSNumber numberWithDouble:MKHistogramPercentile(histogram, 0.95)], MKFacebookRequestMetricsP95Key,
+						   [NSNumber numberWithDouble:MKHistogramPercentile(histogram, 0.99)], MKFacebookRequestMetricsP99Key,
+						   nil]
+				   forKey:phaseKeys[phase]];
+	}
+	return phases;
+}
+
+@end
+
+
+@interface MKFacebookRequestMetrics (Private)
+- (void)addPhase:(NSUInteger)phase from:(uint64_t)start to:(uint64_t)end metrics:(MKFacebookMethodMetrics *)metrics;
+@end
+
+
+@implementation MKFacebookRequestMetrics
+
+SYNTHESIZE_SINGLETON_FOR_CLASS(MKFacebookRequestMetrics);
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_methods = [[NSMutableDictionary alloc] init];
+		mach_timebase_info_data_t timebase;
+		mach_timebase_info(&timebase);
+		_secondsPerTick = (double)timebase.numer / timebase.denom / 1000000000.0;
+	}
+	return self;
+}
+
+
+- (BOOL)enabled
+{
+	return MKFacebookRequestMetricsEnabled;
+}
+
+
+- (void)setEnabled:(BOOL)aBool
+{
+	MKFacebookRequestMetricsEnabled = aBool;
+}
+
+
+- (NSDictionary *)snapshot
+{
+	NSMutableDictionary *snapshot = [NSMutableDictionary dictionary];
+	@synchronized(self) {
+		for (NSString *aMethod in _methods) {
+			[snapshot setObject:[[_methods objectForKey:aMethod] dictionary] forKey:aMethod];
+		}
+	}
+	return snapshot;
+}
+
+
+- (NSDictionary *)snapshotAndReset
+{
+	@synchronized(self) {
+		NSDictionary *snapshot = [self snapshot];
+		[self reset];
+		return snapshot;
+	}
+	return nil;
+}
+
+
+- (void)reset
+{
+	@synchronized(self) {
+		[_methods removeAllObjects];
+	}
+}
+
+
+- (void)recordTimestamps:(const uint64_t *)timestamps firstAttemptStart:(uint64_t)firstAttemptStart forMethod:(NSString *)aMethod
+{
+	if (aMethod == nil) {
+		aMethod = @"unknown";
+	}
+
+	@synchronized(self) {
+		MKFacebookMethodMetrics *metrics = [_methods objectForKey:aMethod];
+		if (metrics == nil) {
+			metrics = [[[MKFacebookMethodMetrics alloc] init] autorelease];
+			[_methods setObject:metrics forKey:aMethod];
+		}
+
+		uint64_t response = timestamps[MKFacebookRequestTimestampResponse];
+		[self addPhase:MKPhaseBuild from:timestamps[MKFacebookRequestTimestampStart] to:timestamps[MKFacebookRequestTimestampBuilt] metrics:metrics];
+		//without response headers connecting lasts until the first byte
+		[self addPhase:MKPhaseConnect from:timestamps[MKFacebookRequestTimestampBuilt] to:response != 0 ? response : timestamps[MKFacebookRequestTimestampFirstByte] metrics:metrics];
+		[self addPhase:MKPhaseFirstByte from:response to:timestamps[MKFacebookRequestTimestampFirstByte] metrics:metrics];
+		[self addPhase:MKPhaseTransfer from:timestamps[MKFacebookRequestTimestampFirstByte] to:timestamps[MKFacebookRequestTimestampLastByte] metrics:metrics];
+		[self addPhase:MKPhaseParse from:timestamps[MKFacebookRequestTimestampLastByte] to:timestamps[MKFacebookRequestTimestampParsed] metrics:metrics];
+		[self addPhase:MKPhaseDelegate from:timestamps[MKFacebookRequestTimestampDelivering] to:timestamps[MKFacebookRequestTimestampDelivered] metrics:metrics];
+		[self addPhase:MKPhaseTotal from:firstAttemptStart to:timestamps[MKFacebookRequestTimestampDelivered] metrics:metrics];
+	}
+}
+
+
+#pragma mark Private Methods
+
+//phases whose start or end didn't happen in this attempt are left out
+- (void)addPhase:(NSUInteger)phase from:(uint64_t)start to:(uint64_t)end metrics:(MKFacebookMethodMetrics *)metrics
+{
+	if (start == 0 || end == 0 || end < start) {
+		return;
+	}
+	MKHistogramAdd(&metrics->histograms[phase], (end - start) * _secondsPerTick);
+}
+
+@end
@@ -0,0 +1,46 @@
+//
+//  MKFacebookRequestPrivate.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookRequest.h"
+
+//stands in for the response of a request with a streamingDelegate, which has been handed out as it was parsed
+#define MKFacebookStreamedResponse [NSNull null]
+
+//methods shared between MKFacebookRequest and the classes that send requests on its behalf. not part of the public API.
+@interface MKFacebookRequest (Private)
+- (NSString *)generateFacebookMethodURL;
+- (BOOL)scheduleRetryForErrorCode:(int)errorCode;
+- (NSTimeInterval)nextRetryDelay;
+- (void)retryRequest;
+- (void)sendUncachedRequest;
+- (void)beginRequest;
+- (BOOL)requestIsDone;
+- (void)startRequest;
+- (void)handleResponseData:(NSData *)data allowRetry:(BOOL)allowRetry;
+- (id)parseResponseData:(NSData *)data;
+- (id)validResponseFromParsedResponse:(id)parsedResponse errorDictionary:(NSDictionary **)errorDictionary;
+- (void)handleParsedResponse:(id)response errorDictionary:(NSDictionary *)errorDictionary data:(NSData *)data allowRetry:(BOOL)allowRetry;
+- (void)handleErrorDictionary:(NSDictionary *)errorDictionary responseData:(NSData *)data;
+- (void)setRawResponseData:(NSData *)data;
+- (NSData *)rawResponseData;
+- (void)handleConnectionError:(NSError *)error;
+- (void)reportAttemptFailed:(BOOL)failed;
+- (void)deliverOpenCircuitFailure;
+- (void)cancelConnection;
+- (void)releaseConnection;
+- (void)detachFromDelegate;
+- (void)deliverResponse:(id)response;
+- (void)deliverError:(MKFacebookResponseError *)responseError;
+- (void)deliverFailure:(NSError *)error;
+- (void)deliverCachedResponse:(id)response;
+- (void)cacheLookup:(id)lookup didFindResponse:(id)response responseData:(NSData *)data;
+- (MKDelegateDispatchTable *)delegateDispatchTable;
+- (void)recordMetrics;
+- (void)callCompletionHandlerWithResponse:(id)response responseError:(MKFacebookResponseError *)responseError error:(NSError *)error;
+- (NSArray *)finishCoalescedFetch;
+@end
@@ -23,7 +23,11 @@
  @brief Sends series of requests to Facebook
  
  @class MKFacebookRequestQueue
-  This class is used to send a series of requests to the Facebook API.  Requests are sent sequentially and do not begin until the previous request has been completed.  This class is useful for sending multiple photo uploads or when you need to ensure you have information from one request before processing another.
+  This class is used to send a series of requests to the Facebook API.  By default requests are sent sequentially and do not begin until the previous request has been completed.  This class is useful for sending multiple photo uploads or when you need to ensure you have information from one request before processing another.
+ 
+ Set maxConcurrentRequests to a value greater than 1 to keep several requests in flight at once. Requests start by priority, see below, and responses may arrive in any order. Use indexOfRequest: to match a response to the position of its request in the queue.
+ 
+ Requests with a higher priority start first, see MKFacebookRequestPriority. Interactive requests start as soon as they are added to a running queue, without waiting for the pause between requests. Besides the maxConcurrentRequests slots they may use reservedInteractiveRequests slots of their own, so they don't wait for a slow request to finish, but a burst of them is still bounded. Background requests can be held to fewer slots with maxConcurrentBackgroundRequests so they never crowd out normal requests. Requests of the same priority start in the order they were added.
  
  
  Note: The queue will override all delegate / selector settings on the individual requests. The queue pass all request responses back to the delegate accordingly via the MKFacebookRequestDelegate protocol.
@@ -33,12 +37,24 @@
   @version 0.7 and later
  */
 @interface MKFacebookRequestQueue : NSObject <MKFacebookRequestDelegate> {
-	NSMutableArray *_requestsArray;
+	struct MKQueuedRequest *_pendingRequests; //binary heap, highest priority and earliest added first
+	NSUInteger _pendingCount;
+	NSUInteger _pendingCapacity;
+	NSMapTable *_pendingPositions;
+	NSMapTable *_requestNumbers;
+	NSUInteger _requestCount;
 	id _delegate;
-	int _currentRequest;
+	BOOL _queueRunning;
 	BOOL _cancelRequestQueue;
 	float _timeBetweenRequests;
 	BOOL _shouldPauseBetweenRequests;
+	NSUInteger _maxConcurrentRequests;
+	NSMutableArray *_activeRequests;
+	NSMutableArray *_activeBackgroundRequests;
+	NSUInteger _maxConcurrentBackgroundRequests;
+	NSUInteger _reservedInteractiveRequests;
+	NSUInteger _scheduledRequests;
+	MKDelegateDispatchTable *_delegateDispatchTable;
 }
 
 
@@ -90,6 +106,8 @@
  
  @param request MKFacebookRequest object that is ready to be sent.
  
+ The request is placed by its priority. When the queue is already running the request starts as soon as a slot is free, interactive requests start right away.
+ 
  @warning Requests added to the queue will not send delegate messages back to custom selectors set on MKFacebookRequest objects. Use the MKFacebookRequestDelegate protocol to receive responses.
  
  @see setRequests:
@@ -98,10 +116,28 @@
  */
 - (void)addRequest:(MKFacebookRequest *)request;
 
+/*!
+ @brief Remove a request from the queue.
+ 
+ A request that hasn't started yet is dropped, a request that is loading is cancelled. The delegate hears nothing more about it.
+ 
+ @version 0.9 and later
+ */
+- (void)removeRequest:(MKFacebookRequest *)request;
+
+/*!
+ @brief Change the priority of a request in the queue.
+ 
+ A request that hasn't started yet keeps its place among requests of its new priority that were added before it. A request that is loading keeps loading, its new priority only decides whether it counts towards maxConcurrentBackgroundRequests. Setting the priority property of a request that is in the queue has no effect, use this method instead.
+ 
+ @version 0.9 and later
+ */
+- (void)setPriority:(MKFacebookRequestPriority)priority forRequest:(MKFacebookRequest *)request;
+
 /*!
   @brief Starts processing the request queue.
 
-  Requests in the queue will be sent to Facebook in the same order they were added. You can receive response information from each request by implementing the MKFacebookRequestDelegate methods in your queue delegate.
+  Requests in the queue are sent to Facebook by priority, requests of the same priority in the order they were added. You can receive response information from each request by implementing the MKFacebookRequestDelegate methods in your queue delegate.
  
   See the MKFacebookRequestQueueDelegate documentation for receiving information about the progress of the queue.
  
@@ -112,7 +148,7 @@
 - (void)startRequestQueue;
 
 /*!
- Set whether or not queue should automatically pause between requests in order to try to prevent the too many requests error.  Default is NO.
+ Set whether or not queue should automatically pause between requests in order to try to prevent the too many requests error.  The pause is scheduled on the run loop and does not block the thread.  Default is NO.
  @param aBool Should we wait or should we go now?
  @version 0.8 and later
  */
@@ -131,10 +167,69 @@
  @version 0.8 and later
  */
 - (void)setTimeBetweenRequests:(float)waitTime;
+
+
+/*!
+ Maximum number of requests the queue will keep in flight at the same time.
+ @result Number of requests allowed to run concurrently.
+ @version 0.9 and later
+ */
+- (NSUInteger)maxConcurrentRequests;
+
+/*!
+ Sets how many requests may be in flight at the same time. A request is started as soon as a slot becomes available, higher priorities first and requests of the same priority in the order they were added.  Responses may be received in any order when this is greater than 1.  Default is 1, which sends requests sequentially.
+ @param count Number of concurrent requests. Values less than 1 are treated as 1.
+ @version 0.9 and later
+ */
+- (void)setMaxConcurrentRequests:(NSUInteger)count;
+
+
+/*!
+ Maximum number of background requests the queue will keep in flight at the same time.
+ @result Number of background requests allowed to run concurrently.
+ @version 0.9 and later
+ */
+- (NSUInteger)maxConcurrentBackgroundRequests;
+
+/*!
+ Sets how many of the concurrent requests may be background requests. Background requests also count towards maxConcurrentRequests.  Default is NSUIntegerMax, background requests are only limited by maxConcurrentRequests.
+ @param count Number of concurrent background requests. Values less than 1 are treated as 1.
+ @version 0.9 and later
+ */
+- (void)setMaxConcurrentBackgroundRequests:(NSUInteger)count;
+
+
+/*!
+ Number of slots only interactive requests may use, on top of maxConcurrentRequests.
+ @result Number of reserved slots.
+ @version 0.9 and later
+ */
+- (NSUInteger)reservedInteractiveRequests;
+
+/*!
+ Sets how many interactive requests may be in flight beyond maxConcurrentRequests. Interactive requests use the normal slots first, once those and the reserved slots are all taken they wait for the next free slot like other requests, ahead of them.  Default is 1.
+ @param count Number of reserved slots, 0 makes interactive requests wait for a normal slot.
+ @version 0.9 and later
+ */
+- (void)setReservedInteractiveRequests:(NSUInteger)count;
+
+
+/*!
+ @brief Position of a request in the queue.
+ 
+ Use this to match a response received through the MKFacebookRequestDelegate or MKFacebookRequestQueueDelegate methods to the request that was added to the queue. The numbering is the same as the index passed to requestQueue:activeRequest:ofRequests:. Requests are numbered in the order they were added, so a request that was moved ahead by its priority keeps its number.
+ 
+ @param request A request that was added to the queue.
+ 
+ @result Index of the request, first index is 1. Returns NSNotFound if the request is not in the queue.
+ 
+ @version 0.9 and later
+ */
+- (NSUInteger)indexOfRequest:(MKFacebookRequest *)request;
 //@}
 
 /*!
-  Attempts to stop the current request being processed and prevents any further requests from starting.
+  Attempts to stop the requests currently being processed and prevents any further requests from starting.
   @version 0.7 and later
  */
 - (void)cancelRequestQueue;
@@ -161,7 +256,7 @@
  
  @param queue The request queue.
  
- @param index Number of the request being send. First index is 1.
+ @param index Number of the request being send, see indexOfRequest:. First index is 1. Higher priority requests are sent first, so the numbers aren't always in order.
  
  @param total Total number of requests in queue.
  
@@ -173,7 +268,7 @@
 /*!
  @brief Sent when all requests have finished.
  
- Sent when the queue has finished sending all requests and all responses have been received.
+ Sent when the queue has finished sending all requests and all responses have been received.  When requests run concurrently this is sent after the last outstanding response has arrived, regardless of the order responses were received in.
  
  @param queue The queue.
  
@@ -17,13 +17,55 @@
  */
 
 #import "MKFacebookRequestQueue.h"
+#import "MKDelegateDispatchTable.h"
+
+//a request waiting to be started
+typedef struct MKQueuedRequest {
+	MKFacebookRequest *request; //retained
+	NSUInteger number;
+	MKFacebookRequestPriority priority;
+} MKQueuedRequest;
+
+//higher priority first, then the request that was added first
+static inline BOOL MKQueuedRequestPrecedes(MKQueuedRequest *a, MKQueuedRequest *b)
+{
+	if (a->priority != b->priority) {
+		return a->priority > b->priority;
+	}
+	return a->number < b->number;
+}
+
 
 @interface MKFacebookRequestQueue (Private)
 
 - (void)startNextRequest;
 
+- (void)startRequestsWithPriorityOfAtLeast:(MKFacebookRequestPriority)lowestPriority;
+
+- (BOOL)hasSlotForPriority:(MKFacebookRequestPriority)priority;
+
 - (void)continueQueue;
 
+- (void)finishQueueIfDone;
+
+- (void)requestFinished:(MKFacebookRequest *)request;
+
+- (void)startScheduledRequest;
+
+- (IMP)delegateImplementationForMessage:(MKDelegateMessage)message;
+
+- (void)pushPendingRequest:(MKFacebookRequest *)request number:(NSUInteger)number;
+
+- (MKQueuedRequest)removePendingRequestAtPosition:(NSUInteger)position;
+
+- (void)removeAllPendingRequests;
+
+- (void)setPendingRequest:(MKQueuedRequest)entry atPosition:(NSUInteger)position;
+
+- (void)siftUpFromPosition:(NSUInteger)position;
+
+- (void)siftDownFromPosition:(NSUInteger)position;
+
 @end
 
 
@@ -33,10 +75,22 @@
 {
 	self = [super init];
 	if (self != nil) {
-		_requestsArray = [[NSMutableArray alloc] init];
+		_pendingPositions = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+													   valueOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+														   capacity:0];
+		//keeps the requests around until the queue is done with them
+		_requestNumbers = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+													 valueOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+														 capacity:0];
+		_activeRequests = [[NSMutableArray alloc] init];
+		_activeBackgroundRequests = [[NSMutableArray alloc] init];
 		_cancelRequestQueue = NO;
-		_currentRequest = 0;
+		_queueRunning = NO;
 		_timeBetweenRequests = 1.0;
+		_maxConcurrentRequests = 1;
+		_maxConcurrentBackgroundRequests = NSUIntegerMax;
+		_reservedInteractiveRequests = 1;
+		_scheduledRequests = 0;
 	}
 	return self;
 }
@@ -44,13 +98,10 @@
 
 - (id)initWithRequests:(NSArray *)requests
 {
-	self = [super init];
+	self = [self init];
 	if(self != nil)
 	{
-		_requestsArray = [[NSMutableArray arrayWithArray:requests] retain];
-		_cancelRequestQueue = NO;
-		_currentRequest = 0;
-		_timeBetweenRequests = 1.0;
+		[self setRequests:requests];
 	}
 	return self;
 }
@@ -58,15 +109,25 @@
 
 - (void)dealloc
 {
-	[_requestsArray release];
+	[self removeAllPendingRequests];
+	free(_pendingRequests);
+	[_pendingPositions release];
+	[_requestNumbers release];
+	[_activeRequests release];
+	[_activeBackgroundRequests release];
+	[_delegateDispatchTable release];
 	[super dealloc];
 }
 
 
 - (void)setRequests:(NSArray *)requests
 {
-	[_requestsArray release];
-	_requestsArray = [[NSMutableArray arrayWithArray:requests] retain];
+	[self removeAllPendingRequests];
+	NSResetMapTable(_requestNumbers);
+	_requestCount = 0;
+	for (MKFacebookRequest *request in requests) {
+		[self addRequest:request];
+	}
 }
 
 
@@ -78,65 +139,272 @@
 
 - (void)addRequest:(MKFacebookRequest *)request
 {
-	[_requestsArray addObject:request];
+	//a request can only be loading once
+	if (NSMapGet(_requestNumbers, request) != NULL) {
+		return;
+	}
+	_requestCount++;
+	NSMapInsert(_requestNumbers, request, (void *)_requestCount);
+	[self pushPendingRequest:request number:_requestCount];
+	
+	if (_queueRunning == YES && _cancelRequestQueue == NO) {
+		//with a pause between requests only interactive requests start right away, the others wait their turn
+		[self startRequestsWithPriorityOfAtLeast:_shouldPauseBetweenRequests ? MKFacebookRequestPriorityInteractive : MKFacebookRequestPriorityBackground];
+	}
+}
+
+
+- (void)removeRequest:(MKFacebookRequest *)request
+{
+	[[request retain] autorelease];
+	NSUInteger position = (NSUInteger)NSMapGet(_pendingPositions, request);
+	if (position > 0) {
+		MKQueuedRequest entry = [self removePendingRequestAtPosition:position - 1];
+		[entry.request release];
+		NSMapRemove(_requestNumbers, request);
+		[self finishQueueIfDone];
+	} else if ([_activeRequests indexOfObjectIdenticalTo:request] != NSNotFound) {
+		[request cancelRequest];
+		NSMapRemove(_requestNumbers, request);
+		[self requestFinished:request];
+	}
 }
 
+
+- (void)setPriority:(MKFacebookRequestPriority)priority forRequest:(MKFacebookRequest *)request
+{
+	[request setPriority:priority];
+	
+	NSUInteger position = (NSUInteger)NSMapGet(_pendingPositions, request);
+	if (position > 0) {
+		MKFacebookRequestPriority oldPriority = _pendingRequests[position - 1].priority;
+		_pendingRequests[position - 1].priority = priority;
+		if (priority > oldPriority) {
+			[self siftUpFromPosition:position - 1];
+		} else {
+			[self siftDownFromPosition:position - 1];
+		}
+	} else if ([_activeRequests indexOfObjectIdenticalTo:request] != NSNotFound) {
+		//a loading request only moves in or out of the background count, which may free a background slot
+		BOOL countedAsBackground = [_activeBackgroundRequests indexOfObjectIdenticalTo:request] != NSNotFound;
+		if (priority == MKFacebookRequestPriorityBackground && countedAsBackground == NO) {
+			[_activeBackgroundRequests addObject:request];
+		} else if (priority != MKFacebookRequestPriorityBackground && countedAsBackground == YES) {
+			[_activeBackgroundRequests removeObjectIdenticalTo:request];
+		}
+	} else {
+		return;
+	}
+	
+	if (_queueRunning == YES && _cancelRequestQueue == NO) {
+		//with a pause between requests only interactive requests start right away, the others wait their turn
+		[self startRequestsWithPriorityOfAtLeast:_shouldPauseBetweenRequests ? MKFacebookRequestPriorityInteractive : MKFacebookRequestPriorityBackground];
+	}
+}
+
+
 - (void)startRequestQueue
 {
-	 _cancelRequestQueue = NO;
-	[self startNextRequest];	
+	_cancelRequestQueue = NO;
+	if (_pendingCount == 0 && [_activeRequests count] == 0) {
+		return;
+	}
+	_queueRunning = YES;
+	//fill every available slot, with the default of 1 this only starts the first request
+	[self startRequestsWithPriorityOfAtLeast:MKFacebookRequestPriorityBackground];
+}
+
+
+- (NSUInteger)indexOfRequest:(MKFacebookRequest *)request
+{
+	NSUInteger number = (NSUInteger)NSMapGet(_requestNumbers, request);
+	if (number == 0) {
+		return NSNotFound;
+	}
+	return number;
 }
 
 #pragma mark Private Methods
 
+//starts the request at the top of the heap
 - (void)startNextRequest
 {
-	if(_currentRequest < [_requestsArray count] && _cancelRequestQueue == NO && [_requestsArray count] != 0 )
+	if(_pendingCount > 0 && _cancelRequestQueue == NO)
 	{
-		if ([_delegate respondsToSelector:@selector(requestQueue:activeRequest:ofRequests:)]) {
-			NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[_delegate methodSignatureForSelector:@selector(requestQueue:activeRequest:ofRequests:)]];
-			[invocation setTarget:_delegate];
-			[invocation setSelector:@selector(requestQueue:activeRequest:ofRequests:)];
-			[invocation setArgument:&self atIndex:2];
-			NSUInteger activeRequest = _currentRequest + 1;
-			[invocation setArgument:&activeRequest atIndex:3];
-			NSUInteger count = [_requestsArray count];
-			[invocation setArgument:&count atIndex:4];
-			[invocation invoke];
+		MKQueuedRequest entry = [self removePendingRequestAtPosition:0];
+		MKFacebookRequest *request = [entry.request autorelease];
+		
+		IMP implementation = [self delegateImplementationForMessage:MKDelegateMessageQueueActiveRequest];
+		if (implementation != NULL) {
+			((MKDelegateIndexIMP)implementation)(_delegate, @selector(requestQueue:activeRequest:ofRequests:), self, entry.number, _requestCount);
 		}
 		
-		[[_requestsArray objectAtIndex:_currentRequest] setDelegate:self];
-		[[_requestsArray objectAtIndex:_currentRequest] sendRequest];
+		[_activeRequests addObject:request];
+		if (entry.priority == MKFacebookRequestPriorityBackground) {
+			[_activeBackgroundRequests addObject:request];
+		}
+		[request setDelegate:self];
+		[request sendRequest];
 		DLog(@"request started");
 	}
-	_currentRequest++;
+}
+
+- (void)startRequestsWithPriorityOfAtLeast:(MKFacebookRequestPriority)lowestPriority
+{
+	//every request below the top has the same priority or a lower one, so the top decides
+	while (_pendingCount > 0 && _cancelRequestQueue == NO) {
+		MKFacebookRequestPriority priority = _pendingRequests[0].priority;
+		if (priority < lowestPriority || [self hasSlotForPriority:priority] == NO) {
+			break;
+		}
+		[self startNextRequest];
+	}
+}
+
+//interactive requests may also use the reserved slots
+- (BOOL)hasSlotForPriority:(MKFacebookRequestPriority)priority
+{
+	if (priority >= MKFacebookRequestPriorityInteractive) {
+		NSUInteger activeCount = [_activeRequests count];
+		return activeCount < _maxConcurrentRequests || activeCount - _maxConcurrentRequests < _reservedInteractiveRequests;
+	}
+	if ([_activeRequests count] >= _maxConcurrentRequests) {
+		return NO;
+	}
+	if (priority <= MKFacebookRequestPriorityBackground && [_activeBackgroundRequests count] >= _maxConcurrentBackgroundRequests) {
+		return NO;
+	}
+	return YES;
+}
+
+- (void)startScheduledRequest
+{
+	_scheduledRequests--;
+	if (_pendingCount > 0 && _cancelRequestQueue == NO && [self hasSlotForPriority:_pendingRequests[0].priority]) {
+		[self startNextRequest];
+	}
+	[self finishQueueIfDone];
 }
 
 - (void)continueQueue{
-	if(_currentRequest < [_requestsArray count] && _cancelRequestQueue == NO && [_requestsArray count] != 0)
+	if(_pendingCount > _scheduledRequests && _cancelRequestQueue == NO)
 	{
 		if(_shouldPauseBetweenRequests == YES)
 		{
-			NSDate *sleepUntilDate = [[NSDate date] addTimeInterval:_timeBetweenRequests];
-			[NSThread sleepUntilDate:sleepUntilDate];			
+			//interactive requests don't wait, the rest waits on the run loop instead of sleeping so requests that are still in flight keep receiving data
+			[self startRequestsWithPriorityOfAtLeast:MKFacebookRequestPriorityInteractive];
+			if (_pendingCount > _scheduledRequests) {
+				_scheduledRequests++;
+				[self performSelector:@selector(startScheduledRequest) withObject:nil afterDelay:_timeBetweenRequests];
+			}
+		}
+		else
+		{
+			[self startRequestsWithPriorityOfAtLeast:MKFacebookRequestPriorityBackground];
 		}
-		[self startNextRequest];
 	}
-	else
+	[self finishQueueIfDone];
+}
+
+- (void)finishQueueIfDone
+{
+	if (_queueRunning == YES && _pendingCount == 0 && [_activeRequests count] == 0 && _scheduledRequests == 0)
 	{
 		DLog(@"no more requests");
-		_currentRequest = 0;
-		[_requestsArray removeAllObjects];
+		_queueRunning = NO;
+		NSResetMapTable(_requestNumbers);
+		_requestCount = 0;
 		
-		if ([_delegate respondsToSelector:@selector(requestQueueDidFinish:)]) {
-			NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[_delegate methodSignatureForSelector:@selector(requestQueueDidFinish:)]];
-			[invocation setTarget:_delegate];
-			[invocation setSelector:@selector(requestQueueDidFinish:)];
-			[invocation setArgument:&self atIndex:2];
-			[invocation invoke];
+		IMP implementation = [self delegateImplementationForMessage:MKDelegateMessageQueueDidFinish];
+		if (implementation != NULL) {
+			((MKDelegateObjectIMP)implementation)(_delegate, @selector(requestQueueDidFinish:), self);
 		}
-	
-	}	
+	}
+}
+
+//the delegate methods are looked up once per delegate class, see MKDelegateDispatchTable
+- (IMP)delegateImplementationForMessage:(MKDelegateMessage)message
+{
+	return [[MKDelegateDispatchTable dispatchTableForDelegate:_delegate cachedTable:&_delegateDispatchTable] implementationForMessage:message delegate:_delegate];
+}
+
+#pragma mark Pending Requests
+
+- (void)pushPendingRequest:(MKFacebookRequest *)request number:(NSUInteger)number
+{
+	if (_pendingCount == _pendingCapacity) {
+		_pendingCapacity = _pendingCapacity > 0 ? _pendingCapacity * 2 : 16;
+		_pendingRequests = reallocf(_pendingRequests, _pendingCapacity * sizeof(MKQueuedRequest));
+	}
+	MKQueuedRequest entry = {[request retain], number, [request priority]};
+	_pendingRequests[_pendingCount] = entry;
+	_pendingCount++;
+	[self siftUpFromPosition:_pendingCount - 1];
+}
+
+//the caller takes over the retained request
+- (MKQueuedRequest)removePendingRequestAtPosition:(NSUInteger)position
+{
+	MKQueuedRequest entry = _pendingRequests[position];
+	NSMapRemove(_pendingPositions, entry.request);
+	_pendingCount--;
+	if (position < _pendingCount) {
+		//the last request fills the gap, it may belong above or below it
+		_pendingRequests[position] = _pendingRequests[_pendingCount];
+		if (position > 0 && MKQueuedRequestPrecedes(&_pendingRequests[position], &_pendingRequests[(position - 1) / 2])) {
+			[self siftUpFromPosition:position];
+		} else {
+			[self siftDownFromPosition:position];
+		}
+	}
+	return entry;
+}
+
+- (void)removeAllPendingRequests
+{
+	NSUInteger i;
+	for (i = 0; i < _pendingCount; i++) {
+		[_pendingRequests[i].request release];
+	}
+	_pendingCount = 0;
+	NSResetMapTable(_pendingPositions);
+}
+
+- (void)setPendingRequest:(MKQueuedRequest)entry atPosition:(NSUInteger)position
+{
+	_pendingRequests[position] = entry;
+	NSMapInsert(_pendingPositions, entry.request, (void *)(position + 1));
+}
+
+- (void)siftUpFromPosition:(NSUInteger)position
+{
+	MKQueuedRequest entry = _pendingRequests[position];
+	while (position > 0) {
+		NSUInteger parent = (position - 1) / 2;
+		if (MKQueuedRequestPrecedes(&entry, &_pendingRequests[parent]) == NO) {
+			break;
+		}
+		[self setPendingRequest:_pendingRequests[parent] atPosition:position];
+		position = parent;
+	}
+	[self setPendingRequest:entry atPosition:position];
+}
+
+- (void)siftDownFromPosition:(NSUInteger)position
+{
+	MKQueuedRequest entry = _pendingRequests[position];
+	while (position * 2 + 1 < _pendingCount) {
+		NSUInteger child = position * 2 + 1;
+		if (child + 1 < _pendingCount && MKQueuedRequestPrecedes(&_pendingRequests[child + 1], &_pendingRequests[child])) {
+			child++;
+		}
+		if (MKQueuedRequestPrecedes(&_pendingRequests[child], &entry) == NO) {
+			break;
+		}
+		[self setPendingRequest:_pendingRequests[child] atPosition:position];
+		position = child;
+	}
+	[self setPendingRequest:entry atPosition:position];
 }
 
 #pragma mark -
@@ -156,62 +424,90 @@
 	_timeBetweenRequests = waitTime;
 }
 
+- (NSUInteger)maxConcurrentRequests
+{
+	return _maxConcurrentRequests;
+}
+
+- (void)setMaxConcurrentRequests:(NSUInteger)count
+{
+	_maxConcurrentRequests = count > 0 ? count : 1;
+}
+
+- (NSUInteger)maxConcurrentBackgroundRequests
+{
+	return _maxConcurrentBackgroundRequests;
+}
+
+- (void)setMaxConcurrentBackgroundRequests:(NSUInteger)count
+{
+	_maxConcurrentBackgroundRequests = count > 0 ? count : 1;
+}
+
+- (NSUInteger)reservedInteractiveRequests
+{
+	return _reservedInteractiveRequests;
+}
+
+- (void)setReservedInteractiveRequests:(NSUInteger)count
+{
+	_reservedInteractiveRequests = count;
+}
+
 - (void)cancelRequestQueue
 {
-	if(_currentRequest < [_requestsArray count])
+	if([_activeRequests count] > 0 || _scheduledRequests > 0 || _pendingCount > 0)
 	{
-		[[_requestsArray objectAtIndex:_currentRequest] cancelRequest];
 		_cancelRequestQueue = YES;
-		[_requestsArray removeAllObjects];
+		_queueRunning = NO;
+		[NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(startScheduledRequest) object:nil];
+		_scheduledRequests = 0;
+		[_activeRequests makeObjectsPerformSelector:@selector(cancelRequest)];
+		[_activeRequests removeAllObjects];
+		[_activeBackgroundRequests removeAllObjects];
+		[self removeAllPendingRequests];
+		NSResetMapTable(_requestNumbers);
+		_requestCount = 0;
 	}
 }
 
+//a request has completed one way or another, free its slot before the queue continues
+- (void)requestFinished:(MKFacebookRequest *)request
+{
+	[[request retain] autorelease];
+	[_activeRequests removeObjectIdenticalTo:request];
+	[_activeBackgroundRequests removeObjectIdenticalTo:request];
+	[self continueQueue];
+}
+
 #pragma mark MKFacebookRequestDelegate Methods
 
 /*
  The queue needs to know when a requests finishes. It may be successful, contain an error, or fail completely. No matter what it does we'll forward the response back to the delegate and continue the queue.
  */
 - (void)facebookRequest:(MKFacebookRequest *)request responseReceived:(id)response{
-	SEL responseReceivedSelector = @selector(requestQueue:lastRequest:responseReceived:);
-	if ([_delegate respondsToSelector:responseReceivedSelector]) {
-		NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[_delegate methodSignatureForSelector:responseReceivedSelector]];
-		[invocation setTarget:_delegate];
-		[invocation setSelector:responseReceivedSelector];
-		[invocation setArgument:&self atIndex:2];
-		[invocation setArgument:&request atIndex:3];
-		[invocation setArgument:&response atIndex:4];
-		[invocation invoke];
+	IMP implementation = [self delegateImplementationForMessage:MKDelegateMessageQueueResponseReceived];
+	if (implementation != NULL) {
+		((MKDelegateThreeObjectIMP)implementation)(_delegate, @selector(requestQueue:lastRequest:responseReceived:), self, request, response);
 	}
 	
-	[self continueQueue];
+	[self requestFinished:request];
 }
 
 - (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error{
-	SEL errorReceivedSelector = @selector(requestQueue:lastRequest:errorReceived:);
-	if ([_delegate respondsToSelector:errorReceivedSelector]) {
-		NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[_delegate methodSignatureForSelector:errorReceivedSelector]];
-		[invocation setTarget:_delegate];
-		[invocation setSelector:errorReceivedSelector];
-		[invocation setArgument:&self atIndex:2];
-		[invocation setArgument:&request atIndex:3];
-		[invocation setArgument:&error atIndex:4];
-		[invocation invoke];
+	IMP implementation = [self delegateImplementationForMessage:MKDelegateMessageQueueErrorReceived];
+	if (implementation != NULL) {
+		((MKDelegateThreeObjectIMP)implementation)(_delegate, @selector(requestQueue:lastRequest:errorReceived:), self, request, error);
 	}
-	[self continueQueue];
+	[self requestFinished:request];
 }
 
 - (void)facebookRequest:(MKFacebookRequest *)request failed:(NSError *)error{
-	SEL failedSelector = @selector(requestQueue:lastRequest:failed:);
-	if ([_delegate respondsToSelector:failedSelector]) {
-		NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[_delegate methodSignatureForSelector:failedSelector]];
-		[invocation setTarget:_delegate];
-		[invocation setSelector:failedSelector];
-		[invocation setArgument:&self atIndex:2];
-		[invocation setArgument:&request atIndex:3];
-		[invocation setArgument:&error atIndex:4];
-		[invocation invoke];
+	IMP implementation = [self delegateImplementationForMessage:MKDelegateMessageQueueFailed];
+	if (implementation != NULL) {
+		((MKDelegateThreeObjectIMP)implementation)(_delegate, @selector(requestQueue:lastRequest:failed:), self, request, error);
 	}
-	[self continueQueue];
+	[self requestFinished:request];
 }
 
 #pragma mark -
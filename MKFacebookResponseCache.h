@@ -0,0 +1,167 @@
+//
+//  MKFacebookResponseCache.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "SynthesizeSingleton.h"
+
+@class MKFacebookRequest;
+@class MKFacebookCacheEntry;
+
+extern NSString *MKFacebookResponseCacheHitCountKey;
+extern NSString *MKFacebookResponseCacheDiskHitCountKey;
+extern NSString *MKFacebookResponseCacheMissCountKey;
+extern NSString *MKFacebookResponseCacheEvictionCountKey;
+extern NSString *MKFacebookResponseCacheMemoryUsageKey;
+extern NSString *MKFacebookResponseCacheDiskUsageKey;
+
+
+/*!
+ @class MKFacebookResponseCache
+
+ Shared cache of responses to read methods, consulted by every MKFacebookRequest before it is sent.
+
+ Responses are cached per method, parameters, response format and access token, so a different user never sees another user's data. Parsed responses are kept in memory up to memoryCapacity bytes, the least recently used are dropped first. The raw responses are also written to the Caches folder, up to diskCapacity bytes, so they survive a relaunch and are parsed again on first use.
+
+ Nothing is cached until a time to live is set for a method:
+
+ @verbatim
+ MKFacebookResponseCache *cache = [MKFacebookResponseCache sharedMKFacebookResponseCache];
+ [cache setTimeToLive:300 forMethod:@"photos.getAlbums"];
+ [cache setTimeToLive:600 forMethod:@"users.getInfo"];
+ @endverbatim
+
+ A request answered from the cache does not touch the network. Its delegate receives the response on the next pass of the run loop. The disk is only read and written on a background queue, a request that has to look there hears back once the file has been read. Each request answered from the cache gets a copy of its own, with the same mutable containers and strings as a response parsed from the network, so delegates can change it.
+
+ @version 0.9 and later
+ */
+@interface MKFacebookResponseCache : NSObject {
+	NSMutableDictionary *_timesToLive;
+	NSTimeInterval defaultTimeToLive;
+	NSUInteger memoryCapacity;
+	unsigned long long diskCapacity;
+	NSString *_diskPath;
+
+	NSMutableDictionary *_entries;
+	MKFacebookCacheEntry *_mostRecentEntry;
+	MKFacebookCacheEntry *_leastRecentEntry;
+	NSUInteger _memoryUsage;
+	unsigned long long _diskUsage;
+	NSOperationQueue *_diskQueue;
+	NSFileManager *_fileManager;
+
+	NSUInteger _hitCount;
+	NSUInteger _diskHitCount;
+	NSUInteger _missCount;
+	NSUInteger _evictionCount;
+}
+
++ (MKFacebookResponseCache *)sharedMKFacebookResponseCache;
+
+/*! @name Properties */
+//@{
+/*!
+ @brief Time to live for methods without one of their own.
+
+ Only read methods are ever cached. Default is 0, only methods given a time to live with setTimeToLive:forMethod: are cached.
+ */
+@property NSTimeInterval defaultTimeToLive;
+
+/*!
+ @brief Size of the raw responses kept in memory, in bytes.
+
+ Default is 4 MB.
+ */
+@property NSUInteger memoryCapacity;
+
+/*!
+ @brief Size of the responses written to disk, in bytes. 0 disables the disk cache.
+
+ Default is 20 MB.
+ */
+@property unsigned long long diskCapacity;
+//@}
+
+
+/*! @name Configuring */
+//@{
+/*!
+ @brief How long responses to a method stay valid, in seconds.
+
+ Pass 0 to stop caching the method.
+
+ @version 0.9 and later
+ */
+- (void)setTimeToLive:(NSTimeInterval)seconds forMethod:(NSString *)aMethod;
+
+- (NSTimeInterval)timeToLiveForMethod:(NSString *)aMethod;
+//@}
+
+
+/*! @name Using the Cache */
+//@{
+/*!
+ @brief The cached, parsed response for a request or nil.
+
+ Only checks memory, the disk is read with lookUpCachedResponseForRequest:. Called by MKFacebookRequest.
+
+ @version 0.9 and later
+ */
+- (id)cachedResponseForRequest:(MKFacebookRequest *)request responseData:(NSData **)responseData;
+
+/*!
+ @brief Look for the response to a request on disk, without blocking the calling thread.
+
+ The file is read on a background queue. The request is told what was found with cacheLookup:didFindResponse:responseData: on the thread this was called from, the response is nil if there was nothing usable. Returns the lookup the request is told about, or nil if the disk cache is off or the method isn't cached. Called by MKFacebookRequest after cachedResponseForRequest:responseData: came back empty.
+
+ @version 0.9 and later
+ */
+- (id)lookUpCachedResponseForRequest:(MKFacebookRequest *)request;
+
+/*!
+ @brief Store a valid response and the bytes it was parsed from. Called by MKFacebookRequest.
+
+ @version 0.9 and later
+ */
+- (void)storeResponse:(id)response responseData:(NSData *)responseData forRequest:(MKFacebookRequest *)request;
+
+/*!
+ @brief Forget the response to a request, the next identical request goes to Facebook.
+
+ @version 0.9 and later
+ */
+- (void)removeCachedResponseForRequest:(MKFacebookRequest *)request;
+
+/*!
+ @brief Empty the memory and disk caches.
+
+ @version 0.9 and later
+ */
+- (void)removeAllCachedResponses;
+//@}
+
+
+/*! @name Statistics */
+//@{
+/*!
+ @brief Counters describing how well the cache is doing.
+
+ Contains NSNumbers for MKFacebookResponseCacheHitCountKey (answered from memory), MKFacebookResponseCacheDiskHitCountKey (answered from disk), MKFacebookResponseCacheMissCountKey, MKFacebookResponseCacheEvictionCountKey (responses dropped from memory to stay under memoryCapacity), MKFacebookResponseCacheMemoryUsageKey and MKFacebookResponseCacheDiskUsageKey (bytes). The disk usage is measured in the background when the cache is created and is 0 until then.
+
+ @version 0.9 and later
+ */
+- (NSDictionary *)statistics;
+
+/*!
+ @brief Set the hit, miss and eviction counters back to zero.
+
+ @version 0.9 and later
+ */
+- (void)resetStatistics;
+//@}
+
+@end
@@ -0,0 +1,593 @@
+//
+//  MKFacebookResponseCache.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookResponseCache.h"
+#import "MKFacebookRequest.h"
+#import "MKFacebookRequestPrivate.h"
+#import "MKFacebookRequestCoalescer.h"
+#import "CocoaCryptoHashing.h"
+
+NSString *MKFacebookResponseCacheHitCountKey = @"MKFacebookResponseCacheHitCount";
+NSString *MKFacebookResponseCacheDiskHitCountKey = @"MKFacebookResponseCacheDiskHitCount";
+NSString *MKFacebookResponseCacheMissCountKey = @"MKFacebookResponseCacheMissCount";
+NSString *MKFacebookResponseCacheEvictionCountKey = @"MKFacebookResponseCacheEvictionCount";
+NSString *MKFacebookResponseCacheMemoryUsageKey = @"MKFacebookResponseCacheMemoryUsage";
+NSString *MKFacebookResponseCacheDiskUsageKey = @"MKFacebookResponseCacheDiskUsage";
+
+
+//a parsed response in the memory cache, entries form a list from most to least recently used
+@interface MKFacebookCacheEntry : NSObject {
+@public
+	NSString *key;
+	id response;
+	NSData *responseData;
+	NSUInteger cost;
+	NSTimeInterval expirationTime;
+	MKFacebookCacheEntry *previous; //more recently used
+	MKFacebookCacheEntry *next; //less recently used
+}
+@end
+
+@implementation MKFacebookCacheEntry
+
+- (void)dealloc
+{
+	[key release];
+	[response release];
+	[responseData release];
+	[super dealloc];
+}
+
+@end
+
+
+//a look for a response in the disk cache. the file is read on the disk queue, the request hears back on the thread it was sent from
+@interface MKFacebookCacheLookup : NSObject {
+@public
+	MKFacebookRequest *request;
+	NSThread *thread;
+	NSString *key;
+	NSTimeInterval timeToLive;
+	id response;
+	NSData *responseData;
+}
+- (void)finish;
+@end
+
+@implementation MKFacebookCacheLookup
+
+- (void)dealloc
+{
+	[request release];
+	[thread release];
+	[key release];
+	[response release];
+	[responseData release];
+	[super dealloc];
+}
+
+
+- (void)finish
+{
+	[request cacheLookup:self didFindResponse:response responseData:responseData];
+}
+
+@end
+
+
+@interface MKFacebookResponseCache (Private)
+- (NSString *)keyForRequest:(MKFacebookRequest *)request;
+- (NSString *)diskPathForKey:(NSString *)key;
+- (void)linkEntryAtFront:(MKFacebookCacheEntry *)entry;
+- (void)unlinkEntry:(MKFacebookCacheEntry *)entry;
+- (void)removeEntry:(MKFacebookCacheEntry *)entry;
+- (void)addEntry:(MKFacebookCacheEntry *)entry;
+- (void)trimMemory;
+- (id)copyOfResponse:(id)response;
+- (id)responseForEntry:(MKFacebookCacheEntry *)entry;
+- (void)runOnDiskQueue:(SEL)aSelector object:(id)object;
+- (void)readLookup:(MKFacebookCacheLookup *)lookup;
+- (void)writeEntry:(MKFacebookCacheEntry *)entry;
+- (void)removeFileForKey:(NSString *)key;
+- (void)removeAllFiles;
+- (void)trimDisk;
+- (void)measureDiskUsage;
+@end
+
+
+//the same mutable containers and strings the parser builds, so a response from the cache can be changed like any other. keys stay immutable, as the parser makes them
+static id MKMutableCopy(id object)
+{
+	if ([object isKindOfClass:[NSDictionary class]] == YES) {
+		NSMutableDictionary *copy = [NSMutableDictionary dictionaryWithCapacity:[object count]];
+		for (id key in object) {
+			[copy setObject:MKMutableCopy([object objectForKey:key]) forKey:key];
+		}
+		return copy;
+	}
+	if ([object isKindOfClass:[NSArray class]] == YES) {
+		NSMutableArray *copy = [NSMutableArray arrayWithCapacity:[object count]];
+		for (id element in object) {
+			[copy addObject:MKMutableCopy(element)];
+		}
+		return copy;
+	}
+	if ([object isKindOfClass:[NSString class]] == YES) {
+		return [[object mutableCopy] autorelease];
+	}
+	//numbers, booleans and null can't be changed
+	return object;
+}
+
+
+@implementation MKFacebookResponseCache
+
+SYNTHESIZE_SINGLETON_FOR_CLASS(MKFacebookResponseCache);
+
+@synthesize defaultTimeToLive;
+@synthesize memoryCapacity;
+@synthesize diskCapacity;
+
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_timesToLive = [[NSMutableDictionary alloc] init];
+		_entries = [[NSMutableDictionary alloc] init];
+		defaultTimeToLive = 0;
+		memoryCapacity = 4 * 1024 * 1024;
+		diskCapacity = 20 * 1024 * 1024;
+
+		NSArray *cachesDirectories = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+		NSString *bundleIdentifier = [[NSBundle mainBundle] bundleIdentifier];
+		if ([cachesDirectories count] > 0) {
+			_diskPath = [[[[cachesDirectories objectAtIndex:0] stringByAppendingPathComponent:bundleIdentifier != nil ? bundleIdentifier : @"MKAbeFook"] stringByAppendingPathComponent:@"MKFacebookResponseCache"] retain];
+		}
+
+		//files are only touched on the disk queue, one operation at a time, so reads, writes and removals happen in the order they were asked for
+		_diskQueue = [[NSOperationQueue alloc] init];
+		[_diskQueue setMaxConcurrentOperationCount:1];
+		_fileManager = [[NSFileManager alloc] init];
+		if (_diskPath != nil) {
+			[self runOnDiskQueue:@selector(measureDiskUsage) object:nil];
+		}
+	}
+	return self;
+}
+
+
+- (void)setTimeToLive:(NSTimeInterval)seconds forMethod:(NSString *)aMethod
+{
+	@synchronized(self) {
+		if (seconds > 0) {
+			[_timesToLive setObject:[NSNumber numberWithDouble:seconds] forKey:aMethod];
+		} else {
+			[_timesToLive removeObjectForKey:aMethod];
+		}
+	}
+}
+
+
+- (NSTimeInterval)timeToLiveForMethod:(NSString *)aMethod
+{
+	@synchronized(self) {
+		NSNumber *seconds = [_timesToLive objectForKey:aMethod];
+		return seconds != nil ? [seconds doubleValue] : defaultTimeToLive;
+	}
+	return 0;
+}
+
+
+- (id)cachedResponseForRequest:(MKFacebookRequest *)request responseData:(NSData **)responseData
+{
+	NSTimeInterval timeToLive = [self timeToLiveForMethod:request.method];
+	if (timeToLive <= 0) {
+		return nil;
+	}
+	NSString *key = [self keyForRequest:request];
+	if (key == nil) {
+		return nil;
+	}
+
+	MKFacebookCacheEntry *entry = nil;
+	@synchronized(self) {
+		entry = [[[_entries objectForKey:key] retain] autorelease];
+		if (entry != nil && entry->expirationTime > [NSDate timeIntervalSinceReferenceDate]) {
+			[self unlinkEntry:entry];
+			[self linkEntryAtFront:entry];
+			_hitCount++;
+		} else {
+			if (entry != nil) {
+				[self removeEntry:entry];
+				entry = nil;
+			}
+			//with a disk cache the miss is counted once the disk has been looked at
+			if (diskCapacity == 0 || _diskPath == nil) {
+				_missCount++;
+			}
+		}
+	}
+
+	if (entry == nil) {
+		return nil;
+	}
+	if (responseData != NULL) {
+		*responseData = entry->responseData;
+	}
+	return [self responseForEntry:entry];
+}
+
+
+- (id)lookUpCachedResponseForRequest:(MKFacebookRequest *)request
+{
+	if (diskCapacity == 0 || _diskPath == nil) {
+		return nil;
+	}
+	NSTimeInterval timeToLive = [self timeToLiveForMethod:request.method];
+	if (timeToLive <= 0) {
+		return nil;
+	}
+	NSString *key = [self keyForRequest:request];
+	if (key == nil) {
+		return nil;
+	}
+
+	MKFacebookCacheLookup *lookup = [[[MKFacebookCacheLookup alloc] init] autorelease];
+	//the request has to stay around until it has its answer
+	lookup->request = [request retain];
+	lookup->thread = [[NSThread currentThread] retain];
+	lookup->key = [key copy];
+	lookup->timeToLive = timeToLive;
+	[self runOnDiskQueue:@selector(readLookup:) object:lookup];
+	return lookup;
+}
+
+
+- (void)storeResponse:(id)response responseData:(NSData *)responseData forRequest:(MKFacebookRequest *)request
+{
+	NSTimeInterval timeToLive = [self timeToLiveForMethod:request.method];
+	if (timeToLive <= 0 || response == nil || responseData == nil) {
+		return;
+	}
+	NSString *key = [self keyForRequest:request];
+	if (key == nil) {
+		return;
+	}
+
+	MKFacebookCacheEntry *entry = [[[MKFacebookCacheEntry alloc] init] autorelease];
+	entry->key = [key copy];
+	//the request's delegate is free to change the response it was given
+	entry->response = [[self copyOfResponse:response] retain];
+	//MKFacebookRequest doesn't change the data after handing it over, so there is no need to copy a possibly large response
+	entry->responseData = [responseData retain];
+	entry->cost = [responseData length];
+	entry->expirationTime = [NSDate timeIntervalSinceReferenceDate] + timeToLive;
+
+	@synchronized(self) {
+		[self addEntry:entry];
+	}
+	if (diskCapacity > 0 && _diskPath != nil) {
+		[self runOnDiskQueue:@selector(writeEntry:) object:entry];
+	}
+}
+
+
+- (void)removeCachedResponseForRequest:(MKFacebookRequest *)request
+{
+	NSString *key = [self keyForRequest:request];
+	if (key == nil) {
+		return;
+	}
+	@synchronized(self) {
+		MKFacebookCacheEntry *entry = [_entries objectForKey:key];
+		if (entry != nil) {
+			[self removeEntry:entry];
+		}
+	}
+	if (_diskPath != nil) {
+		[self runOnDiskQueue:@selector(removeFileForKey:) object:key];
+	}
+}
+
+
+- (void)removeAllCachedResponses
+{
+	@synchronized(self) {
+		while (_leastRecentEntry != nil) {
+			[self removeEntry:_leastRecentEntry];
+		}
+	}
+	if (_diskPath != nil) {
+		[self runOnDiskQueue:@selector(removeAllFiles) object:nil];
+	}
+}
+
+
+- (NSDictionary *)statistics
+{
+	@synchronized(self) {
+		return [NSDictionary dictionaryWithObjectsAndKeys:
+				[NSNumber numberWithUnsignedInteger:_hitCount], MKFacebookResponseCacheHitCountKey,
+				[NSNumber numberWithUnsignedInteger:_diskHitCount], MKFacebookResponseCacheDiskHitCountKey,
+				[NSNumber numberWithUnsignedInteger:_missCount], MKFacebookResponseCacheMissCountKey,
+				[NSNumber numberWithUnsignedInteger:_evictionCount], MKFacebookResponseCacheEvictionCountKey,
+				[NSNumber numberWithUnsignedInteger:_memoryUsage], MKFacebookResponseCacheMemoryUsageKey,
+				[NSNumber numberWithUnsignedLongLong:_diskUsage], MKFacebookResponseCacheDiskUsageKey,
+				nil];
+	}
+	return nil;
+}
+
+
+- (void)resetStatistics
+{
+	@synchronized(self) {
+		_hitCount = 0;
+		_diskHitCount = 0;
+		_missCount = 0;
+		_evictionCount = 0;
+	}
+}
+
+
+#pragma mark Private Methods
+
+//responses belong to the user who asked for them, the key includes a hash of the access token
+- (NSString *)keyForRequest:(MKFacebookRequest *)request
+{
+	NSString *requestKey = [MKFacebookRequestCoalescer keyForRequest:request];
+	if (requestKey == nil) {
+		return nil;
+	}
+	NSString *accessToken = [[MKFacebookSession sharedMKFacebookSession] accessToken];
+	return [NSString stringWithFormat:@"%@\n%@", requestKey, accessToken != nil ? [accessToken sha1HexHash] : @""];
+}
+
+
+- (NSString *)diskPathForKey:(NSString *)key
+{
+	return [_diskPath stringByAppendingPathComponent:[key sha1HexHash]];
+}
+
+
+- (void)linkEntryAtFront:(MKFacebookCacheEntry *)entry
+{
+	entry->previous = nil;
+	entry->next = _mostRecentEntry;
+	if (_mostRecentEntry != nil) {
+		_mostRecentEntry->previous = entry;
+	}
+	_mostRecentEntry = entry;
+	if (_leastRecentEntry == nil) {
+		_leastRecentEntry = entry;
+	}
+}
+
+
+- (void)unlinkEntry:(MKFacebookCacheEntry *)entry
+{
+	if (entry->previous != nil) {
+		entry->previous->next = entry->next;
+	} else {
+		_mostRecentEntry = entry->next;
+	}
+	if (entry->next != nil) {
+		entry->next->previous = entry->previous;
+	} else {
+		_leastRecentEntry = entry->previous;
+	}
+	entry->previous = nil;
+	entry->next = nil;
+}
+
+
+//the dictionary owns the entries, the list only points at them
+- (void)removeEntry:(MKFacebookCacheEntry *)entry
+{
+	[[entry retain] autorelease];
+	[self unlinkEntry:entry];
+	_memoryUsage -= entry->cost;
+	[_entries removeObjectForKey:entry->key];
+}
+
+
+- (void)addEntry:(MKFacebookCacheEntry *)entry
+{
+	MKFacebookCacheEntry *existing = [_entries objectForKey:entry->key];
+	if (existing != nil) {
+		[self removeEntry:existing];
+	}
+	//too big to ever fit, it still goes to disk
+	if (entry->cost > memoryCapacity) {
+		return;
+	}
+	[_entries setObject:entry forKey:entry->key];
+	[self linkEntryAtFront:entry];
+	_memoryUsage += entry->cost;
+	[self trimMemory];
+}
+
+
+- (void)trimMemory
+{
+	while (_memoryUsage > memoryCapacity && _leastRecentEntry != nil) {
+		[self removeEntry:_leastRecentEntry];
+		_evictionCount++;
+	}
+}
+
+
+//the cache keeps its own copy of a response, the request that stored it may still change the original
+- (id)copyOfResponse:(id)response
+{
+	if ([response isKindOfClass:[NSXMLNode class]] == YES) {
+		return [[response copy] autorelease];
+	}
+	return MKMutableCopy(response);
+}
+
+
+//every hit gets a copy of its own, of the same types an uncached response has
+- (id)responseForEntry:(MKFacebookCacheEntry *)entry
+{
+	return [self copyOfResponse:entry->response];
+}
+
+
+- (void)runOnDiskQueue:(SEL)aSelector object:(id)object
+{
+	NSInvocationOperation *operation = [[[NSInvocationOperation alloc] initWithTarget:self selector:aSelector object:object] autorelease];
+	[_diskQueue addOperation:operation];
+}
+
+
+#pragma mark Disk Queue
+
+//the disk cache keeps the raw response and uses the file date to tell how old it is
+- (void)readLookup:(MKFacebookCacheLookup *)lookup
+{
+	NSAutoreleasePool *autoreleasePool = [[NSAutoreleasePool alloc] init];
+	NSString *path = [self diskPathForKey:lookup->key];
+	NSDictionary *attributes = [_fileManager attributesOfItemAtPath:path error:nil];
+	NSTimeInterval expirationTime = [[attributes fileModificationDate] timeIntervalSinceReferenceDate] + lookup->timeToLive;
+
+	if (attributes != nil && expirationTime > [NSDate timeIntervalSinceReferenceDate]) {
+		NSData *data = [NSData dataWithContentsOfFile:path];
+		//freshly parsed, so the request can have it and the cache keeps a copy
+		id response = [lookup->request parseResponseData:data];
+		if (response != nil) {
+			MKFacebookCacheEntry *entry = [[[MKFacebookCacheEntry alloc] init] autorelease];
+			entry->key = [lookup->key copy];
+			entry->response = [[self copyOfResponse:response] retain];
+			entry->responseData = [data retain];
+			entry->cost = [data length];
+			entry->expirationTime = expirationTime;
+			@synchronized(self) {
+				//a response stored while the file was being read is newer
+				if ([_entries objectForKey:entry->key] == nil) {
+					[self addEntry:entry];
+				}
+				_diskHitCount++;
+			}
+			lookup->response = [response retain];
+			lookup->responseData = [data retain];
+		}
+	} else if (attributes != nil) {
+		if ([_fileManager removeItemAtPath:path error:nil] == YES) {
+			@synchronized(self) {
+				_diskUsage -= MIN(_diskUsage, [attributes fileSize]);
+			}
+		}
+	}
+
+	if (lookup->response == nil) {
+		@synchronized(self) {
+			_missCount++;
+		}
+	}
+	[autoreleasePool drain];
+	[lookup performSelector:@selector(finish) onThread:lookup->thread withObject:nil waitUntilDone:NO modes:[NSArray arrayWithObject:NSRunLoopCommonModes]];
+}
+
+
+- (void)writeEntry:(MKFacebookCacheEntry *)entry
+{
+	NSAutoreleasePool *autoreleasePool = [[NSAutoreleasePool alloc] init];
+	if (![_fileManager fileExistsAtPath:_diskPath]) {
+		[_fileManager createDirectoryAtPath:_diskPath withIntermediateDirectories:YES attributes:nil error:nil];
+	}
+
+	NSString *path = [self diskPathForKey:entry->key];
+	unsigned long long oldSize = [[_fileManager attributesOfItemAtPath:path error:nil] fileSize];
+	if ([entry->responseData writeToFile:path atomically:YES] == NO) {
+		DLog(@"unable to write cached response to %@", path);
+	} else {
+		BOOL overCapacity = NO;
+		@synchronized(self) {
+			_diskUsage = _diskUsage - MIN(_diskUsage, oldSize) + [entry->responseData length];
+			overCapacity = _diskUsage > diskCapacity;
+		}
+		if (overCapacity == YES) {
+			[self trimDisk];
+		}
+	}
+	[autoreleasePool drain];
+}
+
+
+- (void)removeFileForKey:(NSString *)key
+{
+	NSString *path = [self diskPathForKey:key];
+	unsigned long long size = [[_fileManager attributesOfItemAtPath:path error:nil] fileSize];
+	if ([_fileManager removeItemAtPath:path error:nil] == YES) {
+		@synchronized(self) {
+			_diskUsage -= MIN(_diskUsage, size);
+		}
+	}
+}
+
+
+- (void)removeAllFiles
+{
+	[_fileManager removeItemAtPath:_diskPath error:nil];
+	@synchronized(self) {
+		_diskUsage = 0;
+	}
+}
+
+
+//oldest files go first until the cache fits again
+- (void)trimDisk
+{
+	NSMutableArray *files = [NSMutableArray array];
+	for (NSString *name in [_fileManager contentsOfDirectoryAtPath:_diskPath error:nil]) {
+		NSString *path = [_diskPath stringByAppendingPathComponent:name];
+		NSDictionary *attributes = [_fileManager attributesOfItemAtPath:path error:nil];
+		if (attributes != nil) {
+			[files addObject:[NSDictionary dictionaryWithObjectsAndKeys:path, @"path", [attributes fileModificationDate], @"date", [NSNumber numberWithUnsignedLongLong:[attributes fileSize]], @"size", nil]];
+		}
+	}
+	NSSortDescriptor *byDate = [[[NSSortDescriptor alloc] initWithKey:@"date" ascending:YES] autorelease];
+	[files sortUsingDescriptors:[NSArray arrayWithObject:byDate]];
+
+	unsigned long long usage = 0;
+	for (NSDictionary *file in files) {
+		usage += [[file objectForKey:@"size"] unsignedLongLongValue];
+	}
+	for (NSDictionary *file in files) {
+		if (usage <= diskCapacity) {
+			break;
+		}
+		if ([_fileManager removeItemAtPath:[file objectForKey:@"path"] error:nil]) {
+			usage -= [[file objectForKey:@"size"] unsignedLongLongValue];
+		}
+	}
+
+	@synchronized(self) {
+		_diskUsage = usage;
+	}
+}
+
+
+//worked out from the files once, when the cache is created, then kept up to date as files are written and removed
+- (void)measureDiskUsage
+{
+	NSAutoreleasePool *autoreleasePool = [[NSAutoreleasePool alloc] init];
+	unsigned long long usage = 0;
+	for (NSString *name in [_fileManager contentsOfDirectoryAtPath:_diskPath error:nil]) {
+		usage += [[_fileManager attributesOfItemAtPath:[_diskPath stringByAppendingPathComponent:name] error:nil] fileSize];
+	}
+
+	@synchronized(self) {
+		_diskUsage = usage;
+	}
+	[autoreleasePool drain];
+}
+
+@end
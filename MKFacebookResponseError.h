@@ -55,8 +55,23 @@
 
 
 
+/*!
+ @brief Error from the response of a finished request.
+ 
+ Parses the response again. Use errorWithDictionary: if the response has already been parsed.
+ */
 + (MKFacebookResponseError *)errorFromRequest:(MKFacebookRequest *)request;
 - (id)initWithRequest:(MKFacebookRequest *)request;
 
+/*!
+ @brief Error from a parsed error response.
+ 
+ @param responseDictionary A JSON error response, or the result of dictionaryFromXMLElement for an XML error response. nil if the response could not be parsed.
+ 
+ @version 0.9 and later
+ */
++ (MKFacebookResponseError *)errorWithDictionary:(NSDictionary *)responseDictionary;
+- (id)initWithDictionary:(NSDictionary *)responseDictionary;
+
 
 @end
@@ -12,6 +12,8 @@
 #import "JSON.h"
 #import "NSDictionaryAdditions.h"
 #import "MKFacebookRequest.h"
+#import "MKFacebookRequestPrivate.h"
+#import "MKFacebookParsePool.h"
 
 
 
@@ -24,32 +26,46 @@
 	return error;
 }
 
++ (MKFacebookResponseError *)errorWithDictionary:(NSDictionary *)responseDictionary{
+	MKFacebookResponseError *error = [[[MKFacebookResponseError alloc] initWithDictionary:responseDictionary] autorelease];
+	return error;
+}
+
 - (id)initWithRequest:(MKFacebookRequest *)request{
 	
-	self = [super init];
-	errorCode = 0;
-	errorMessage = nil;
-	requestArgs = nil;
-	
 	if (request == nil) {
+		self = [self initWithDictionary:nil];
 		errorMessage = @"Unknown Error";
 		return self;
 	}
 	
 	NSDictionary *responseDictionary = nil;
-	NSString *rawResponse = request.rawResponse;
+	NSData *responseData = [request rawResponseData];
 	
-	if (request.responseFormat == MKFacebookRequestResponseFormatXML) {
-		NSXMLDocument *xml = [[NSXMLDocument alloc] initWithXMLString:rawResponse options:0 error:nil];
+	if (request.responseFormat == MKFacebookRequestResponseFormatXML && responseData != nil) {
+		NSXMLDocument *xml = [[NSXMLDocument alloc] initWithData:responseData options:0 error:nil];
 		responseDictionary = [[xml rootElement] dictionaryFromXMLElement];
 		[xml release];
 	}
 	
 	if (request.responseFormat == MKFacebookRequestResponseFormatJSON) {
-		responseDictionary = [rawResponse JSONValue]; 
+		MKFacebookParsePool *parsePool = [MKFacebookParsePool sharedMKFacebookParsePool];
+		SBJsonParser *parser = [parsePool checkOutParser];
+		responseDictionary = [parser objectWithData:responseData];
+		[parsePool checkInParser:parser];
 	}
 	
-	if (responseDictionary != nil) {
+	return [self initWithDictionary:responseDictionary];
+}
+
+- (id)initWithDictionary:(NSDictionary *)responseDictionary{
+	
+	self = [super init];
+	errorCode = 0;
+	errorMessage = nil;
+	requestArgs = nil;
+	
+	if ([responseDictionary isKindOfClass:[NSDictionary class]]) {
 		if ([responseDictionary valueForKey:@"error_code"] != nil) {
 			errorCode = [[responseDictionary valueForKey:@"error_code"] intValue];
 		}
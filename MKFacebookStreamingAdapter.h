@@ -0,0 +1,36 @@
+//
+//  MKFacebookStreamingAdapter.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "JSON.h"
+
+/*
+ Sits between the parser and the streamingDelegate of a MKFacebookRequest and passes the events of a response on.
+
+ Facebook answers errors with an object starting with an error_code key, so the root object is held back until its first key is known. Error objects are built instead of passed on and can be read from errorDictionary once the response has been parsed, the consumer never sees them. Every other response reaches the consumer as it arrives. Used by MKFacebookParsePool, one adapter per response.
+ */
+@interface MKFacebookStreamingAdapter : NSObject <SBJsonStreamParserDelegate> {
+	id <SBJsonStreamParserDelegate> _consumer;
+	NSUInteger _depth;
+	int _mode;
+	NSMutableArray *_capture;
+	NSString *_captureKey;
+	NSDictionary *_errorDictionary;
+}
+
+/*
+ The consumer is retained until the adapter goes away, the request only keeps a weak reference and may be released while its response is parsed.
+ */
+- (id)initWithConsumer:(id <SBJsonStreamParserDelegate>)consumer;
+
+/*
+ The Facebook error the response turned out to be, nil for any other response.
+ */
+- (NSDictionary *)errorDictionary;
+
+@end
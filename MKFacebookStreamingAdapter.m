@@ -0,0 +1,243 @@
+//
+//  MKFacebookStreamingAdapter.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookStreamingAdapter.h"
+#import "NSDictionaryAdditions.h"
+
+enum {
+	MKStreamingModeForwarding,	//events go straight to the consumer
+	MKStreamingModeDeciding,	//the root object has started, its first key tells whether it's an error
+	MKStreamingModeCapturing	//the root object is built in _capture
+};
+
+
+@interface MKFacebookStreamingAdapter (Private)
+- (void)captureValue:(id)value;
+- (void)captureContainer:(id)container;
+- (void)endCapturedContainer:(SBJsonParser *)parser;
+- (void)replayValue:(id)value parser:(SBJsonParser *)parser;
+@end
+
+
+@implementation MKFacebookStreamingAdapter
+
+- (id)initWithConsumer:(id <SBJsonStreamParserDelegate>)consumer
+{
+	self = [super init];
+	if (self != nil) {
+		_consumer = [consumer retain];
+		_mode = MKStreamingModeForwarding;
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[_consumer release];
+	[_capture release];
+	[_captureKey release];
+	[_errorDictionary release];
+	[super dealloc];
+}
+
+
+- (NSDictionary *)errorDictionary
+{
+	return [[_errorDictionary retain] autorelease];
+}
+
+
+#pragma mark SBJsonStreamParserDelegate
+
+- (void)parserDidStartObject:(SBJsonParser *)parser
+{
+	if (_mode == MKStreamingModeCapturing) {
+		[self captureContainer:[NSMutableDictionary dictionary]];
+	} else if (_depth == 0) {
+		_mode = MKStreamingModeDeciding;
+	} else {
+		[_consumer parserDidStartObject:parser];
+	}
+	_depth++;
+}
+
+
+- (void)parser:(SBJsonParser *)parser foundKey:(NSString *)key
+{
+	if (_mode == MKStreamingModeDeciding) {
+		if ([key isEqualToString:@"error_code"] == YES) {
+			_mode = MKStreamingModeCapturing;
+			[self captureContainer:[NSMutableDictionary dictionary]];
+		} else {
+			_mode = MKStreamingModeForwarding;
+			[_consumer parserDidStartObject:parser];
+		}
+	}
+
+	if (_mode == MKStreamingModeCapturing) {
+		[_captureKey release];
+		_captureKey = [key copy];
+	} else {
+		[_consumer parser:parser foundKey:key];
+	}
+}
+
+
+- (void)parserDidEndObject:(SBJsonParser *)parser
+{
+	_depth--;
+	if (_mode == MKStreamingModeDeciding) {
+		//an empty root object
+		_mode = MKStreamingModeForwarding;
+		[_consumer parserDidStartObject:parser];
+		[_consumer parserDidEndObject:parser];
+	} else if (_mode == MKStreamingModeCapturing) {
+		[self endCapturedContainer:parser];
+	} else {
+		[_consumer parserDidEndObject:parser];
+	}
+}
+
+
+- (void)parserDidStartArray:(SBJsonParser *)parser
+{
+	if (_mode == MKStreamingModeCapturing) {
+		[self captureContainer:[NSMutableArray array]];
+	} else {
+		[_consumer parserDidStartArray:parser];
+	}
+	_depth++;
+}
+
+
+- (void)parserDidEndArray:(SBJsonParser *)parser
+{
+	_depth--;
+	if (_mode == MKStreamingModeCapturing) {
+		[self endCapturedContainer:parser];
+	} else {
+		[_consumer parserDidEndArray:parser];
+	}
+}
+
+
+- (void)parser:(SBJsonParser *)parser foundString:(NSString *)string
+{
+	if (_mode == MKStreamingModeCapturing) {
+		[self captureValue:string];
+	} else {
+		[_consumer parser:parser foundString:string];
+	}
+}
+
+
+- (void)parser:(SBJsonParser *)parser foundNumber:(NSNumber *)number
+{
+	if (_mode == MKStreamingModeCapturing) {
+		[self captureValue:number];
+	} else {
+		[_consumer parser:parser foundNumber:number];
+	}
+}
+
+
+- (void)parser:(SBJsonParser *)parser foundBoolean:(BOOL)x
+{
+	if (_mode == MKStreamingModeCapturing) {
+		//the CFBoolean constants, so a replay can tell them from numbers
+		[self captureValue:(id)(x ? kCFBooleanTrue : kCFBooleanFalse)];
+	} else {
+		[_consumer parser:parser foundBoolean:x];
+	}
+}
+
+
+- (void)parserFoundNull:(SBJsonParser *)parser
+{
+	if (_mode == MKStreamingModeCapturing) {
+		[self captureValue:[NSNull null]];
+	} else {
+		[_consumer parserFoundNull:parser];
+	}
+}
+
+
+#pragma mark Capturing
+
+- (void)captureValue:(id)value
+{
+	id container = [_capture lastObject];
+	if ([container isKindOfClass:[NSDictionary class]] == YES) {
+		[container setObject:value forKey:_captureKey];
+	} else {
+		[container addObject:value];
+	}
+}
+
+
+//the root object is the first container captured
+- (void)captureContainer:(id)container
+{
+	if (_capture == nil) {
+		_capture = [[NSMutableArray alloc] init];
+	} else {
+		[self captureValue:container];
+	}
+	[_capture addObject:container];
+}
+
+
+- (void)endCapturedContainer:(SBJsonParser *)parser
+{
+	if ([_capture count] > 1) {
+		[_capture removeLastObject];
+		return;
+	}
+
+	//the whole root object is in, it only started like an error
+	NSDictionary *root = [[[_capture lastObject] retain] autorelease];
+	[_capture release];
+	_capture = nil;
+	_mode = MKStreamingModeForwarding;
+	if ([root validFacebookResponse] == NO) {
+		_errorDictionary = [root retain];
+	} else {
+		[self replayValue:root parser:parser];
+	}
+}
+
+
+//sends a captured value to the consumer as if it had just been parsed. keys come in the dictionary's order rather than the document's
+- (void)replayValue:(id)value parser:(SBJsonParser *)parser
+{
+	if ([value isKindOfClass:[NSDictionary class]] == YES) {
+		[_consumer parserDidStartObject:parser];
+		for (NSString *key in value) {
+			[_consumer parser:parser foundKey:key];
+			[self replayValue:[value objectForKey:key] parser:parser];
+		}
+		[_consumer parserDidEndObject:parser];
+	} else if ([value isKindOfClass:[NSArray class]] == YES) {
+		[_consumer parserDidStartArray:parser];
+		for (id element in value) {
+			[self replayValue:element parser:parser];
+		}
+		[_consumer parserDidEndArray:parser];
+	} else if ([value isKindOfClass:[NSString class]] == YES) {
+		[_consumer parser:parser foundString:value];
+	} else if (value == (id)kCFBooleanTrue || value == (id)kCFBooleanFalse) {
+		[_consumer parser:parser foundBoolean:(value == (id)kCFBooleanTrue)];
+	} else if (value == [NSNull null]) {
+		[_consumer parserFoundNull:parser];
+	} else {
+		[_consumer parser:parser foundNumber:value];
+	}
+}
+
+@end
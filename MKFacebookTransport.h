@@ -0,0 +1,56 @@
+//
+//  MKFacebookTransport.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+
+/*!
+ @protocol MKFacebookTransport
+
+ Moves requests between MKFacebookRequest and a server.
+
+ A transport starts an asynchronous connection for a prepared NSURLRequest and reports back to the delegate through the same methods NSURLConnection uses: connection:didReceiveData:, connectionDidFinishLoading:, connection:didFailWithError: and, optionally, connection:didSendBodyData:totalBytesWritten:totalBytesExpectedToWrite:. The connection object passed to those methods is the one returned by connectionWithRequest:delegate:.
+
+ MKURLConnectionTransport, the default, uses NSURLConnection. MKLoopbackTransport answers requests in process from scripted responses.
+
+ @see MKFacebookRequest transport
+ @version 0.9 and later
+ */
+@protocol MKFacebookTransport <NSObject>
+
+/*!
+ @brief Start loading a request asynchronously on the current run loop.
+
+ The delegate is retained until the connection finishes, fails or is cancelled, like NSURLConnection does.
+
+ @return A connection object responding to cancel.
+ */
+- (id)connectionWithRequest:(NSURLRequest *)urlRequest delegate:(id)aDelegate;
+
+/*!
+ @brief Load a request and wait for the response.
+ */
+- (NSData *)sendSynchronousRequest:(NSURLRequest *)urlRequest returningResponse:(NSURLResponse **)response error:(NSError **)error;
+
+@end
+
+
+
+/*!
+ @class MKURLConnectionTransport
+
+ Sends requests over the network using NSURLConnection. Used by every MKFacebookRequest unless another transport is set.
+
+ @version 0.9 and later
+ */
+@interface MKURLConnectionTransport : NSObject <MKFacebookTransport> {
+}
+
++ (MKURLConnectionTransport *)transport;
+
+@end
@@ -0,0 +1,31 @@
+//
+//  MKFacebookTransport.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKFacebookTransport.h"
+
+
+@implementation MKURLConnectionTransport
+
++ (MKURLConnectionTransport *)transport
+{
+	return [[[MKURLConnectionTransport alloc] init] autorelease];
+}
+
+
+- (id)connectionWithRequest:(NSURLRequest *)urlRequest delegate:(id)aDelegate
+{
+	return [NSURLConnection connectionWithRequest:urlRequest delegate:aDelegate];
+}
+
+
+- (NSData *)sendSynchronousRequest:(NSURLRequest *)urlRequest returningResponse:(NSURLResponse **)response error:(NSError **)error
+{
+	return [NSURLConnection sendSynchronousRequest:urlRequest returningResponse:response error:error];
+}
+
+@end
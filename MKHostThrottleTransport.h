@@ -0,0 +1,77 @@
+//
+//  MKHostThrottleTransport.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "MKFacebookTransport.h"
+
+extern NSString *MKHostThrottleRequestCountKey;
+extern NSString *MKHostThrottleTotalTimeToFirstByteKey;
+extern NSString *MKHostThrottleAverageTimeToFirstByteKey;
+extern NSString *MKHostThrottleWaitingRequestCountKey;
+
+
+/*!
+ @class MKHostThrottleTransport
+
+ Limits how many requests are in flight to each host, and sends them through CFHTTPStream asking for HTTP/1.1 keep-alive connections.
+
+ This is a throttle, not a connection pool. It doesn't hold sockets, and can't tell whether a request reused a connection or how long connecting took.
+
+ CFNetwork owns the sockets. Every request is sent with kCFStreamPropertyHTTPAttemptPersistentConnection, so CFNetwork may send it on a socket and TLS session left open by an earlier request to the same host instead of opening a new one. Whether it does, and how long it keeps idle sockets open, is up to CFNetwork and the server, the transport can't see it. What the transport does control is how many requests run at once: each host gets at most maximumRequestsPerHost, requests beyond the limit wait in order, which keeps the number of sockets CFNetwork needs per host small.
+
+ Call prewarmHost:connections: at launch so the first real requests may find open connections:
+
+ @verbatim
+ MKHostThrottleTransport *throttle = [MKHostThrottleTransport transport];
+ [throttle prewarmHost:[NSURL URLWithString:MKAPIServerURL] connections:2];
+ [MKFacebookRequest setDefaultTransport:throttle];
+ @endverbatim
+
+ Synchronous requests are sent with NSURLConnection and aren't limited.
+
+ @version 0.9 and later
+ */
+@interface MKHostThrottleTransport : NSObject <MKFacebookTransport> {
+	NSMutableDictionary *_hostQueues;
+	NSUInteger maximumRequestsPerHost;
+
+	NSUInteger _requestCount;
+	NSUInteger _firstByteCount;
+	NSTimeInterval _totalTimeToFirstByte;
+}
+
++ (MKHostThrottleTransport *)transport;
+
+/*!
+ @brief Most requests in flight to a single host at the same time. Default is 4.
+ */
+@property NSUInteger maximumRequestsPerHost;
+
+/*!
+ @brief Ask CFNetwork to open connections to a host before they are needed.
+
+ Sends a HEAD request for the URL for each connection, at the same time, so CFNetwork opens that many connections and may keep them for the requests that follow. Requests already in flight to the host count towards the number asked for.
+
+ @param url Any URL on the host, i.e. MKAPIServerURL or MKVideoAPIServerURL.
+
+ @param count Number of connections to open, limited to maximumRequestsPerHost.
+ */
+- (void)prewarmHost:(NSURL *)url connections:(NSUInteger)count;
+
+/*!
+ @brief Request statistics.
+
+ Contains NSNumbers for MKHostThrottleRequestCountKey (requests started), MKHostThrottleTotalTimeToFirstByteKey and MKHostThrottleAverageTimeToFirstByteKey (seconds from starting a request to its first response byte, a request that reuses a connection skips the handshake and should show a shorter time) and MKHostThrottleWaitingRequestCountKey (requests waiting for the host's limit).
+
+ Which requests were sent on a reused connection isn't reported, CFNetwork doesn't say.
+ */
+- (NSDictionary *)statistics;
+
+- (void)resetStatistics;
+
+@end
@@ -0,0 +1,424 @@
+//
+//  MKHostThrottleTransport.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKHostThrottleTransport.h"
+
+NSString *MKHostThrottleRequestCountKey = @"MKHostThrottleRequestCount";
+NSString *MKHostThrottleTotalTimeToFirstByteKey = @"MKHostThrottleTotalTimeToFirstByte";
+NSString *MKHostThrottleAverageTimeToFirstByteKey = @"MKHostThrottleAverageTimeToFirstByte";
+NSString *MKHostThrottleWaitingRequestCountKey = @"MKHostThrottleWaitingRequestCount";
+
+static const CFIndex MKThrottledReadBufferSize = 16 * 1024;
+
+
+//the requests in flight to one host and the ones waiting for the host's limit. which socket a request goes out on is up to CFNetwork
+@interface MKHostQueue : NSObject {
+@public
+	NSUInteger activeCount;
+	NSMutableArray *waiting;
+}
+@end
+
+@implementation MKHostQueue
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		waiting = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[waiting release];
+	[super dealloc];
+}
+
+@end
+
+
+@class MKThrottledConnection;
+
+@interface MKHostThrottleTransport (Private)
++ (NSString *)hostKeyForURL:(NSURL *)url;
+- (MKHostQueue *)queueForURL:(NSURL *)url;
+- (void)enqueueConnection:(MKThrottledConnection *)connection;
+- (void)startWaitingConnectionsInQueue:(MKHostQueue *)queue;
+- (void)connectionDidStart:(MKThrottledConnection *)connection;
+- (void)connection:(MKThrottledConnection *)connection didReceiveFirstByteAfter:(NSTimeInterval)timeToFirstByte;
+- (void)connectionDidFinish:(MKThrottledConnection *)connection;
+- (void)cancelWaitingConnection:(MKThrottledConnection *)connection;
+@end
+
+
+//stands in for NSURLConnection, runs one request through a CFHTTPStream once the host's limit allows it
+@interface MKThrottledConnection : NSObject {
+@public
+	NSURLRequest *urlRequest;
+	id delegate;
+	MKHostThrottleTransport *transport;
+	CFReadStreamRef stream;
+	NSTimer *timeoutTimer;
+	NSTimeInterval startTime;
+	BOOL started;
+	BOOL receivedBytes;
+	BOOL finished;
+}
+- (id)initWithRequest:(NSURLRequest *)aRequest delegate:(id)aDelegate transport:(MKHostThrottleTransport *)aTransport;
+- (void)start;
+- (void)handleEvent:(CFStreamEventType)event;
+- (void)cancel;
+@end
+
+
+@interface MKThrottledConnection (Private)
+- (void)readAvailableBytes;
+- (void)failWithError:(NSError *)error;
+- (void)finish;
+- (void)timedOut:(NSTimer *)timer;
+@end
+
+
+static void MKThrottledStreamCallback(CFReadStreamRef stream, CFStreamEventType event, void *info)
+{
+	[(MKThrottledConnection *)info handleEvent:event];
+}
+
+
+@implementation MKThrottledConnection
+
+- (id)initWithRequest:(NSURLRequest *)aRequest delegate:(id)aDelegate transport:(MKHostThrottleTransport *)aTransport
+{
+	self = [super init];
+	if (self != nil) {
+		urlRequest = [aRequest copy];
+		//NSURLConnection keeps its delegate until it is done, so do we
+		delegate = [aDelegate retain];
+		transport = [aTransport retain];
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[urlRequest release];
+	[delegate release];
+	[transport release];
+	[super dealloc];
+}
+
+
+- (void)start
+{
+	//released when the request finishes
+	[self retain];
+	started = YES;
+	startTime = [NSDate timeIntervalSinceReferenceDate];
+	[transport connectionDidStart:self];
+
+	NSString *httpMethod = [urlRequest HTTPMethod] != nil ? [urlRequest HTTPMethod] : @"GET";
+	CFHTTPMessageRef message = CFHTTPMessageCreateRequest(kCFAllocatorDefault, (CFStringRef)httpMethod, (CFURLRef)[urlRequest URL], kCFHTTPVersion1_1);
+	for (NSString *header in [urlRequest allHTTPHeaderFields]) {
+		CFHTTPMessageSetHeaderFieldValue(message, (CFStringRef)header, (CFStringRef)[[urlRequest allHTTPHeaderFields] objectForKey:header]);
+	}
+	CFHTTPMessageSetHeaderFieldValue(message, CFSTR("Connection"), CFSTR("keep-alive"));
+
+	if ([urlRequest HTTPBodyStream] != nil) {
+		stream = CFReadStreamCreateForStreamedHTTPRequest(kCFAllocatorDefault, message, (CFReadStreamRef)[urlRequest HTTPBodyStream]);
+	} else {
+		if ([urlRequest HTTPBody] != nil) {
+			CFHTTPMessageSetBody(message, (CFDataRef)[urlRequest HTTPBody]);
+		}
+		stream = CFReadStreamCreateForHTTPRequest(kCFAllocatorDefault, message);
+	}
+	CFRelease(message);
+
+	//lets CFNetwork keep the socket and TLS session open for the next request to the host, and send this one on a socket it kept
+	CFReadStreamSetProperty(stream, kCFStreamPropertyHTTPAttemptPersistentConnection, kCFBooleanTrue);
+	CFReadStreamSetProperty(stream, kCFStreamPropertyHTTPShouldAutoredirect, kCFBooleanTrue);
+
+	CFStreamClientContext context = {0, self, NULL, NULL, NULL};
+	CFReadStreamSetClient(stream, kCFStreamEventHasBytesAvailable | kCFStreamEventEndEncountered | kCFStreamEventErrorOccurred, MKThrottledStreamCallback, &context);
+	CFReadStreamScheduleWithRunLoop(stream, CFRunLoopGetCurrent(), kCFRunLoopCommonModes);
+
+	if ([urlRequest timeoutInterval] > 0) {
+		timeoutTimer = [NSTimer timerWithTimeInterval:[urlRequest timeoutInterval] target:self selector:@selector(timedOut:) userInfo:nil repeats:NO];
+		[[NSRunLoop currentRunLoop] addTimer:timeoutTimer forMode:NSRunLoopCommonModes];
+	}
+
+	if (CFReadStreamOpen(stream) == NO) {
+		CFErrorRef error = CFReadStreamCopyError(stream);
+		[self failWithError:[(NSError *)error autorelease]];
+	}
+}
+
+
+- (void)handleEvent:(CFStreamEventType)event
+{
+	//the delegate may release the connection from its callbacks
+	[[self retain] autorelease];
+
+	switch (event) {
+		case kCFStreamEventHasBytesAvailable:
+			[self readAvailableBytes];
+			break;
+		case kCFStreamEventEndEncountered:
+			[self readAvailableBytes];
+			if (finished == NO) {
+				[delegate connectionDidFinishLoading:(NSURLConnection *)self];
+				[self finish];
+			}
+			break;
+		case kCFStreamEventErrorOccurred: {
+			CFErrorRef error = CFReadStreamCopyError(stream);
+			[self failWithError:[(NSError *)error autorelease]];
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+
+- (void)cancel
+{
+	if (started == NO) {
+		[transport cancelWaitingConnection:self];
+		[delegate release];
+		delegate = nil;
+		return;
+	}
+	if (finished == NO) {
+		//closing the stream early makes CFNetwork drop the socket rather than reuse it in an unknown state
+		[self finish];
+	}
+}
+
+
+#pragma mark Private Methods
+
+- (void)readAvailableBytes
+{
+	UInt8 buffer[MKThrottledReadBufferSize];
+	while (finished == NO && CFReadStreamHasBytesAvailable(stream)) {
+		CFIndex length = CFReadStreamRead(stream, buffer, MKThrottledReadBufferSize);
+		if (length <= 0) {
+			break;
+		}
+		if (receivedBytes == NO) {
+			receivedBytes = YES;
+			[transport connection:self didReceiveFirstByteAfter:[NSDate timeIntervalSinceReferenceDate] - startTime];
+		}
+		[delegate connection:(NSURLConnection *)self didReceiveData:[NSData dataWithBytes:buffer length:length]];
+	}
+}
+
+
+- (void)failWithError:(NSError *)error
+{
+	if (finished == YES) {
+		return;
+	}
+	id failedDelegate = [[delegate retain] autorelease];
+	[self finish];
+	if ([failedDelegate respondsToSelector:@selector(connection:didFailWithError:)]) {
+		[failedDelegate connection:(NSURLConnection *)self didFailWithError:error];
+	}
+}
+
+
+- (void)timedOut:(NSTimer *)timer
+{
+	timeoutTimer = nil;
+	[self failWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil]];
+}
+
+
+- (void)finish
+{
+	finished = YES;
+	[timeoutTimer invalidate];
+	timeoutTimer = nil;
+	if (stream != NULL) {
+		CFReadStreamSetClient(stream, kCFStreamEventNone, NULL, NULL);
+		CFReadStreamUnscheduleFromRunLoop(stream, CFRunLoopGetCurrent(), kCFRunLoopCommonModes);
+		CFReadStreamClose(stream);
+		CFRelease(stream);
+		stream = NULL;
+	}
+	[delegate release];
+	delegate = nil;
+	[transport connectionDidFinish:self];
+	//balances the retain in start
+	[self autorelease];
+}
+
+@end
+
+
+
+@implementation MKHostThrottleTransport
+
+@synthesize maximumRequestsPerHost;
+
+
++ (MKHostThrottleTransport *)transport
+{
+	return [[[MKHostThrottleTransport alloc] init] autorelease];
+}
+
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_hostQueues = [[NSMutableDictionary alloc] init];
+		maximumRequestsPerHost = 4;
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[_hostQueues release];
+	[super dealloc];
+}
+
+
+- (void)prewarmHost:(NSURL *)url connections:(NSUInteger)count
+{
+	MKHostQueue *queue = [self queueForURL:url];
+	count = MIN(count, maximumRequestsPerHost);
+
+	//only requests running at the same time need connections of their own
+	for (NSUInteger i = queue->activeCount; i < count; i++) {
+		NSMutableURLRequest *headRequest = [NSMutableURLRequest requestWithURL:url cachePolicy:NSURLRequestReloadIgnoringCacheData timeoutInterval:30];
+		[headRequest setHTTPMethod:@"HEAD"];
+		MKThrottledConnection *connection = [[[MKThrottledConnection alloc] initWithRequest:headRequest delegate:nil transport:self] autorelease];
+		[self enqueueConnection:connection];
+	}
+}
+
+
+- (NSDictionary *)statistics
+{
+	NSUInteger waiting = 0;
+	for (MKHostQueue *queue in [_hostQueues objectEnumerator]) {
+		waiting += [queue->waiting count];
+	}
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInteger:_requestCount], MKHostThrottleRequestCountKey,
+			[NSNumber numberWithDouble:_totalTimeToFirstByte], MKHostThrottleTotalTimeToFirstByteKey,
+			[NSNumber numberWithDouble:_firstByteCount > 0 ? _totalTimeToFirstByte / _firstByteCount : 0], MKHostThrottleAverageTimeToFirstByteKey,
+			[NSNumber numberWithUnsignedInteger:waiting], MKHostThrottleWaitingRequestCountKey,
+			nil];
+}
+
+
+- (void)resetStatistics
+{
+	_requestCount = 0;
+	_firstByteCount = 0;
+	_totalTimeToFirstByte = 0;
+}
+
+
+#pragma mark MKFacebookTransport Methods
+
+- (id)connectionWithRequest:(NSURLRequest *)urlRequest delegate:(id)aDelegate
+{
+	MKThrottledConnection *connection = [[[MKThrottledConnection alloc] initWithRequest:urlRequest delegate:aDelegate transport:self] autorelease];
+	[self enqueueConnection:connection];
+	return connection;
+}
+
+
+- (NSData *)sendSynchronousRequest:(NSURLRequest *)urlRequest returningResponse:(NSURLResponse **)response error:(NSError **)error
+{
+	return [NSURLConnection sendSynchronousRequest:urlRequest returningResponse:response error:error];
+}
+
+
+#pragma mark Private Methods
+
++ (NSString *)hostKeyForURL:(NSURL *)url
+{
+	NSNumber *port = [url port];
+	if (port == nil) {
+		port = [NSNumber numberWithInt:[[url scheme] caseInsensitiveCompare:@"https"] == NSOrderedSame ? 443 : 80];
+	}
+	return [NSString stringWithFormat:@"%@://%@:%@", [[url scheme] lowercaseString], [[url host] lowercaseString], port];
+}
+
+
+- (MKHostQueue *)queueForURL:(NSURL *)url
+{
+	NSString *key = [MKHostThrottleTransport hostKeyForURL:url];
+	MKHostQueue *queue = [_hostQueues objectForKey:key];
+	if (queue == nil) {
+		queue = [[[MKHostQueue alloc] init] autorelease];
+		[_hostQueues setObject:queue forKey:key];
+	}
+	return queue;
+}
+
+
+- (void)enqueueConnection:(MKThrottledConnection *)connection
+{
+	MKHostQueue *queue = [self queueForURL:[connection->urlRequest URL]];
+	[queue->waiting addObject:connection];
+	[self startWaitingConnectionsInQueue:queue];
+}
+
+
+- (void)startWaitingConnectionsInQueue:(MKHostQueue *)queue
+{
+	while ([queue->waiting count] > 0 && queue->activeCount < MAX(maximumRequestsPerHost, (NSUInteger)1)) {
+		MKThrottledConnection *connection = [[[queue->waiting objectAtIndex:0] retain] autorelease];
+		[queue->waiting removeObjectAtIndex:0];
+		queue->activeCount++;
+		[connection start];
+	}
+}
+
+
+- (void)connectionDidStart:(MKThrottledConnection *)connection
+{
+	_requestCount++;
+}
+
+
+//includes the handshake when CFNetwork had to open a new connection
+- (void)connection:(MKThrottledConnection *)connection didReceiveFirstByteAfter:(NSTimeInterval)timeToFirstByte
+{
+	_firstByteCount++;
+	_totalTimeToFirstByte += timeToFirstByte;
+}
+
+
+- (void)connectionDidFinish:(MKThrottledConnection *)connection
+{
+	MKHostQueue *queue = [self queueForURL:[connection->urlRequest URL]];
+	queue->activeCount -= MIN(queue->activeCount, (NSUInteger)1);
+	[self startWaitingConnectionsInQueue:queue];
+}
+
+
+- (void)cancelWaitingConnection:(MKThrottledConnection *)connection
+{
+	for (MKHostQueue *queue in [_hostQueues objectEnumerator]) {
+		[queue->waiting removeObjectIdenticalTo:connection];
+	}
+}
+
+@end
@@ -0,0 +1,86 @@
+//
+//  MKLoopbackTransport.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "MKFacebookTransport.h"
+
+
+/*!
+ @class MKLoopbackTransport
+
+ Answers requests in process from scripted responses, no network involved.
+
+ Useful for testing code that sends requests, and for measuring the queue, retry and parsing code under repeatable conditions. Responses are scripted per method and replayed in the order they were added. The last response for a method is repeated for every later request. Request bodies, streamed ones included, are read first and reported through connection:didSendBodyData:totalBytesWritten:totalBytesExpectedToWrite:, so upload progress can be tested too. Each response is then delivered after latency seconds, in chunks limited to bytesPerSecond, from timers on the run loop of the thread that started the request.
+
+ @verbatim
+ MKLoopbackTransport *loopback = [MKLoopbackTransport transport];
+ loopback.latency = 0.2;
+ [loopback addErrorCode:4 forMethod:@"photos.getAlbums"];
+ [loopback addResponse:@"[{\"aid\":\"1\"}]" forMethod:@"photos.getAlbums"];
+ [MKFacebookRequest setDefaultTransport:loopback];
+ @endverbatim
+
+ Error responses are written in the response format the request asked for. Requests for a method without a script fail with NSURLErrorResourceUnavailable.
+
+ @version 0.9 and later
+ */
+@interface MKLoopbackTransport : NSObject <MKFacebookTransport> {
+	NSMutableDictionary *_scripts;
+	NSMutableDictionary *_requestCounts;
+	NSUInteger _requestCount;
+	NSTimeInterval latency;
+	NSUInteger bytesPerSecond;
+}
+
++ (MKLoopbackTransport *)transport;
+
+/*!
+ @brief Seconds between the start of a request and its first byte. Default is 0.
+ */
+@property NSTimeInterval latency;
+
+/*!
+ @brief Speed request bodies are read and responses delivered at. 0, the default, reads each body and delivers each response in one piece.
+ */
+@property NSUInteger bytesPerSecond;
+
+/*!
+ @brief Script a response body, raw XML or JSON.
+
+ @param aMethod The method the response is for, nil for any method without a script of its own.
+ */
+- (void)addResponse:(NSString *)body forMethod:(NSString *)aMethod;
+
+/*!
+ @brief Script a Facebook error response.
+
+ 1 (unknown error), 2 (service unavailable) and 4 (too many requests) are retried by MKFacebookRequest, other codes are passed to the delegate.
+ */
+- (void)addErrorCode:(int)errorCode forMethod:(NSString *)aMethod;
+
+/*!
+ @brief Script a connection failure, passed to connection:didFailWithError:.
+ */
+- (void)addFailure:(NSError *)error forMethod:(NSString *)aMethod;
+
+/*!
+ @brief Forget all scripted responses and reset the request counts.
+ */
+- (void)removeAllResponses;
+
+/*!
+ @brief Number of requests received.
+ */
+- (NSUInteger)requestCount;
+
+/*!
+ @brief Number of requests received for a method.
+ */
+- (NSUInteger)requestCountForMethod:(NSString *)aMethod;
+
+@end
@@ -0,0 +1,468 @@
+//
+//  MKLoopbackTransport.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKLoopbackTransport.h"
+
+//scripts added with a nil method
+static NSString *MKLoopbackAnyMethod = @"*";
+
+//delivery speed is simulated in slices of this many seconds
+static const NSTimeInterval MKLoopbackSliceInterval = 0.01;
+
+//request bodies are read in pieces of at most this many bytes
+#define MKLoopbackReadBufferSize 16384
+
+
+//one scripted answer: a body, a Facebook error code or a connection failure
+@interface MKLoopbackResponse : NSObject {
+@public
+	NSString *body;
+	int errorCode;
+	NSError *error;
+}
+@end
+
+@implementation MKLoopbackResponse
+
+- (void)dealloc
+{
+	[body release];
+	[error release];
+	[super dealloc];
+}
+
+@end
+
+
+//stands in for NSURLConnection, delivers a response to the delegate from run loop timers
+@interface MKLoopbackConnection : NSObject {
+	id _delegate;
+	NSData *_data;
+	NSError *_error;
+	NSUInteger _offset;
+	NSUInteger _chunkSize;
+	NSTimeInterval _chunkInterval;
+	NSTimeInterval _latency;
+	NSTimer *_timer;
+	NSInputStream *_bodyStream;
+	NSInteger _bodyLength;
+	NSInteger _bodyBytesWritten;
+}
+- (id)initWithDelegate:(id)aDelegate data:(NSData *)data error:(NSError *)error;
+- (void)setRequestBody:(NSURLRequest *)urlRequest;
+- (void)startAfterDelay:(NSTimeInterval)delay bytesPerSecond:(NSUInteger)bytesPerSecond;
+- (void)cancel;
+@end
+
+
+@interface MKLoopbackConnection (Private)
+- (void)scheduleTimerAfterDelay:(NSTimeInterval)delay;
+- (void)deliver:(NSTimer *)timer;
+- (void)sendBody;
+- (void)closeBody;
+- (void)finish;
+@end
+
+
+@implementation MKLoopbackConnection
+
+- (id)initWithDelegate:(id)aDelegate data:(NSData *)data error:(NSError *)error
+{
+	self = [super init];
+	if (self != nil) {
+		//NSURLConnection keeps its delegate until it is done, so do we
+		_delegate = [aDelegate retain];
+		_data = [data retain];
+		_error = [error retain];
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[_timer invalidate];
+	[self closeBody];
+	[_delegate release];
+	[_data release];
+	[_error release];
+	[super dealloc];
+}
+
+
+//the body is read like NSURLConnection writes it, before the response starts
+- (void)setRequestBody:(NSURLRequest *)urlRequest
+{
+	NSString *contentLength = [urlRequest valueForHTTPHeaderField:@"Content-Length"];
+	if ([urlRequest HTTPBodyStream] != nil) {
+		_bodyStream = [[urlRequest HTTPBodyStream] retain];
+		_bodyLength = contentLength != nil ? (NSInteger)[contentLength longLongValue] : NSURLResponseUnknownLength;
+	} else if ([[urlRequest HTTPBody] length] > 0) {
+		_bodyStream = [[NSInputStream alloc] initWithData:[urlRequest HTTPBody]];
+		_bodyLength = (NSInteger)[[urlRequest HTTPBody] length];
+	}
+	[_bodyStream open];
+}
+
+
+- (void)startAfterDelay:(NSTimeInterval)delay bytesPerSecond:(NSUInteger)bytesPerSecond
+{
+	if (bytesPerSecond > 0) {
+		_chunkSize = MAX((NSUInteger)(bytesPerSecond * MKLoopbackSliceInterval), (NSUInteger)1);
+		_chunkInterval = (NSTimeInterval)_chunkSize / bytesPerSecond;
+	} else {
+		_chunkSize = NSUIntegerMax;
+		_chunkInterval = 0;
+	}
+	_latency = delay;
+	[self scheduleTimerAfterDelay:_bodyStream != nil ? 0 : delay];
+}
+
+
+- (void)cancel
+{
+	[_timer invalidate];
+	_timer = nil;
+	[self closeBody];
+	[_delegate release];
+	_delegate = nil;
+}
+
+
+#pragma mark Private Methods
+
+- (void)scheduleTimerAfterDelay:(NSTimeInterval)delay
+{
+	_timer = [NSTimer timerWithTimeInterval:delay target:self selector:@selector(deliver:) userInfo:nil repeats:NO];
+	[[NSRunLoop currentRunLoop] addTimer:_timer forMode:NSRunLoopCommonModes];
+}
+
+
+- (void)deliver:(NSTimer *)timer
+{
+	_timer = nil;
+	//the delegate may release us from its callbacks
+	[[self retain] autorelease];
+
+	if (_bodyStream != nil) {
+		[self sendBody];
+		return;
+	}
+
+	if (_error != nil) {
+		if ([_delegate respondsToSelector:@selector(connection:didFailWithError:)]) {
+			[_delegate connection:(NSURLConnection *)self didFailWithError:_error];
+		}
+		[self finish];
+		return;
+	}
+
+	NSUInteger length = MIN(_chunkSize, [_data length] - _offset);
+	if (length > 0) {
+		NSData *chunk = [_data subdataWithRange:NSMakeRange(_offset, length)];
+		_offset += length;
+		[_delegate connection:(NSURLConnection *)self didReceiveData:chunk];
+	}
+
+	if (_delegate == nil) {
+		return;
+	}
+	if (_offset < [_data length]) {
+		[self scheduleTimerAfterDelay:_chunkInterval];
+	} else {
+		[_delegate connectionDidFinishLoading:(NSURLConnection *)self];
+		[self finish];
+	}
+}
+
+
+//reads one slice of the request body and reports it. the response follows latency seconds after the last byte
+- (void)sendBody
+{
+	uint8_t buffer[MKLoopbackReadBufferSize];
+	NSUInteger sent = 0;
+	BOOL done = NO;
+
+	while (sent < _chunkSize) {
+		NSInteger count = [_bodyStream read:buffer maxLength:MIN((NSUInteger)MKLoopbackReadBufferSize, _chunkSize - sent)];
+		if (count < 0) {
+			NSError *error = [_bodyStream streamError];
+			if (error == nil) {
+				error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotOpenFile userInfo:nil];
+			}
+			[self closeBody];
+			if ([_delegate respondsToSelector:@selector(connection:didFailWithError:)]) {
+				[_delegate connection:(NSURLConnection *)self didFailWithError:error];
+			}
+			[self finish];
+			return;
+		}
+		if (count == 0) {
+			done = YES;
+			break;
+		}
+		sent += count;
+	}
+
+	if (sent > 0) {
+		_bodyBytesWritten += sent;
+		if ([_delegate respondsToSelector:@selector(connection:didSendBodyData:totalBytesWritten:totalBytesExpectedToWrite:)]) {
+			[_delegate connection:(NSURLConnection *)self didSendBodyData:sent totalBytesWritten:_bodyBytesWritten totalBytesExpectedToWrite:_bodyLength];
+		}
+	}
+
+	if (_delegate == nil) {
+		return;
+	}
+	if (done == YES) {
+		[self closeBody];
+		[self scheduleTimerAfterDelay:_latency];
+	} else {
+		[self scheduleTimerAfterDelay:_chunkInterval];
+	}
+}
+
+
+- (void)closeBody
+{
+	[_bodyStream close];
+	[_bodyStream release];
+	_bodyStream = nil;
+}
+
+
+- (void)finish
+{
+	[_delegate release];
+	_delegate = nil;
+}
+
+@end
+
+
+
+@interface MKLoopbackTransport (Private)
+- (void)addScript:(MKLoopbackResponse *)response forMethod:(NSString *)aMethod;
+- (MKLoopbackResponse *)nextResponseForMethod:(NSString *)aMethod;
+- (NSString *)methodForRequest:(NSURLRequest *)urlRequest;
+- (BOOL)requestWantsJSON:(NSURLRequest *)urlRequest;
+- (NSData *)bodyForResponse:(MKLoopbackResponse *)response request:(NSURLRequest *)urlRequest error:(NSError **)error;
+@end
+
+
+@implementation MKLoopbackTransport
+
+@synthesize latency;
+@synthesize bytesPerSecond;
+
+
++ (MKLoopbackTransport *)transport
+{
+	return [[[MKLoopbackTransport alloc] init] autorelease];
+}
+
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_scripts = [[NSMutableDictionary alloc] init];
+		_requestCounts = [[NSMutableDictionary alloc] init];
+		latency = 0;
+		bytesPerSecond = 0;
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[_scripts release];
+	[_requestCounts release];
+	[super dealloc];
+}
+
+
+- (void)addResponse:(NSString *)body forMethod:(NSString *)aMethod
+{
+	MKLoopbackResponse *response = [[[MKLoopbackResponse alloc] init] autorelease];
+	response->body = [body copy];
+	[self addScript:response forMethod:aMethod];
+}
+
+
+- (void)addErrorCode:(int)errorCode forMethod:(NSString *)aMethod
+{
+	MKLoopbackResponse *response = [[[MKLoopbackResponse alloc] init] autorelease];
+	response->errorCode = errorCode;
+	[self addScript:response forMethod:aMethod];
+}
+
+
+- (void)addFailure:(NSError *)error forMethod:(NSString *)aMethod
+{
+	MKLoopbackResponse *response = [[[MKLoopbackResponse alloc] init] autorelease];
+	response->error = [error retain];
+	[self addScript:response forMethod:aMethod];
+}
+
+
+- (void)removeAllResponses
+{
+	@synchronized(self) {
+		[_scripts removeAllObjects];
+		[_requestCounts removeAllObjects];
+		_requestCount = 0;
+	}
+}
+
+
+- (NSUInteger)requestCount
+{
+	@synchronized(self) {
+		return _requestCount;
+	}
+	return 0;
+}
+
+
+- (NSUInteger)requestCountForMethod:(NSString *)aMethod
+{
+	@synchronized(self) {
+		return [[_requestCounts objectForKey:aMethod] unsignedIntegerValue];
+	}
+	return 0;
+}
+
+
+#pragma mark MKFacebookTransport Methods
+
+- (id)connectionWithRequest:(NSURLRequest *)urlRequest delegate:(id)aDelegate
+{
+	NSError *error = nil;
+	NSData *body = [self bodyForResponse:[self nextResponseForMethod:[self methodForRequest:urlRequest]] request:urlRequest error:&error];
+
+	MKLoopbackConnection *connection = [[[MKLoopbackConnection alloc] initWithDelegate:aDelegate data:body error:error] autorelease];
+	[connection setRequestBody:urlRequest];
+	[connection startAfterDelay:latency bytesPerSecond:bytesPerSecond];
+	return connection;
+}
+
+
+- (NSData *)sendSynchronousRequest:(NSURLRequest *)urlRequest returningResponse:(NSURLResponse **)response error:(NSError **)error
+{
+	NSError *scriptedError = nil;
+	NSData *body = [self bodyForResponse:[self nextResponseForMethod:[self methodForRequest:urlRequest]] request:urlRequest error:&scriptedError];
+
+	NSTimeInterval duration = latency + (bytesPerSecond > 0 ? (NSTimeInterval)[body length] / bytesPerSecond : 0);
+	if (duration > 0) {
+		[NSThread sleepForTimeInterval:duration];
+	}
+
+	if (response != NULL) {
+		*response = nil;
+	}
+	if (error != NULL) {
+		*error = scriptedError;
+	}
+	return body;
+}
+
+
+#pragma mark Private Methods
+
+- (void)addScript:(MKLoopbackResponse *)response forMethod:(NSString *)aMethod
+{
+	NSString *key = aMethod != nil ? aMethod : MKLoopbackAnyMethod;
+	@synchronized(self) {
+		NSMutableArray *script = [_scripts objectForKey:key];
+		if (script == nil) {
+			script = [NSMutableArray array];
+			[_scripts setObject:script forKey:key];
+		}
+		[script addObject:response];
+	}
+}
+
+
+//responses are used up in order, the last one keeps answering
+- (MKLoopbackResponse *)nextResponseForMethod:(NSString *)aMethod
+{
+	@synchronized(self) {
+		_requestCount++;
+		NSUInteger count = [[_requestCounts objectForKey:aMethod] unsignedIntegerValue];
+		[_requestCounts setObject:[NSNumber numberWithUnsignedInteger:count + 1] forKey:aMethod];
+
+		NSMutableArray *script = [_scripts objectForKey:aMethod];
+		if (script == nil) {
+			script = [_scripts objectForKey:MKLoopbackAnyMethod];
+		}
+		if ([script count] == 0) {
+			return nil;
+		}
+		MKLoopbackResponse *response = [[[script objectAtIndex:0] retain] autorelease];
+		if ([script count] > 1) {
+			[script removeObjectAtIndex:0];
+		}
+		return response;
+	}
+	return nil;
+}
+
+
+//REST methods are the last part of the path, i.e. https://api.facebook.com/method/users.getInfo
+- (NSString *)methodForRequest:(NSURLRequest *)urlRequest
+{
+	NSString *aMethod = [[[urlRequest URL] path] lastPathComponent];
+	return aMethod != nil ? aMethod : @"";
+}
+
+
+//GET requests carry format in the query, POST requests in a form field. streamed bodies can't be looked at and get XML
+- (BOOL)requestWantsJSON:(NSURLRequest *)urlRequest
+{
+	NSString *query = [[urlRequest URL] query];
+	if (query != nil && [query rangeOfString:@"format=JSON"].location != NSNotFound) {
+		return YES;
+	}
+	NSData *body = [urlRequest HTTPBody];
+	const char *field = "name=\"format\"\r\n\r\nJSON";
+	if (body != nil && memmem([body bytes], [body length], field, strlen(field)) != NULL) {
+		return YES;
+	}
+	return NO;
+}
+
+
+- (NSData *)bodyForResponse:(MKLoopbackResponse *)response request:(NSURLRequest *)urlRequest error:(NSError **)error
+{
+	if (response == nil) {
+		NSDictionary *userInfo = [NSDictionary dictionaryWithObject:[NSString stringWithFormat:@"No response scripted for %@", [self methodForRequest:urlRequest]] forKey:NSLocalizedDescriptionKey];
+		*error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorResourceUnavailable userInfo:userInfo];
+		return nil;
+	}
+	if (response->error != nil) {
+		*error = response->error;
+		return nil;
+	}
+	if (response->body != nil) {
+		return [response->body dataUsingEncoding:NSUTF8StringEncoding];
+	}
+
+	//same shape as the errors Facebook sends, request_args has to be there for the response to be recognized as an error
+	NSString *message = [NSString stringWithFormat:@"Loopback error %d", response->errorCode];
+	NSString *body = nil;
+	if ([self requestWantsJSON:urlRequest]) {
+		body = [NSString stringWithFormat:@"{\"error_code\":%d,\"error_msg\":\"%@\",\"request_args\":[]}", response->errorCode, message];
+	} else {
+		body = [NSString stringWithFormat:@"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<error_response xmlns=\"http://api.facebook.com/1.0/\"><error_code>%d</error_code><error_msg>%@</error_msg><request_args list=\"true\"/></error_response>", response->errorCode, message];
+	}
+	return [body dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+@end
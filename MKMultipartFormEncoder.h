@@ -0,0 +1,86 @@
+//
+//  MKMultipartFormEncoder.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+@class MKMultipartInputStream;
+struct MKMultipartFormPart;
+
+
+/*!
+ @class MKMultipartFormEncoder
+
+ Builds the multipart/form-data body of a POST request.
+
+ Parts are collected first and the body is written in one pass once the exact size is known. All form fields and part headers are written into a single buffer allocated at its final size. Binary data and files are referenced rather than copied: bodyStream reads them in place next to the ranges of the header buffer.
+
+ @version 0.9 and later
+ */
+@interface MKMultipartFormEncoder : NSObject {
+	struct MKMultipartFormPart *_parts;
+	NSUInteger _count;
+	NSUInteger _capacity;
+	NSUInteger _textLength;
+	unsigned long long _binaryLength;
+	NSMutableData *_textBuffer;
+}
+
+/*!
+ @brief Content-Type header value for the body, including the boundary.
+ */
++ (NSString *)contentType;
+
+/*!
+ @param capacity Number of parts expected, avoids growing the part list.
+ */
+- (id)initWithCapacity:(NSUInteger)capacity;
+
+/*!
+ @brief Add a form field.
+
+ Objects other than NSString are sent using their description.
+ */
+- (void)addFieldWithName:(NSString *)name value:(id)value;
+
+/*!
+ @brief Add a block of binary data.
+
+ The data is retained, not copied.
+ */
+- (void)addData:(NSData *)data filename:(NSString *)filename contentType:(NSString *)contentType;
+
+/*!
+ @brief Add a range of a file. The file is read when the body is streamed.
+ */
+- (void)addFileAtPath:(NSString *)path offset:(unsigned long long)offset length:(unsigned long long)length filename:(NSString *)filename contentType:(NSString *)contentType;
+
+/*!
+ @brief YES if the form contains binary data or files.
+ */
+- (BOOL)hasBinaryParts;
+
+/*!
+ @brief Total length of the body in bytes.
+ */
+- (unsigned long long)length;
+
+/*!
+ @brief The whole body in a single buffer.
+
+ Binary data is copied into the buffer. Forms containing files can't be returned as data, use bodyStream instead.
+ */
+- (NSData *)bodyData;
+
+/*!
+ @brief A stream reading the body without copying binary data or files.
+
+ Returns nil if a file is missing, can't be read or is shorter than the range that was added. The error is in NSCocoaErrorDomain with the path under NSFilePathErrorKey.
+ */
+- (MKMultipartInputStream *)bodyStream:(NSError **)error;
+
+@end
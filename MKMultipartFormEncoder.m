@@ -0,0 +1,300 @@
+//
+//  MKMultipartFormEncoder.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKMultipartFormEncoder.h"
+#import "MKMultipartInputStream.h"
+
+#define MKMultipartFormBoundary "xXxiFyOuTyPeThIsThEwOrLdWiLlExPlOdExXx"
+
+//everything that doesn't depend on the parameters is a compile time constant
+static const char MKMultipartFormOpening[] = "--" MKMultipartFormBoundary "\r\n";
+static const char MKMultipartFormEndLine[] = "\r\n--" MKMultipartFormBoundary "\r\n";
+static const char MKMultipartFormNamePrefix[] = "Content-Disposition: form-data; name=\"";
+static const char MKMultipartFormNameSuffix[] = "\"\r\n\r\n";
+static const char MKMultipartFormFilenamePrefix[] = "Content-Disposition: form-data; filename=\"";
+static const char MKMultipartFormFilenameSuffix[] = "\"\r\n";
+static const char MKMultipartFormContentTypePrefix[] = "Content-Type: ";
+static const char MKMultipartFormContentTypeSuffix[] = "\r\n\r\n";
+
+#define MKStaticLength(s) (sizeof(s) - 1)
+
+enum {
+	MKMultipartFormFieldPart,
+	MKMultipartFormDataPart,
+	MKMultipartFormFilePart
+};
+
+struct MKMultipartFormPart {
+	int kind;
+	NSString *name;				//field name or filename
+	NSUInteger nameLength;
+	id value;					//NSString field value, NSData or file path
+	NSUInteger valueLength;		//encoded length of a field value
+	NSString *contentType;
+	NSUInteger contentTypeLength;
+	unsigned long long offset;	//file offset
+	unsigned long long length;	//binary length
+	NSUInteger textOffset;		//where the binary goes in the text buffer
+};
+
+
+static inline NSUInteger MKUTF8Length(NSString *string)
+{
+	return [string lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+}
+
+static inline char *MKAppendBytes(char *buffer, const char *bytes, NSUInteger length)
+{
+	memcpy(buffer, bytes, length);
+	return buffer + length;
+}
+
+static inline char *MKAppendString(char *buffer, NSString *string, NSUInteger length)
+{
+	NSUInteger used = 0;
+	[string getBytes:buffer maxLength:length usedLength:&used encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, [string length]) remainingRange:NULL];
+	return buffer + used;
+}
+
+
+@interface MKMultipartFormEncoder (Private)
+- (struct MKMultipartFormPart *)nextPart;
+- (void)writeText;
+- (NSError *)errorForFileAtPath:(NSString *)path;
+@end
+
+
+@implementation MKMultipartFormEncoder
+
++ (NSString *)contentType
+{
+	static NSString *contentType = nil;
+	if (contentType == nil) {
+		contentType = [[NSString alloc] initWithFormat:@"multipart/form-data; boundary=%s", MKMultipartFormBoundary];
+	}
+	return contentType;
+}
+
+
+- (id)init
+{
+	return [self initWithCapacity:16];
+}
+
+
+- (id)initWithCapacity:(NSUInteger)capacity
+{
+	self = [super init];
+	if (self != nil) {
+		_capacity = capacity > 0 ? capacity : 1;
+		_parts = calloc(_capacity, sizeof(struct MKMultipartFormPart));
+		_count = 0;
+		//the opening boundary and the extra end line after the last part
+		_textLength = MKStaticLength(MKMultipartFormOpening) + MKStaticLength(MKMultipartFormEndLine);
+		_binaryLength = 0;
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	for (NSUInteger i = 0; i < _count; i++) {
+		[_parts[i].name release];
+		[_parts[i].value release];
+		[_parts[i].contentType release];
+	}
+	free(_parts);
+	[_textBuffer release];
+	[super dealloc];
+}
+
+
+- (void)addFieldWithName:(NSString *)name value:(id)value
+{
+	struct MKMultipartFormPart *part = [self nextPart];
+	part->kind = MKMultipartFormFieldPart;
+	part->name = [name copy];
+	part->nameLength = MKUTF8Length(name);
+	part->value = [value isKindOfClass:[NSString class]] ? [value copy] : [[value description] copy];
+	part->valueLength = MKUTF8Length(part->value);
+	_textLength += MKStaticLength(MKMultipartFormNamePrefix) + part->nameLength + MKStaticLength(MKMultipartFormNameSuffix) + part->valueLength + MKStaticLength(MKMultipartFormEndLine);
+}
+
+
+- (void)addData:(NSData *)data filename:(NSString *)filename contentType:(NSString *)contentType
+{
+	struct MKMultipartFormPart *part = [self nextPart];
+	part->kind = MKMultipartFormDataPart;
+	part->name = [filename copy];
+	part->nameLength = MKUTF8Length(filename);
+	part->value = [data retain];
+	part->contentType = [contentType copy];
+	part->contentTypeLength = MKUTF8Length(contentType);
+	part->offset = 0;
+	part->length = [data length];
+	_textLength += MKStaticLength(MKMultipartFormFilenamePrefix) + part->nameLength + MKStaticLength(MKMultipartFormFilenameSuffix) + MKStaticLength(MKMultipartFormContentTypePrefix) + part->contentTypeLength + MKStaticLength(MKMultipartFormContentTypeSuffix) + MKStaticLength(MKMultipartFormEndLine);
+	_binaryLength += part->length;
+}
+
+
+- (void)addFileAtPath:(NSString *)path offset:(unsigned long long)offset length:(unsigned long long)length filename:(NSString *)filename contentType:(NSString *)contentType
+{
+	struct MKMultipartFormPart *part = [self nextPart];
+	part->kind = MKMultipartFormFilePart;
+	part->name = [filename copy];
+	part->nameLength = MKUTF8Length(filename);
+	part->value = [path copy];
+	part->contentType = [contentType copy];
+	part->contentTypeLength = MKUTF8Length(contentType);
+	part->offset = offset;
+	part->length = length;
+	_textLength += MKStaticLength(MKMultipartFormFilenamePrefix) + part->nameLength + MKStaticLength(MKMultipartFormFilenameSuffix) + MKStaticLength(MKMultipartFormContentTypePrefix) + part->contentTypeLength + MKStaticLength(MKMultipartFormContentTypeSuffix) + MKStaticLength(MKMultipartFormEndLine);
+	_binaryLength += part->length;
+}
+
+
+- (BOOL)hasBinaryParts
+{
+	for (NSUInteger i = 0; i < _count; i++) {
+		if (_parts[i].kind != MKMultipartFormFieldPart) {
+			return YES;
+		}
+	}
+	return NO;
+}
+
+
+- (unsigned long long)length
+{
+	return _textLength + _binaryLength;
+}
+
+
+- (NSData *)bodyData
+{
+	[self writeText];
+
+	NSMutableData *body = [NSMutableData dataWithLength:(NSUInteger)[self length]];
+	char *out = [body mutableBytes];
+	const char *text = [_textBuffer bytes];
+	NSUInteger textPosition = 0;
+
+	for (NSUInteger i = 0; i < _count; i++) {
+		struct MKMultipartFormPart *part = &_parts[i];
+		if (part->kind == MKMultipartFormFieldPart) {
+			continue;
+		}
+		NSAssert(part->kind == MKMultipartFormDataPart, @"Files can only be sent with bodyStream");
+		out = MKAppendBytes(out, text + textPosition, part->textOffset - textPosition);
+		out = MKAppendBytes(out, [part->value bytes], (NSUInteger)part->length);
+		textPosition = part->textOffset;
+	}
+	MKAppendBytes(out, text + textPosition, _textLength - textPosition);
+
+	return body;
+}
+
+
+- (MKMultipartInputStream *)bodyStream:(NSError **)error
+{
+	[self writeText];
+
+	MKMultipartInputStream *stream = [[[MKMultipartInputStream alloc] init] autorelease];
+	NSUInteger textPosition = 0;
+
+	for (NSUInteger i = 0; i < _count; i++) {
+		struct MKMultipartFormPart *part = &_parts[i];
+		if (part->kind == MKMultipartFormFieldPart) {
+			continue;
+		}
+		[stream appendData:_textBuffer range:NSMakeRange(textPosition, part->textOffset - textPosition)];
+		if (part->kind == MKMultipartFormDataPart) {
+			[stream appendData:part->value];
+		} else if ([[NSFileManager defaultManager] isReadableFileAtPath:part->value] == NO ||
+				   [stream appendFileAtPath:part->value offset:part->offset length:part->length] == NO) {
+			//a body without the file would still be accepted, with the wrong content
+			if (error != NULL) {
+				*error = [self errorForFileAtPath:part->value];
+			}
+			return nil;
+		}
+		textPosition = part->textOffset;
+	}
+	[stream appendData:_textBuffer range:NSMakeRange(textPosition, _textLength - textPosition)];
+
+	return stream;
+}
+
+
+#pragma mark Private Methods
+
+- (NSError *)errorForFileAtPath:(NSString *)path
+{
+	NSInteger code = NSFileReadUnknownError;
+	NSString *description = [NSString stringWithFormat:@"The upload file %@ is shorter than the part to be sent.", path];
+	if ([[NSFileManager defaultManager] fileExistsAtPath:path] == NO) {
+		code = NSFileReadNoSuchFileError;
+		description = [NSString stringWithFormat:@"The upload file %@ does not exist.", path];
+	} else if ([[NSFileManager defaultManager] isReadableFileAtPath:path] == NO) {
+		code = NSFileReadNoPermissionError;
+		description = [NSString stringWithFormat:@"The upload file %@ can't be read.", path];
+	}
+	NSDictionary *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:path, NSFilePathErrorKey, description, NSLocalizedDescriptionKey, nil];
+	return [NSError errorWithDomain:NSCocoaErrorDomain code:code userInfo:userInfo];
+}
+
+
+- (struct MKMultipartFormPart *)nextPart
+{
+	NSAssert(_textBuffer == nil, @"Parts can't be added after the body has been written");
+	if (_count == _capacity) {
+		_capacity *= 2;
+		_parts = realloc(_parts, _capacity * sizeof(struct MKMultipartFormPart));
+	}
+	struct MKMultipartFormPart *part = &_parts[_count++];
+	memset(part, 0, sizeof(struct MKMultipartFormPart));
+	return part;
+}
+
+
+//writes every header and field into one buffer of the exact size, remembering where binary parts belong
+- (void)writeText
+{
+	if (_textBuffer != nil) {
+		return;
+	}
+
+	_textBuffer = [[NSMutableData alloc] initWithLength:_textLength];
+	char *start = [_textBuffer mutableBytes];
+	char *out = MKAppendBytes(start, MKMultipartFormOpening, MKStaticLength(MKMultipartFormOpening));
+
+	for (NSUInteger i = 0; i < _count; i++) {
+		struct MKMultipartFormPart *part = &_parts[i];
+		if (part->kind == MKMultipartFormFieldPart) {
+			out = MKAppendBytes(out, MKMultipartFormNamePrefix, MKStaticLength(MKMultipartFormNamePrefix));
+			out = MKAppendString(out, part->name, part->nameLength);
+			out = MKAppendBytes(out, MKMultipartFormNameSuffix, MKStaticLength(MKMultipartFormNameSuffix));
+			out = MKAppendString(out, part->value, part->valueLength);
+		} else {
+			out = MKAppendBytes(out, MKMultipartFormFilenamePrefix, MKStaticLength(MKMultipartFormFilenamePrefix));
+			out = MKAppendString(out, part->name, part->nameLength);
+			out = MKAppendBytes(out, MKMultipartFormFilenameSuffix, MKStaticLength(MKMultipartFormFilenameSuffix));
+			out = MKAppendBytes(out, MKMultipartFormContentTypePrefix, MKStaticLength(MKMultipartFormContentTypePrefix));
+			out = MKAppendString(out, part->contentType, part->contentTypeLength);
+			out = MKAppendBytes(out, MKMultipartFormContentTypeSuffix, MKStaticLength(MKMultipartFormContentTypeSuffix));
+			part->textOffset = out - start;
+		}
+		out = MKAppendBytes(out, MKMultipartFormEndLine, MKStaticLength(MKMultipartFormEndLine));
+	}
+	out = MKAppendBytes(out, MKMultipartFormEndLine, MKStaticLength(MKMultipartFormEndLine));
+
+	NSAssert((NSUInteger)(out - start) == _textLength, @"Multipart body length was miscalculated");
+}
+
+@end
@@ -0,0 +1,103 @@
+//
+//  MKMultipartInputStream.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+
+/*!
+ @class MKFileRange
+
+ Part of a file to upload. Pass an MKFileRange as a parameter value to send a range of a file in the body of a POST request without loading it into memory.
+
+ @version 0.9 and later
+ */
+@interface MKFileRange : NSObject {
+	NSURL *fileURL;
+	unsigned long long offset;
+	unsigned long long length;
+}
+
+@property (readonly) NSURL *fileURL;
+@property (readonly) unsigned long long offset;
+@property (readonly) unsigned long long length;
+
++ (MKFileRange *)rangeWithFileURL:(NSURL *)aFileURL offset:(unsigned long long)anOffset length:(unsigned long long)aLength;
+- (id)initWithFileURL:(NSURL *)aFileURL offset:(unsigned long long)anOffset length:(unsigned long long)aLength;
+
+@end
+
+
+/*!
+ @class MKMultipartInputStream
+
+ An input stream that reads a series of in memory segments and files one after another, used as the HTTPBodyStream of large uploads.
+
+ Files are opened only when the stream reaches them and are read in chunks, so the memory needed to send a request does not depend on the size of the files being uploaded. The total length is known before the stream is opened and is used for the Content-Length header of the request.
+
+ @version 0.9 and later
+ */
+@interface MKMultipartInputStream : NSInputStream {
+	NSMutableArray *_segments;
+	NSUInteger _segmentIndex;
+	unsigned long long _segmentOffset;
+	NSInputStream *_fileStream;
+	unsigned long long _length;
+	NSStreamStatus _streamStatus;
+	NSError *_streamError;
+	id _delegate;
+}
+
+/*!
+ @brief Add bytes to the end of the stream.
+
+ The data is retained, not copied.
+ */
+- (void)appendData:(NSData *)data;
+
+/*!
+ @brief Add part of a block of memory to the end of the stream.
+
+ The data is retained, not copied.
+ */
+- (void)appendData:(NSData *)data range:(NSRange)range;
+
+/*!
+ @brief Add the contents of a file to the end of the stream.
+
+ @param path Path of the file to read.
+
+ @result NO if the size of the file could not be determined, the file is not added.
+ */
+- (BOOL)appendFileAtPath:(NSString *)path;
+
+/*!
+ @brief Add part of a file to the end of the stream.
+
+ @param path Path of the file to read.
+
+ @param offset Position of the first byte to read.
+
+ @param length Number of bytes to read.
+
+ @result NO if the file does not contain the requested range, the file is not added.
+ */
+- (BOOL)appendFileAtPath:(NSString *)path offset:(unsigned long long)offset length:(unsigned long long)length;
+
+/*!
+ @brief Total number of bytes the stream will produce.
+ */
+- (unsigned long long)length;
+
+/*!
+ @brief A new unopened stream reading the same segments.
+
+ NSURLConnection asks for a new body stream when it has to send the body again, for example after a redirect or an authentication challenge.
+ */
+- (MKMultipartInputStream *)unopenedCopy;
+
+@end
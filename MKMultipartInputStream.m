@@ -0,0 +1,335 @@
+//
+//  MKMultipartInputStream.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKMultipartInputStream.h"
+
+
+@implementation MKFileRange
+
+@synthesize fileURL, offset, length;
+
++ (MKFileRange *)rangeWithFileURL:(NSURL *)aFileURL offset:(unsigned long long)anOffset length:(unsigned long long)aLength
+{
+	return [[[MKFileRange alloc] initWithFileURL:aFileURL offset:anOffset length:aLength] autorelease];
+}
+
+
+- (id)initWithFileURL:(NSURL *)aFileURL offset:(unsigned long long)anOffset length:(unsigned long long)aLength
+{
+	self = [super init];
+	if (self != nil) {
+		fileURL = [aFileURL retain];
+		offset = anOffset;
+		length = aLength;
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[fileURL release];
+	[super dealloc];
+}
+
+@end
+
+
+//either a block of memory or a range of a file
+@interface MKMultipartInputStreamSegment : NSObject {
+@public
+	NSData *data;
+	NSString *path;
+	unsigned long long offset;
+	unsigned long long length;
+}
+@end
+
+@implementation MKMultipartInputStreamSegment
+
+- (void)dealloc
+{
+	[data release];
+	[path release];
+	[super dealloc];
+}
+
+@end
+
+
+@interface MKMultipartInputStream (Private)
+- (void)appendSegment:(MKMultipartInputStreamSegment *)segment;
+- (void)setStreamError:(NSError *)error;
+@end
+
+
+@implementation MKMultipartInputStream
+
+- (id)init
+{
+	self = [super init];
+	if (self != nil) {
+		_segments = [[NSMutableArray alloc] init];
+		_segmentIndex = 0;
+		_segmentOffset = 0;
+		_length = 0;
+		_streamStatus = NSStreamStatusNotOpen;
+		_delegate = self;
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[_fileStream close];
+	[_fileStream release];
+	[_segments release];
+	[_streamError release];
+	[super dealloc];
+}
+
+
+- (void)appendData:(NSData *)data
+{
+	[self appendData:data range:NSMakeRange(0, [data length])];
+}
+
+
+- (void)appendData:(NSData *)data range:(NSRange)range
+{
+	NSAssert(NSMaxRange(range) <= [data length], @"Range is outside of data");
+	if (range.length == 0) {
+		return;
+	}
+	MKMultipartInputStreamSegment *segment = [[[MKMultipartInputStreamSegment alloc] init] autorelease];
+	segment->data = [data retain];
+	segment->offset = range.location;
+	segment->length = range.length;
+	[self appendSegment:segment];
+}
+
+
+- (BOOL)appendFileAtPath:(NSString *)path
+{
+	NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+	if (attributes == nil) {
+		return NO;
+	}
+	return [self appendFileAtPath:path offset:0 length:[attributes fileSize]];
+}
+
+
+- (BOOL)appendFileAtPath:(NSString *)path offset:(unsigned long long)offset length:(unsigned long long)length
+{
+	NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+	if (attributes == nil || offset + length > [attributes fileSize]) {
+		return NO;
+	}
+	if (length == 0) {
+		return YES;
+	}
+	MKMultipartInputStreamSegment *segment = [[[MKMultipartInputStreamSegment alloc] init] autorelease];
+	segment->path = [path copy];
+	segment->offset = offset;
+	segment->length = length;
+	[self appendSegment:segment];
+	return YES;
+}
+
+
+- (unsigned long long)length
+{
+	return _length;
+}
+
+
+- (MKMultipartInputStream *)unopenedCopy
+{
+	MKMultipartInputStream *stream = [[[MKMultipartInputStream alloc] init] autorelease];
+	for (MKMultipartInputStreamSegment *segment in _segments) {
+		[stream appendSegment:segment];
+	}
+	return stream;
+}
+
+
+#pragma mark NSStream Methods
+
+- (void)open
+{
+	if (_streamStatus != NSStreamStatusNotOpen) {
+		return;
+	}
+	_streamStatus = NSStreamStatusOpen;
+	_segmentIndex = 0;
+	_segmentOffset = 0;
+}
+
+
+- (void)close
+{
+	[_fileStream close];
+	[_fileStream release];
+	_fileStream = nil;
+	_streamStatus = NSStreamStatusClosed;
+}
+
+
+- (id)delegate
+{
+	return _delegate;
+}
+
+
+- (void)setDelegate:(id)aDelegate
+{
+	_delegate = aDelegate != nil ? aDelegate : self;
+}
+
+
+//bytes are always available so there is nothing to schedule, NSURLConnection polls the stream
+- (void)scheduleInRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode
+{
+}
+
+
+- (void)removeFromRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode
+{
+}
+
+
+- (id)propertyForKey:(NSString *)key
+{
+	return nil;
+}
+
+
+- (BOOL)setProperty:(id)property forKey:(NSString *)key
+{
+	return NO;
+}
+
+
+- (NSStreamStatus)streamStatus
+{
+	return _streamStatus;
+}
+
+
+- (NSError *)streamError
+{
+	return _streamError;
+}
+
+
+#pragma mark NSInputStream Methods
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)len
+{
+	if (_streamStatus != NSStreamStatusOpen) {
+		return _streamStatus == NSStreamStatusAtEnd ? 0 : -1;
+	}
+
+	NSUInteger written = 0;
+	while (written < len && _segmentIndex < [_segments count]) {
+		MKMultipartInputStreamSegment *segment = [_segments objectAtIndex:_segmentIndex];
+		unsigned long long remaining = segment->length - _segmentOffset;
+		NSUInteger wanted = (NSUInteger)MIN((unsigned long long)(len - written), remaining);
+		NSInteger read = 0;
+
+		if (segment->data != nil) {
+			[segment->data getBytes:buffer + written range:NSMakeRange((NSUInteger)(segment->offset + _segmentOffset), wanted)];
+			read = wanted;
+		} else {
+			if (_fileStream == nil) {
+				_fileStream = [[NSInputStream alloc] initWithFileAtPath:segment->path];
+				[_fileStream open];
+				if (segment->offset > 0) {
+					[_fileStream setProperty:[NSNumber numberWithUnsignedLongLong:segment->offset] forKey:NSStreamFileCurrentOffsetKey];
+				}
+			}
+			read = [_fileStream read:buffer + written maxLength:wanted];
+			if (read <= 0) {
+				//the file got shorter or disappeared after the Content-Length was calculated, we can't finish the body
+				NSError *error = [_fileStream streamError];
+				if (error == nil) {
+					error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
+				}
+				[self setStreamError:error];
+				_streamStatus = NSStreamStatusError;
+				return -1;
+			}
+		}
+
+		written += read;
+		_segmentOffset += read;
+		if (_segmentOffset == segment->length) {
+			[_fileStream close];
+			[_fileStream release];
+			_fileStream = nil;
+			_segmentIndex++;
+			_segmentOffset = 0;
+		}
+	}
+
+	if (_segmentIndex == [_segments count]) {
+		_streamStatus = NSStreamStatusAtEnd;
+	}
+	return written;
+}
+
+
+- (BOOL)getBuffer:(uint8_t **)buffer length:(NSUInteger *)len
+{
+	return NO;
+}
+
+
+- (BOOL)hasBytesAvailable
+{
+	return _streamStatus == NSStreamStatusOpen;
+}
+
+
+#pragma mark CFReadStream Bridging
+
+//NSURLConnection talks to body streams through CFReadStream, subclasses of NSInputStream have to answer these undocumented methods or the connection raises an exception
+- (void)_scheduleInCFRunLoop:(CFRunLoopRef)aRunLoop forMode:(CFStringRef)aMode
+{
+}
+
+
+- (void)_unscheduleFromCFRunLoop:(CFRunLoopRef)aRunLoop forMode:(CFStringRef)aMode
+{
+}
+
+
+- (BOOL)_setCFClientFlags:(CFOptionFlags)inFlags callback:(CFReadStreamClientCallBack)inCallback context:(CFStreamClientContext *)inContext
+{
+	return NO;
+}
+
+
+#pragma mark Private Methods
+
+- (void)appendSegment:(MKMultipartInputStreamSegment *)segment
+{
+	NSAssert(_streamStatus == NSStreamStatusNotOpen, @"Segments can't be added after the stream has been opened");
+	[_segments addObject:segment];
+	_length += segment->length;
+}
+
+
+- (void)setStreamError:(NSError *)error
+{
+	[_streamError release];
+	_streamError = [error retain];
+}
+
+@end
@@ -69,6 +69,25 @@ extern NSString *MKVideoAPIServerURL;
  @version 0.9 and later
  */
 - (void)videoUpload:(NSData *)video title:(NSString *)title description:(NSString *)description;
+
+
+/*!
+ 
+ @brief Uploads a video file to Facebook.
+ 
+ The file is read from disk in small chunks while the request is sent, so memory use does not grow with the size of the video. Upload progress is reported through facebookRequest:bytesWritten:totalBytesWritten:totalBytesExpectedToWrite:.
+ 
+ @param fileURL File URL of the video to upload.
+ 
+ @param title Title for the video. Should be 65 characters or less, Facebook will truncate anything past 65 characters.
+ 
+ @param description A description of the video.
+ 
+ See Facebook documentation for video.upload at http://wiki.developers.facebook.com/index.php/Video.upload
+ 
+ @version 0.9 and later
+ */
+- (void)videoUploadFileAtURL:(NSURL *)fileURL title:(NSString *)title description:(NSString *)description;
 //@}
 
 @end
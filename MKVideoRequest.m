@@ -43,4 +43,18 @@ NSString *MKVideoAPIServerURL = @"https://api-video.facebook.com/method/";
 	[self sendRequest];
 	[params release];
 }
+
+
+- (void)videoUploadFileAtURL:(NSURL *)fileURL title:(NSString *)title description:(NSString *)description{
+	NSAssert([fileURL isFileURL], @"Video URL must be a file URL");
+	[self setUrlRequestType:MKFacebookRequestTypePOST];
+	self.method=@"video.upload";
+	NSMutableDictionary *params = [[NSMutableDictionary alloc] init];
+	[params setObject:fileURL forKey:@"video"];
+	[params setValue:title forKey:@"title"];
+	[params setValue:description forKey:@"description"];
+	[self setParameters:params];
+	[self sendRequest];
+	[params release];
+}
 @end
@@ -0,0 +1,222 @@
+//
+//  MKVideoUploadSession.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "MKVideoRequest.h"
+
+extern NSString *MKVideoUploadSessionErrorDomain;
+
+/*!
+ @enum MKVideoUploadSessionError
+ */
+enum MKVideoUploadSessionError
+{
+	MKVideoUploadSessionFileUnreadableError = 1,
+	MKVideoUploadSessionInvalidResponseError
+};
+
+
+/*!
+ @class MKVideoUploadSession
+
+ Uploads a video in fixed size parts so a failed upload can continue from the last part Facebook acknowledged.
+
+ The video is sent to MKVideoAPIServerURL using the start, transfer and finish phases of video.upload. After each part is acknowledged the session writes a small checkpoint file. If a part fails the session tries it again, and if the upload is given up or the application quits, calling start on a new session with the same file and checkpoint path picks up where the last one stopped instead of sending the whole file again. The checkpoint is deleted once the upload has finished.
+
+ @verbatim
+ MKVideoUploadSession *upload = [MKVideoUploadSession sessionWithFileURL:movieURL checkpointPath:checkpointPath delegate:self];
+ upload.title = @"Summer";
+ [upload start];
+ @endverbatim
+
+ @see MKVideoUploadSessionDelegate
+
+ @version 0.9 and later
+ */
+@interface MKVideoUploadSession : NSObject <MKFacebookRequestDelegate> {
+	id delegate;
+	NSURL *fileURL;
+	NSString *checkpointPath;
+	NSString *title;
+	NSString *videoDescription;
+	unsigned long long chunkSize;
+	int numberOfChunkAttempts;
+	NSTimeInterval retryDelay;
+
+	unsigned long long _fileSize;
+	NSDate *_fileModificationDate;
+	unsigned long long _acknowledgedOffset;
+	unsigned long long _chunkLength;
+	NSString *_uploadSessionID;
+	NSString *_videoID;
+	MKVideoRequest *_activeRequest;
+	int _chunkAttemptCount;
+	BOOL _cancelled;
+}
+
+/*! @name Properties */
+//@{
+/*!
+ @brief Receives progress and the result of the upload.
+ */
+@property (nonatomic, assign) id delegate;
+
+/*!
+ @brief The video being uploaded.
+ */
+@property (readonly) NSURL *fileURL;
+
+/*!
+ @brief Where progress is recorded between parts.
+ */
+@property (readonly) NSString *checkpointPath;
+
+/*!
+ @brief Title for the video. Should be 65 characters or less, Facebook will truncate anything past 65 characters.
+ */
+@property (nonatomic, copy) NSString *title;
+
+/*!
+ @brief A description of the video.
+ */
+@property (nonatomic, copy) NSString *videoDescription;
+
+/*!
+ @brief Size of each part in bytes.
+
+ Changing the size of the parts invalidates an existing checkpoint. Default is 4 MB.
+ */
+@property unsigned long long chunkSize;
+
+/*!
+ @brief How many times a part is sent before the upload is given up.
+
+ Default is 5.
+ */
+@property int numberOfChunkAttempts;
+
+/*!
+ @brief How long to wait before sending a failed part again. Doubles with each attempt.
+
+ Default is 2 seconds.
+ */
+@property NSTimeInterval retryDelay;
+
+/*!
+ @brief Number of bytes Facebook has acknowledged so far.
+ */
+@property (readonly) unsigned long long acknowledgedBytes;
+
+/*!
+ @brief Size of the video in bytes.
+ */
+@property (readonly) unsigned long long fileSize;
+//@}
+
+
+/*! @name Creating and Initializing */
+//@{
+/*!
+ @brief New autoreleased upload session.
+
+ @param aFileURL File URL of the video to upload.
+
+ @param aCheckpointPath Path of the file used to record progress. Use the same path to resume an upload in a later session.
+
+ @param aDelegate Object implementing the MKVideoUploadSessionDelegate methods.
+
+ @version 0.9 and later
+ */
++ (MKVideoUploadSession *)sessionWithFileURL:(NSURL *)aFileURL checkpointPath:(NSString *)aCheckpointPath delegate:(id)aDelegate;
+
+- (id)initWithFileURL:(NSURL *)aFileURL checkpointPath:(NSString *)aCheckpointPath delegate:(id)aDelegate;
+//@}
+
+
+/*! @name Uploading */
+//@{
+/*!
+ @brief Start or resume the upload.
+
+ If the checkpoint file describes an earlier upload of the same, unchanged file in parts of the same size, the upload continues after the last acknowledged part. Otherwise a new upload is started.
+
+ The session retains itself until the upload finishes, fails or is cancelled.
+
+ @version 0.9 and later
+ */
+- (void)start;
+
+/*!
+ @brief Stop sending parts.
+
+ The checkpoint is kept so the upload can be resumed later.
+
+ @version 0.9 and later
+ */
+- (void)cancel;
+
+/*!
+ @brief Delete the checkpoint file so the next upload starts from the beginning.
+
+ @version 0.9 and later
+ */
+- (void)removeCheckpoint;
+//@}
+
+@end
+
+
+
+/*!
+ @protocol MKVideoUploadSessionDelegate
+
+ Receives progress information and the result of an MKVideoUploadSession.
+ */
+@protocol MKVideoUploadSessionDelegate
+
+/*!
+ @brief Bytes sent so far.
+
+ Includes parts acknowledged in earlier sessions when an upload is resumed.
+
+ @version 0.9 and later
+ */
+@optional
+- (void)videoUploadSession:(MKVideoUploadSession *)session sentBytes:(unsigned long long)sentBytes ofBytes:(unsigned long long)totalBytes;
+
+/*!
+ @brief The upload has finished.
+
+ @param response The parsed response to the finish phase.
+
+ @version 0.9 and later
+ */
+@optional
+- (void)videoUploadSession:(MKVideoUploadSession *)session didFinishWithResponse:(id)response;
+
+/*!
+ @brief Facebook returned an error.
+
+ The checkpoint is kept.
+
+ @version 0.9 and later
+ */
+@optional
+- (void)videoUploadSession:(MKVideoUploadSession *)session errorReceived:(MKFacebookResponseError *)error;
+
+/*!
+ @brief The upload could not be completed.
+
+ Called when a part still fails after numberOfChunkAttempts attempts, or when the file can't be read. The checkpoint is kept so the upload can be resumed later.
+
+ @version 0.9 and later
+ */
+@optional
+- (void)videoUploadSession:(MKVideoUploadSession *)session failed:(NSError *)error;
+
+@end
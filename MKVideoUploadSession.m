@@ -0,0 +1,355 @@
+//
+//  MKVideoUploadSession.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+#import "MKVideoUploadSession.h"
+#import "MKMultipartInputStream.h"
+
+NSString *MKVideoUploadSessionErrorDomain = @"MKVideoUploadSessionErrorDomain";
+
+//checkpoint file keys
+static NSString *MKVideoUploadCheckpointPathKey = @"path";
+static NSString *MKVideoUploadCheckpointFileSizeKey = @"fileSize";
+static NSString *MKVideoUploadCheckpointModificationDateKey = @"modificationDate";
+static NSString *MKVideoUploadCheckpointChunkSizeKey = @"chunkSize";
+static NSString *MKVideoUploadCheckpointSessionIDKey = @"uploadSessionID";
+static NSString *MKVideoUploadCheckpointVideoIDKey = @"videoID";
+static NSString *MKVideoUploadCheckpointOffsetKey = @"acknowledgedOffset";
+
+
+@interface MKVideoUploadSession (Private)
+- (BOOL)loadCheckpoint;
+- (void)saveCheckpoint;
+- (void)sendCurrentPhase;
+- (void)sendPhase:(NSString *)phase parameters:(NSDictionary *)params;
+- (void)finishWithError:(NSError *)error;
+- (void)stop;
+@end
+
+
+@implementation MKVideoUploadSession
+
+@synthesize delegate;
+@synthesize fileURL;
+@synthesize checkpointPath;
+@synthesize title;
+@synthesize videoDescription;
+@synthesize chunkSize;
+@synthesize numberOfChunkAttempts;
+@synthesize retryDelay;
+@synthesize acknowledgedBytes = _acknowledgedOffset;
+@synthesize fileSize = _fileSize;
+
+
++ (MKVideoUploadSession *)sessionWithFileURL:(NSURL *)aFileURL checkpointPath:(NSString *)aCheckpointPath delegate:(id)aDelegate
+{
+	return [[[MKVideoUploadSession alloc] initWithFileURL:aFileURL checkpointPath:aCheckpointPath delegate:aDelegate] autorelease];
+}
+
+
+- (id)initWithFileURL:(NSURL *)aFileURL checkpointPath:(NSString *)aCheckpointPath delegate:(id)aDelegate
+{
+	NSAssert([aFileURL isFileURL], @"Video URL must be a file URL");
+	self = [super init];
+	if (self != nil) {
+		fileURL = [aFileURL retain];
+		checkpointPath = [aCheckpointPath copy];
+		delegate = aDelegate;
+		chunkSize = 4 * 1024 * 1024;
+		numberOfChunkAttempts = 5;
+		retryDelay = 2.0;
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[fileURL release];
+	[checkpointPath release];
+	[title release];
+	[videoDescription release];
+	[_fileModificationDate release];
+	[_uploadSessionID release];
+	[_videoID release];
+	[_activeRequest release];
+	[super dealloc];
+}
+
+
+- (void)start
+{
+	if (_activeRequest != nil) {
+		return;
+	}
+
+	NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:[fileURL path] error:nil];
+	if (attributes == nil) {
+		NSDictionary *userInfo = [NSDictionary dictionaryWithObject:@"The video file could not be read." forKey:NSLocalizedDescriptionKey];
+		[self finishWithError:[NSError errorWithDomain:MKVideoUploadSessionErrorDomain code:MKVideoUploadSessionFileUnreadableError userInfo:userInfo]];
+		return;
+	}
+
+	//released in stop
+	[self retain];
+	_cancelled = NO;
+	_chunkAttemptCount = 0;
+	_fileSize = [attributes fileSize];
+	[_fileModificationDate release];
+	_fileModificationDate = [[attributes fileModificationDate] retain];
+
+	if ([self loadCheckpoint] == YES) {
+		DLog(@"resuming video upload at %llu of %llu bytes", _acknowledgedOffset, _fileSize);
+	} else {
+		_acknowledgedOffset = 0;
+		[_uploadSessionID release];
+		_uploadSessionID = nil;
+		[_videoID release];
+		_videoID = nil;
+	}
+
+	[self sendCurrentPhase];
+}
+
+
+- (void)cancel
+{
+	if (_activeRequest == nil) {
+		return;
+	}
+	_cancelled = YES;
+	[NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(sendCurrentPhase) object:nil];
+	[_activeRequest cancelRequest];
+	[self stop];
+}
+
+
+- (void)removeCheckpoint
+{
+	[[NSFileManager defaultManager] removeItemAtPath:checkpointPath error:nil];
+}
+
+
+#pragma mark Private Methods
+
+//a checkpoint is only used if it was written for this exact file, unchanged, and split into parts of the same size
+- (BOOL)loadCheckpoint
+{
+	NSDictionary *checkpoint = [NSDictionary dictionaryWithContentsOfFile:checkpointPath];
+	if (checkpoint == nil) {
+		return NO;
+	}
+
+	if (![[checkpoint objectForKey:MKVideoUploadCheckpointPathKey] isEqualToString:[fileURL path]] ||
+		[[checkpoint objectForKey:MKVideoUploadCheckpointFileSizeKey] unsignedLongLongValue] != _fileSize ||
+		![[checkpoint objectForKey:MKVideoUploadCheckpointModificationDateKey] isEqualToDate:_fileModificationDate] ||
+		[[checkpoint objectForKey:MKVideoUploadCheckpointChunkSizeKey] unsignedLongLongValue] != chunkSize ||
+		[checkpoint objectForKey:MKVideoUploadCheckpointSessionIDKey] == nil) {
+		DLog(@"ignoring stale video upload checkpoint at %@", checkpointPath);
+		return NO;
+	}
+
+	[_uploadSessionID release];
+	_uploadSessionID = [[checkpoint objectForKey:MKVideoUploadCheckpointSessionIDKey] copy];
+	[_videoID release];
+	_videoID = [[checkpoint objectForKey:MKVideoUploadCheckpointVideoIDKey] copy];
+	_acknowledgedOffset = [[checkpoint objectForKey:MKVideoUploadCheckpointOffsetKey] unsignedLongLongValue];
+	if (_acknowledgedOffset > _fileSize) {
+		_acknowledgedOffset = _fileSize;
+	}
+	return YES;
+}
+
+
+- (void)saveCheckpoint
+{
+	NSMutableDictionary *checkpoint = [NSMutableDictionary dictionary];
+	[checkpoint setObject:[fileURL path] forKey:MKVideoUploadCheckpointPathKey];
+	[checkpoint setObject:[NSNumber numberWithUnsignedLongLong:_fileSize] forKey:MKVideoUploadCheckpointFileSizeKey];
+	[checkpoint setObject:_fileModificationDate forKey:MKVideoUploadCheckpointModificationDateKey];
+	[checkpoint setObject:[NSNumber numberWithUnsignedLongLong:chunkSize] forKey:MKVideoUploadCheckpointChunkSizeKey];
+	[checkpoint setObject:[NSNumber numberWithUnsignedLongLong:_acknowledgedOffset] forKey:MKVideoUploadCheckpointOffsetKey];
+	[checkpoint setValue:_uploadSessionID forKey:MKVideoUploadCheckpointSessionIDKey];
+	[checkpoint setValue:_videoID forKey:MKVideoUploadCheckpointVideoIDKey];
+	if ([checkpoint writeToFile:checkpointPath atomically:YES] == NO) {
+		DLog(@"unable to write video upload checkpoint to %@", checkpointPath);
+	}
+}
+
+
+//works out what to send next from what has been acknowledged, so a retry or a resumed session always sends the right part
+- (void)sendCurrentPhase
+{
+	if (_uploadSessionID == nil) {
+		_chunkLength = 0;
+		NSMutableDictionary *params = [NSMutableDictionary dictionary];
+		[params setObject:[NSString stringWithFormat:@"%llu", _fileSize] forKey:@"file_size"];
+		[self sendPhase:@"start" parameters:params];
+	} else if (_acknowledgedOffset < _fileSize) {
+		_chunkLength = MIN(chunkSize, _fileSize - _acknowledgedOffset);
+		NSMutableDictionary *params = [NSMutableDictionary dictionary];
+		[params setObject:_uploadSessionID forKey:@"upload_session_id"];
+		[params setObject:[NSString stringWithFormat:@"%llu", _acknowledgedOffset] forKey:@"start_offset"];
+		[params setObject:[MKFileRange rangeWithFileURL:fileURL offset:_acknowledgedOffset length:_chunkLength] forKey:@"video_file_chunk"];
+		[self sendPhase:@"transfer" parameters:params];
+	} else {
+		_chunkLength = 0;
+		NSMutableDictionary *params = [NSMutableDictionary dictionary];
+		[params setObject:_uploadSessionID forKey:@"upload_session_id"];
+		[params setValue:title forKey:@"title"];
+		[params setValue:videoDescription forKey:@"description"];
+		[self sendPhase:@"finish" parameters:params];
+	}
+}
+
+
+- (void)sendPhase:(NSString *)phase parameters:(NSDictionary *)params
+{
+	NSMutableDictionary *phaseParameters = [NSMutableDictionary dictionaryWithDictionary:params];
+	[phaseParameters setObject:phase forKey:@"upload_phase"];
+
+	[_activeRequest release];
+	_activeRequest = [[MKVideoRequest alloc] initWithDelegate:self selector:nil];
+	_activeRequest.urlRequestType = MKFacebookRequestTypePOST;
+	_activeRequest.responseFormat = MKFacebookRequestResponseFormatJSON;
+	[_activeRequest sendRequest:@"video.upload" withParameters:phaseParameters];
+}
+
+
+- (void)finishWithError:(NSError *)error
+{
+	if ([delegate respondsToSelector:@selector(videoUploadSession:failed:)]) {
+		[delegate videoUploadSession:self failed:error];
+	}
+	[self stop];
+}
+
+
+- (void)stop
+{
+	if (_activeRequest == nil) {
+		return;
+	}
+	[_activeRequest setDelegate:nil];
+	[_activeRequest autorelease];
+	_activeRequest = nil;
+	//balances the retain in start
+	[self autorelease];
+}
+
+
+#pragma mark MKFacebookRequestDelegate Methods
+
+- (void)facebookRequest:(MKFacebookRequest *)request responseReceived:(id)response
+{
+	if (_cancelled == YES || request != _activeRequest) {
+		return;
+	}
+
+	NSString *phase = [[request parameters] objectForKey:@"upload_phase"];
+	if (![response isKindOfClass:[NSDictionary class]]) {
+		NSDictionary *userInfo = [NSDictionary dictionaryWithObject:@"Facebook returned an unexpected response to video.upload." forKey:NSLocalizedDescriptionKey];
+		[self finishWithError:[NSError errorWithDomain:MKVideoUploadSessionErrorDomain code:MKVideoUploadSessionInvalidResponseError userInfo:userInfo]];
+		return;
+	}
+
+	_chunkAttemptCount = 0;
+
+	if ([phase isEqualToString:@"start"]) {
+		[_uploadSessionID release];
+		_uploadSessionID = [[[response valueForKey:@"upload_session_id"] description] copy];
+		[_videoID release];
+		_videoID = [[[response valueForKey:@"video_id"] description] copy];
+		if ([response valueForKey:@"start_offset"] != nil) {
+			_acknowledgedOffset = [[response valueForKey:@"start_offset"] longLongValue];
+		}
+		[self saveCheckpoint];
+		[self sendCurrentPhase];
+	}
+	else if ([phase isEqualToString:@"transfer"]) {
+		//the server tells us where the next part should start, if it doesn't we assume the whole part arrived
+		if ([response valueForKey:@"start_offset"] != nil) {
+			_acknowledgedOffset = [[response valueForKey:@"start_offset"] longLongValue];
+		} else {
+			_acknowledgedOffset += _chunkLength;
+		}
+		if (_acknowledgedOffset > _fileSize) {
+			_acknowledgedOffset = _fileSize;
+		}
+		[self saveCheckpoint];
+		if ([delegate respondsToSelector:@selector(videoUploadSession:sentBytes:ofBytes:)]) {
+			[delegate videoUploadSession:self sentBytes:_acknowledgedOffset ofBytes:_fileSize];
+		}
+		[self sendCurrentPhase];
+	}
+	else {
+		[self removeCheckpoint];
+		if ([delegate respondsToSelector:@selector(videoUploadSession:didFinishWithResponse:)]) {
+			[delegate videoUploadSession:self didFinishWithResponse:response];
+		}
+		[self stop];
+	}
+}
+
+
+//errors Facebook considers temporary have already been retried by the request, anything that reaches us is final
+- (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error
+{
+	if (_cancelled == YES || request != _activeRequest) {
+		return;
+	}
+	if ([delegate respondsToSelector:@selector(videoUploadSession:errorReceived:)]) {
+		[delegate videoUploadSession:self errorReceived:error];
+	}
+	[self stop];
+}
+
+
+//the connection dropped, send the same part again after a short wait
+- (void)facebookRequest:(MKFacebookRequest *)request failed:(NSError *)error
+{
+	if (_cancelled == YES || request != _activeRequest) {
+		return;
+	}
+
+	//the file couldn't be read, sending the part again won't help
+	if ([[error domain] isEqualToString:NSCocoaErrorDomain] == YES) {
+		[self finishWithError:error];
+		return;
+	}
+
+	_chunkAttemptCount++;
+	if (_chunkAttemptCount >= numberOfChunkAttempts) {
+		DLog(@"giving up on video upload after %i attempts at offset %llu", _chunkAttemptCount, _acknowledgedOffset);
+		[self finishWithError:error];
+		return;
+	}
+
+	NSTimeInterval delay = retryDelay;
+	for (int i = 1; i < _chunkAttemptCount; i++) {
+		delay *= 2.0;
+	}
+	DLog(@"video upload part failed, trying again in %.1f seconds", delay);
+	[self performSelector:@selector(sendCurrentPhase) withObject:nil afterDelay:delay];
+}
+
+
+- (void)facebookRequest:(MKFacebookRequest *)request bytesWritten:(NSUInteger)bytesWritten totalBytesWritten:(NSUInteger)totalBytesWritten totalBytesExpectedToWrite:(NSUInteger)totalBytesExpectedToWrite
+{
+	if (_cancelled == YES || request != _activeRequest) {
+		return;
+	}
+	if ([delegate respondsToSelector:@selector(videoUploadSession:sentBytes:ofBytes:)]) {
+		//the body also carries the form fields and part headers. counting all of them as written before any of the video keeps progress from running ahead of what was sent
+		unsigned long long overhead = totalBytesExpectedToWrite > _chunkLength ? totalBytesExpectedToWrite - _chunkLength : 0;
+		unsigned long long chunkBytesWritten = totalBytesWritten > overhead ? MIN(totalBytesWritten - overhead, _chunkLength) : 0;
+		unsigned long long sent = _acknowledgedOffset + chunkBytesWritten;
+		[delegate videoUploadSession:self sentBytes:sent ofBytes:_fileSize];
+	}
+}
+
+@end
@@ -20,6 +20,11 @@
  */
 - (NSString *) encodeURLLegally;
 
+/*
+ Percent encodes everything except unreserved characters (A-Z a-z 0-9 - . _ ~) so the string can be used as a single key or value in a query string.
+ */
+- (NSString *)encodeURLComponent;
+
 /*
  Returns the string found between start and stop, nil if no string was found
  */
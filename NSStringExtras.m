@@ -8,6 +8,28 @@
 
 #import "NSStringExtras.h"
 
+//1 for the bytes that can go into a query component as they are, everything else is percent encoded
+static const unsigned char MKURLComponentSafeBytes[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, // - .
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, // 0-9
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // A-O
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, // P-Z _
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // a-o
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, // p-z ~
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const char MKHexDigits[] = "0123456789ABCDEF";
+
 
 
 @implementation NSString(NSStringExtras)
@@ -29,6 +51,42 @@
 }
 
 
+//one pass over the UTF-8 bytes with a table lookup per byte. strings that don't need encoding, the common case for keys and ids, are returned without copying
+- (NSString *)encodeURLComponent
+{
+	const unsigned char *bytes = (const unsigned char *)[self UTF8String];
+	if (bytes == NULL) {
+		return self;
+	}
+
+	size_t length = 0;
+	size_t unsafeCount = 0;
+	for (const unsigned char *c = bytes; *c != 0; c++) {
+		length++;
+		if (MKURLComponentSafeBytes[*c] == 0) {
+			unsafeCount++;
+		}
+	}
+	if (unsafeCount == 0) {
+		return self;
+	}
+
+	size_t encodedLength = length + unsafeCount * 2;
+	char *encoded = malloc(encodedLength);
+	char *out = encoded;
+	for (const unsigned char *c = bytes; *c != 0; c++) {
+		if (MKURLComponentSafeBytes[*c] == 1) {
+			*out++ = *c;
+		} else {
+			*out++ = '%';
+			*out++ = MKHexDigits[*c >> 4];
+			*out++ = MKHexDigits[*c & 0x0F];
+		}
+	}
+	return [[[NSString alloc] initWithBytesNoCopy:encoded length:encodedLength encoding:NSASCIIStringEncoding freeWhenDone:YES] autorelease];
+}
+
+
 //based on example from: http://stackoverflow.com/questions/3058799/nsstring-simple-pattern-matching
 - (NSString *)substringBetweenString:(NSString *)start andString:(NSString *)stop{
     
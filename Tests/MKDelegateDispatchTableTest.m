@@ -0,0 +1,388 @@
+//
+//  MKDelegateDispatchTableTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Checks the implementations MKDelegateDispatchTable finds for a delegate, and that requests call
+ the same delegate methods they called before the table: the custom selector before
+ facebookRequest:responseReceived:, which comes before the deprecated facebookResponseReceived:.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKDelegateDispatchTableTest.m -o build/MKDelegateDispatchTableTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKDelegateDispatchTableTest
+
+ Covered: a table is shared by a class and found again after key-value observing swaps the
+ delegate's class, delegates that override respondsToSelector: or are proxies are asked every time,
+ methods added at runtime are seen after flushDispatchTables, and completion handlers are called
+ once after the delegate and then let go.
+
+ Exits with 0 if every check passed.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+#import <objc/runtime.h>
+#import <objc/message.h>
+#import "../MKDelegateDispatchTable.h"
+
+static const NSTimeInterval MKTestTimeout = 10;
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: %@", [NSString stringWithFormat:__VA_ARGS__]); \
+	} \
+} while (0)
+
+
+//implements the current response message and a custom selector, has a property to observe
+@interface MKTestDelegate : NSObject {
+@public
+	NSString *name;
+	NSUInteger responseCount;
+	NSUInteger customSelectorCount;
+	NSUInteger errorCount;
+}
+@property (copy) NSString *name;
+@end
+
+@implementation MKTestDelegate
+
+@synthesize name;
+
+- (void)dealloc
+{
+	[name release];
+	[super dealloc];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request responseReceived:(id)response
+{
+	responseCount++;
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error
+{
+	errorCount++;
+}
+
+- (void)customResponseReceived:(id)response
+{
+	customSelectorCount++;
+}
+
+@end
+
+
+//only the message earlier versions sent
+@interface MKTestDeprecatedDelegate : NSObject {
+@public
+	NSUInteger responseCount;
+}
+@end
+
+@implementation MKTestDeprecatedDelegate
+
+- (void)facebookResponseReceived:(id)response
+{
+	responseCount++;
+}
+
+@end
+
+
+//answers respondsToSelector: per instance, and forwards everything it answers YES for
+@interface MKTestSwitchingDelegate : NSObject {
+@public
+	BOOL respondsToResponses;
+	NSUInteger forwardedCount;
+}
+@end
+
+@implementation MKTestSwitchingDelegate
+
+- (BOOL)respondsToSelector:(SEL)aSelector
+{
+	if (aSelector == @selector(facebookRequest:responseReceived:)) {
+		return respondsToResponses;
+	}
+	return [super respondsToSelector:aSelector];
+}
+
+- (NSMethodSignature *)methodSignatureForSelector:(SEL)aSelector
+{
+	if (aSelector == @selector(facebookRequest:responseReceived:)) {
+		return [NSMethodSignature signatureWithObjCTypes:"v@:@@"];
+	}
+	return [super methodSignatureForSelector:aSelector];
+}
+
+- (void)forwardInvocation:(NSInvocation *)invocation
+{
+	if ([invocation selector] == @selector(facebookRequest:responseReceived:)) {
+		forwardedCount++;
+		return;
+	}
+	[super forwardInvocation:invocation];
+}
+
+@end
+
+
+@interface MKTestProxy : NSProxy {
+	id _target;
+}
+- (id)initWithTarget:(id)target;
+@end
+
+@implementation MKTestProxy
+
+- (id)initWithTarget:(id)target
+{
+	_target = [target retain];
+	return self;
+}
+
+- (void)dealloc
+{
+	[_target release];
+	[super dealloc];
+}
+
+- (BOOL)respondsToSelector:(SEL)aSelector
+{
+	return [_target respondsToSelector:aSelector];
+}
+
+- (NSMethodSignature *)methodSignatureForSelector:(SEL)aSelector
+{
+	return [_target methodSignatureForSelector:aSelector];
+}
+
+- (void)forwardInvocation:(NSInvocation *)invocation
+{
+	[invocation invokeWithTarget:_target];
+}
+
+@end
+
+
+@interface MKTestAddedMethodDelegate : NSObject {
+@public
+	NSUInteger errorCount;
+}
+@end
+
+@implementation MKTestAddedMethodDelegate
+@end
+
+static void MKTestAddedErrorReceived(id self, SEL _cmd, MKFacebookRequest *request, MKFacebookResponseError *error)
+{
+	((MKTestAddedMethodDelegate *)self)->errorCount++;
+}
+
+
+static void MKTestClassTables(void)
+{
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+	MKTestDelegate *otherDelegate = [[[MKTestDelegate alloc] init] autorelease];
+	MKDelegateDispatchTable *table = [MKDelegateDispatchTable dispatchTableForDelegate:delegate];
+
+	MKTestCheck(table != nil && table == [MKDelegateDispatchTable dispatchTableForDelegate:otherDelegate], @"two delegates of one class have different tables");
+	MKTestCheck([MKDelegateDispatchTable dispatchTableForDelegate:nil] == nil, @"a nil delegate has a table");
+
+	IMP expected = [delegate methodForSelector:@selector(facebookRequest:responseReceived:)];
+	MKTestCheck([table implementationForMessage:MKDelegateMessageResponseReceived delegate:delegate] == expected, @"facebookRequest:responseReceived: isn't the delegate's implementation");
+	MKTestCheck([table implementationForMessage:MKDelegateMessageDeprecatedResponseReceived delegate:delegate] == NULL, @"facebookResponseReceived: was found on a delegate without it");
+	MKTestCheck([table implementationForMessage:MKDelegateMessageFailed delegate:delegate] == NULL, @"facebookRequest:failed: was found on a delegate without it");
+	MKTestCheck([table implementationForSelector:@selector(customResponseReceived:) delegate:delegate] == [delegate methodForSelector:@selector(customResponseReceived:)], @"the custom selector isn't the delegate's implementation");
+	MKTestCheck([table implementationForSelector:@selector(missingResponseReceived:) delegate:delegate] == NULL, @"a missing custom selector was found");
+	MKTestCheck([table implementationForSelector:NULL delegate:delegate] == NULL, @"no custom selector has an implementation");
+
+	((MKDelegateTwoObjectIMP)[table implementationForMessage:MKDelegateMessageResponseReceived delegate:delegate])(delegate, @selector(facebookRequest:responseReceived:), nil, nil);
+	MKTestCheck(delegate->responseCount == 1, @"calling the implementation reached the delegate %lu times", (unsigned long)delegate->responseCount);
+}
+
+
+//observing a delegate gives it a new class, NSKVONotifying_MKTestDelegate, and the request's cached table has to follow
+static void MKTestObservedDelegate(void)
+{
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+	MKDelegateDispatchTable *cachedTable = nil;
+	MKDelegateDispatchTable *classTable = [MKDelegateDispatchTable dispatchTableForDelegate:delegate cachedTable:&cachedTable];
+	MKTestCheck(classTable == [MKDelegateDispatchTable dispatchTableForDelegate:delegate] && cachedTable == classTable, @"the cached table isn't the class's table");
+	MKTestCheck([MKDelegateDispatchTable dispatchTableForDelegate:delegate cachedTable:&cachedTable] == classTable, @"an unchanged delegate got a new table");
+
+	Class originalClass = object_getClass(delegate);
+	[delegate addObserver:delegate forKeyPath:@"name" options:0 context:NULL];
+	MKTestCheck(object_getClass(delegate) != originalClass, @"observing the delegate didn't change its class, nothing else here is tested");
+
+	MKDelegateDispatchTable *observedTable = [MKDelegateDispatchTable dispatchTableForDelegate:delegate cachedTable:&cachedTable];
+	MKTestCheck(observedTable != classTable && cachedTable == observedTable, @"the cached table wasn't replaced when the delegate's class changed");
+	MKTestCheck([observedTable implementationForMessage:MKDelegateMessageResponseReceived delegate:delegate] == [delegate methodForSelector:@selector(facebookRequest:responseReceived:)], @"the observed delegate's facebookRequest:responseReceived: isn't its implementation");
+	MKTestCheck([observedTable implementationForMessage:MKDelegateMessageFailed delegate:delegate] == NULL, @"the observed delegate has a facebookRequest:failed:");
+
+	[delegate removeObserver:delegate forKeyPath:@"name"];
+	MKTestCheck([MKDelegateDispatchTable dispatchTableForDelegate:delegate cachedTable:&cachedTable] == classTable, @"the delegate didn't get its class's table back once it wasn't observed");
+	[cachedTable release];
+}
+
+
+static void MKTestPerInstanceDelegates(void)
+{
+	MKTestSwitchingDelegate *delegate = [[[MKTestSwitchingDelegate alloc] init] autorelease];
+	MKDelegateDispatchTable *table = [MKDelegateDispatchTable dispatchTableForDelegate:delegate];
+	MKTestCheck([table implementationForMessage:MKDelegateMessageResponseReceived delegate:delegate] == NULL, @"a delegate answering NO has an implementation");
+	delegate->respondsToResponses = YES;
+	IMP implementation = [table implementationForMessage:MKDelegateMessageResponseReceived delegate:delegate];
+	MKTestCheck(implementation == (IMP)objc_msgSend, @"a delegate overriding respondsToSelector: isn't sent the message");
+	if (implementation != NULL) {
+		((MKDelegateTwoObjectIMP)implementation)(delegate, @selector(facebookRequest:responseReceived:), nil, nil);
+	}
+	MKTestCheck(delegate->forwardedCount == 1, @"the forwarded message arrived %lu times", (unsigned long)delegate->forwardedCount);
+
+	MKTestDelegate *target = [[[MKTestDelegate alloc] init] autorelease];
+	MKTestProxy *proxy = [[[MKTestProxy alloc] initWithTarget:target] autorelease];
+	table = [MKDelegateDispatchTable dispatchTableForDelegate:proxy];
+	implementation = [table implementationForMessage:MKDelegateMessageResponseReceived delegate:proxy];
+	MKTestCheck(implementation == (IMP)objc_msgSend, @"a proxy isn't sent the message");
+	MKTestCheck([table implementationForMessage:MKDelegateMessageFailed delegate:proxy] == NULL, @"a proxy for a delegate without facebookRequest:failed: has it");
+	if (implementation != NULL) {
+		((MKDelegateTwoObjectIMP)implementation)(proxy, @selector(facebookRequest:responseReceived:), nil, nil);
+	}
+	MKTestCheck(target->responseCount == 1, @"the proxy's target received the message %lu times", (unsigned long)target->responseCount);
+}
+
+
+static void MKTestFlush(void)
+{
+	MKTestAddedMethodDelegate *delegate = [[[MKTestAddedMethodDelegate alloc] init] autorelease];
+	MKTestCheck([[MKDelegateDispatchTable dispatchTableForDelegate:delegate] implementationForMessage:MKDelegateMessageErrorReceived delegate:delegate] == NULL, @"a delegate without facebookRequest:errorReceived: has it");
+
+	class_addMethod([MKTestAddedMethodDelegate class], @selector(facebookRequest:errorReceived:), (IMP)MKTestAddedErrorReceived, "v@:@@");
+	[MKDelegateDispatchTable flushDispatchTables];
+	MKTestCheck([[MKDelegateDispatchTable dispatchTableForDelegate:delegate] implementationForMessage:MKDelegateMessageErrorReceived delegate:delegate] == (IMP)MKTestAddedErrorReceived, @"a method added at runtime wasn't found after flushDispatchTables");
+}
+
+
+static MKFacebookRequest *MKTestRequest(id delegate, SEL selector, NSString *method)
+{
+	MKFacebookRequest *request = [[[MKFacebookRequest alloc] initWithDelegate:delegate selector:selector] autorelease];
+	request.method = method;
+	request.responseFormat = MKFacebookRequestResponseFormatJSON;
+	request.numberOfRequestAttempts = 1;
+	request.coalescesRequests = NO;
+	request.displayAPIErrorAlerts = NO;
+	return request;
+}
+
+
+static void MKTestRunUntil(NSUInteger *count, NSUInteger expected)
+{
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKTestTimeout];
+	while (*count < expected && [timeout timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+	}
+	//a second delivery would come from the next timers
+	[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+}
+
+
+//whole requests, the delegate observed between them
+static void MKTestRequests(MKLoopbackTransport *transport)
+{
+	[transport addResponse:@"[]" forMethod:@"test.dispatch"];
+
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+	MKFacebookRequest *request = MKTestRequest(delegate, nil, @"test.dispatch");
+	[request sendRequest];
+	MKTestRunUntil(&delegate->responseCount, 1);
+	MKTestCheck(delegate->responseCount == 1, @"facebookRequest:responseReceived: was called %lu times", (unsigned long)delegate->responseCount);
+
+	[delegate addObserver:delegate forKeyPath:@"name" options:0 context:NULL];
+	[request sendRequest];
+	MKTestRunUntil(&delegate->responseCount, 2);
+	MKTestCheck(delegate->responseCount == 2, @"facebookRequest:responseReceived: was called %lu times once the delegate was observed, should be twice in all", (unsigned long)delegate->responseCount);
+	[delegate removeObserver:delegate forKeyPath:@"name"];
+
+	//the custom selector takes the place of facebookRequest:responseReceived:
+	request = MKTestRequest(delegate, @selector(customResponseReceived:), @"test.dispatch");
+	[request sendRequest];
+	MKTestRunUntil(&delegate->customSelectorCount, 1);
+	MKTestCheck(delegate->customSelectorCount == 1 && delegate->responseCount == 2, @"with a custom selector it was called %lu times, facebookRequest:responseReceived: %lu times in all", (unsigned long)delegate->customSelectorCount, (unsigned long)delegate->responseCount);
+
+	MKTestDeprecatedDelegate *deprecatedDelegate = [[[MKTestDeprecatedDelegate alloc] init] autorelease];
+	[MKTestRequest(deprecatedDelegate, nil, @"test.dispatch") sendRequest];
+	MKTestRunUntil(&deprecatedDelegate->responseCount, 1);
+	MKTestCheck(deprecatedDelegate->responseCount == 1, @"facebookResponseReceived: was called %lu times", (unsigned long)deprecatedDelegate->responseCount);
+
+	MKTestSwitchingDelegate *switchingDelegate = [[[MKTestSwitchingDelegate alloc] init] autorelease];
+	switchingDelegate->respondsToResponses = YES;
+	[MKTestRequest(switchingDelegate, nil, @"test.dispatch") sendRequest];
+	MKTestRunUntil(&switchingDelegate->forwardedCount, 1);
+	MKTestCheck(switchingDelegate->forwardedCount == 1, @"the forwarding delegate received %lu responses", (unsigned long)switchingDelegate->forwardedCount);
+}
+
+
+#if NS_BLOCKS_AVAILABLE
+static void MKTestCompletionHandlers(MKLoopbackTransport *transport)
+{
+	[transport addErrorCode:100 forMethod:@"test.completionError"];
+
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+	NSArray *methods = [NSArray arrayWithObjects:@"test.dispatch", @"test.completionError", nil];
+	for (NSString *method in methods) {
+		__block NSUInteger calls = 0;
+		__block BOOL delegateCalledFirst = NO;
+		__block BOOL hadResult = NO;
+		NSUInteger delegateCalls = delegate->responseCount + delegate->errorCount;
+
+		MKFacebookRequest *request = MKTestRequest(delegate, nil, method);
+		request.completionHandler = ^(MKFacebookRequest *aRequest, id response, MKFacebookResponseError *responseError, NSError *error) {
+			calls++;
+			delegateCalledFirst = delegate->responseCount + delegate->errorCount == delegateCalls + 1;
+			hadResult = response != nil || responseError != nil;
+		};
+		[request sendRequest];
+		MKTestRunUntil(&calls, 1);
+
+		MKTestCheck(calls == 1, @"%@: the completion handler was called %lu times", method, (unsigned long)calls);
+		MKTestCheck(delegateCalledFirst && hadResult, @"%@: the completion handler wasn't called after the delegate with the result", method);
+		MKTestCheck(request.completionHandler == nil, @"%@: the request kept its completion handler after calling it", method);
+	}
+}
+#endif
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	MKTestClassTables();
+	MKTestObservedDelegate();
+	MKTestPerInstanceDelegates();
+	MKTestFlush();
+
+	MKLoopbackTransport *transport = [MKLoopbackTransport transport];
+	[MKFacebookRequest setDefaultTransport:transport];
+	[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] setEnabled:NO];
+	MKTestRequests(transport);
+#if NS_BLOCKS_AVAILABLE
+	MKTestCompletionHandlers(transport);
+#endif
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed");
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
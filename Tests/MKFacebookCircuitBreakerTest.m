@@ -0,0 +1,258 @@
+//
+//  MKFacebookCircuitBreakerTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Drives MKFacebookCircuitBreaker through its states with requests answered by MKLoopbackTransport:
+ closed until enough attempts failed, open, half open with a single probe, and closed or open again
+ depending on the probe.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKFacebookCircuitBreakerTest.m -o build/MKFacebookCircuitBreakerTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKFacebookCircuitBreakerTest
+
+ The circuit opens after 4 attempts and stays open for half a second. Requests are attempted once,
+ so each request is one attempt. Every state change has to be posted, and requests failed by an open
+ circuit must not be sent or take a token from MKFacebookRateLimiter.
+
+ Exits with 0 if every check passed.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+
+static const NSTimeInterval MKTestTimeout = 10;
+static const NSTimeInterval MKTestOpenInterval = 0.5;
+static const NSUInteger MKTestMinimumRequestCount = 4;
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: %@", [NSString stringWithFormat:__VA_ARGS__]); \
+	} \
+} while (0)
+
+
+@interface MKTestDelegate : NSObject {
+@public
+	NSUInteger deliveryCount;
+	NSUInteger responseCount;
+	NSUInteger errorCount;
+	NSUInteger openCircuitCount;
+	NSUInteger otherFailureCount;
+	NSDate *retryDate;
+	NSMutableArray *stateChanges;
+}
+- (void)reset;
+@end
+
+@implementation MKTestDelegate
+
+- (id)init
+{
+	if (self = [super init]) {
+		stateChanges = [[NSMutableArray alloc] init];
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(circuitChanged:) name:MKFacebookCircuitBreakerStateChangedNotification object:nil];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	[stateChanges release];
+	[retryDate release];
+	[super dealloc];
+}
+
+- (void)reset
+{
+	deliveryCount = responseCount = errorCount = openCircuitCount = otherFailureCount = 0;
+	[retryDate release];
+	retryDate = nil;
+}
+
+- (void)circuitChanged:(NSNotification *)notification
+{
+	[stateChanges addObject:[notification userInfo]];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request responseReceived:(id)response
+{
+	deliveryCount++;
+	responseCount++;
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error
+{
+	deliveryCount++;
+	errorCount++;
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request failed:(NSError *)error
+{
+	deliveryCount++;
+	if ([[error domain] isEqualToString:MKFacebookCircuitBreakerErrorDomain] && [error code] == MKFacebookCircuitBreakerOpenError) {
+		openCircuitCount++;
+		[retryDate release];
+		retryDate = [[[error userInfo] objectForKey:MKFacebookCircuitBreakerRetryDateKey] retain];
+	} else {
+		otherFailureCount++;
+	}
+}
+
+@end
+
+
+static MKFacebookRequest *MKTestRequest(NSString *method, MKTestDelegate *delegate)
+{
+	MKFacebookRequest *request = [[[MKFacebookRequest alloc] initWithDelegate:delegate selector:nil] autorelease];
+	request.method = method;
+	request.responseFormat = MKFacebookRequestResponseFormatJSON;
+	request.numberOfRequestAttempts = 1;
+	request.coalescesRequests = NO;
+	request.displayAPIErrorAlerts = NO;
+	return request;
+}
+
+
+static void MKTestRunUntilDelivered(MKTestDelegate *delegate, NSUInteger count)
+{
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKTestTimeout];
+	while (delegate->deliveryCount < count && [timeout timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+	}
+	MKTestCheck(delegate->deliveryCount == count, @"%lu of %lu requests were delivered", (unsigned long)delegate->deliveryCount, (unsigned long)count);
+}
+
+
+//sends requests one after another, each after the last was delivered
+static void MKTestSend(NSString *method, NSUInteger count, MKTestDelegate *delegate)
+{
+	[delegate reset];
+	for (NSUInteger i = 0; i < count; i++) {
+		[MKTestRequest(method, delegate) sendRequest];
+		MKTestRunUntilDelivered(delegate, i + 1);
+	}
+}
+
+
+static void MKTestWaitForHalfOpen(MKFacebookCircuitBreaker *breaker)
+{
+	NSDate *halfOpen = [NSDate dateWithTimeIntervalSinceNow:MKTestOpenInterval + 0.05];
+	while ([halfOpen timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:halfOpen];
+	}
+	MKTestCheck([breaker stateForEndpoint:MKAPIServerURL] == MKFacebookCircuitStateHalfOpen, @"the circuit is in state %d after its open interval, expected half open", [breaker stateForEndpoint:MKAPIServerURL]);
+}
+
+
+//the state changes posted since the last call have to lead through the states given, in order
+static void MKTestStateChanges(MKTestDelegate *delegate, NSString *when, const MKFacebookCircuitState *states, NSUInteger stateCount)
+{
+	NSString *host = [[NSURL URLWithString:MKAPIServerURL] host];
+	MKTestCheck([delegate->stateChanges count] == stateCount - 1, @"%@: %lu state changes were posted, expected %lu: %@", when, (unsigned long)[delegate->stateChanges count], (unsigned long)(stateCount - 1), delegate->stateChanges);
+	for (NSUInteger i = 0; i < [delegate->stateChanges count] && i + 1 < stateCount; i++) {
+		NSDictionary *change = [delegate->stateChanges objectAtIndex:i];
+		MKTestCheck([[change objectForKey:MKFacebookCircuitBreakerPreviousStateKey] intValue] == states[i] && [[change objectForKey:MKFacebookCircuitBreakerStateKey] intValue] == states[i + 1], @"%@: the circuit went from %@ to %@, expected %d to %d", when, [change objectForKey:MKFacebookCircuitBreakerPreviousStateKey], [change objectForKey:MKFacebookCircuitBreakerStateKey], states[i], states[i + 1]);
+		MKTestCheck([[change objectForKey:MKFacebookCircuitBreakerHostKey] caseInsensitiveCompare:host] == NSOrderedSame, @"%@: the change was posted for %@, expected %@", when, [change objectForKey:MKFacebookCircuitBreakerHostKey], host);
+		MKTestCheck([change objectForKey:MKFacebookCircuitBreakerFailureRateKey] != nil, @"%@: the change has no failure rate", when);
+	}
+	[delegate->stateChanges removeAllObjects];
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	MKLoopbackTransport *transport = [MKLoopbackTransport transport];
+	[transport addErrorCode:2 forMethod:@"test.unavailable"];
+	[transport addErrorCode:100 forMethod:@"test.invalidParameter"];
+	[transport addResponse:@"[]" forMethod:@"test.available"];
+	[MKFacebookRequest setDefaultTransport:transport];
+
+	MKFacebookCircuitBreaker *breaker = [MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker];
+	breaker.enabled = YES;
+	breaker.minimumRequestCount = MKTestMinimumRequestCount;
+	breaker.failureRateThreshold = 0.5;
+	breaker.openInterval = MKTestOpenInterval;
+	[breaker reset];
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+
+	//errors other than 1 and 2 mean Facebook is up
+	MKTestSend(@"test.invalidParameter", MKTestMinimumRequestCount * 2, delegate);
+	MKTestCheck([breaker stateForEndpoint:MKAPIServerURL] == MKFacebookCircuitStateClosed && [delegate->stateChanges count] == 0, @"error 100 changed the circuit to state %d", [breaker stateForEndpoint:MKAPIServerURL]);
+	[breaker reset];
+
+	//the last of minimumRequestCount failures opens the circuit
+	MKTestSend(@"test.unavailable", MKTestMinimumRequestCount - 1, delegate);
+	MKTestCheck([breaker stateForEndpoint:MKAPIServerURL] == MKFacebookCircuitStateClosed, @"%lu failures opened the circuit before minimumRequestCount", (unsigned long)(MKTestMinimumRequestCount - 1));
+	MKTestSend(@"test.unavailable", 1, delegate);
+	MKTestCheck([breaker stateForEndpoint:MKAPIServerURL] == MKFacebookCircuitStateOpen, @"%lu failures left the circuit in state %d", (unsigned long)MKTestMinimumRequestCount, [breaker stateForEndpoint:MKAPIServerURL]);
+	MKFacebookCircuitState opening[] = {MKFacebookCircuitStateClosed, MKFacebookCircuitStateOpen};
+	MKTestStateChanges(delegate, @"opening", opening, 2);
+
+	//an open circuit fails requests without sending them or taking a token
+	MKFacebookRateLimiter *limiter = [MKFacebookRateLimiter sharedMKFacebookRateLimiter];
+	[limiter resetStatistics];
+	NSUInteger sentBefore = [transport requestCountForMethod:@"test.available"];
+	MKTestSend(@"test.available", 3, delegate);
+	MKTestCheck(delegate->openCircuitCount == 3 && delegate->responseCount == 0, @"an open circuit let %lu of 3 requests through", (unsigned long)delegate->responseCount);
+	MKTestCheck([transport requestCountForMethod:@"test.available"] == sentBefore, @"an open circuit sent %lu requests", (unsigned long)([transport requestCountForMethod:@"test.available"] - sentBefore));
+	MKTestCheck([[[limiter statistics] objectForKey:MKFacebookRateLimiterRequestCountKey] unsignedIntegerValue] == 0, @"requests failed by an open circuit asked the rate limiter for %@ tokens", [[limiter statistics] objectForKey:MKFacebookRateLimiterRequestCountKey]);
+	MKTestCheck(delegate->retryDate != nil && [delegate->retryDate timeIntervalSinceNow] > 0 && [delegate->retryDate timeIntervalSinceNow] <= MKTestOpenInterval, @"the open circuit error says to retry at %@", delegate->retryDate);
+
+	//half open: the next request moves the circuit and goes through as the probe, the others fail. the probe fails and the circuit opens again
+	MKTestWaitForHalfOpen(breaker);
+	[delegate reset];
+	[MKTestRequest(@"test.unavailable", delegate) sendRequest];
+	[MKTestRequest(@"test.available", delegate) sendRequest];
+	MKTestRunUntilDelivered(delegate, 2);
+	MKTestCheck(delegate->errorCount == 1 && delegate->openCircuitCount == 1, @"a half open circuit let %lu probes through and failed %lu requests, expected 1 and 1", (unsigned long)delegate->errorCount, (unsigned long)delegate->openCircuitCount);
+	MKTestCheck([breaker stateForEndpoint:MKAPIServerURL] == MKFacebookCircuitStateOpen, @"a failed probe left the circuit in state %d", [breaker stateForEndpoint:MKAPIServerURL]);
+	MKFacebookCircuitState failedProbe[] = {MKFacebookCircuitStateOpen, MKFacebookCircuitStateHalfOpen, MKFacebookCircuitStateOpen};
+	MKTestStateChanges(delegate, @"failed probe", failedProbe, 3);
+
+	//a cancelled probe lets the next request probe, which succeeds and closes the circuit
+	MKTestWaitForHalfOpen(breaker);
+	transport.latency = 0.2;
+	[delegate reset];
+	MKFacebookRequest *probe = MKTestRequest(@"test.available", delegate);
+	[probe sendRequest];
+	[probe cancelRequest];
+	transport.latency = 0;
+	MKTestSend(@"test.available", 1, delegate);
+	MKTestCheck(delegate->responseCount == 1, @"the request after a cancelled probe wasn't let through");
+	MKTestCheck([breaker stateForEndpoint:MKAPIServerURL] == MKFacebookCircuitStateClosed, @"a successful probe left the circuit in state %d", [breaker stateForEndpoint:MKAPIServerURL]);
+	MKFacebookCircuitState successfulProbe[] = {MKFacebookCircuitStateOpen, MKFacebookCircuitStateHalfOpen, MKFacebookCircuitStateClosed};
+	MKTestStateChanges(delegate, @"successful probe", successfulProbe, 3);
+
+	//closing forgets the failures: it takes minimumRequestCount new ones to open again
+	MKTestSend(@"test.unavailable", MKTestMinimumRequestCount - 1, delegate);
+	MKTestCheck([breaker stateForEndpoint:MKAPIServerURL] == MKFacebookCircuitStateClosed, @"failures from before the circuit closed were counted again");
+	MKTestSend(@"test.unavailable", 1, delegate);
+	MKTestStateChanges(delegate, @"opening again", opening, 2);
+
+	//turning the breaker off closes the circuit and sends everything
+	breaker.enabled = NO;
+	MKTestCheck([breaker stateForEndpoint:MKAPIServerURL] == MKFacebookCircuitStateClosed, @"turning the breaker off left the circuit in state %d", [breaker stateForEndpoint:MKAPIServerURL]);
+	[delegate->stateChanges removeAllObjects];
+	MKTestSend(@"test.unavailable", MKTestMinimumRequestCount * 2, delegate);
+	MKTestCheck(delegate->errorCount == MKTestMinimumRequestCount * 2 && [delegate->stateChanges count] == 0, @"with the breaker off %lu of %lu requests were sent", (unsigned long)delegate->errorCount, (unsigned long)(MKTestMinimumRequestCount * 2));
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed");
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
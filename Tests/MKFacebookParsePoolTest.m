@@ -0,0 +1,219 @@
+//
+//  MKFacebookParsePoolTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Checks that responses parsed by MKFacebookParsePool reach their delegates on the thread the
+ requests were sent from, in the order the requests finished loading, even when a later response is
+ parsed first.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKFacebookParsePoolTest.m -o build/MKFacebookParsePoolTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKFacebookParsePoolTest
+
+ Every batch starts with a large response followed by small ones, all answered by MKLoopbackTransport
+ without latency, so they finish loading in the order they were sent and the small ones are parsed
+ while the large one still is. Batches are sent with maximumConcurrentParses at 4, at 1 and at 0.
+ A delegate that cancels the next request from its callback checks that an already parsed response
+ of a cancelled request is dropped.
+
+ Exits with 0 if every check passed.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+
+static const NSTimeInterval MKTestTimeout = 30;
+static const NSUInteger MKTestBatchSize = 8;
+static const NSUInteger MKTestLargeResponseCount = 50000;
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: %@", [NSString stringWithFormat:__VA_ARGS__]); \
+	} \
+} while (0)
+
+
+@interface MKTestDelegate : NSObject {
+@public
+	NSMutableArray *deliveredMethods;
+	NSUInteger offThreadCount;
+	NSUInteger wrongResponseCount;
+	NSArray *requests;
+	NSUInteger cancelAfterIndex;
+}
+@end
+
+@implementation MKTestDelegate
+
+- (id)init
+{
+	if (self = [super init]) {
+		deliveredMethods = [[NSMutableArray alloc] init];
+		cancelAfterIndex = NSNotFound;
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[deliveredMethods release];
+	[requests release];
+	[super dealloc];
+}
+
+- (void)delivered:(MKFacebookRequest *)request
+{
+	if ([NSThread isMainThread] == NO) {
+		offThreadCount++;
+	}
+	[deliveredMethods addObject:request.method];
+	NSUInteger index = [requests indexOfObjectIdenticalTo:request];
+	if (index == cancelAfterIndex && index + 1 < [requests count]) {
+		[[requests objectAtIndex:index + 1] cancelRequest];
+	}
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request responseReceived:(id)response
+{
+	//every response is an array as long as the number in its method name, test.response.<index>.<count>
+	NSUInteger count = (NSUInteger)[[[request.method componentsSeparatedByString:@"."] lastObject] integerValue];
+	if ([response isKindOfClass:[NSArray class]] == NO || [response count] != count) {
+		wrongResponseCount++;
+	}
+	[self delivered:request];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error
+{
+	wrongResponseCount++;
+	[self delivered:request];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request failed:(NSError *)error
+{
+	wrongResponseCount++;
+	[self delivered:request];
+}
+
+@end
+
+
+static NSString *MKTestResponse(NSUInteger count)
+{
+	NSMutableArray *items = [NSMutableArray arrayWithCapacity:count];
+	for (NSUInteger i = 0; i < count; i++) {
+		[items addObject:[NSString stringWithFormat:@"{\"pid\":\"%lu\",\"caption\":\"Photo number %lu\",\"created\":%lu}", (unsigned long)i, (unsigned long)i, (unsigned long)(1287000000 + i)]];
+	}
+	return [NSString stringWithFormat:@"[%@]", [items componentsJoinedByString:@","]];
+}
+
+
+//sends a large request and small ones, returns the methods in the order they were sent
+static NSArray *MKTestSendBatch(MKLoopbackTransport *transport, MKTestDelegate *delegate, NSUInteger cancelAfterIndex)
+{
+	static NSString *largeResponse = nil;
+	if (largeResponse == nil) {
+		largeResponse = [MKTestResponse(MKTestLargeResponseCount) retain];
+	}
+
+	NSMutableArray *methods = [NSMutableArray arrayWithCapacity:MKTestBatchSize];
+	NSMutableArray *requests = [NSMutableArray arrayWithCapacity:MKTestBatchSize];
+	for (NSUInteger i = 0; i < MKTestBatchSize; i++) {
+		NSUInteger count = i == 0 ? MKTestLargeResponseCount : i;
+		NSString *method = [NSString stringWithFormat:@"test.response.%lu.%lu", (unsigned long)i, (unsigned long)count];
+		[transport addResponse:(i == 0 ? largeResponse : MKTestResponse(count)) forMethod:method];
+
+		MKFacebookRequest *request = [[[MKFacebookRequest alloc] initWithDelegate:delegate selector:nil] autorelease];
+		request.method = method;
+		request.responseFormat = MKFacebookRequestResponseFormatJSON;
+		request.numberOfRequestAttempts = 1;
+		request.coalescesRequests = NO;
+		request.displayAPIErrorAlerts = NO;
+		[methods addObject:method];
+		[requests addObject:request];
+	}
+
+	[delegate->deliveredMethods removeAllObjects];
+	delegate->offThreadCount = 0;
+	delegate->wrongResponseCount = 0;
+	[delegate->requests release];
+	delegate->requests = [requests retain];
+	delegate->cancelAfterIndex = cancelAfterIndex;
+
+	for (MKFacebookRequest *request in requests) {
+		[request sendRequest];
+	}
+
+	NSUInteger expected = cancelAfterIndex == NSNotFound ? MKTestBatchSize : MKTestBatchSize - 1;
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKTestTimeout];
+	while ([delegate->deliveredMethods count] < expected && [timeout timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+	}
+	//a cancelled response delivered anyway would arrive from the next deliveries
+	[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+	return methods;
+}
+
+
+static void MKTestOrder(MKLoopbackTransport *transport, MKTestDelegate *delegate, NSUInteger concurrentParses)
+{
+	MKFacebookParsePool *pool = [MKFacebookParsePool sharedMKFacebookParsePool];
+	pool.maximumConcurrentParses = concurrentParses;
+	[pool resetStatistics];
+
+	NSArray *methods = MKTestSendBatch(transport, delegate, NSNotFound);
+	MKTestCheck([delegate->deliveredMethods isEqualToArray:methods], @"%lu parses at a time delivered %@, sent %@", (unsigned long)concurrentParses, delegate->deliveredMethods, methods);
+	MKTestCheck(delegate->offThreadCount == 0, @"%lu parses at a time delivered %lu responses off the main thread", (unsigned long)concurrentParses, (unsigned long)delegate->offThreadCount);
+	MKTestCheck(delegate->wrongResponseCount == 0, @"%lu parses at a time delivered %lu wrong responses", (unsigned long)concurrentParses, (unsigned long)delegate->wrongResponseCount);
+
+	NSUInteger parsedCount = [[[pool statistics] objectForKey:MKFacebookParsePoolParsedResponseCountKey] unsignedIntegerValue];
+	MKTestCheck(parsedCount == MKTestBatchSize, @"%lu parses at a time counted %lu parsed responses, %lu were sent", (unsigned long)concurrentParses, (unsigned long)parsedCount, (unsigned long)MKTestBatchSize);
+}
+
+
+//the large response's delegate cancels the second request, which is parsed by then and waiting
+static void MKTestCancelWhileWaiting(MKLoopbackTransport *transport, MKTestDelegate *delegate)
+{
+	[MKFacebookParsePool sharedMKFacebookParsePool].maximumConcurrentParses = 4;
+
+	NSMutableArray *methods = [NSMutableArray arrayWithArray:MKTestSendBatch(transport, delegate, 0)];
+	[methods removeObjectAtIndex:1];
+	MKTestCheck([delegate->deliveredMethods isEqualToArray:methods], @"cancelling the second request delivered %@, expected %@", delegate->deliveredMethods, methods);
+	MKTestCheck(delegate->wrongResponseCount == 0, @"cancelling the second request delivered %lu wrong responses", (unsigned long)delegate->wrongResponseCount);
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	MKLoopbackTransport *transport = [MKLoopbackTransport transport];
+	[MKFacebookRequest setDefaultTransport:transport];
+	[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] setEnabled:NO];
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+
+	NSUInteger concurrentParses[] = {4, 1, 0};
+	for (NSUInteger i = 0; i < sizeof(concurrentParses) / sizeof(concurrentParses[0]); i++) {
+		NSAutoreleasePool *batchPool = [[NSAutoreleasePool alloc] init];
+		MKTestOrder(transport, delegate, concurrentParses[i]);
+		[batchPool drain];
+	}
+	MKTestCancelWhileWaiting(transport, delegate);
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed");
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+//
+//  MKFacebookRequestMetricsTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Checks the statistics MKFacebookRequestMetrics reports: percentiles within the accuracy of its
+ buckets, exact counts, means, minimums and maximums, phases left out when their moments are
+ missing, and snapshotAndReset.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKFacebookRequestMetricsTest.m -o build/MKFacebookRequestMetricsTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKFacebookRequestMetricsTest
+
+ Timestamps are first made up and passed to recordTimestamps:firstAttemptStart:forMethod:, so the
+ expected statistics are known exactly. Then requests are answered by MKLoopbackTransport with a
+ latency and a delegate that takes its time, and their phases have to be at least that long.
+
+ Exits with 0 if every check passed.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+#include <mach/mach_time.h>
+
+static const NSTimeInterval MKTestTimeout = 10;
+static const NSUInteger MKTestSampleCount = 1000;
+static const NSTimeInterval MKTestLatency = 0.1;
+static const NSTimeInterval MKTestDelegateTime = 0.02;
+static const double MKTestBucketAccuracy = 0.125;
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: %@", [NSString stringWithFormat:__VA_ARGS__]); \
+	} \
+} while (0)
+
+
+@interface MKTestDelegate : NSObject {
+@public
+	NSUInteger deliveryCount;
+}
+@end
+
+@implementation MKTestDelegate
+
+- (void)facebookRequest:(MKFacebookRequest *)request responseReceived:(id)response
+{
+	usleep((useconds_t)(MKTestDelegateTime * 1000000));
+	deliveryCount++;
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error
+{
+	deliveryCount++;
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request failed:(NSError *)error
+{
+	deliveryCount++;
+}
+
+@end
+
+
+static uint64_t MKTestTicks(double seconds)
+{
+	static mach_timebase_info_data_t timebase;
+	if (timebase.denom == 0) {
+		mach_timebase_info(&timebase);
+	}
+	return (uint64_t)llround(seconds * 1e9 * timebase.denom / timebase.numer);
+}
+
+
+static double MKTestStatistic(NSDictionary *snapshot, NSString *method, NSString *phase, NSString *key)
+{
+	return [[[[snapshot objectForKey:method] objectForKey:phase] objectForKey:key] doubleValue];
+}
+
+
+static void MKTestClose(double value, double expected, double tolerance, NSString *what)
+{
+	MKTestCheck(fabs(value - expected) <= expected * tolerance, @"%@ is %.6f s, expected %.6f s within %.1f%%", what, value, expected, tolerance * 100);
+}
+
+
+//the i-th request took 5 ms plus i * 100 us in all, its attempt 1 ms for each phase and no response headers
+static void MKTestSyntheticTimestamps(MKFacebookRequestMetrics *metrics)
+{
+	[metrics reset];
+	uint64_t start = mach_absolute_time();
+	uint64_t timestamps[MKFacebookRequestTimestampCount] = {0};
+	timestamps[MKFacebookRequestTimestampStart] = start;
+	timestamps[MKFacebookRequestTimestampBuilt] = start + MKTestTicks(0.001);
+	timestamps[MKFacebookRequestTimestampFirstByte] = start + MKTestTicks(0.002);
+	timestamps[MKFacebookRequestTimestampLastByte] = start + MKTestTicks(0.003);
+	timestamps[MKFacebookRequestTimestampParsed] = start + MKTestTicks(0.004);
+	timestamps[MKFacebookRequestTimestampDelivering] = start + MKTestTicks(0.004);
+	timestamps[MKFacebookRequestTimestampDelivered] = start + MKTestTicks(0.005);
+	for (NSUInteger i = 1; i <= MKTestSampleCount; i++) {
+		//the request waited before this attempt, the total runs from its first attempt
+		uint64_t firstAttemptStart = timestamps[MKFacebookRequestTimestampDelivered] - MKTestTicks(0.005 + i * 0.0001);
+		[metrics recordTimestamps:timestamps firstAttemptStart:firstAttemptStart forMethod:@"test.synthetic"];
+	}
+
+	//attempts that were retried have no total
+	for (NSUInteger i = 0; i < 10; i++) {
+		[metrics recordTimestamps:timestamps firstAttemptStart:0 forMethod:@"test.synthetic"];
+	}
+	[metrics recordTimestamps:timestamps firstAttemptStart:0 forMethod:nil];
+
+	NSDictionary *snapshot = [metrics snapshotAndReset];
+	NSDictionary *phases = [snapshot objectForKey:@"test.synthetic"];
+	MKTestCheck([[snapshot objectForKey:@"unknown"] objectForKey:MKFacebookRequestPhaseBuildKey] != nil, @"an attempt without a method wasn't recorded as unknown: %@", snapshot);
+	MKTestCheck([phases objectForKey:MKFacebookRequestPhaseFirstByteKey] == nil, @"attempts without response headers have a first byte phase: %@", [phases objectForKey:MKFacebookRequestPhaseFirstByteKey]);
+	MKTestCheck([[[phases objectForKey:MKFacebookRequestPhaseBuildKey] objectForKey:MKFacebookRequestMetricsCountKey] unsignedIntegerValue] == MKTestSampleCount + 10, @"the build phase counted %@ attempts, expected %lu", [[phases objectForKey:MKFacebookRequestPhaseBuildKey] objectForKey:MKFacebookRequestMetricsCountKey], (unsigned long)(MKTestSampleCount + 10));
+	MKTestCheck([[[phases objectForKey:MKFacebookRequestPhaseTotalKey] objectForKey:MKFacebookRequestMetricsCountKey] unsignedIntegerValue] == MKTestSampleCount, @"the total counted %@ requests, expected %lu", [[phases objectForKey:MKFacebookRequestPhaseTotalKey] objectForKey:MKFacebookRequestMetricsCountKey], (unsigned long)MKTestSampleCount);
+
+	//exact mean, minimum and maximum, percentiles to half a bucket
+	NSString *totalKey = MKFacebookRequestPhaseTotalKey;
+	MKTestClose(MKTestStatistic(snapshot, @"test.synthetic", totalKey, MKFacebookRequestMetricsMeanKey), 0.0001 * (MKTestSampleCount + 1) / 2 + 0.005, 1e-3, @"the mean total");
+	MKTestClose(MKTestStatistic(snapshot, @"test.synthetic", totalKey, MKFacebookRequestMetricsMinimumKey), 0.0001 + 0.005, 1e-3, @"the shortest total");
+	MKTestClose(MKTestStatistic(snapshot, @"test.synthetic", totalKey, MKFacebookRequestMetricsMaximumKey), 0.0001 * MKTestSampleCount + 0.005, 1e-3, @"the longest total");
+	MKTestClose(MKTestStatistic(snapshot, @"test.synthetic", totalKey, MKFacebookRequestMetricsP50Key), 0.0001 * MKTestSampleCount * 0.50 + 0.005, MKTestBucketAccuracy, @"the median total");
+	MKTestClose(MKTestStatistic(snapshot, @"test.synthetic", totalKey, MKFacebookRequestMetricsP95Key), 0.0001 * MKTestSampleCount * 0.95 + 0.005, MKTestBucketAccuracy, @"the 95th percentile total");
+	MKTestClose(MKTestStatistic(snapshot, @"test.synthetic", totalKey, MKFacebookRequestMetricsP99Key), 0.0001 * MKTestSampleCount * 0.99 + 0.005, MKTestBucketAccuracy, @"the 99th percentile total");
+
+	//every build took 1 ms, percentiles are kept between the minimum and the maximum
+	NSString *buildKey = MKFacebookRequestPhaseBuildKey;
+	MKTestClose(MKTestStatistic(snapshot, @"test.synthetic", buildKey, MKFacebookRequestMetricsP50Key), 0.001, 1e-3, @"the median of a constant build phase");
+	MKTestClose(MKTestStatistic(snapshot, @"test.synthetic", buildKey, MKFacebookRequestMetricsP99Key), 0.001, 1e-3, @"the 99th percentile of a constant build phase");
+	MKTestClose(MKTestStatistic(snapshot, @"test.synthetic", MKFacebookRequestPhaseConnectKey, MKFacebookRequestMetricsMeanKey), 0.001, 1e-3, @"connecting, until the first byte without response headers,");
+
+	MKTestCheck([[metrics snapshot] count] == 0, @"snapshotAndReset left %@", [metrics snapshot]);
+}
+
+
+static void MKTestRunUntilDelivered(MKTestDelegate *delegate, NSUInteger count)
+{
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKTestTimeout];
+	while (delegate->deliveryCount < count && [timeout timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+	}
+	MKTestCheck(delegate->deliveryCount == count, @"%lu of %lu requests were delivered", (unsigned long)delegate->deliveryCount, (unsigned long)count);
+}
+
+
+static void MKTestSend(NSString *method, NSUInteger count, MKTestDelegate *delegate)
+{
+	delegate->deliveryCount = 0;
+	for (NSUInteger i = 0; i < count; i++) {
+		MKFacebookRequest *request = [[[MKFacebookRequest alloc] initWithDelegate:delegate selector:nil] autorelease];
+		request.method = method;
+		request.responseFormat = MKFacebookRequestResponseFormatJSON;
+		request.retryDelay = 0;
+		request.retryJitter = 0;
+		request.coalescesRequests = NO;
+		request.displayAPIErrorAlerts = NO;
+		[request sendRequest];
+		MKTestRunUntilDelivered(delegate, i + 1);
+	}
+}
+
+
+static void MKTestRequests(MKFacebookRequestMetrics *metrics)
+{
+	MKLoopbackTransport *transport = [MKLoopbackTransport transport];
+	transport.latency = MKTestLatency;
+	[transport addResponse:@"[]" forMethod:@"test.metrics"];
+	[transport addErrorCode:2 forMethod:@"test.retried"];
+	[transport addResponse:@"[]" forMethod:@"test.retried"];
+	[MKFacebookRequest setDefaultTransport:transport];
+	[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] setEnabled:NO];
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+
+	metrics.enabled = NO;
+	[metrics reset];
+	MKTestSend(@"test.metrics", 2, delegate);
+	MKTestCheck([[metrics snapshot] count] == 0, @"requests were recorded with metrics off: %@", [metrics snapshot]);
+
+	metrics.enabled = YES;
+	MKTestSend(@"test.metrics", 5, delegate);
+	MKTestSend(@"test.retried", 1, delegate);
+	metrics.enabled = NO;
+	NSDictionary *snapshot = [metrics snapshotAndReset];
+
+	NSArray *phaseKeys = [NSArray arrayWithObjects:MKFacebookRequestPhaseBuildKey, MKFacebookRequestPhaseConnectKey, MKFacebookRequestPhaseTransferKey, MKFacebookRequestPhaseParseKey, MKFacebookRequestPhaseDelegateKey, MKFacebookRequestPhaseTotalKey, nil];
+	for (NSString *phase in phaseKeys) {
+		NSUInteger count = (NSUInteger)MKTestStatistic(snapshot, @"test.metrics", phase, MKFacebookRequestMetricsCountKey);
+		MKTestCheck(count == 5, @"%@ of test.metrics counted %lu attempts, expected 5", phase, (unsigned long)count);
+	}
+	MKTestCheck(MKTestStatistic(snapshot, @"test.metrics", MKFacebookRequestPhaseConnectKey, MKFacebookRequestMetricsMinimumKey) >= MKTestLatency * 0.9, @"connecting took %.3f s, the latency is %.3f s", MKTestStatistic(snapshot, @"test.metrics", MKFacebookRequestPhaseConnectKey, MKFacebookRequestMetricsMinimumKey), MKTestLatency);
+	MKTestCheck(MKTestStatistic(snapshot, @"test.metrics", MKFacebookRequestPhaseDelegateKey, MKFacebookRequestMetricsMinimumKey) >= MKTestDelegateTime * 0.9, @"the delegate phase took %.3f s, the delegate takes %.3f s", MKTestStatistic(snapshot, @"test.metrics", MKFacebookRequestPhaseDelegateKey, MKFacebookRequestMetricsMinimumKey), MKTestDelegateTime);
+	MKTestCheck(MKTestStatistic(snapshot, @"test.metrics", MKFacebookRequestPhaseTotalKey, MKFacebookRequestMetricsMinimumKey) >= (MKTestLatency + MKTestDelegateTime) * 0.9, @"the total took %.3f s, latency and delegate take %.3f s", MKTestStatistic(snapshot, @"test.metrics", MKFacebookRequestPhaseTotalKey, MKFacebookRequestMetricsMinimumKey), MKTestLatency + MKTestDelegateTime);
+
+	//both attempts of a retried request are recorded, its total only once and spanning both
+	NSUInteger attempts = (NSUInteger)MKTestStatistic(snapshot, @"test.retried", MKFacebookRequestPhaseBuildKey, MKFacebookRequestMetricsCountKey);
+	NSUInteger totals = (NSUInteger)MKTestStatistic(snapshot, @"test.retried", MKFacebookRequestPhaseTotalKey, MKFacebookRequestMetricsCountKey);
+	MKTestCheck(attempts == 2 && totals == 1, @"a request sent twice recorded %lu attempts and %lu totals, expected 2 and 1", (unsigned long)attempts, (unsigned long)totals);
+	MKTestCheck(MKTestStatistic(snapshot, @"test.retried", MKFacebookRequestPhaseTotalKey, MKFacebookRequestMetricsMinimumKey) >= 2 * MKTestLatency * 0.9, @"the total of a request sent twice took %.3f s, less than two latencies", MKTestStatistic(snapshot, @"test.retried", MKFacebookRequestPhaseTotalKey, MKFacebookRequestMetricsMinimumKey));
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	MKFacebookRequestMetrics *metrics = [MKFacebookRequestMetrics sharedMKFacebookRequestMetrics];
+	MKTestSyntheticTimestamps(metrics);
+	MKTestRequests(metrics);
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed");
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+//
+//  MKFacebookRequestQueueTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Checks the order MKFacebookRequestQueue starts requests in and how many it keeps in flight, by
+ priority: maxConcurrentRequests, the reservedInteractiveRequests slots and
+ maxConcurrentBackgroundRequests.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKFacebookRequestQueueTest.m -o build/MKFacebookRequestQueueTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKFacebookRequestQueueTest
+
+ Requests are answered by MKLoopbackTransport after a latency, so the ones the queue starts together
+ overlap. The queue delegate counts requests from requestQueue:activeRequest:ofRequests: to the
+ response, by the priority they started with, and keeps the largest counts it saw.
+
+ Exits with 0 if every check passed.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+
+static const NSTimeInterval MKTestTimeout = 10;
+static const NSTimeInterval MKTestLatency = 0.2;
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: %@", [NSString stringWithFormat:__VA_ARGS__]); \
+	} \
+} while (0)
+
+
+@interface MKTestQueueDelegate : NSObject {
+@public
+	NSMutableArray *requests;				//by number, the first request is number 1
+	NSMutableArray *startedNumbers;
+	NSMutableDictionary *startPriorities;
+	NSUInteger finishedCount;
+	NSUInteger didFinishCount;
+	NSUInteger inFlight;
+	NSUInteger interactiveInFlight;
+	NSUInteger backgroundInFlight;
+	NSUInteger maxInFlight;
+	NSUInteger maxOthersInFlight;			//everything but interactive requests
+	NSUInteger maxBackgroundInFlight;
+}
+- (void)reset;
+@end
+
+@implementation MKTestQueueDelegate
+
+- (id)init
+{
+	if (self = [super init]) {
+		requests = [[NSMutableArray alloc] init];
+		startedNumbers = [[NSMutableArray alloc] init];
+		startPriorities = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[requests release];
+	[startedNumbers release];
+	[startPriorities release];
+	[super dealloc];
+}
+
+- (void)reset
+{
+	[requests removeAllObjects];
+	[startedNumbers removeAllObjects];
+	[startPriorities removeAllObjects];
+	finishedCount = didFinishCount = 0;
+	inFlight = interactiveInFlight = backgroundInFlight = 0;
+	maxInFlight = maxOthersInFlight = maxBackgroundInFlight = 0;
+}
+
+- (void)requestQueue:(MKFacebookRequestQueue *)queue activeRequest:(NSUInteger)index ofRequests:(NSUInteger)total
+{
+	NSNumber *number = [NSNumber numberWithUnsignedInteger:index];
+	MKFacebookRequestPriority priority = [[requests objectAtIndex:index - 1] priority];
+	[startedNumbers addObject:number];
+	[startPriorities setObject:[NSNumber numberWithInt:priority] forKey:number];
+
+	inFlight++;
+	if (priority == MKFacebookRequestPriorityInteractive) {
+		interactiveInFlight++;
+	}
+	if (priority == MKFacebookRequestPriorityBackground) {
+		backgroundInFlight++;
+	}
+	maxInFlight = MAX(maxInFlight, inFlight);
+	maxOthersInFlight = MAX(maxOthersInFlight, inFlight - interactiveInFlight);
+	maxBackgroundInFlight = MAX(maxBackgroundInFlight, backgroundInFlight);
+}
+
+- (void)finished:(MKFacebookRequest *)request queue:(MKFacebookRequestQueue *)queue
+{
+	NSNumber *number = [NSNumber numberWithUnsignedInteger:[queue indexOfRequest:request]];
+	MKFacebookRequestPriority priority = [[startPriorities objectForKey:number] intValue];
+	finishedCount++;
+	inFlight--;
+	if (priority == MKFacebookRequestPriorityInteractive) {
+		interactiveInFlight--;
+	}
+	if (priority == MKFacebookRequestPriorityBackground) {
+		backgroundInFlight--;
+	}
+}
+
+- (void)requestQueue:(MKFacebookRequestQueue *)queue lastRequest:(MKFacebookRequest *)request responseReceived:(id)response
+{
+	[self finished:request queue:queue];
+}
+
+- (void)requestQueue:(MKFacebookRequestQueue *)queue lastRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)errorResponse
+{
+	[self finished:request queue:queue];
+}
+
+- (void)requestQueue:(MKFacebookRequestQueue *)queue lastRequest:(MKFacebookRequest *)request failed:(NSError *)error
+{
+	[self finished:request queue:queue];
+}
+
+- (void)requestQueueDidFinish:(MKFacebookRequestQueue *)queue
+{
+	didFinishCount++;
+}
+
+@end
+
+
+static MKFacebookRequest *MKTestAddRequest(MKFacebookRequestQueue *queue, MKTestQueueDelegate *delegate, MKFacebookRequestPriority priority)
+{
+	MKFacebookRequest *request = [[[MKFacebookRequest alloc] init] autorelease];
+	request.method = @"test.queue";
+	request.responseFormat = MKFacebookRequestResponseFormatJSON;
+	request.numberOfRequestAttempts = 1;
+	request.coalescesRequests = NO;
+	request.displayAPIErrorAlerts = NO;
+	request.priority = priority;
+	[delegate->requests addObject:request];
+	[queue addRequest:request];
+	return request;
+}
+
+
+static MKFacebookRequestQueue *MKTestQueue(MKTestQueueDelegate *delegate, NSUInteger maxConcurrent, NSUInteger reserved, NSUInteger maxBackground)
+{
+	[delegate reset];
+	MKFacebookRequestQueue *queue = [[[MKFacebookRequestQueue alloc] init] autorelease];
+	[queue setDelegate:delegate];
+	[queue setMaxConcurrentRequests:maxConcurrent];
+	[queue setReservedInteractiveRequests:reserved];
+	[queue setMaxConcurrentBackgroundRequests:maxBackground];
+	return queue;
+}
+
+
+static void MKTestRunUntilFinished(MKTestQueueDelegate *delegate)
+{
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKTestTimeout];
+	while (delegate->didFinishCount == 0 && [timeout timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+	}
+	MKTestCheck(delegate->didFinishCount == 1, @"requestQueueDidFinish: was sent %lu times", (unsigned long)delegate->didFinishCount);
+}
+
+
+//request numbers, ended by 0
+static NSArray *MKTestNumbers(int first, ...)
+{
+	NSMutableArray *numbers = [NSMutableArray arrayWithObject:[NSNumber numberWithUnsignedInteger:first]];
+	va_list arguments;
+	va_start(arguments, first);
+	int number;
+	while ((number = va_arg(arguments, int)) != 0) {
+		[numbers addObject:[NSNumber numberWithUnsignedInteger:number]];
+	}
+	va_end(arguments);
+	return numbers;
+}
+
+
+//one at a time: by priority, then in the order added. a pending request that changes priority keeps its number
+static void MKTestStartOrder(MKTestQueueDelegate *delegate)
+{
+	MKFacebookRequestQueue *queue = MKTestQueue(delegate, 1, 0, NSUIntegerMax);
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityBackground);		//1
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityNormal);			//2
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityInteractive);	//3
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityNormal);			//4
+	MKFacebookRequest *moved = MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityBackground);	//5
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityInteractive);	//6
+	MKFacebookRequest *removed = MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityNormal);		//7
+
+	MKTestCheck([queue indexOfRequest:moved] == 5, @"the fifth request has number %lu", (unsigned long)[queue indexOfRequest:moved]);
+	[queue setPriority:MKFacebookRequestPriorityInteractive forRequest:moved];
+	[queue removeRequest:removed];
+	MKTestCheck([queue indexOfRequest:removed] == NSNotFound, @"a removed request still has number %lu", (unsigned long)[queue indexOfRequest:removed]);
+
+	[queue startRequestQueue];
+	MKTestRunUntilFinished(delegate);
+
+	NSArray *expected = MKTestNumbers(3, 5, 6, 2, 4, 1, 0);
+	MKTestCheck([delegate->startedNumbers isEqualToArray:expected], @"requests started in the order %@, expected %@", delegate->startedNumbers, expected);
+	MKTestCheck(delegate->maxInFlight == 1, @"%lu requests were in flight with maxConcurrentRequests 1 and no reserved slots", (unsigned long)delegate->maxInFlight);
+	MKTestCheck(delegate->finishedCount == 6, @"%lu of 6 requests finished", (unsigned long)delegate->finishedCount);
+}
+
+
+//interactive requests added to a full running queue take the reserved slots, then wait ahead of the others
+static void MKTestReservedSlots(MKTestQueueDelegate *delegate)
+{
+	MKFacebookRequestQueue *queue = MKTestQueue(delegate, 2, 1, NSUIntegerMax);
+	for (NSUInteger i = 0; i < 4; i++) {
+		MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityNormal);
+	}
+	[queue startRequestQueue];
+	MKTestCheck([delegate->startedNumbers count] == 2, @"%lu requests started with maxConcurrentRequests 2", (unsigned long)[delegate->startedNumbers count]);
+
+	for (NSUInteger i = 0; i < 3; i++) {
+		MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityInteractive);
+	}
+	MKTestCheck([delegate->startedNumbers count] == 3 && [[delegate->startedNumbers lastObject] unsignedIntegerValue] == 5, @"after adding three interactive requests to a full queue %@ had started, expected 1, 2 and 5", delegate->startedNumbers);
+	MKTestRunUntilFinished(delegate);
+
+	NSArray *expected = MKTestNumbers(1, 2, 5, 6, 7, 3, 4, 0);
+	MKTestCheck([delegate->startedNumbers isEqualToArray:expected], @"requests started in the order %@, expected %@", delegate->startedNumbers, expected);
+	MKTestCheck(delegate->maxInFlight == 3, @"%lu requests were in flight, maxConcurrentRequests 2 and 1 reserved slot allow 3", (unsigned long)delegate->maxInFlight);
+	MKTestCheck(delegate->maxOthersInFlight <= 2, @"%lu normal requests were in flight with maxConcurrentRequests 2", (unsigned long)delegate->maxOthersInFlight);
+	MKTestCheck(delegate->finishedCount == 7, @"%lu of 7 requests finished", (unsigned long)delegate->finishedCount);
+}
+
+
+static void MKTestBackgroundLimit(MKTestQueueDelegate *delegate)
+{
+	MKFacebookRequestQueue *queue = MKTestQueue(delegate, 3, 0, 1);
+	for (NSUInteger i = 0; i < 4; i++) {
+		MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityBackground);
+	}
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityNormal);
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityNormal);
+	[queue startRequestQueue];
+	MKTestCheck([delegate->startedNumbers count] == 3, @"%lu requests started, expected both normal ones and one background request", (unsigned long)[delegate->startedNumbers count]);
+	MKTestRunUntilFinished(delegate);
+
+	MKTestCheck(delegate->maxBackgroundInFlight == 1, @"%lu background requests were in flight with maxConcurrentBackgroundRequests 1", (unsigned long)delegate->maxBackgroundInFlight);
+	MKTestCheck(delegate->maxInFlight <= 3, @"%lu requests were in flight with maxConcurrentRequests 3", (unsigned long)delegate->maxInFlight);
+	MKTestCheck(delegate->finishedCount == 6, @"%lu of 6 requests finished", (unsigned long)delegate->finishedCount);
+}
+
+
+//raising a loading background request frees its background slot at once
+static void MKTestPriorityOfLoadingRequest(MKTestQueueDelegate *delegate)
+{
+	MKFacebookRequestQueue *queue = MKTestQueue(delegate, 2, 0, 1);
+	MKFacebookRequest *first = MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityBackground);
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityBackground);
+	[queue startRequestQueue];
+	MKTestCheck([delegate->startedNumbers count] == 1, @"%lu background requests started with maxConcurrentBackgroundRequests 1", (unsigned long)[delegate->startedNumbers count]);
+
+	[queue setPriority:MKFacebookRequestPriorityNormal forRequest:first];
+	MKTestCheck([delegate->startedNumbers count] == 2 && delegate->finishedCount == 0, @"raising the loading background request started %lu requests with %lu finished, expected the second to start right away", (unsigned long)[delegate->startedNumbers count], (unsigned long)delegate->finishedCount);
+	MKTestRunUntilFinished(delegate);
+	MKTestCheck(delegate->finishedCount == 2, @"%lu of 2 requests finished", (unsigned long)delegate->finishedCount);
+}
+
+
+//with a pause between requests, interactive requests still start right away
+static void MKTestPauseBetweenRequests(MKTestQueueDelegate *delegate)
+{
+	MKFacebookRequestQueue *queue = MKTestQueue(delegate, 1, 1, NSUIntegerMax);
+	[queue setShouldPauseBetweenRequests:YES];
+	[queue setTimeBetweenRequests:1.0];
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityNormal);
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityNormal);
+	[queue startRequestQueue];
+
+	//wait for the first response, the second request is then waiting for its pause
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKTestTimeout];
+	while (delegate->finishedCount == 0 && [timeout timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+	}
+	MKTestCheck([delegate->startedNumbers count] == 1, @"%lu requests started before the pause was over", (unsigned long)[delegate->startedNumbers count]);
+
+	MKTestAddRequest(queue, delegate, MKFacebookRequestPriorityInteractive);
+	MKTestCheck([delegate->startedNumbers count] == 2 && [[delegate->startedNumbers lastObject] unsignedIntegerValue] == 3, @"an interactive request added during the pause didn't start right away, started %@", delegate->startedNumbers);
+	MKTestRunUntilFinished(delegate);
+	MKTestCheck(delegate->finishedCount == 3, @"%lu of 3 requests finished", (unsigned long)delegate->finishedCount);
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	MKLoopbackTransport *transport = [MKLoopbackTransport transport];
+	transport.latency = MKTestLatency;
+	[transport addResponse:@"[]" forMethod:@"test.queue"];
+	[MKFacebookRequest setDefaultTransport:transport];
+	[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] setEnabled:NO];
+	MKTestQueueDelegate *delegate = [[[MKTestQueueDelegate alloc] init] autorelease];
+
+	MKTestStartOrder(delegate);
+	MKTestReservedSlots(delegate);
+	MKTestBackgroundLimit(delegate);
+	MKTestPriorityOfLoadingRequest(delegate);
+	MKTestPauseBetweenRequests(delegate);
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed");
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
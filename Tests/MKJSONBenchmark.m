@@ -0,0 +1,102 @@
+//
+//  MKJSONBenchmark.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Times SBJsonParser on sample responses, photos.get and users.getInfo as the REST API returns them.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKJSONBenchmark.m Tests/SBJsonRecursiveParser.m -o build/MKJSONBenchmark
+ DYLD_FRAMEWORK_PATH=build/Release build/MKJSONBenchmark Tests/Samples 200
+
+ The arguments are the folder with the samples and the number of parses per run. Every sample is
+ parsed once to warm up, then in 5 runs, the fastest run is reported. Parsing goes through
+ objectWithString:, the one entry point every version of the parser has, so the same binary can
+ compare two builds of the framework: build each into its own folder and point DYLD_FRAMEWORK_PATH
+ at one, then the other.
+
+ The first column is the recursive scanner SBJsonParser was before 0.9, built into the tool from
+ Tests/SBJsonRecursiveParser.m, as the baseline for the framework's parser in the same run.
+
+ Exits with 1 if a sample doesn't parse.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+#import "SBJsonRecursiveParser.h"
+#include <mach/mach_time.h>
+
+static const NSUInteger MKBenchmarkRuns = 5;
+
+
+static double MKBenchmarkSeconds(uint64_t elapsed)
+{
+	static mach_timebase_info_data_t timebase;
+	if (timebase.denom == 0) {
+		mach_timebase_info(&timebase);
+	}
+	return (double)elapsed * timebase.numer / timebase.denom / 1e9;
+}
+
+
+//seconds per parse, of the fastest run. a new parser for every document, or one parser for all of them
+static double MKBenchmarkParse(Class parserClass, NSString *json, NSUInteger iterations, BOOL reuseParser)
+{
+	double best = 0;
+	for (NSUInteger run = 0; run < MKBenchmarkRuns; run++) {
+		id sharedParser = [[parserClass alloc] init];
+		uint64_t start = mach_absolute_time();
+		for (NSUInteger i = 0; i < iterations; i++) {
+			NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+			id parser = reuseParser ? sharedParser : [[[parserClass alloc] init] autorelease];
+			[parser objectWithString:json];
+			[pool drain];
+		}
+		double seconds = MKBenchmarkSeconds(mach_absolute_time() - start) / iterations;
+		[sharedParser release];
+		if (run == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+	return best;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	NSString *directory = argc > 1 ? [NSString stringWithUTF8String:argv[1]] : @"Tests/Samples";
+	NSUInteger iterations = argc > 2 ? (NSUInteger)MAX(atoi(argv[2]), 1) : 200;
+	int result = 0;
+
+	NSArray *samples = [NSArray arrayWithObjects:@"photos.get.json", @"users.getInfo.json", nil];
+	for (NSString *sample in samples) {
+		NSData *data = [NSData dataWithContentsOfFile:[directory stringByAppendingPathComponent:sample]];
+		NSString *json = data != nil ? [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease] : nil;
+		SBJsonParser *parser = [[[SBJsonParser alloc] init] autorelease];
+		id parsed = [parser objectWithString:json];
+		if (parsed == nil) {
+			NSLog(@"FAILED: %@ can't be parsed: %@", sample, [parser errorTrace]);
+			result = 1;
+			continue;
+		}
+
+		double megabytes = [data length] / (1024.0 * 1024.0);
+		double recursiveParser = MKBenchmarkParse([SBJsonRecursiveParser class], json, iterations, NO);
+		double newParser = MKBenchmarkParse([SBJsonParser class], json, iterations, NO);
+		double reusedParser = MKBenchmarkParse([SBJsonParser class], json, iterations, YES);
+		printf("%-20s %7lu bytes %5lu objects\n", [sample UTF8String], (unsigned long)[data length], (unsigned long)[parsed count]);
+		printf("   recursive scanner %9.1f us %7.1f MB/s\n", recursiveParser * 1e6, megabytes / recursiveParser);
+		printf("   new parser        %9.1f us %7.1f MB/s   %.1fx\n", newParser * 1e6, megabytes / newParser, recursiveParser / newParser);
+		printf("   reused parser     %9.1f us %7.1f MB/s   %.1fx\n", reusedParser * 1e6, megabytes / reusedParser, recursiveParser / reusedParser);
+	}
+
+	[pool drain];
+	return result;
+}
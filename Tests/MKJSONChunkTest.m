@@ -0,0 +1,185 @@
+//
+//  MKJSONChunkTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Checks that a document passed to -parseBytes:length: in pieces gives the same result as passed
+ to objectWithData: in one go, wherever it is split: in strings, escapes, surrogate pairs,
+ multi-byte UTF-8 characters, numbers and literals.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKJSONChunkTest.m -o build/MKJSONChunkTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKJSONChunkTest Tests/Samples [seed]
+
+ Every document in MKJSONTestSupport.h is split in two at every byte, and parsed a byte at a time.
+ The samples in the folder are parsed a byte at a time and in chunks of random sizes, from the seed
+ given or from the time. The seed is printed so a failure can be repeated.
+
+ For an invalid document, parsing a byte at a time tells after which byte -parseBytes:length: first
+ returns NO. However the document is split, it has to return NO for the chunk holding that byte
+ and not before, and -finishParsing has to fail with the error trace of objectWithData:.
+
+ Exits with 0 if every check passed.
+ */
+
+#import "MKJSONTestSupport.h"
+
+static const NSUInteger MKTestRandomSplits = 20;
+static const NSUInteger MKTestMaximumChunkLength = 4096;
+
+
+//parses the chunks, and sets failedAt to the end of the first chunk -parseBytes:length: returned NO for, or NSNotFound
+static id MKTestParseChunks(SBJsonParser *parser, NSData *data, NSArray *lengths, NSUInteger *failedAt)
+{
+	const char *bytes = [data bytes];
+	NSUInteger offset = 0;
+	*failedAt = NSNotFound;
+	for (NSNumber *length in lengths) {
+		BOOL valid = [parser parseBytes:bytes + offset length:[length unsignedIntegerValue]];
+		offset += [length unsignedIntegerValue];
+		if (valid == NO && *failedAt == NSNotFound) {
+			*failedAt = offset;
+		}
+	}
+	NSCAssert(offset == [data length], @"The chunks don't add up to the document");
+	return [parser finishParsing];
+}
+
+
+//where the chunks should fail: at the end of the chunk holding byte failurePoint - 1
+static NSUInteger MKTestExpectedFailure(NSArray *lengths, NSUInteger failurePoint)
+{
+	if (failurePoint == NSNotFound) {
+		return NSNotFound;
+	}
+	NSUInteger offset = 0;
+	for (NSNumber *length in lengths) {
+		offset += [length unsignedIntegerValue];
+		if (offset >= failurePoint) {
+			return offset;
+		}
+	}
+	return NSNotFound;
+}
+
+
+static void MKTestChunks(SBJsonParser *parser, NSData *data, NSArray *lengths, id expected, NSArray *expectedTrace, NSUInteger failurePoint, NSString *how)
+{
+	NSUInteger failedAt;
+	id o = MKTestParseChunks(parser, data, lengths, &failedAt);
+	NSString *description = MKJSONTestDescription(data);
+	MKTestCheck(MKJSONObjectsEqual(o, expected, YES), @"%@ %@ returned %@, in one go %@", description, how, o, expected);
+	MKTestCheck(MKJSONTracesEqual([parser errorTrace], expectedTrace), @"%@ %@ failed with %@, in one go with %@", description, how, MKJSONTraceDescription([parser errorTrace]), MKJSONTraceDescription(expectedTrace));
+	NSUInteger expectedFailure = MKTestExpectedFailure(lengths, failurePoint);
+	MKTestCheck(failedAt == expectedFailure, @"%@ %@ stopped after byte %ld, should have after byte %ld", description, how, (long)(failedAt == NSNotFound ? -1 : (long)failedAt), (long)(expectedFailure == NSNotFound ? -1 : (long)expectedFailure));
+}
+
+
+static NSArray *MKTestLengths(NSUInteger first, NSUInteger second)
+{
+	return [NSArray arrayWithObjects:[NSNumber numberWithUnsignedInteger:first], [NSNumber numberWithUnsignedInteger:second], nil];
+}
+
+
+//a byte at a time, empty chunks now and then
+static NSArray *MKTestByteLengths(NSUInteger length)
+{
+	NSMutableArray *lengths = [NSMutableArray arrayWithCapacity:length];
+	for (NSUInteger i = 0; i < length; i++) {
+		if (i % 7 == 3) {
+			[lengths addObject:[NSNumber numberWithUnsignedInteger:0]];
+		}
+		[lengths addObject:[NSNumber numberWithUnsignedInteger:1]];
+	}
+	return lengths;
+}
+
+
+static NSArray *MKTestRandomLengths(NSUInteger length, NSUInteger maximum)
+{
+	NSMutableArray *lengths = [NSMutableArray array];
+	while (length > 0) {
+		NSUInteger chunk = MIN(length, (NSUInteger)random() % (maximum + 1));
+		[lengths addObject:[NSNumber numberWithUnsignedInteger:chunk]];
+		length -= chunk;
+	}
+	return lengths;
+}
+
+
+static void MKTestDocument(SBJsonParser *parser, NSData *data, BOOL everySplit)
+{
+	id expected = [parser objectWithData:data];
+	NSArray *expectedTrace = [[[parser errorTrace] copy] autorelease];
+
+	//a byte at a time finds the failure point the other splits are checked against
+	NSUInteger failurePoint;
+	NSArray *byteLengths = MKTestByteLengths([data length]);
+	MKTestParseChunks(parser, data, byteLengths, &failurePoint);
+	MKTestCheck(expected != nil || [expectedTrace count] > 0, @"%@ failed without an error trace", MKJSONTestDescription(data));
+	MKTestCheck(expected == nil || failurePoint == NSNotFound, @"%@ parses in one go, but not a byte at a time", MKJSONTestDescription(data));
+	MKTestChunks(parser, data, byteLengths, expected, expectedTrace, failurePoint, @"a byte at a time");
+
+	if (everySplit) {
+		for (NSUInteger split = 0; split <= [data length]; split++) {
+			NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+			MKTestChunks(parser, data, MKTestLengths(split, [data length] - split), expected, expectedTrace, failurePoint, [NSString stringWithFormat:@"split at %lu", (unsigned long)split]);
+			[pool drain];
+		}
+	} else {
+		for (NSUInteger i = 0; i < MKTestRandomSplits; i++) {
+			NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+			NSUInteger maximum = 1 + (NSUInteger)random() % MKTestMaximumChunkLength;
+			MKTestChunks(parser, data, MKTestRandomLengths([data length], maximum), expected, expectedTrace, failurePoint, [NSString stringWithFormat:@"in chunks of up to %lu bytes", (unsigned long)maximum]);
+			[pool drain];
+		}
+	}
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	NSString *directory = argc > 1 ? [NSString stringWithUTF8String:argv[1]] : @"Tests/Samples";
+	unsigned long seed = argc > 2 ? strtoul(argv[2], NULL, 10) : (unsigned long)time(NULL);
+	srandom((unsigned)seed);
+	NSLog(@"random chunks from seed %lu", seed);
+
+	//one parser for everything, so documents that fail half way also show that it recovers for the next one
+	SBJsonParser *parser = [[[SBJsonParser alloc] init] autorelease];
+
+	NSMutableArray *corpus = [NSMutableArray arrayWithArray:MKJSONTestCorpus()];
+	[corpus addObjectsFromArray:MKJSONTestInvalidUTF8Corpus()];
+	for (NSData *data in corpus) {
+		NSAutoreleasePool *documentPool = [[NSAutoreleasePool alloc] init];
+		MKTestDocument(parser, data, YES);
+		[documentPool drain];
+	}
+
+	NSArray *samples = [NSArray arrayWithObjects:@"photos.get.json", @"users.getInfo.json", @"error_response.json", nil];
+	for (NSString *sample in samples) {
+		NSData *data = [NSData dataWithContentsOfFile:[directory stringByAppendingPathComponent:sample]];
+		MKTestCheck(data != nil, @"%@ is missing from %@", sample, directory);
+		MKTestCheck(data == nil || [parser objectWithData:data] != nil, @"%@ doesn't parse: %@", sample, MKJSONTraceDescription([parser errorTrace]));
+		if (data != nil) {
+			NSAutoreleasePool *documentPool = [[NSAutoreleasePool alloc] init];
+			MKTestDocument(parser, data, NO);
+			[documentPool drain];
+		}
+	}
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed, %lu documents and %lu samples", (unsigned long)[corpus count], (unsigned long)[samples count]);
+	} else {
+		NSLog(@"%d checks failed, seed %lu", MKTestFailures, seed);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+//
+//  MKJSONCompatibilityTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Checks that SBJsonParser returns what the recursive scanner it replaced in 0.9 returned, and
+ fails with the same error trace, for every document in MKJSONTestSupport.h: deep nesting on both
+ sides of maxDepth, surrogate pairs, numbers out of the range of 64 bit integers and doubles,
+ trailing garbage and the end of input in every state.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKJSONCompatibilityTest.m Tests/SBJsonRecursiveParser.m -o build/MKJSONCompatibilityTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKJSONCompatibilityTest
+
+ With decimalNumbers set results have to be equal, numbers included. With decimalNumbers off
+ integers have to have the same value, other numbers the nearest double, and numbers out of range
+ have to still be NSDecimalNumber. Error traces have to be the same either way.
+
+ Exits with 0 if every check passed.
+ */
+
+#import "MKJSONTestSupport.h"
+#import "SBJsonRecursiveParser.h"
+
+
+//parses through every entry point that takes a string, and through objectWithData: unless the data
+//holds a NUL, where the string entry points stop
+static void MKTestCompare(NSData *data, SBJsonRecursiveParser *oldParser, SBJsonParser *parser)
+{
+	NSString *description = MKJSONTestDescription(data);
+	NSString *json = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+	MKTestCheck(json != nil, @"%@ is not UTF-8", description);
+	if (json == nil) {
+		return;
+	}
+	BOOL exactNumbers = parser.decimalNumbers;
+	NSString *mode = exactNumbers ? @"decimal numbers" : @"native numbers";
+
+	id expected = [oldParser objectWithString:json];
+	NSArray *expectedTrace = [[[oldParser errorTrace] copy] autorelease];
+
+	id o = [parser objectWithString:json];
+	MKTestCheck(MKJSONObjectsEqual(o, expected, exactNumbers), @"%@, %@: objectWithString: returned %@, the recursive scanner %@", description, mode, o, expected);
+	MKTestCheck(MKJSONTracesEqual([parser errorTrace], expectedTrace), @"%@, %@: objectWithString: failed with %@, the recursive scanner with %@", description, mode, MKJSONTraceDescription([parser errorTrace]), MKJSONTraceDescription(expectedTrace));
+
+	if (memchr([data bytes], 0, [data length]) == NULL) {
+		o = [parser objectWithData:data];
+		MKTestCheck(MKJSONObjectsEqual(o, expected, exactNumbers), @"%@, %@: objectWithData: returned %@, the recursive scanner %@", description, mode, o, expected);
+		MKTestCheck(MKJSONTracesEqual([parser errorTrace], expectedTrace), @"%@, %@: objectWithData: failed with %@, the recursive scanner with %@", description, mode, MKJSONTraceDescription([parser errorTrace]), MKJSONTraceDescription(expectedTrace));
+	}
+
+	expected = [oldParser fragmentWithString:json];
+	expectedTrace = [[[oldParser errorTrace] copy] autorelease];
+	o = [parser fragmentWithString:json];
+	MKTestCheck(MKJSONObjectsEqual(o, expected, exactNumbers), @"%@, %@: fragmentWithString: returned %@, the recursive scanner %@", description, mode, o, expected);
+	MKTestCheck(MKJSONTracesEqual([parser errorTrace], expectedTrace), @"%@, %@: fragmentWithString: failed with %@, the recursive scanner with %@", description, mode, MKJSONTraceDescription([parser errorTrace]), MKJSONTraceDescription(expectedTrace));
+}
+
+
+//what each number in MKJSONTestNumbers becomes with decimalNumbers off
+static void MKTestNumberTypes(SBJsonParser *parser)
+{
+	parser.decimalNumbers = NO;
+	for (NSUInteger i = 0; i < sizeof(MKJSONTestNumbers) / sizeof(MKJSONTestNumbers[0]); i++) {
+		const char *text = MKJSONTestNumbers[i].text;
+		NSNumber *n = [[parser objectWithString:[NSString stringWithFormat:@"[%s]", text]] lastObject];
+		MKTestCheck(n != nil, @"%s doesn't parse: %@", text, MKJSONTraceDescription([parser errorTrace]));
+		if (n == nil) {
+			continue;
+		}
+
+		BOOL isDecimal = [n isKindOfClass:[NSDecimalNumber class]];
+		char type = *[n objCType];
+		switch (MKJSONTestNumbers[i].type) {
+			case 'i':
+				MKTestCheck(isDecimal == NO && (type == 'q' || type == 'Q'), @"%s should be a 64 bit integer, is a %@ of type %s", text, [n class], [n objCType]);
+				MKTestCheck([[NSDecimalNumber decimalNumberWithString:[n stringValue]] compare:[NSDecimalNumber decimalNumberWithString:[NSString stringWithUTF8String:text]]] == NSOrderedSame, @"%s became %@", text, n);
+				break;
+			case 'd':
+				MKTestCheck(isDecimal == NO && type == 'd', @"%s should be a double, is a %@ of type %s", text, [n class], [n objCType]);
+				MKTestCheck([n doubleValue] == strtod(text, NULL), @"%s became %.17g", text, [n doubleValue]);
+				break;
+			default:
+				MKTestCheck(isDecimal, @"%s is out of range and should be an NSDecimalNumber, is a %@ of value %@", text, [n class], n);
+				break;
+		}
+	}
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	SBJsonRecursiveParser *oldParser = [[[SBJsonRecursiveParser alloc] init] autorelease];
+	SBJsonParser *parser = [[[SBJsonParser alloc] init] autorelease];
+	NSArray *corpus = MKJSONTestCorpus();
+
+	for (NSUInteger mode = 0; mode < 2; mode++) {
+		parser.decimalNumbers = mode == 0;
+		for (NSData *data in corpus) {
+			NSAutoreleasePool *documentPool = [[NSAutoreleasePool alloc] init];
+			MKTestCompare(data, oldParser, parser);
+			[documentPool drain];
+		}
+	}
+
+	MKTestNumberTypes(parser);
+
+	//the recursive scanner could hang on these, SBJsonParser has to reject them
+	for (NSData *data in MKJSONTestInvalidUTF8Corpus()) {
+		id o = [parser objectWithData:data];
+		NSError *error = [[parser errorTrace] objectAtIndex:0];
+		MKTestCheck(o == nil && [error code] == EUNICODE, @"%@ is not UTF-8 but returned %@ with %@", MKJSONTestDescription(data), o, MKJSONTraceDescription([parser errorTrace]));
+	}
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed, %lu documents", (unsigned long)[corpus count]);
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
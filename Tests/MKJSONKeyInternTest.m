@@ -0,0 +1,299 @@
+//
+//  MKJSONKeyInternTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Checks that SBJsonParser hands out the same string for an object key it has seen before, within a
+ document, across documents and across parsers reused through MKFacebookParsePool, and that keys
+ it doesn't keep still come out right.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKJSONKeyInternTest.m -o build/MKJSONKeyInternTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKJSONKeyInternTest
+
+ Keys are compared by pointer. The documents they came from are kept until the comparison is done,
+ so a freed key can't be mistaken for the same one at the same address. The keys are long enough
+ not to be tagged pointers, which would compare equal without being shared.
+
+ Exits with 0 if every check passed.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+
+static const NSTimeInterval MKTestTimeout = 10;
+static const NSUInteger MKTestIdleParserLimit = 16;     //MKParsePoolMaximumIdleParsers
+static const NSUInteger MKTestManyKeysCount = 400;      //more than the 384 a table keeps
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: %@", [NSString stringWithFormat:__VA_ARGS__]); \
+	} \
+} while (0)
+
+
+@interface MKTestDelegate : NSObject {
+@public
+	NSMutableArray *responses;
+	NSUInteger errorCount;
+}
+@end
+
+@implementation MKTestDelegate
+
+- (id)init
+{
+	if (self = [super init]) {
+		responses = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[responses release];
+	[super dealloc];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request responseReceived:(id)response
+{
+	[responses addObject:response];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error
+{
+	errorCount++;
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request failed:(NSError *)error
+{
+	errorCount++;
+}
+
+@end
+
+
+//the key object the dictionary holds for name
+static NSString *MKTestKey(NSDictionary *dictionary, NSString *name)
+{
+	for (NSString *key in dictionary) {
+		if ([key isEqualToString:name]) {
+			return key;
+		}
+	}
+	return nil;
+}
+
+
+static NSDictionary *MKTestParse(SBJsonParser *parser, NSString *json)
+{
+	NSDictionary *dictionary = [parser objectWithString:json];
+	MKTestCheck([dictionary isKindOfClass:[NSDictionary class]], @"%@ doesn't parse to a dictionary", json);
+	return dictionary;
+}
+
+
+static void MKTestSameParser(void)
+{
+	SBJsonParser *parser = [[[SBJsonParser alloc] init] autorelease];
+
+	NSArray *photos = [parser objectWithString:@"[{\"photo_tag_count\":1},{\"photo_tag_count\":2}]"];
+	MKTestCheck([photos count] == 2, @"the photos didn't parse");
+	NSString *first = MKTestKey([photos objectAtIndex:0], @"photo_tag_count");
+	MKTestCheck(first != nil && first == MKTestKey([photos objectAtIndex:1], @"photo_tag_count"), @"a key repeated in one document is a different string");
+
+	NSDictionary *next = MKTestParse(parser, @"{\"photo_tag_count\":3}");
+	MKTestCheck(first == MKTestKey(next, @"photo_tag_count"), @"a key repeated in the next document is a different string");
+
+	//the stream API and a document dropped half way share the same table
+	MKTestCheck([parser parseBytes:"{\"photo_tag_count\":4,\"unfin" length:27], @"the first half of a document doesn't parse");
+	[parser resetStream];
+	MKTestCheck([parser parseBytes:"{\"photo_tag_count\":5}" length:21], @"a document after a dropped one doesn't parse");
+	NSDictionary *streamed = [parser finishParsing];
+	MKTestCheck([[streamed objectForKey:@"photo_tag_count"] intValue] == 5 && [streamed count] == 1, @"a document after a dropped one became %@", streamed);
+	MKTestCheck(first == MKTestKey(streamed, @"photo_tag_count"), @"a key parsed from chunks is a different string");
+
+	//an escaped key is kept by what it decodes to
+	NSDictionary *escaped = MKTestParse(parser, @"{\"photo_tag_\\u0063ount\":6}");
+	MKTestCheck(first == MKTestKey(escaped, @"photo_tag_count"), @"an escaped key became %@", [escaped allKeys]);
+
+	//keys longer than 32 bytes aren't kept, but still come out right
+	NSString *longKey = @"a_key_that_is_longer_than_32_bytes";
+	NSString *longJSON = [NSString stringWithFormat:@"{\"%@\":1}", longKey];
+	NSDictionary *long1 = MKTestParse(parser, longJSON);
+	NSDictionary *long2 = MKTestParse(parser, longJSON);
+	MKTestCheck(MKTestKey(long1, longKey) != nil && MKTestKey(long2, longKey) != nil, @"a long key became %@", [long1 allKeys]);
+	MKTestCheck(MKTestKey(long1, longKey) != MKTestKey(long2, longKey), @"a key longer than 32 bytes was kept");
+
+	NSString *longestKey = @"a_key_that_is_exactly_32_bytes__";
+	NSString *longestJSON = [NSString stringWithFormat:@"{\"%@\":1}", longestKey];
+	NSDictionary *longest1 = MKTestParse(parser, longestJSON);
+	NSDictionary *longest2 = MKTestParse(parser, longestJSON);
+	MKTestCheck(MKTestKey(longest1, longestKey) != nil && MKTestKey(longest1, longestKey) == MKTestKey(longest2, longestKey), @"a key of 32 bytes wasn't kept");
+
+	//multi-byte UTF-8 keys are kept by their bytes
+	NSString *unicodeKey = [NSString stringWithUTF8String:"caf\xc3\xa9"];
+	NSString *unicodeJSON = [NSString stringWithFormat:@"{\"%@\":1}", unicodeKey];
+	NSDictionary *unicode1 = MKTestParse(parser, unicodeJSON);
+	NSDictionary *unicode2 = MKTestParse(parser, unicodeJSON);
+	MKTestCheck(MKTestKey(unicode1, unicodeKey) != nil && MKTestKey(unicode1, unicodeKey) == MKTestKey(unicode2, unicodeKey), @"a non-ASCII key wasn't kept");
+
+	//values aren't shared
+	NSArray *values = [parser objectWithString:@"[\"pid\",\"pid\"]"];
+	MKTestCheck([values count] == 2 && [values objectAtIndex:0] != [values objectAtIndex:1], @"two equal values are the same string");
+}
+
+
+//the known Facebook field names are in every new table
+static void MKTestKnownKeys(void)
+{
+	SBJsonParser *parser1 = [[[SBJsonParser alloc] init] autorelease];
+	SBJsonParser *parser2 = [[[SBJsonParser alloc] init] autorelease];
+	NSDictionary *photo1 = MKTestParse(parser1, @"{\"pid\":1,\"caption\":\"a\",\"src_big\":\"b\"}");
+	NSDictionary *photo2 = MKTestParse(parser2, @"{\"pid\":2,\"caption\":\"c\",\"src_big\":\"d\"}");
+	for (NSString *name in [NSArray arrayWithObjects:@"pid", @"caption", @"src_big", nil]) {
+		MKTestCheck(MKTestKey(photo1, name) != nil && MKTestKey(photo1, name) == MKTestKey(photo2, name), @"the known key %@ differs between two new parsers", name);
+	}
+
+	NSDictionary *custom1 = MKTestParse(parser1, @"{\"photo_tag_count\":1}");
+	NSDictionary *custom2 = MKTestParse(parser2, @"{\"photo_tag_count\":1}");
+	MKTestCheck(MKTestKey(custom1, @"photo_tag_count") != MKTestKey(custom2, @"photo_tag_count"), @"two parsers share a key that isn't a known one");
+}
+
+
+//a document with more one-off keys than the table keeps clears it back to the known keys
+static void MKTestTableReset(void)
+{
+	SBJsonParser *parser = [[[SBJsonParser alloc] init] autorelease];
+	NSMutableArray *members = [NSMutableArray arrayWithCapacity:MKTestManyKeysCount];
+	for (NSUInteger i = 0; i < MKTestManyKeysCount; i++) {
+		[members addObject:[NSString stringWithFormat:@"\"one_off_key_%lu\":%lu", (unsigned long)i, (unsigned long)i]];
+	}
+	NSString *json = [NSString stringWithFormat:@"{%@,\"pid\":1}", [members componentsJoinedByString:@","]];
+
+	NSDictionary *many1 = MKTestParse(parser, json);
+	MKTestCheck([many1 count] == MKTestManyKeysCount + 1, @"a document with %lu keys has %lu", (unsigned long)MKTestManyKeysCount + 1, (unsigned long)[many1 count]);
+	BOOL valuesMatch = YES;
+	for (NSUInteger i = 0; i < MKTestManyKeysCount; i++) {
+		valuesMatch &= [[many1 objectForKey:[NSString stringWithFormat:@"one_off_key_%lu", (unsigned long)i]] unsignedIntegerValue] == i;
+	}
+	MKTestCheck(valuesMatch, @"a key was mixed up when the table was cleared");
+
+	NSDictionary *many2 = MKTestParse(parser, json);
+	NSString *lastName = [NSString stringWithFormat:@"one_off_key_%lu", (unsigned long)MKTestManyKeysCount - 1];
+	MKTestCheck(MKTestKey(many1, @"one_off_key_0") != MKTestKey(many2, @"one_off_key_0"), @"one_off_key_0 was still kept after the table was full");
+	MKTestCheck(MKTestKey(many1, lastName) == MKTestKey(many2, lastName), @"%@, added after the table was cleared, wasn't kept", lastName);
+
+	SBJsonParser *newParser = [[[SBJsonParser alloc] init] autorelease];
+	NSDictionary *photo = MKTestParse(newParser, @"{\"pid\":1}");
+	MKTestCheck(MKTestKey(many2, @"pid") == MKTestKey(photo, @"pid"), @"the known keys are gone after the table was cleared");
+}
+
+
+static void MKTestPoolParsers(void)
+{
+	MKFacebookParsePool *pool = [MKFacebookParsePool sharedMKFacebookParsePool];
+
+	SBJsonParser *parser = [pool checkOutParser];
+	MKTestCheck(parser != nil && [pool checkOutParser] != parser, @"two parsers checked out at once are the same");
+	NSDictionary *first = MKTestParse(parser, @"{\"photo_tag_count\":1}");
+
+	//a parser checked in in the middle of a document is reset
+	[parser parseBytes:"{\"photo_tag_count\":2,\"unfin" length:27];
+	[pool checkInParser:parser];
+	[pool checkInParser:parser];
+
+	SBJsonParser *again = [pool checkOutParser];
+	MKTestCheck(again == parser, @"the parser checked in last wasn't handed out again");
+	MKTestCheck([pool checkOutParser] != parser, @"a parser checked in twice was handed out twice");
+	MKTestCheck([again parseBytes:"{\"photo_tag_count\":3}" length:21], @"a checked in parser doesn't parse");
+	NSDictionary *next = [again finishParsing];
+	MKTestCheck([next count] == 1 && [[next objectForKey:@"photo_tag_count"] intValue] == 3, @"a checked in parser still had its old document, parsed %@", next);
+	MKTestCheck(MKTestKey(first, @"photo_tag_count") == MKTestKey(next, @"photo_tag_count"), @"a checked in parser lost its keys");
+
+	//only so many idle parsers are kept
+	NSMutableArray *parsers = [NSMutableArray array];
+	for (NSUInteger i = 0; i < MKTestIdleParserLimit + 4; i++) {
+		[parsers addObject:[pool checkOutParser]];
+	}
+	for (SBJsonParser *p in parsers) {
+		[pool checkInParser:p];
+	}
+	NSUInteger reused = 0;
+	for (NSUInteger i = 0; i < MKTestIdleParserLimit + 4; i++) {
+		if ([parsers indexOfObjectIdenticalTo:[pool checkOutParser]] != NSNotFound) {
+			reused++;
+		}
+	}
+	MKTestCheck(reused == MKTestIdleParserLimit, @"%lu idle parsers were kept, expected %lu", (unsigned long)reused, (unsigned long)MKTestIdleParserLimit);
+	for (SBJsonParser *p in parsers) {
+		[pool checkInParser:p];
+	}
+}
+
+
+//the same response twice, sent one after the other, comes back with the same keys
+static void MKTestRequests(NSUInteger concurrentParses)
+{
+	[MKFacebookParsePool sharedMKFacebookParsePool].maximumConcurrentParses = concurrentParses;
+
+	MKLoopbackTransport *transport = [MKLoopbackTransport transport];
+	[MKFacebookRequest setDefaultTransport:transport];
+	[transport addResponse:@"[{\"photo_tag_count\":1,\"pid\":\"1\"}]" forMethod:@"test.photos"];
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+
+	for (NSUInteger i = 0; i < 2; i++) {
+		MKFacebookRequest *request = [[[MKFacebookRequest alloc] initWithDelegate:delegate selector:nil] autorelease];
+		request.method = @"test.photos";
+		request.responseFormat = MKFacebookRequestResponseFormatJSON;
+		request.numberOfRequestAttempts = 1;
+		request.coalescesRequests = NO;
+		request.displayAPIErrorAlerts = NO;
+		[request sendRequest];
+
+		NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKTestTimeout];
+		while ([delegate->responses count] + delegate->errorCount < i + 1 && [timeout timeIntervalSinceNow] > 0) {
+			[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+		}
+		//the parser goes back to the pool once the response is parsed, which may be just after it is delivered
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+	}
+
+	MKTestCheck([delegate->responses count] == 2 && delegate->errorCount == 0, @"%lu parses at a time delivered %lu responses and %lu errors", (unsigned long)concurrentParses, (unsigned long)[delegate->responses count], (unsigned long)delegate->errorCount);
+	if ([delegate->responses count] == 2) {
+		NSDictionary *photo1 = [[delegate->responses objectAtIndex:0] lastObject];
+		NSDictionary *photo2 = [[delegate->responses objectAtIndex:1] lastObject];
+		MKTestCheck(MKTestKey(photo1, @"photo_tag_count") != nil && MKTestKey(photo1, @"photo_tag_count") == MKTestKey(photo2, @"photo_tag_count"), @"%lu parses at a time parsed the second response with a parser that hadn't seen the keys", (unsigned long)concurrentParses);
+	}
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] setEnabled:NO];
+
+	MKTestSameParser();
+	MKTestKnownKeys();
+	MKTestTableReset();
+	MKTestPoolParsers();
+	MKTestRequests(4);
+	MKTestRequests(0);
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed");
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
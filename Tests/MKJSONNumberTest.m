@@ -0,0 +1,190 @@
+//
+//  MKJSONNumberTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Checks the numbers SBJsonParser makes with decimalNumbers off: the exact value and type of
+ integers at the edges of 64 bits, correctly rounded doubles, NSDecimalNumber for everything out of
+ range, and the same results whatever the locale of the process. With decimalNumbers on, every
+ number has to be an NSDecimalNumber equal to the text.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKJSONNumberTest.m -o build/MKJSONNumberTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKJSONNumberTest
+
+ MKJSONCompatibilityTest compares the same numbers with the recursive scanner, this test checks
+ them against values worked out in C.
+
+ Exits with 0 if every check passed.
+ */
+
+#import "MKJSONTestSupport.h"
+#include <float.h>
+#include <locale.h>
+
+
+static NSNumber *MKTestParseNumber(SBJsonParser *parser, NSString *text)
+{
+	NSArray *array = [parser objectWithString:[NSString stringWithFormat:@"[%@]", text]];
+	MKTestCheck([array count] == 1, @"%@ doesn't parse: %@", text, MKJSONTraceDescription([parser errorTrace]));
+	return [array lastObject];
+}
+
+
+static void MKTestInteger(SBJsonParser *parser, NSString *text, long long expected)
+{
+	NSNumber *n = MKTestParseNumber(parser, text);
+	MKTestCheck(n != nil && [n isKindOfClass:[NSDecimalNumber class]] == NO && strcmp([n objCType], @encode(long long)) == 0, @"%@ should be a long long, is a %@ of type %s", text, [n class], [n objCType]);
+	MKTestCheck([n longLongValue] == expected, @"%@ became %lld", text, [n longLongValue]);
+}
+
+
+static void MKTestUnsignedInteger(SBJsonParser *parser, NSString *text, unsigned long long expected)
+{
+	NSNumber *n = MKTestParseNumber(parser, text);
+	MKTestCheck(n != nil && [n isKindOfClass:[NSDecimalNumber class]] == NO && strcmp([n objCType], @encode(unsigned long long)) == 0, @"%@ should be an unsigned long long, is a %@ of type %s", text, [n class], [n objCType]);
+	MKTestCheck([n unsignedLongLongValue] == expected, @"%@ became %llu", text, [n unsignedLongLongValue]);
+}
+
+
+//expected bit for bit, so -0.0 and 0.0 differ
+static void MKTestDouble(SBJsonParser *parser, NSString *text, double expected)
+{
+	NSNumber *n = MKTestParseNumber(parser, text);
+	double d = [n doubleValue];
+	MKTestCheck(n != nil && [n isKindOfClass:[NSDecimalNumber class]] == NO && strcmp([n objCType], @encode(double)) == 0, @"%@ should be a double, is a %@ of type %s", text, [n class], [n objCType]);
+	MKTestCheck(memcmp(&d, &expected, sizeof(double)) == 0, @"%@ became %.17g, expected %.17g", text, d, expected);
+}
+
+
+static void MKTestDecimal(SBJsonParser *parser, NSString *text)
+{
+	NSNumber *n = MKTestParseNumber(parser, text);
+	MKTestCheck([n isKindOfClass:[NSDecimalNumber class]], @"%@ is out of range and should be an NSDecimalNumber, is a %@ of value %@", text, [n class], n);
+	//1e309 and 1e-400 are past the exponents NSDecimal holds, both sides are then notANumber
+	NSDecimalNumber *expected = [NSDecimalNumber decimalNumberWithString:text locale:[NSDictionary dictionaryWithObject:@"." forKey:NSLocaleDecimalSeparator]];
+	if ([n isKindOfClass:[NSDecimalNumber class]] && [expected isEqual:[NSDecimalNumber notANumber]] == NO) {
+		MKTestCheck([(NSDecimalNumber *)n compare:expected] == NSOrderedSame, @"%@ became %@, expected %@", text, n, expected);
+	}
+}
+
+
+static void MKTestNativeNumbers(SBJsonParser *parser)
+{
+	parser.decimalNumbers = NO;
+
+	MKTestInteger(parser, @"0", 0);
+	MKTestInteger(parser, @"-0", 0);
+	MKTestInteger(parser, @"42", 42);
+	MKTestInteger(parser, @"-42", -42);
+	MKTestInteger(parser, @"100000123456789", 100000123456789LL);
+	MKTestInteger(parser, @"9007199254740993", 9007199254740993LL);
+	MKTestInteger(parser, @"9223372036854775807", LLONG_MAX);
+	MKTestInteger(parser, @"-9223372036854775807", -LLONG_MAX);
+	MKTestInteger(parser, @"-9223372036854775808", LLONG_MIN);
+	MKTestUnsignedInteger(parser, @"9223372036854775808", 9223372036854775808ULL);
+	MKTestUnsignedInteger(parser, @"18446744073709551615", ULLONG_MAX);
+
+	MKTestDouble(parser, @"-0.0", -0.0);
+	MKTestDouble(parser, @"0.1", 0.1);
+	MKTestDouble(parser, @"0.30000000000000004", 0.1 + 0.2);
+	MKTestDouble(parser, @"1.5e3", 1500.0);
+	MKTestDouble(parser, @"-2.5E-3", -0.0025);
+	MKTestDouble(parser, @"1E+2", 100.0);
+	MKTestDouble(parser, @"9007199254740993.0", 9007199254740992.0);
+	MKTestDouble(parser, @"1.7976931348623157e308", DBL_MAX);
+	MKTestDouble(parser, @"2.2250738585072014e-308", DBL_MIN);
+	MKTestDouble(parser, @"37.4419", 37.4419);
+	MKTestDouble(parser, @"-122.1430", -122.1430);
+
+	//longer than the stack buffer strtod is given the number in
+	NSString *longFraction = [NSString stringWithFormat:@"0.%@1", [@"" stringByPaddingToLength:99 withString:@"0" startingAtIndex:0]];
+	MKTestDouble(parser, longFraction, 1e-100);
+	NSString *longMantissa = [NSString stringWithFormat:@"1.%@e2", [@"" stringByPaddingToLength:120 withString:@"0" startingAtIndex:0]];
+	MKTestDouble(parser, longMantissa, 100.0);
+
+	MKTestDecimal(parser, @"-9223372036854775809");
+	MKTestDecimal(parser, @"18446744073709551616");
+	MKTestDecimal(parser, @"123456789012345678901234567890");
+	MKTestDecimal(parser, @"1e309");
+	MKTestDecimal(parser, @"-1e309");
+	MKTestDecimal(parser, @"1e-400");
+
+	//true and false stay booleans, not the integers 1 and 0
+	NSArray *booleans = [parser objectWithString:@"[true,false,1,0]"];
+	MKTestCheck(MKJSONIsBoolean([booleans objectAtIndex:0]) && MKJSONIsBoolean([booleans objectAtIndex:1]), @"true and false became %@ and %@", [booleans objectAtIndex:0], [booleans objectAtIndex:1]);
+	MKTestCheck(MKJSONIsBoolean([booleans objectAtIndex:2]) == NO && MKJSONIsBoolean([booleans objectAtIndex:3]) == NO, @"1 and 0 became booleans");
+
+	//numbers as object values, followed by more of the document
+	NSDictionary *photo = [parser objectWithString:@"{\"pid\":100000123456789,\"created\":1287000000,\"latitude\":37.4419,\"size\":-1}"];
+	MKTestCheck([[photo objectForKey:@"pid"] longLongValue] == 100000123456789LL && [[photo objectForKey:@"created"] longLongValue] == 1287000000LL, @"integers in an object became %@", photo);
+	MKTestCheck([[photo objectForKey:@"latitude"] doubleValue] == 37.4419 && [[photo objectForKey:@"size"] longLongValue] == -1, @"numbers in an object became %@", photo);
+}
+
+
+//a locale with a decimal comma mustn't change how 1.5 is read
+static void MKTestLocale(SBJsonParser *parser)
+{
+	const char *locales[] = {"de_DE.UTF-8", "fr_FR.UTF-8", "de_DE"};
+	char *previous = strdup(setlocale(LC_ALL, NULL));
+	const char *locale = NULL;
+	for (NSUInteger i = 0; i < sizeof(locales) / sizeof(locales[0]) && locale == NULL; i++) {
+		locale = setlocale(LC_ALL, locales[i]);
+	}
+	if (locale == NULL) {
+		NSLog(@"no locale with a decimal comma is installed, skipping the locale check");
+	} else {
+		MKTestDouble(parser, @"1.5", 1.5);
+		MKTestDouble(parser, @"-122.1430", -122.1430);
+	}
+	setlocale(LC_ALL, previous);
+	free(previous);
+}
+
+
+static void MKTestDecimalNumbers(SBJsonParser *parser)
+{
+	parser.decimalNumbers = YES;
+	NSArray *texts = [NSArray arrayWithObjects:@"0", @"-0", @"42", @"0.1", @"37.4419", @"9223372036854775807", @"18446744073709551616", @"1e309", @"1.5e3", nil];
+	for (NSString *text in texts) {
+		MKTestDecimal(parser, text);
+	}
+	parser.decimalNumbers = NO;
+
+	//SBJSON.h isn't a public header, the facade is reached through the protocol it shares with the parser
+	id <SBJsonParser> facade = [[[NSClassFromString(@"SBJSON") alloc] init] autorelease];
+	MKTestCheck(facade != nil, @"there is no SBJSON class");
+	MKTestCheck(facade.decimalNumbers == NO, @"SBJSON starts with decimalNumbers on");
+	facade.decimalNumbers = YES;
+	id n = [[facade objectWithString:@"[0.1]"] lastObject];
+	MKTestCheck([n isKindOfClass:[NSDecimalNumber class]], @"SBJSON with decimalNumbers on made a %@ of 0.1", [n class]);
+	facade.decimalNumbers = NO;
+	n = [[facade objectWithString:@"[0.1]"] lastObject];
+	MKTestCheck([n isKindOfClass:[NSDecimalNumber class]] == NO && [n doubleValue] == 0.1, @"SBJSON with decimalNumbers off made a %@ of value %@ of 0.1", [n class], n);
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	SBJsonParser *parser = [[[SBJsonParser alloc] init] autorelease];
+	MKTestCheck(parser.decimalNumbers == NO, @"SBJsonParser starts with decimalNumbers on");
+	MKTestNativeNumbers(parser);
+	MKTestLocale(parser);
+	MKTestDecimalNumbers(parser);
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed");
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+//
+//  MKJSONTestSupport.h
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Documents and comparisons shared by the JSON tests. Import it into the tool, there is nothing to
+ build separately.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: " __VA_ARGS__); \
+	} \
+} while (0)
+
+
+//valid and invalid documents, none deeper than a few levels. the deep ones are made by MKJSONTestCorpus()
+static const char *MKJSONTestDocuments[] = {
+	//valid
+	"[]", "{}", "[ ]", "{ }", " [1] ", "\v[\f1\r]\n\t",
+	"[1,2,3]", "[-0, 0, -1, 1.5, -1.5e10, 2E-3, 0.0, 1e2, 1E+2, 0.1, 123.456e-7]",
+	"[9223372036854775807, -9223372036854775808, 18446744073709551615]",
+	"{\"a\":1,\"b\":[true,false,null],\"c\":{\"d\":\"e\"}}",
+	"{\"uid\":100000123456789,\"name\":\"Mike\",\"pic_square\":null,\"a_key_that_is_longer_than_thirty_two_bytes\":[]}",
+	"{\"a\":1,\"a\":2}",
+	"[\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"]",
+	"[\"\\u0041\\u00e9\\u20ac\\uffff\\uE000\"]",
+	"[\"\\u0000\"]", "[\"a\\u0000b\"]", "{\"\\u0000\":\"\"}",
+	"[\"\\ud83d\\ude00\", \"\\ud83d\\udffe\", \"\\udbff\\udc00\", \"\\uD800\\uDC00\"]",
+	"[\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\"]", "{\"\xc3\xa9t\xc3\xa9\":\"\xe2\x82\xac\"}",
+	"[\"a string well over the sixty four bytes the vector kernels look at in one go, \\n with an escape and more text behind it\"]",
+	"[1 2]", "{\"a\":1 \"b\":2}", "[truefalse]", "[1\"a\"]",
+	//not closed
+	"", "   ", "[", "[ ", "{", "{ ", "[1", "[1 ", "[1,", "[1, ", "[[[[", "[{\"a\":[",
+	"{\"a\"", "{\"a\" ", "{\"a\":", "{\"a\": ", "{\"a\":1", "{\"a\":1,", "{\"a\":1 ",
+	"[\"abc", "[\"", "[\"abc\\n", "[\"abc\\nd", "[\"\\u00e9", "[\"\\ud83d\\ude00", "[\"\\", "[\"\\u12",
+	"[\"\\ud800", "[\"\\ud800\\", "[\"\\ud800\\u", "[\"\\ud800\\udc", "{\"a", "{\"a\\t",
+	"[tru", "[nul", "[fals", "{\"a\":tru", "[-", "[1.", "[1e", "[1e+", "[1E-",
+	//trailing garbage and commas
+	"[1] x", "[1]]", "{}{}", "[1] 2", "[] \"a\"",
+	"[1,]", "[1, ]", "{\"a\":1,}", "{\"a\":1 , }",
+	//structure
+	"[,1]", "[1,,2]", "{,}", "{\"a\" 1}", "{1:2}", "{\"a\":1 x}", "[x]", "]", "}", "[}", "{]", "{\"a\":}",
+	//numbers
+	"[+1]", "[01]", "[-01]", "[00]", "[1.e5]", "[.5]", "[1.5.3]", "[1e5.3]", "[--1]", "[- 1]", "[-a]", "[1ee5]", "[0x10]",
+	//literals
+	"[tRue]", "[nulll]", "[t]", "[f,", "[n]",
+	//escapes and control characters
+	"[\"\\x\"]", "[\"\\'\"]", "[\"\\\xc3\xa9\"]", "[\"\\u12G4\"]", "[\"\\U0041\"]",
+	"[\"a\x01" "b\"]", "[\"\t\"]", "{\"a\nb\":1}", "[\"\x1f\"]",
+	//surrogates
+	"[\"\\ud83d\\udfff\"]", "[\"\\udc00\"]", "[\"\\udfff\"]", "[\"\\ud800x\"]", "[\"\\ud800\\n\"]",
+	"[\"\\ud800\\ud800\"]", "[\"\\ud800\\u00zz\"]", "[\"\\ud800\\u0041\"]", "{\"\\udc00\":1}", "{\"a\":\"\\ud800\"}",
+	//fragments
+	"1", "-1.5", "\"a\"", "true", "false", "null", " 2 ", "\"\\u00e9\"",
+};
+
+//integers at the edges of 64 bits and numbers out of the range of a double, and what they become
+//when decimalNumbers is off: i for a 64 bit integer, d for a double, D for an NSDecimalNumber
+static const struct {
+	const char *text;
+	char type;
+} MKJSONTestNumbers[] = {
+	{ "9223372036854775807", 'i' },
+	{ "9223372036854775808", 'i' },
+	{ "18446744073709551615", 'i' },
+	{ "18446744073709551616", 'D' },
+	{ "-9223372036854775808", 'i' },
+	{ "-9223372036854775809", 'D' },
+	{ "123456789012345678901234567890", 'D' },
+	{ "-0", 'i' },
+	{ "-0.0", 'd' },
+	{ "0.1", 'd' },
+	{ "1e200", 'd' },
+	{ "1e-300", 'd' },
+	{ "1.7976931348623157e308", 'd' },
+	{ "1e309", 'D' },
+	{ "-1e309", 'D' },
+	{ "1E400", 'D' },
+	{ "1e-400", 'D' },
+	{ "-1e-400", 'D' },
+	{ "0.0000000000000000000000000000000000000000000000000000000000000000000001e-400", 'D' },
+};
+
+//strings that aren't UTF-8. the recursive scanner could loop forever on these, so they are only run through SBJsonParser
+static const char *MKJSONTestInvalidUTF8Documents[] = {
+	"[\"\xff\"]", "[\"ab\xc3\"]", "[\"\xc3(\"]", "[\"\xc0\xaf\"]", "{\"\xfe\":1}", "[\"\xe2\x82\"]",
+};
+
+
+static NSData *MKJSONNestedDocument(NSUInteger depth, BOOL objects)
+{
+	NSMutableData *data = [NSMutableData data];
+	for (NSUInteger i = 0; i < depth; i++) {
+		const char *open = objects && i % 2 == 1 ? "{\"a\":" : "[";
+		[data appendBytes:open length:strlen(open)];
+	}
+	for (NSUInteger i = depth; i > 0; i--) {
+		const char *close = objects && (i - 1) % 2 == 1 ? "}" : "]";
+		[data appendBytes:close length:1];
+	}
+	return data;
+}
+
+
+//every document, with arrays and objects nested as deep as maxDepth allows and one level deeper
+static NSArray *MKJSONTestCorpus(void)
+{
+	NSMutableArray *corpus = [NSMutableArray array];
+	for (NSUInteger i = 0; i < sizeof(MKJSONTestDocuments) / sizeof(MKJSONTestDocuments[0]); i++) {
+		[corpus addObject:[NSData dataWithBytes:MKJSONTestDocuments[i] length:strlen(MKJSONTestDocuments[i])]];
+	}
+	for (NSUInteger i = 0; i < sizeof(MKJSONTestNumbers) / sizeof(MKJSONTestNumbers[0]); i++) {
+		[corpus addObject:[[NSString stringWithFormat:@"[%s]", MKJSONTestNumbers[i].text] dataUsingEncoding:NSUTF8StringEncoding]];
+	}
+	[corpus addObject:MKJSONNestedDocument(512, NO)];
+	[corpus addObject:MKJSONNestedDocument(513, NO)];
+	[corpus addObject:MKJSONNestedDocument(512, YES)];
+	[corpus addObject:MKJSONNestedDocument(513, YES)];
+	//not closed, as deep as allowed
+	[corpus addObject:[MKJSONNestedDocument(1024, NO) subdataWithRange:NSMakeRange(0, 512)]];
+	return corpus;
+}
+
+
+static NSArray *MKJSONTestInvalidUTF8Corpus(void)
+{
+	NSMutableArray *corpus = [NSMutableArray array];
+	for (NSUInteger i = 0; i < sizeof(MKJSONTestInvalidUTF8Documents) / sizeof(MKJSONTestInvalidUTF8Documents[0]); i++) {
+		[corpus addObject:[NSData dataWithBytes:MKJSONTestInvalidUTF8Documents[i] length:strlen(MKJSONTestInvalidUTF8Documents[i])]];
+	}
+	return corpus;
+}
+
+
+//the document as a C string for log messages, non-ASCII bytes escaped
+static NSString *MKJSONTestDescription(NSData *data)
+{
+	NSMutableString *description = [NSMutableString string];
+	const unsigned char *bytes = [data bytes];
+	NSUInteger length = MIN([data length], (NSUInteger)80);
+	for (NSUInteger i = 0; i < length; i++) {
+		if (bytes[i] >= 0x20 && bytes[i] < 0x7f) {
+			[description appendFormat:@"%c", bytes[i]];
+		} else {
+			[description appendFormat:@"\\x%02x", bytes[i]];
+		}
+	}
+	if (length < [data length]) {
+		[description appendFormat:@"... (%lu bytes)", (unsigned long)[data length]];
+	}
+	return description;
+}
+
+
+static BOOL MKJSONIsBoolean(id o)
+{
+	return CFGetTypeID((CFTypeRef)o) == CFBooleanGetTypeID();
+}
+
+
+/*
+ Compares two numbers the parsers returned. Exactly means same class and same value. Otherwise
+ a is from SBJsonParser with decimalNumbers off and b an NSDecimalNumber from the recursive
+ scanner: integers have to have the same value, doubles the nearest value, and numbers SBJsonParser
+ still returns as NSDecimalNumber the same digits.
+ */
+static BOOL MKJSONNumbersEqual(NSNumber *a, NSNumber *b, BOOL exactly)
+{
+	if (MKJSONIsBoolean(a) || MKJSONIsBoolean(b)) {
+		return a == b;
+	}
+	if ([a isKindOfClass:[NSDecimalNumber class]] || [b isKindOfClass:[NSDecimalNumber class]]) {
+		if ([a isKindOfClass:[NSDecimalNumber class]] && [b isKindOfClass:[NSDecimalNumber class]]) {
+			//descriptions, so that NaN equals NaN
+			return [[a description] isEqualToString:[b description]];
+		}
+		if (exactly || [b isKindOfClass:[NSDecimalNumber class]] == NO) {
+			return NO;
+		}
+	}
+	if (exactly) {
+		return strcmp([a objCType], [b objCType]) == 0 && [a isEqualToNumber:b];
+	}
+
+	char type = *[a objCType];
+	if (type == 'q' || type == 'Q') {
+		return [(NSDecimalNumber *)b compare:[NSDecimalNumber decimalNumberWithString:[a stringValue]]] == NSOrderedSame;
+	}
+	double x = [a doubleValue], y = [b doubleValue];
+	return x == y || fabs(x - y) <= fabs(y) * 1e-12;
+}
+
+
+//arrays, objects, strings and null have to be equal, numbers as MKJSONNumbersEqual() compares them
+static BOOL MKJSONObjectsEqual(id a, id b, BOOL exactNumbers)
+{
+	if (a == nil || b == nil) {
+		return a == b;
+	}
+	if ([a isKindOfClass:[NSDictionary class]]) {
+		if ([b isKindOfClass:[NSDictionary class]] == NO || [a count] != [b count]) {
+			return NO;
+		}
+		for (id key in a) {
+			if ([key isKindOfClass:[NSString class]] == NO || MKJSONObjectsEqual([a objectForKey:key], [b objectForKey:key], exactNumbers) == NO) {
+				return NO;
+			}
+		}
+		return YES;
+	}
+	if ([a isKindOfClass:[NSArray class]]) {
+		if ([b isKindOfClass:[NSArray class]] == NO || [a count] != [b count]) {
+			return NO;
+		}
+		for (NSUInteger i = 0; i < [a count]; i++) {
+			if (MKJSONObjectsEqual([a objectAtIndex:i], [b objectAtIndex:i], exactNumbers) == NO) {
+				return NO;
+			}
+		}
+		return YES;
+	}
+	if ([a isKindOfClass:[NSString class]]) {
+		return [b isKindOfClass:[NSString class]] && [a isEqualToString:b];
+	}
+	if ([a isKindOfClass:[NSNumber class]]) {
+		return [b isKindOfClass:[NSNumber class]] && MKJSONNumbersEqual(a, b, exactNumbers);
+	}
+	return [a isKindOfClass:[NSNull class]] && [b isKindOfClass:[NSNull class]];
+}
+
+
+//same codes and messages in the same order
+static BOOL MKJSONTracesEqual(NSArray *a, NSArray *b)
+{
+	if ([a count] != [b count]) {
+		return NO;
+	}
+	for (NSUInteger i = 0; i < [a count]; i++) {
+		NSError *x = [a objectAtIndex:i], *y = [b objectAtIndex:i];
+		if ([x code] != [y code] || [[x localizedDescription] isEqualToString:[y localizedDescription]] == NO) {
+			return NO;
+		}
+	}
+	return YES;
+}
+
+
+static NSString *MKJSONTraceDescription(NSArray *trace)
+{
+	NSMutableArray *lines = [NSMutableArray array];
+	for (NSError *error in trace) {
+		[lines addObject:[NSString stringWithFormat:@"%ld %@", (long)[error code], [error localizedDescription]]];
+	}
+	return [lines count] > 4 ? [NSString stringWithFormat:@"%@ ... (%lu errors)", [[lines subarrayWithRange:NSMakeRange(0, 4)] componentsJoinedByString:@" / "], (unsigned long)[lines count]] : [lines componentsJoinedByString:@" / "];
+}
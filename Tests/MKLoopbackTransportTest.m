@@ -0,0 +1,209 @@
+//
+//  MKLoopbackTransportTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Sends requests through MKLoopbackTransport and checks how MKFacebookRequest retries: errors 1, 2
+ and 4 are tried again until a response arrives or numberOfRequestAttempts is used up, other error
+ codes and connection failures go to the delegate after one attempt.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKLoopbackTransportTest.m -o build/MKLoopbackTransportTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKLoopbackTransportTest
+
+ Retries are sent without delay or jitter and the circuit breaker is off, so the requests the
+ transport counts are the attempts each request made.
+
+ Exits with 0 if every check passed.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+
+static const NSTimeInterval MKTestTimeout = 10;
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: %@", [NSString stringWithFormat:__VA_ARGS__]); \
+	} \
+} while (0)
+
+
+@interface MKTestDelegate : NSObject {
+@public
+	NSUInteger responseCount;
+	NSUInteger errorCount;
+	NSUInteger failureCount;
+	id lastResponse;
+	NSUInteger lastErrorCode;
+	NSError *lastFailure;
+	NSDate *lastDeliveryDate;
+}
+- (void)reset;
+@end
+
+@implementation MKTestDelegate
+
+- (void)dealloc
+{
+	[self reset];
+	[super dealloc];
+}
+
+- (void)reset
+{
+	responseCount = errorCount = failureCount = 0;
+	lastErrorCode = 0;
+	[lastResponse release];
+	lastResponse = nil;
+	[lastFailure release];
+	lastFailure = nil;
+	[lastDeliveryDate release];
+	lastDeliveryDate = nil;
+}
+
+- (NSUInteger)deliveryCount
+{
+	return responseCount + errorCount + failureCount;
+}
+
+- (void)delivered
+{
+	[lastDeliveryDate release];
+	lastDeliveryDate = [[NSDate date] retain];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request responseReceived:(id)response
+{
+	responseCount++;
+	[lastResponse release];
+	lastResponse = [response retain];
+	[self delivered];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error
+{
+	errorCount++;
+	lastErrorCode = error.errorCode;
+	[self delivered];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request failed:(NSError *)error
+{
+	failureCount++;
+	[lastFailure release];
+	lastFailure = [error retain];
+	[self delivered];
+}
+
+@end
+
+
+//sends one request and runs the run loop until it has been delivered, or the timeout
+static MKFacebookRequest *MKTestSend(NSString *method, int attempts, MKTestDelegate *delegate)
+{
+	[delegate reset];
+	MKFacebookRequest *request = [[[MKFacebookRequest alloc] initWithDelegate:delegate selector:nil] autorelease];
+	request.method = method;
+	request.responseFormat = MKFacebookRequestResponseFormatJSON;
+	request.numberOfRequestAttempts = attempts;
+	request.retryDelay = 0;
+	request.retryJitter = 0;
+	request.coalescesRequests = NO;
+	request.displayAPIErrorAlerts = NO;
+	[request sendRequest];
+
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKTestTimeout];
+	while ([delegate deliveryCount] == 0 && [timeout timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+	}
+	//anything delivered twice would arrive from the next timers
+	[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+	MKTestCheck([delegate deliveryCount] == 1, @"%@ was delivered %lu times", method, (unsigned long)[delegate deliveryCount]);
+	return request;
+}
+
+
+//an error that is retried, then a response: the delegate only sees the response
+static void MKTestRetriedError(MKLoopbackTransport *transport, MKTestDelegate *delegate, int errorCode)
+{
+	NSString *method = [NSString stringWithFormat:@"test.retried%d", errorCode];
+	[transport addErrorCode:errorCode forMethod:method];
+	[transport addResponse:@"[{\"aid\":\"1\"}]" forMethod:method];
+	MKTestSend(method, 5, delegate);
+	MKTestCheck(delegate->responseCount == 1 && delegate->errorCount == 0, @"error %d then a response gave %lu responses, %lu errors", errorCode, (unsigned long)delegate->responseCount, (unsigned long)delegate->errorCount);
+	MKTestCheck([delegate->lastResponse isKindOfClass:[NSArray class]] && [[[delegate->lastResponse lastObject] valueForKey:@"aid"] isEqualToString:@"1"], @"error %d then a response gave %@", errorCode, delegate->lastResponse);
+	MKTestCheck([transport requestCountForMethod:method] == 2, @"error %d then a response took %lu attempts, should take 2", errorCode, (unsigned long)[transport requestCountForMethod:method]);
+}
+
+
+//an error that keeps coming back: the delegate receives it once the attempts are used up
+static void MKTestExhaustedAttempts(MKLoopbackTransport *transport, MKTestDelegate *delegate, int errorCode)
+{
+	NSString *method = [NSString stringWithFormat:@"test.exhausted%d", errorCode];
+	[transport addErrorCode:errorCode forMethod:method];
+	MKTestSend(method, 3, delegate);
+	MKTestCheck(delegate->errorCount == 1 && delegate->lastErrorCode == (NSUInteger)errorCode, @"error %d every time gave %lu errors, the last with code %lu", errorCode, (unsigned long)delegate->errorCount, (unsigned long)delegate->lastErrorCode);
+	MKTestCheck([transport requestCountForMethod:method] == 3, @"error %d every time took %lu attempts, numberOfRequestAttempts is 3", errorCode, (unsigned long)[transport requestCountForMethod:method]);
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	MKLoopbackTransport *transport = [MKLoopbackTransport transport];
+	[MKFacebookRequest setDefaultTransport:transport];
+	[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] setEnabled:NO];
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+
+	int retriedCodes[] = {1, 2, 4};
+	for (NSUInteger i = 0; i < sizeof(retriedCodes) / sizeof(retriedCodes[0]); i++) {
+		MKTestRetriedError(transport, delegate, retriedCodes[i]);
+		MKTestExhaustedAttempts(transport, delegate, retriedCodes[i]);
+	}
+
+	//any other code goes straight to the delegate
+	[transport addErrorCode:100 forMethod:@"test.invalidParameter"];
+	[transport addResponse:@"[]" forMethod:@"test.invalidParameter"];
+	MKTestSend(@"test.invalidParameter", 5, delegate);
+	MKTestCheck(delegate->errorCount == 1 && delegate->lastErrorCode == 100, @"error 100 gave %lu errors, the last with code %lu", (unsigned long)delegate->errorCount, (unsigned long)delegate->lastErrorCode);
+	MKTestCheck([transport requestCountForMethod:@"test.invalidParameter"] == 1, @"error 100 was attempted %lu times", (unsigned long)[transport requestCountForMethod:@"test.invalidParameter"]);
+
+	//and so do connection failures
+	NSError *failure = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNotConnectedToInternet userInfo:nil];
+	[transport addFailure:failure forMethod:@"test.offline"];
+	MKTestSend(@"test.offline", 5, delegate);
+	MKTestCheck(delegate->failureCount == 1 && [delegate->lastFailure code] == NSURLErrorNotConnectedToInternet, @"a connection failure gave %lu failures, the last %@", (unsigned long)delegate->failureCount, delegate->lastFailure);
+	MKTestCheck([transport requestCountForMethod:@"test.offline"] == 1, @"a connection failure was attempted %lu times", (unsigned long)[transport requestCountForMethod:@"test.offline"]);
+
+	MKTestSend(@"test.unscripted", 5, delegate);
+	MKTestCheck(delegate->failureCount == 1 && [delegate->lastFailure code] == NSURLErrorResourceUnavailable, @"a method without a script gave %lu failures, the last %@", (unsigned long)delegate->failureCount, delegate->lastFailure);
+
+	//nothing arrives before the latency is up
+	transport.latency = 0.3;
+	[transport addResponse:@"[]" forMethod:@"test.latency"];
+	NSDate *sent = [NSDate date];
+	MKTestSend(@"test.latency", 1, delegate);
+	MKTestCheck(delegate->lastDeliveryDate != nil && [delegate->lastDeliveryDate timeIntervalSinceDate:sent] >= 0.3, @"a response with a latency of 0.3 s arrived after %.3f s", [delegate->lastDeliveryDate timeIntervalSinceDate:sent]);
+	transport.latency = 0;
+
+	[transport removeAllResponses];
+	MKTestCheck([transport requestCount] == 0, @"removeAllResponses left a request count of %lu", (unsigned long)[transport requestCount]);
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed");
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
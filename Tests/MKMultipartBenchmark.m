@@ -0,0 +1,219 @@
+//
+//  MKMultipartBenchmark.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Times the body of a POST request built by MKMultipartFormEncoder against the stringWithFormat: and
+ NSMutableData builder it replaced, and checks that both write the same bytes.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKMultipartBenchmark.m -o build/MKMultipartBenchmark
+ DYLD_FRAMEWORK_PATH=build/Release build/MKMultipartBenchmark 10000
+
+ The argument is the number of bodies per run. Every measurement is made in 5 runs, the fastest run
+ is reported.
+
+ Two bodies are built: a typical 10 parameter POST, and the same parameters with 64 KB of data as an
+ upload sends them. The old builder is copied from sendRequest before 0.9 with the parameters taken
+ in the same order the encoder is given them.
+
+ Allocations are the malloc blocks still alive when a body is finished, before its autorelease pool
+ is drained. That counts every autoreleased string and data the builder made on the way, but not
+ buffers that were freed right away, such as the ones NSMutableData drops when it grows.
+
+ Exits with 1 if the two builders don't write the same bytes.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+#import "../MKMultipartFormEncoder.h"
+#include <mach/mach_time.h>
+#include <malloc/malloc.h>
+
+static const NSUInteger MKBenchmarkRuns = 5;
+static const NSUInteger MKBenchmarkDataLength = 64 * 1024;
+
+
+static double MKBenchmarkSeconds(uint64_t elapsed)
+{
+	static mach_timebase_info_data_t timebase;
+	if (timebase.denom == 0) {
+		mach_timebase_info(&timebase);
+	}
+	return (double)elapsed * timebase.numer / timebase.denom / 1e9;
+}
+
+
+//the parameters of a status update as sendRequest has them once it has signed the request
+static NSArray *MKBenchmarkKeys(void)
+{
+	return [NSArray arrayWithObjects:@"api_key", @"call_id", @"format", @"method", @"session_key", @"sig", @"status", @"status_includes_verb", @"uid", @"v", nil];
+}
+
+
+static NSDictionary *MKBenchmarkParameters(NSData *data)
+{
+	NSMutableDictionary *parameters = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+		@"8f3c5e1a9b2d4f6e8a0c2e4f6a8b0d2c", @"api_key",
+		@"1287654321.123456", @"call_id",
+		@"JSON", @"format",
+		@"facebook.users.setStatus", @"method",
+		@"2.AQBx8Wq3Ew0fZjXe.3600.1287658800-100000123456789", @"session_key",
+		@"0d4f1c9a2b7e6d5c8f3a1e0b9c2d7f6a", @"sig",
+		@"Testing the new uploader — café über alles", @"status",
+		@"true", @"status_includes_verb",
+		@"100000123456789", @"uid",
+		@"1.0", @"v",
+		nil];
+	if (data != nil) {
+		[parameters setObject:data forKey:@"data"];
+	}
+	return parameters;
+}
+
+
+//sendRequest before 0.9, less the image case, which doesn't occur here
+static NSData *MKBenchmarkOldBody(NSDictionary *parameters, NSArray *keys)
+{
+	NSMutableData *postBody = [NSMutableData data];
+	NSString *stringBoundary = [NSString stringWithString:@"xXxiFyOuTyPeThIsThEwOrLdWiLlExPlOdExXx"];
+	NSData *endLineData = [[NSString stringWithFormat:@"\r\n--%@\r\n", stringBoundary] dataUsingEncoding:NSUTF8StringEncoding];
+	[postBody appendData:[[NSString stringWithFormat:@"--%@\r\n", stringBoundary] dataUsingEncoding:NSUTF8StringEncoding]];
+
+	for (id key in keys) {
+		if ([[parameters objectForKey:key] isKindOfClass:[NSData class]]) {
+			[postBody appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; filename=\"data.mov\"\r\n"] dataUsingEncoding:NSUTF8StringEncoding]];
+			[postBody appendData:[[NSString stringWithString:@"Content-Type: content/unknown\r\n\r\n"] dataUsingEncoding:NSUTF8StringEncoding]];
+			[postBody appendData:(NSData *)[parameters objectForKey:key]];
+			[postBody appendData:endLineData];
+		} else if ([[parameters objectForKey:key] isKindOfClass:[NSArray class]]) {
+			NSString *stringFromArray = [[parameters objectForKey:key] componentsJoinedByString:@","];
+			[postBody appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; name=\"%@\"\r\n\r\n", key] dataUsingEncoding:NSUTF8StringEncoding]];
+			[postBody appendData:[stringFromArray dataUsingEncoding:NSUTF8StringEncoding]];
+			[postBody appendData:endLineData];
+		} else {
+			[postBody appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; name=\"%@\"\r\n\r\n", key] dataUsingEncoding:NSUTF8StringEncoding]];
+			[postBody appendData:[[parameters valueForKey:key] dataUsingEncoding:NSUTF8StringEncoding]];
+			[postBody appendData:endLineData];
+		}
+	}
+	[postBody appendData:endLineData];
+	return postBody;
+}
+
+
+//sendRequest from 0.9 on, for the same kinds of values
+static NSData *MKBenchmarkEncoderBody(NSDictionary *parameters, NSArray *keys)
+{
+	MKMultipartFormEncoder *encoder = [[[MKMultipartFormEncoder alloc] initWithCapacity:[keys count]] autorelease];
+	for (id key in keys) {
+		id value = [parameters objectForKey:key];
+		if ([value isKindOfClass:[NSData class]]) {
+			[encoder addData:value filename:@"data.mov" contentType:@"content/unknown"];
+		} else if ([value isKindOfClass:[NSArray class]]) {
+			[encoder addFieldWithName:key value:[value componentsJoinedByString:@","]];
+		} else {
+			[encoder addFieldWithName:key value:value];
+		}
+	}
+	return [encoder bodyData];
+}
+
+
+typedef NSData *(*MKBenchmarkBuilder)(NSDictionary *, NSArray *);
+
+//seconds per body, of the fastest run
+static double MKBenchmarkTime(MKBenchmarkBuilder builder, NSDictionary *parameters, NSArray *keys, NSUInteger iterations)
+{
+	double best = 0;
+	for (NSUInteger run = 0; run < MKBenchmarkRuns; run++) {
+		uint64_t start = mach_absolute_time();
+		for (NSUInteger i = 0; i < iterations; i++) {
+			NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+			builder(parameters, keys);
+			[pool drain];
+		}
+		double seconds = MKBenchmarkSeconds(mach_absolute_time() - start) / iterations;
+		if (run == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+	return best;
+}
+
+
+//malloc blocks and bytes alive after one body is built, before its pool is drained
+static void MKBenchmarkAllocations(MKBenchmarkBuilder builder, NSDictionary *parameters, NSArray *keys, size_t *blocks, size_t *bytes)
+{
+	//the first body pays for lazily made constants such as the content type
+	NSAutoreleasePool *warmup = [[NSAutoreleasePool alloc] init];
+	builder(parameters, keys);
+	[warmup drain];
+
+	malloc_statistics_t before, after;
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	malloc_zone_statistics(NULL, &before);
+	builder(parameters, keys);
+	malloc_zone_statistics(NULL, &after);
+	[pool drain];
+
+	*blocks = after.blocks_in_use > before.blocks_in_use ? after.blocks_in_use - before.blocks_in_use : 0;
+	*bytes = after.size_in_use > before.size_in_use ? after.size_in_use - before.size_in_use : 0;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	NSUInteger iterations = argc > 1 ? (NSUInteger)MAX(atoi(argv[1]), 1) : 10000;
+	int result = 0;
+
+	NSMutableData *data = [NSMutableData dataWithLength:MKBenchmarkDataLength];
+	unsigned char *bytes = [data mutableBytes];
+	for (NSUInteger i = 0; i < MKBenchmarkDataLength; i++) {
+		bytes[i] = (unsigned char)(i * 31 + 7);
+	}
+
+	NSArray *names = [NSArray arrayWithObjects:@"10 fields", @"10 fields + data", nil];
+	NSArray *uploadKeys = [MKBenchmarkKeys() arrayByAddingObject:@"data"];
+	NSArray *keyLists = [NSArray arrayWithObjects:MKBenchmarkKeys(), uploadKeys, nil];
+	NSArray *parameterLists = [NSArray arrayWithObjects:MKBenchmarkParameters(nil), MKBenchmarkParameters(data), nil];
+
+	for (NSUInteger i = 0; i < [names count]; i++) {
+		NSString *name = [names objectAtIndex:i];
+		NSArray *keys = [keyLists objectAtIndex:i];
+		NSDictionary *parameters = [parameterLists objectAtIndex:i];
+
+		NSData *oldBody = MKBenchmarkOldBody(parameters, keys);
+		NSData *newBody = MKBenchmarkEncoderBody(parameters, keys);
+		if ([oldBody isEqualToData:newBody] == NO) {
+			NSUInteger length = MIN([oldBody length], [newBody length]);
+			NSUInteger offset = 0;
+			while (offset < length && ((const char *)[oldBody bytes])[offset] == ((const char *)[newBody bytes])[offset]) {
+				offset++;
+			}
+			NSLog(@"FAILED: %@ bodies differ at byte %lu, old builder wrote %lu bytes, encoder %lu", name, (unsigned long)offset, (unsigned long)[oldBody length], (unsigned long)[newBody length]);
+			result = 1;
+			continue;
+		}
+
+		size_t oldBlocks, oldBytes, newBlocks, newBytes;
+		MKBenchmarkAllocations(MKBenchmarkOldBody, parameters, keys, &oldBlocks, &oldBytes);
+		MKBenchmarkAllocations(MKBenchmarkEncoderBody, parameters, keys, &newBlocks, &newBytes);
+		double oldSeconds = MKBenchmarkTime(MKBenchmarkOldBody, parameters, keys, iterations);
+		double newSeconds = MKBenchmarkTime(MKBenchmarkEncoderBody, parameters, keys, iterations);
+
+		printf("%-20s %7lu bytes, identical\n", [name UTF8String], (unsigned long)[newBody length]);
+		printf("   old builder  %9.2f us %5lu allocations %8lu bytes\n", oldSeconds * 1e6, (unsigned long)oldBlocks, (unsigned long)oldBytes);
+		printf("   encoder      %9.2f us %5lu allocations %8lu bytes   %.1fx\n", newSeconds * 1e6, (unsigned long)newBlocks, (unsigned long)newBytes, newSeconds > 0 ? oldSeconds / newSeconds : 0);
+	}
+
+	[pool drain];
+	return result;
+}
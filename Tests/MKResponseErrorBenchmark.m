@@ -0,0 +1,211 @@
+//
+//  MKResponseErrorBenchmark.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Times error traffic: Facebook error responses, JSON and XML, turned into MKFacebookResponseError.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKResponseErrorBenchmark.m -o build/MKResponseErrorBenchmark
+ DYLD_FRAMEWORK_PATH=build/Release build/MKResponseErrorBenchmark Tests/Samples 1000
+
+ The arguments are the folder with the samples, error_response.json and error_response.xml, and the
+ number of errors per run. Every measurement is made in 5 runs, the fastest run is reported.
+
+ For each sample the error is built two ways: parsed, then parsed again by errorFromRequest:, as
+ every error used to be, and parsed once and handed to errorWithDictionary:. Builds without
+ errorWithDictionary: skip this.
+
+ Then the sample is answered to that many requests through MKLoopbackTransport, with no latency and
+ no retries, and the errors reaching facebookRequest:errorReceived: are counted. This only uses API
+ every version of the framework has, so the same binary can compare two builds: build each into its
+ own folder and point DYLD_FRAMEWORK_PATH at one, then the other.
+
+ Exits with 1 if a sample doesn't parse or not every request received its error.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+#include <mach/mach_time.h>
+
+static const NSUInteger MKBenchmarkRuns = 5;
+static const NSTimeInterval MKBenchmarkTimeout = 60;
+
+
+//private to the framework, declared here so a request can be given a response without sending it
+@interface MKFacebookRequest (MKBenchmarkPrivate)
+- (void)setRawResponseData:(NSData *)data;
+@end
+
+
+@interface MKBenchmarkErrorCounter : NSObject {
+@public
+	NSUInteger errorCount;
+	NSUInteger failureCount;
+	NSUInteger lastErrorCode;
+}
+@end
+
+@implementation MKBenchmarkErrorCounter
+
+- (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error
+{
+	errorCount++;
+	lastErrorCode = error.errorCode;
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request failed:(NSError *)error
+{
+	failureCount++;
+}
+
+@end
+
+
+static double MKBenchmarkSeconds(uint64_t elapsed)
+{
+	static mach_timebase_info_data_t timebase;
+	if (timebase.denom == 0) {
+		mach_timebase_info(&timebase);
+	}
+	return (double)elapsed * timebase.numer / timebase.denom / 1e9;
+}
+
+
+//the dictionary the framework makes of a response before deciding it is an error
+static NSDictionary *MKBenchmarkParseError(NSData *data, MKFacebookRequestResponseFormat format)
+{
+	if (format == MKFacebookRequestResponseFormatJSON) {
+		SBJsonParser *parser = [[[SBJsonParser alloc] init] autorelease];
+		return [parser objectWithData:data];
+	}
+	NSXMLDocument *xml = [[[NSXMLDocument alloc] initWithData:data options:0 error:nil] autorelease];
+	return [[xml rootElement] dictionaryFromXMLElement];
+}
+
+
+//seconds per error, of the fastest run. parsed twice as errorFromRequest: did, or parsed once
+static double MKBenchmarkBuildErrors(NSData *data, MKFacebookRequestResponseFormat format, NSUInteger iterations, BOOL parseTwice)
+{
+	MKFacebookRequest *request = [[[MKFacebookRequest alloc] init] autorelease];
+	request.responseFormat = format;
+	[request setRawResponseData:data];
+
+	double best = 0;
+	for (NSUInteger run = 0; run < MKBenchmarkRuns; run++) {
+		uint64_t start = mach_absolute_time();
+		for (NSUInteger i = 0; i < iterations; i++) {
+			NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+			NSDictionary *errorDictionary = MKBenchmarkParseError(data, format);
+			if (parseTwice == YES) {
+				[MKFacebookResponseError errorFromRequest:request];
+			} else {
+				[MKFacebookResponseError errorWithDictionary:errorDictionary];
+			}
+			[pool drain];
+		}
+		double seconds = MKBenchmarkSeconds(mach_absolute_time() - start) / iterations;
+		if (run == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+	return best;
+}
+
+
+//seconds per request, of the fastest run, from the first request sent to the last error received
+static double MKBenchmarkSendRequests(NSString *method, MKFacebookRequestResponseFormat format, NSUInteger iterations, MKBenchmarkErrorCounter *counter)
+{
+	double best = 0;
+	for (NSUInteger run = 0; run < MKBenchmarkRuns; run++) {
+		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+		NSMutableArray *requests = [NSMutableArray arrayWithCapacity:iterations];
+		for (NSUInteger i = 0; i < iterations; i++) {
+			MKFacebookRequest *request = [[[MKFacebookRequest alloc] initWithDelegate:counter selector:nil] autorelease];
+			request.method = method;
+			request.responseFormat = format;
+			request.numberOfRequestAttempts = 1;
+			request.coalescesRequests = NO;
+			[requests addObject:request];
+		}
+
+		counter->errorCount = 0;
+		counter->failureCount = 0;
+		uint64_t start = mach_absolute_time();
+		for (MKFacebookRequest *request in requests) {
+			[request sendRequest];
+		}
+		NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKBenchmarkTimeout];
+		while (counter->errorCount + counter->failureCount < iterations && [timeout timeIntervalSinceNow] > 0) {
+			[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+		}
+		double seconds = MKBenchmarkSeconds(mach_absolute_time() - start) / iterations;
+		[pool drain];
+
+		if (counter->errorCount != iterations) {
+			return 0;
+		}
+		if (run == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+	return best;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	NSString *directory = argc > 1 ? [NSString stringWithUTF8String:argv[1]] : @"Tests/Samples";
+	NSUInteger iterations = argc > 2 ? (NSUInteger)MAX(atoi(argv[2]), 1) : 1000;
+	int result = 0;
+
+	BOOL parseOnce = [MKFacebookResponseError respondsToSelector:@selector(errorWithDictionary:)];
+	if (parseOnce == NO) {
+		printf("errorWithDictionary: is not in this build, only requests are timed\n");
+	}
+
+	MKLoopbackTransport *transport = [MKLoopbackTransport transport];
+	[MKFacebookRequest setDefaultTransport:transport];
+	MKBenchmarkErrorCounter *counter = [[[MKBenchmarkErrorCounter alloc] init] autorelease];
+
+	NSArray *samples = [NSArray arrayWithObjects:@"error_response.json", @"error_response.xml", nil];
+	for (NSString *sample in samples) {
+		MKFacebookRequestResponseFormat format = [[sample pathExtension] isEqualToString:@"json"] ? MKFacebookRequestResponseFormatJSON : MKFacebookRequestResponseFormatXML;
+		NSData *data = [NSData dataWithContentsOfFile:[directory stringByAppendingPathComponent:sample]];
+		NSDictionary *errorDictionary = data != nil ? MKBenchmarkParseError(data, format) : nil;
+		if ([errorDictionary isKindOfClass:[NSDictionary class]] == NO || [errorDictionary valueForKey:@"error_code"] == nil) {
+			NSLog(@"FAILED: %@ is not an error response", sample);
+			result = 1;
+			continue;
+		}
+
+		printf("%-20s %5lu bytes\n", [sample UTF8String], (unsigned long)[data length]);
+		if (parseOnce == YES) {
+			double parsedTwice = MKBenchmarkBuildErrors(data, format, iterations, YES);
+			double parsedOnce = MKBenchmarkBuildErrors(data, format, iterations, NO);
+			printf("   parsed twice %9.1f us   parsed once %9.1f us\n", parsedTwice * 1e6, parsedOnce * 1e6);
+		}
+
+		//each sample answers a method of its own, the last scripted response keeps answering
+		NSString *method = [NSString stringWithFormat:@"benchmark.%@", [sample pathExtension]];
+		NSString *body = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+		[transport addResponse:body forMethod:method];
+		double perRequest = MKBenchmarkSendRequests(method, format, iterations, counter);
+		if (perRequest == 0) {
+			NSLog(@"FAILED: %lu of %lu requests received their error, %lu failed", (unsigned long)counter->errorCount, (unsigned long)iterations, (unsigned long)counter->failureCount);
+			result = 1;
+			continue;
+		}
+		printf("   requests     %9.1f us %9.0f errors/s   error code %lu\n", perRequest * 1e6, 1 / perRequest, (unsigned long)counter->lastErrorCode);
+	}
+
+	[pool drain];
+	return result;
+}
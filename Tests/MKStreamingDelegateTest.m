@@ -0,0 +1,358 @@
+//
+//  MKStreamingDelegateTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Checks that a request with a streamingDelegate passes its JSON response on as events, in the order
+ they appear in the document, while the response is still loading, and that Facebook errors are
+ kept from the streaming delegate and go to the request's delegate as before.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKStreamingDelegateTest.m -o build/MKStreamingDelegateTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKStreamingDelegateTest
+
+ Responses come from MKLoopbackTransport. Every check runs with maximumConcurrentParses at 4, where
+ the events are sent from the parse pool's threads, and at 0, where they are sent from the thread
+ the request was sent from.
+
+ Exits with 0 if every check passed.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+
+static const NSTimeInterval MKTestTimeout = 10;
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: %@", [NSString stringWithFormat:__VA_ARGS__]); \
+	} \
+} while (0)
+
+
+//writes the events down as one line, { k:pid s:1 n:2 true false null [ ] }
+@interface MKTestConsumer : NSObject <SBJsonStreamParserDelegate> {
+@public
+	NSMutableArray *events;
+	NSUInteger mainThreadEventCount;
+	NSUInteger otherThreadEventCount;
+	NSDate *firstEventDate;
+}
+- (NSString *)eventLine;
+- (void)reset;
+@end
+
+@implementation MKTestConsumer
+
+- (id)init
+{
+	if (self = [super init]) {
+		events = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[events release];
+	[firstEventDate release];
+	[super dealloc];
+}
+
+- (NSString *)eventLine
+{
+	@synchronized(self) {
+		return [events componentsJoinedByString:@" "];
+	}
+	return nil;
+}
+
+- (void)reset
+{
+	@synchronized(self) {
+		[events removeAllObjects];
+		mainThreadEventCount = 0;
+		otherThreadEventCount = 0;
+		[firstEventDate release];
+		firstEventDate = nil;
+	}
+}
+
+- (void)addEvent:(NSString *)event
+{
+	@synchronized(self) {
+		if (firstEventDate == nil) {
+			firstEventDate = [[NSDate date] retain];
+		}
+		if ([NSThread isMainThread] == YES) {
+			mainThreadEventCount++;
+		} else {
+			otherThreadEventCount++;
+		}
+		[events addObject:event];
+	}
+}
+
+- (void)parserDidStartObject:(SBJsonParser *)parser
+{
+	[self addEvent:@"{"];
+}
+
+- (void)parser:(SBJsonParser *)parser foundKey:(NSString *)key
+{
+	[self addEvent:[NSString stringWithFormat:@"k:%@", key]];
+}
+
+- (void)parserDidEndObject:(SBJsonParser *)parser
+{
+	[self addEvent:@"}"];
+}
+
+- (void)parserDidStartArray:(SBJsonParser *)parser
+{
+	[self addEvent:@"["];
+}
+
+- (void)parserDidEndArray:(SBJsonParser *)parser
+{
+	[self addEvent:@"]"];
+}
+
+- (void)parser:(SBJsonParser *)parser foundString:(NSString *)string
+{
+	[self addEvent:[NSString stringWithFormat:@"s:%@", string]];
+}
+
+- (void)parser:(SBJsonParser *)parser foundNumber:(NSNumber *)number
+{
+	[self addEvent:[NSString stringWithFormat:@"n:%@", number]];
+}
+
+- (void)parser:(SBJsonParser *)parser foundBoolean:(BOOL)x
+{
+	[self addEvent:x ? @"true" : @"false"];
+}
+
+- (void)parserFoundNull:(SBJsonParser *)parser
+{
+	[self addEvent:@"null"];
+}
+
+@end
+
+
+@interface MKTestDelegate : NSObject {
+@public
+	NSUInteger responseCount;
+	NSUInteger errorCount;
+	NSUInteger failureCount;
+	id lastResponse;
+	NSUInteger lastErrorCode;
+	NSDate *lastDeliveryDate;
+}
+- (NSUInteger)deliveryCount;
+- (void)reset;
+@end
+
+@implementation MKTestDelegate
+
+- (void)dealloc
+{
+	[lastResponse release];
+	[lastDeliveryDate release];
+	[super dealloc];
+}
+
+- (NSUInteger)deliveryCount
+{
+	return responseCount + errorCount + failureCount;
+}
+
+- (void)reset
+{
+	responseCount = 0;
+	errorCount = 0;
+	failureCount = 0;
+	lastErrorCode = 0;
+	[lastResponse release];
+	lastResponse = nil;
+	[lastDeliveryDate release];
+	lastDeliveryDate = nil;
+}
+
+- (void)delivered
+{
+	[lastDeliveryDate release];
+	lastDeliveryDate = [[NSDate date] retain];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request responseReceived:(id)response
+{
+	responseCount++;
+	[lastResponse release];
+	lastResponse = [response retain];
+	[self delivered];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request errorReceived:(MKFacebookResponseError *)error
+{
+	errorCount++;
+	lastErrorCode = error.errorCode;
+	[self delivered];
+}
+
+- (void)facebookRequest:(MKFacebookRequest *)request failed:(NSError *)error
+{
+	failureCount++;
+	[self delivered];
+}
+
+@end
+
+
+//sends a streamed request for method and waits until its delegate has been called once
+static MKFacebookRequest *MKTestSend(NSString *method, NSUInteger attempts, MKTestConsumer *consumer, MKTestDelegate *delegate)
+{
+	[consumer reset];
+	[delegate reset];
+
+	MKFacebookRequest *request = [[[MKFacebookRequest alloc] initWithDelegate:delegate selector:nil] autorelease];
+	request.method = method;
+	request.responseFormat = MKFacebookRequestResponseFormatJSON;
+	request.streamingDelegate = consumer;
+	request.numberOfRequestAttempts = attempts;
+	request.retryDelay = 0;
+	request.retryJitter = 0;
+	request.coalescesRequests = NO;
+	request.displayAPIErrorAlerts = NO;
+	[request sendRequest];
+
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:MKTestTimeout];
+	while ([delegate deliveryCount] == 0 && [timeout timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+	}
+	//a second delivery or a late event would show up now
+	[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+	MKTestCheck([delegate deliveryCount] == 1, @"%@ was delivered %lu times", method, (unsigned long)[delegate deliveryCount]);
+	return request;
+}
+
+
+//a response streams to the consumer, the delegate gets responseReceived: with nil
+static void MKTestStreamedResponse(MKLoopbackTransport *transport, MKTestConsumer *consumer, MKTestDelegate *delegate, NSString *body, NSString *expected)
+{
+	static NSUInteger methodNumber = 0;
+	NSString *method = [NSString stringWithFormat:@"test.stream.%lu", (unsigned long)++methodNumber];
+	[transport addResponse:body forMethod:method];
+
+	MKFacebookRequest *request = MKTestSend(method, 1, consumer, delegate);
+	MKTestCheck([[consumer eventLine] isEqualToString:expected], @"%@ streamed as %@, expected %@", body, [consumer eventLine], expected);
+	MKTestCheck(delegate->responseCount == 1 && delegate->lastResponse == nil, @"%@ was delivered as %@ instead of a nil response", body, delegate->lastResponse);
+	MKTestCheck(request.rawResponse == nil, @"%@ was kept after it was streamed", body);
+}
+
+
+static void MKTestEvents(MKLoopbackTransport *transport, MKTestConsumer *consumer, MKTestDelegate *delegate)
+{
+	MKTestStreamedResponse(transport, consumer, delegate,
+						   @"[{\"pid\":\"1\",\"src\":\"http://a\"},{\"pid\":\"2\",\"tags\":[true,false,null]},[],{}]",
+						   @"[ { k:pid s:1 k:src s:http://a } { k:pid s:2 k:tags [ true false null ] } [ ] { } ]");
+	MKTestStreamedResponse(transport, consumer, delegate,
+						   @"{\"uid\":100000123456789,\"photos\":{\"count\":-2,\"scale\":1.5}}",
+						   @"{ k:uid n:100000123456789 k:photos { k:count n:-2 k:scale n:1.5 } }");
+	MKTestStreamedResponse(transport, consumer, delegate, @"{}", @"{ }");
+	MKTestStreamedResponse(transport, consumer, delegate, @"[]", @"[ ]");
+
+	//starts like an error but isn't one, so it is replayed once it has been read
+	MKTestStreamedResponse(transport, consumer, delegate,
+						   @"{\"error_code\":[1,true,false,null,\"x\",{\"a\":2}]}",
+						   @"{ k:error_code [ n:1 true false null s:x { k:a n:2 } ] }");
+}
+
+
+//a Facebook error never reaches the consumer
+static void MKTestErrors(MKLoopbackTransport *transport, MKTestConsumer *consumer, MKTestDelegate *delegate)
+{
+	[transport removeAllResponses];
+	[transport addErrorCode:100 forMethod:@"test.stream.error"];
+	MKTestSend(@"test.stream.error", 3, consumer, delegate);
+	MKTestCheck(delegate->errorCount == 1 && delegate->lastErrorCode == 100, @"a streamed error 100 was delivered as %lu responses and %lu errors with code %lu", (unsigned long)delegate->responseCount, (unsigned long)delegate->errorCount, (unsigned long)delegate->lastErrorCode);
+	MKTestCheck([consumer->events count] == 0, @"a streamed error reached the consumer as %@", [consumer eventLine]);
+	MKTestCheck([transport requestCountForMethod:@"test.stream.error"] == 1, @"a streamed error 100 was sent %lu times", (unsigned long)[transport requestCountForMethod:@"test.stream.error"]);
+
+	//the retried attempt is the only one the consumer sees
+	[transport addErrorCode:2 forMethod:@"test.stream.retry"];
+	[transport addResponse:@"[1,2]" forMethod:@"test.stream.retry"];
+	MKTestSend(@"test.stream.retry", 2, consumer, delegate);
+	MKTestCheck(delegate->responseCount == 1 && delegate->lastResponse == nil, @"a retried streamed request was delivered as %lu responses and %lu errors", (unsigned long)delegate->responseCount, (unsigned long)delegate->errorCount);
+	MKTestCheck([[consumer eventLine] isEqualToString:@"[ n:1 n:2 ]"], @"a retried streamed request streamed as %@", [consumer eventLine]);
+	MKTestCheck([transport requestCountForMethod:@"test.stream.retry"] == 2, @"a streamed request after error 2 was sent %lu times", (unsigned long)[transport requestCountForMethod:@"test.stream.retry"]);
+
+	//events already sent stay sent, the delegate then hears that the response was no good
+	[transport addResponse:@"[1,2,x]" forMethod:@"test.stream.invalid"];
+	MKTestSend(@"test.stream.invalid", 1, consumer, delegate);
+	MKTestCheck(delegate->responseCount == 0 && delegate->errorCount == 1, @"an invalid streamed response was delivered as %lu responses and %lu errors", (unsigned long)delegate->responseCount, (unsigned long)delegate->errorCount);
+	MKTestCheck([[consumer eventLine] isEqualToString:@"[ n:1 n:2"], @"an invalid streamed response streamed as %@", [consumer eventLine]);
+}
+
+
+//events arrive while the response is still loading, from the threads the parse pool uses
+static void MKTestWhileLoading(MKLoopbackTransport *transport, MKTestConsumer *consumer, MKTestDelegate *delegate, NSUInteger concurrentParses)
+{
+	NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:300];
+	for (NSUInteger i = 0; i < 300; i++) {
+		[numbers addObject:@"7"];
+	}
+	//600 bytes at 2000 bytes a second take 0.3 seconds to arrive
+	[transport addResponse:[NSString stringWithFormat:@"[%@]", [numbers componentsJoinedByString:@","]] forMethod:@"test.stream.slow"];
+	transport.bytesPerSecond = 2000;
+	MKTestSend(@"test.stream.slow", 1, consumer, delegate);
+	transport.bytesPerSecond = 0;
+
+	MKTestCheck([consumer->events count] == 302, @"a slow response streamed %lu events, expected 302", (unsigned long)[consumer->events count]);
+	MKTestCheck(consumer->firstEventDate != nil && delegate->lastDeliveryDate != nil && [delegate->lastDeliveryDate timeIntervalSinceDate:consumer->firstEventDate] > 0.15, @"the first event of a slow response came %.3f seconds before the response was delivered", [delegate->lastDeliveryDate timeIntervalSinceDate:consumer->firstEventDate]);
+	if (concurrentParses == 0) {
+		MKTestCheck(consumer->otherThreadEventCount == 0, @"%lu events were sent off the main thread with parsing on the calling thread", (unsigned long)consumer->otherThreadEventCount);
+	} else {
+		MKTestCheck(consumer->mainThreadEventCount == 0, @"%lu events were sent on the main thread with %lu parses at a time", (unsigned long)consumer->mainThreadEventCount, (unsigned long)concurrentParses);
+	}
+}
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	MKLoopbackTransport *transport = [MKLoopbackTransport transport];
+	[MKFacebookRequest setDefaultTransport:transport];
+	[[MKFacebookCircuitBreaker sharedMKFacebookCircuitBreaker] setEnabled:NO];
+	MKTestConsumer *consumer = [[[MKTestConsumer alloc] init] autorelease];
+	MKTestDelegate *delegate = [[[MKTestDelegate alloc] init] autorelease];
+
+	NSUInteger concurrentParses[] = {4, 0};
+	for (NSUInteger i = 0; i < sizeof(concurrentParses) / sizeof(concurrentParses[0]); i++) {
+		NSAutoreleasePool *runPool = [[NSAutoreleasePool alloc] init];
+		[MKFacebookParsePool sharedMKFacebookParsePool].maximumConcurrentParses = concurrentParses[i];
+		[transport removeAllResponses];
+		MKTestEvents(transport, consumer, delegate);
+		MKTestErrors(transport, consumer, delegate);
+		MKTestWhileLoading(transport, consumer, delegate, concurrentParses[i]);
+		[runPool drain];
+	}
+
+	if (MKTestFailures == 0) {
+		NSLog(@"all checks passed");
+	} else {
+		NSLog(@"%d checks failed", MKTestFailures);
+	}
+
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}
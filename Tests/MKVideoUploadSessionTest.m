@@ -0,0 +1,241 @@
+//
+//  MKVideoUploadSessionTest.m
+//  MKAbeFook
+//
+//  Created by agent on 10/16/26.
+//  Copyright 2026 agent. All rights reserved.
+//
+
+/*
+ Uploads a file through MKVideoUploadSession against MKLoopbackTransport standing in for the video
+ server, and checks that progress never runs ahead of the video bytes actually written.
+
+ Build the framework first, then from the project directory:
+
+ gcc -std=c99 -framework Cocoa -F build/Release -framework MKAbeFook Tests/MKVideoUploadSessionTest.m -o build/MKVideoUploadSessionTest
+ DYLD_FRAMEWORK_PATH=build/Release build/MKVideoUploadSessionTest
+
+ Exits with 0 if every check passed.
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <MKAbeFook/MKAbeFook.h>
+#import <MKAbeFook/MKMultipartInputStream.h>
+
+static const unsigned long long MKTestFileSize = 1000000;
+static const unsigned long long MKTestChunkSize = 256 * 1024;
+
+static int MKTestFailures = 0;
+
+#define MKTestCheck(condition, ...) do { \
+	if (!(condition)) { \
+		MKTestFailures++; \
+		NSLog(@"FAILED: " __VA_ARGS__); \
+	} \
+} while (0)
+
+
+/*
+ Sits between a connection and its request and remembers how much of the body has been written
+ when the request is told about it.
+ */
+@interface MKTestBodyRecorder : NSObject {
+@public
+	id target;
+	NSInteger totalBytesWritten;
+}
+@end
+
+@implementation MKTestBodyRecorder
+
+- (void)dealloc
+{
+	[target release];
+	[super dealloc];
+}
+
+- (void)connection:(NSURLConnection *)connection didSendBodyData:(NSInteger)bytesWritten totalBytesWritten:(NSInteger)total totalBytesExpectedToWrite:(NSInteger)expected
+{
+	totalBytesWritten = total;
+	[target connection:connection didSendBodyData:bytesWritten totalBytesWritten:total totalBytesExpectedToWrite:expected];
+}
+
+- (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data
+{
+	[target connection:connection didReceiveData:data];
+}
+
+- (void)connectionDidFinishLoading:(NSURLConnection *)connection
+{
+	[target connectionDidFinishLoading:connection];
+}
+
+- (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error
+{
+	[target connection:connection didFailWithError:error];
+}
+
+@end
+
+
+/*
+ The loopback transport with a look at each body before it is sent: where the video part starts,
+ so progress can be compared with the video bytes written rather than with the whole body.
+ */
+@interface MKTestUploadTransport : MKLoopbackTransport {
+@public
+	NSData *fileData;
+	MKTestBodyRecorder *recorder;
+	unsigned long long chunkStart;		//offset of the part in the file
+	unsigned long long chunkLength;
+	NSUInteger chunkBodyOffset;			//where the part starts in the body
+}
+@end
+
+@implementation MKTestUploadTransport
+
+- (void)dealloc
+{
+	[fileData release];
+	[recorder release];
+	[super dealloc];
+}
+
+- (id)connectionWithRequest:(NSURLRequest *)urlRequest delegate:(id)aDelegate
+{
+	chunkLength = 0;
+	MKMultipartInputStream *bodyStream = (MKMultipartInputStream *)[urlRequest HTTPBodyStream];
+	if (bodyStream != nil) {
+		//read a copy, the request still sends the original
+		NSInputStream *copy = [bodyStream unopenedCopy];
+		NSMutableData *body = [NSMutableData data];
+		uint8_t buffer[16384];
+		NSInteger count;
+		[copy open];
+		while ((count = [copy read:buffer maxLength:sizeof(buffer)]) > 0) {
+			[body appendBytes:buffer length:count];
+		}
+		[copy close];
+
+		//the part is the only thing in the body that looks like the file
+		NSString *startOffset = nil;
+		const char *field = "name=\"start_offset\"\r\n\r\n";
+		const char *found = memmem([body bytes], [body length], field, strlen(field));
+		if (found != NULL) {
+			startOffset = [[[NSString alloc] initWithBytes:found + strlen(field) length:20 encoding:NSASCIIStringEncoding] autorelease];
+		}
+		chunkStart = [startOffset longLongValue];
+		chunkLength = MIN(MKTestChunkSize, MKTestFileSize - chunkStart);
+		const char *part = memmem([body bytes], [body length], (const char *)[fileData bytes] + chunkStart, (size_t)chunkLength);
+		MKTestCheck(part != NULL, @"the part starting at %llu is not in the body", chunkStart);
+		chunkBodyOffset = part != NULL ? (NSUInteger)(part - (const char *)[body bytes]) : 0;
+	}
+
+	[recorder release];
+	recorder = [[MKTestBodyRecorder alloc] init];
+	recorder->target = [aDelegate retain];
+	return [super connectionWithRequest:urlRequest delegate:recorder];
+}
+
+@end
+
+
+@interface MKTestUploadDelegate : NSObject {
+@public
+	MKTestUploadTransport *transport;
+	unsigned long long lastSentBytes;
+	NSUInteger progressCount;
+	BOOL finished;
+	BOOL failed;
+}
+@end
+
+@implementation MKTestUploadDelegate
+
+- (void)videoUploadSession:(MKVideoUploadSession *)session sentBytes:(unsigned long long)sentBytes ofBytes:(unsigned long long)totalBytes
+{
+	progressCount++;
+	MKTestCheck(totalBytes == MKTestFileSize, @"total is %llu", totalBytes);
+	MKTestCheck(sentBytes >= lastSentBytes, @"progress went back from %llu to %llu", lastSentBytes, sentBytes);
+	lastSentBytes = sentBytes;
+
+	//while a part is being written, only the video bytes of the body written so far count
+	if (transport->chunkLength > 0 && sentBytes > transport->chunkStart) {
+		NSInteger written = transport->recorder->totalBytesWritten;
+		unsigned long long videoWritten = written > (NSInteger)transport->chunkBodyOffset ? MIN((unsigned long long)(written - transport->chunkBodyOffset), transport->chunkLength) : 0;
+		MKTestCheck(sentBytes <= transport->chunkStart + videoWritten, @"progress %llu is ahead of the %llu video bytes written", sentBytes, transport->chunkStart + videoWritten);
+	}
+}
+
+- (void)videoUploadSession:(MKVideoUploadSession *)session didFinishWithResponse:(id)response
+{
+	finished = YES;
+}
+
+- (void)videoUploadSession:(MKVideoUploadSession *)session errorReceived:(MKFacebookResponseError *)error
+{
+	NSLog(@"error received: %@", error.errorMessage);
+	failed = YES;
+}
+
+- (void)videoUploadSession:(MKVideoUploadSession *)session failed:(NSError *)error
+{
+	NSLog(@"upload failed: %@", error);
+	failed = YES;
+}
+
+@end
+
+
+int main(int argc, const char *argv[])
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+	//random bytes, so the part can't be mistaken for anything else in the body
+	NSMutableData *fileData = [NSMutableData dataWithLength:(NSUInteger)MKTestFileSize];
+	uint32_t *words = [fileData mutableBytes];
+	for (NSUInteger i = 0; i < MKTestFileSize / sizeof(uint32_t); i++) {
+		words[i] = arc4random();
+	}
+	NSString *directory = NSTemporaryDirectory();
+	NSString *path = [directory stringByAppendingPathComponent:@"MKVideoUploadSessionTest.mov"];
+	NSString *checkpointPath = [directory stringByAppendingPathComponent:@"MKVideoUploadSessionTest.plist"];
+	[fileData writeToFile:path atomically:YES];
+	[[NSFileManager defaultManager] removeItemAtPath:checkpointPath error:nil];
+
+	//start, one transfer per part, finish. the server acknowledges each part with the next offset
+	MKTestUploadTransport *transport = [[[MKTestUploadTransport alloc] init] autorelease];
+	transport->fileData = [fileData retain];
+	transport.bytesPerSecond = 8 * 1024 * 1024;
+	[transport addResponse:@"{\"upload_session_id\":\"1\",\"video_id\":\"2\",\"start_offset\":\"0\"}" forMethod:@"video.upload"];
+	NSUInteger parts = 0;
+	for (unsigned long long offset = MKTestChunkSize; offset < MKTestFileSize + MKTestChunkSize; offset += MKTestChunkSize) {
+		[transport addResponse:[NSString stringWithFormat:@"{\"start_offset\":\"%llu\"}", MIN(offset, MKTestFileSize)] forMethod:@"video.upload"];
+		parts++;
+	}
+	[transport addResponse:@"{\"video_id\":\"2\",\"success\":true}" forMethod:@"video.upload"];
+	[MKFacebookRequest setDefaultTransport:transport];
+
+	MKTestUploadDelegate *delegate = [[[MKTestUploadDelegate alloc] init] autorelease];
+	delegate->transport = transport;
+	MKVideoUploadSession *session = [MKVideoUploadSession sessionWithFileURL:[NSURL fileURLWithPath:path] checkpointPath:checkpointPath delegate:delegate];
+	session.chunkSize = MKTestChunkSize;
+	[session start];
+
+	NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:30];
+	while (delegate->finished == NO && delegate->failed == NO && [timeout timeIntervalSinceNow] > 0) {
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+	}
+
+	MKTestCheck(delegate->finished == YES, @"the upload did not finish");
+	MKTestCheck(delegate->lastSentBytes == MKTestFileSize, @"progress ended at %llu", delegate->lastSentBytes);
+	MKTestCheck(delegate->progressCount > parts, @"only %lu progress updates for %lu parts", (unsigned long)delegate->progressCount, (unsigned long)parts);
+	MKTestCheck([transport requestCountForMethod:@"video.upload"] == parts + 2, @"%lu requests sent", (unsigned long)[transport requestCountForMethod:@"video.upload"]);
+
+	[[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+	[[NSFileManager defaultManager] removeItemAtPath:checkpointPath error:nil];
+
+	NSLog(@"%@", MKTestFailures == 0 ? @"all checks passed" : [NSString stringWithFormat:@"%d checks failed", MKTestFailures]);
+	[pool drain];
+	return MKTestFailures == 0 ? 0 : 1;
+}